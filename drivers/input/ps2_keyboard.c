@@ -5,12 +5,19 @@
 
 #include "kernel.h"
 #include "string.h"
+#include "timer.h"
+#include "workqueue.h"
+#include "tty.h"
+#include "idt.h"
 
 /* PS/2 Controller Ports */
 #define PS2_DATA_PORT    0x60
 #define PS2_STATUS_PORT  0x64
 #define PS2_COMMAND_PORT 0x64
 
+/* Legacy PIC line of the first port */
+#define PS2_KEYBOARD_IRQ 1
+
 /* PS/2 Status Register Bits */
 #define PS2_STATUS_OUTPUT_FULL  0x01
 #define PS2_STATUS_INPUT_FULL   0x02
@@ -110,26 +117,17 @@ static void outb(uint16_t port, uint8_t val) {
     __asm__ __volatile__("outb %0, %1" : : "a"(val), "Nd"(port));
 }
 
+/* Controller response bound; polled, as these run from the IRQ path too */
+#define PS2_TIMEOUT_US   10000
+
 /* Wait for PS/2 controller to be ready for reading */
 static bool ps2_wait_read(void) {
-    int timeout = 100000;
-    while (timeout-- > 0) {
-        if (inb(PS2_STATUS_PORT) & PS2_STATUS_OUTPUT_FULL) {
-            return true;
-        }
-    }
-    return false;
+    return poll_timeout(inb(PS2_STATUS_PORT) & PS2_STATUS_OUTPUT_FULL, 0, PS2_TIMEOUT_US) == 0;
 }
 
 /* Wait for PS/2 controller to be ready for writing */
 static bool ps2_wait_write(void) {
-    int timeout = 100000;
-    while (timeout-- > 0) {
-        if (!(inb(PS2_STATUS_PORT) & PS2_STATUS_INPUT_FULL)) {
-            return true;
-        }
-    }
-    return false;
+    return poll_timeout(!(inb(PS2_STATUS_PORT) & PS2_STATUS_INPUT_FULL), 0, PS2_TIMEOUT_US) == 0;
 }
 
 /* Send command to PS/2 controller */
@@ -276,6 +274,18 @@ static char process_scancode(uint8_t scancode) {
     return ch;
 }
 
+/* Security events noticed in the interrupt handler, logged from a worker */
+static struct work_struct kb_log_work;
+static volatile uint32_t kb_secure_keys;
+
+static void keyboard_log_work(struct work_struct *work) {
+    (void)work;
+    uint32_t count = __sync_lock_test_and_set(&kb_secure_keys, 0);
+    if (count) {
+        KLOG_INFO("Secure input: %u special key(s) pressed", count);
+    }
+}
+
 /* Keyboard interrupt handler */
 void keyboard_interrupt_handler(void) {
     uint8_t status = inb(PS2_STATUS_PORT);
@@ -291,20 +301,30 @@ void keyboard_interrupt_handler(void) {
     
     /* Handle special keys and security events */
     if (ch) {
-        /* For now, just output to console */
-        console_putc(ch);
+        /* The console TTY edits, echoes and queues it for readers */
+        tty_receive(console_tty(), &ch, 1);
         
-        /* Security logging for sensitive keys */
+        /* Security logging for sensitive keys, deferred out of the IRQ */
         if (kb_state.secure_input && (ch == '\n' || ch == '\t')) {
-            KLOG_INFO("Secure input: special key pressed");
+            __sync_fetch_and_add(&kb_secure_keys, 1);
+            schedule_work(&kb_log_work);
         }
     }
 }
 
+/* IRQ1 entry: the PIC takes its EOI once the byte is consumed */
+static void keyboard_irq(struct pt_regs *regs) {
+    (void)regs;
+    keyboard_interrupt_handler();
+    pic_eoi(PS2_KEYBOARD_IRQ);
+}
+
 /* Initialize PS/2 keyboard */
 void keyboard_init(void) {
     KLOG_INFO("Initializing PS/2 keyboard with Pentagon-level security...");
     
+    INIT_WORK(&kb_log_work, keyboard_log_work);
+    
     /* Initialize keyboard state */
     memset(&kb_state, 0, sizeof(kb_state));
     kb_state.num_lock = true; /* Enable num lock by default */
@@ -381,6 +401,13 @@ void keyboard_init(void) {
     ps2_send_command(PS2_CMD_WRITE_CONFIG);
     ps2_send_data(config);
     
+    /* Route IRQ1 through the remapped PIC */
+    if (idt_register_handler(PIC_IRQ_BASE + PS2_KEYBOARD_IRQ, keyboard_irq) < 0) {
+        KLOG_ERR("Keyboard IRQ vector already taken");
+        return;
+    }
+    pic_unmask_irq(PS2_KEYBOARD_IRQ);
+    
     kb_state.initialized = true;
     
     KLOG_INFO("PS/2 keyboard initialized successfully");
@@ -5,6 +5,7 @@
 
 #include "kernel.h"
 #include "string.h"
+#include "timer.h"
 
 /* E1000 Register Offsets */
 #define E1000_CTRL     0x00000  /* Device Control */
@@ -118,14 +119,10 @@ static uint16_t e1000_read_eeprom(uint8_t addr) {
     
     e1000_write32(E1000_EERD, (addr << 8) | 1);
     
-    /* Wait for read completion */
-    while (!((data = e1000_read32(E1000_EERD)) & 0x10)) {
-        /* Busy wait with security timeout */
-        static int timeout = 1000;
-        if (--timeout <= 0) {
-            KLOG_ERR("EEPROM read timeout");
-            return 0;
-        }
+    /* Wait for read completion; takes microseconds, bounded at 10 ms */
+    if (poll_timeout((data = e1000_read32(E1000_EERD)) & 0x10, 0, 10000) < 0) {
+        KLOG_ERR("EEPROM read timeout");
+        return 0;
     }
     
     return (data >> 16) & 0xFFFF;
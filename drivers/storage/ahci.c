@@ -5,6 +5,11 @@
 
 #include "kernel.h"
 #include "string.h"
+#include "timer.h"
+#include "ktime.h"
+#include "wait.h"
+#include "idt.h"
+#include "sched.h"
 
 /* AHCI Register Offsets */
 #define AHCI_CAP        0x00  /* Host Capabilities */
@@ -33,6 +38,7 @@
 #define AHCI_MAX_PORTS  32
 #define AHCI_MAX_CMDS   32
 #define AHCI_SECTOR_SIZE 512
+#define AHCI_CMD_TIMEOUT_MS 5000
 
 /* Port Command Register Bits */
 #define AHCI_PxCMD_ST   0x00000001  /* Start */
@@ -44,6 +50,10 @@
 #define AHCI_PxCMD_CR   0x00008000  /* Command List Running */
 #define AHCI_PxCMD_FR   0x00004000  /* FIS Receive Running */
 
+/* Port Interrupt Status Bits */
+#define AHCI_PxIS_DHRS  0x00000001  /* Device to Host Register FIS */
+#define AHCI_PxIS_TFES  0x40000000  /* Task File Error */
+
 /* ATA Commands */
 #define ATA_CMD_READ_DMA_EX     0x25
 #define ATA_CMD_WRITE_DMA_EX    0x35
@@ -129,6 +139,10 @@ struct ahci_port {
     bool encryption_enabled;
     uint8_t encryption_key[32];
     
+    /* Command completion, signalled from the interrupt handler */
+    volatile uint32_t issued;
+    struct completion cmd_done[AHCI_MAX_CMDS];
+    
     /* Statistics */
     uint64_t reads;
     uint64_t writes;
@@ -141,6 +155,7 @@ struct ahci_controller {
     uint32_t ports_implemented;
     uint32_t num_ports;
     struct ahci_port ports[AHCI_MAX_PORTS];
+    bool irq_enabled;       /* Completions arrive by MSI; otherwise PxCI is polled */
     bool initialized;
 } ahci_ctrl;
 
@@ -164,16 +179,10 @@ static void ahci_port_write32(uint32_t port, uint32_t offset, uint32_t value) {
     ahci_write32(port_base + offset, value);
 }
 
-/* Wait for port to be ready */
+/* Wait for port to be ready (BSY and DRQ clear), sleeping between polls */
 static bool ahci_port_wait_ready(uint32_t port, uint32_t timeout_ms) {
-    for (uint32_t i = 0; i < timeout_ms; i++) {
-        uint32_t tfd = ahci_port_read32(port, AHCI_PxTFD);
-        if (!(tfd & 0x88)) return true; /* BSY and DRQ clear */
-        
-        /* Simple delay (not accurate timing) */
-        for (volatile int j = 0; j < 1000; j++);
-    }
-    return false;
+    return poll_timeout(!(ahci_port_read32(port, AHCI_PxTFD) & 0x88),
+                        10, timeout_ms * 1000) == 0;
 }
 
 /* Stop port */
@@ -245,6 +254,12 @@ static void ahci_init_port(uint32_t port_num) {
     ahci_port_write32(port_num, AHCI_PxSERR, 0xFFFFFFFF);
     ahci_port_write32(port_num, AHCI_PxIS, 0xFFFFFFFF);
     
+    /* Interrupt on D2H register FIS and on task file errors */
+    for (int i = 0; i < AHCI_MAX_CMDS; i++) {
+        init_completion(&port->cmd_done[i]);
+    }
+    ahci_port_write32(port_num, AHCI_PxIE, AHCI_PxIS_DHRS | AHCI_PxIS_TFES);
+    
     /* Start port */
     ahci_port_start(port_num);
     
@@ -253,6 +268,71 @@ static void ahci_init_port(uint32_t port_num) {
     KLOG_INFO("AHCI port %u initialized", port_num);
 }
 
+/* Complete finished command slots of one port (interrupt context) */
+static void ahci_port_interrupt(struct ahci_port *port) {
+    uint32_t is = ahci_port_read32(port->port_num, AHCI_PxIS);
+    ahci_port_write32(port->port_num, AHCI_PxIS, is);
+    
+    /* On a task file error every outstanding slot is finished (failed) */
+    uint32_t pending = (is & AHCI_PxIS_TFES) ? 0 : ahci_port_read32(port->port_num, AHCI_PxCI);
+    uint32_t done = port->issued & ~pending;
+    __sync_fetch_and_and(&port->issued, ~done);
+    
+    while (done) {
+        int slot = __builtin_ctz(done);
+        done &= done - 1;
+        complete(&port->cmd_done[slot]);
+    }
+}
+
+/* AHCI interrupt handler */
+void ahci_interrupt_handler(void) {
+    uint32_t is = ahci_read32(AHCI_IS);
+    
+    for (uint32_t i = 0; i < ahci_ctrl.num_ports; i++) {
+        if ((is & (1U << i)) && ahci_ctrl.ports[i].active) {
+            ahci_port_interrupt(&ahci_ctrl.ports[i]);
+        }
+    }
+    ahci_write32(AHCI_IS, is);
+}
+
+static void ahci_msi_interrupt(struct pt_regs *regs) {
+    (void)regs;
+    ahci_interrupt_handler();
+    lapic_eoi();
+}
+
+/*
+ * Wait for an issued command slot against a ktime deadline. With the MSI
+ * wired the caller sleeps on the slot's completion a tick at a time; without
+ * it, or with interrupts off, PxCI/PxIS are polled directly.
+ */
+static bool ahci_wait_command(struct ahci_port *port, int slot) {
+    uint32_t port_num = port->port_num;
+    uint64_t deadline = ktime_get_ns() + AHCI_CMD_TIMEOUT_MS * NSEC_PER_MSEC;
+    
+    while (!try_wait_for_completion(&port->cmd_done[slot])) {
+        if (!(ahci_port_read32(port_num, AHCI_PxCI) & (1U << slot)) ||
+            (ahci_port_read32(port_num, AHCI_PxIS) & AHCI_PxIS_TFES)) {
+            break;
+        }
+        if (ktime_get_ns() > deadline) {
+            __sync_fetch_and_and(&port->issued, ~(1U << slot));
+            KLOG_ERR("AHCI command timeout on port %u slot %d", port_num, slot);
+            return false;
+        }
+        if (ahci_ctrl.irq_enabled && sched_can_block()) {
+            wait_for_completion_timeout(&port->cmd_done[slot], 1);
+        } else {
+            cpu_relax();
+        }
+    }
+    __sync_fetch_and_and(&port->issued, ~(1U << slot));
+    
+    return !(ahci_port_read32(port_num, AHCI_PxTFD) & 0x01); /* ERR */
+}
+
 /* Read sectors from disk */
 int ahci_read_sectors(uint32_t port_num, uint64_t start_lba, uint32_t sector_count, uint8_t *buffer) {
     if (port_num >= AHCI_MAX_PORTS || !ahci_ctrl.ports[port_num].active) {
@@ -315,17 +395,15 @@ int ahci_read_sectors(uint32_t port_num, uint64_t start_lba, uint32_t sector_cou
     }
     
     /* Issue command */
+    reinit_completion(&port->cmd_done[slot]);
+    __sync_fetch_and_or(&port->issued, 1U << slot);
     ahci_port_write32(port_num, AHCI_PxCI, 1 << slot);
     
-    /* Wait for completion */
-    while (ahci_port_read32(port_num, AHCI_PxCI) & (1 << slot)) {
-        /* Check for errors */
-        uint32_t is = ahci_port_read32(port_num, AHCI_PxIS);
-        if (is & 0x40000000) {
-            KLOG_ERR("AHCI read error on port %u", port_num);
-            port->errors++;
-            return -1;
-        }
+    /* Sleep until the interrupt handler completes the slot */
+    if (!ahci_wait_command(port, slot)) {
+        KLOG_ERR("AHCI read error on port %u", port_num);
+        port->errors++;
+        return -1;
     }
     
     port->reads++;
@@ -348,11 +426,15 @@ int ahci_write_sectors(uint32_t port_num, uint64_t start_lba, uint32_t sector_co
     return sector_count;
 }
 
-/* Initialize AHCI Controller */
-void ahci_init(uint64_t mmio_base) {
+/* Initialize AHCI Controller; msi says the PCI layer routed it to AHCI_MSI_VECTOR */
+void ahci_init(uint64_t mmio_base, bool msi) {
     KLOG_INFO("Initializing AHCI SATA controller...");
     
     ahci_ctrl.mmio_base = mmio_base;
+    ahci_ctrl.irq_enabled = msi && idt_register_handler(AHCI_MSI_VECTOR, ahci_msi_interrupt) == 0;
+    if (!ahci_ctrl.irq_enabled) {
+        KLOG_WARN("AHCI interrupt not routed, polling for command completion");
+    }
     
     /* Check AHCI version */
     uint32_t version = ahci_read32(AHCI_VS);
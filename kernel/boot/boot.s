@@ -86,10 +86,11 @@ gdt64_code:
     .quad 0x00af9a000000ffff    # Kernel code segment
 gdt64_data:
     .quad 0x00af92000000ffff    # Kernel data segment
-gdt64_user_code:
-    .quad 0x00affa000000ffff    # User code segment  
+# SYSRET takes SS from STAR + 8 and CS from STAR + 16: user data comes first
 gdt64_user_data:
-    .quad 0x00aff2000000ffff    # User data segment
+    .quad 0x00aff2000000ffff    # User data segment (0x18)
+gdt64_user_code:
+    .quad 0x00affa000000ffff    # User code segment (0x20)
 gdt64_end:
 
 gdt64_pointer:
@@ -0,0 +1,460 @@
+/*
+ * SentinalOS Syscall Audit
+ * Compiled Rule Filter and Binary Event Rings
+ */
+
+#include "kernel.h"
+#include "string.h"
+#include "smp.h"
+#include "ktime.h"
+#include "spinlock.h"
+#include "preempt.h"
+#include "rcu.h"
+#include "audit.h"
+
+/* lib/string.c */
+int snprintf(char *buf, size_t size, const char *fmt, ...);
+
+/* Records buffered per CPU until a consumer drains them */
+#define AUDIT_RING_SIZE         256
+
+/* Program opcode that ends a rule: value is the action, arg the rule id */
+#define AUDIT_RET               0
+
+/*
+ * One step of a decision program: compare 'field' with 'value' and go on
+ * to the next instruction on success or to 'fail' otherwise. Path
+ * comparisons take the string at offset 'value' in the ruleset's string
+ * pool, 'arg' bytes long.
+ */
+struct audit_insn {
+    uint8_t op;
+    uint8_t field;
+    uint16_t resv;
+    uint32_t fail;
+    uint32_t arg;
+    int64_t value;
+};
+
+/* Compiled rules, replaced as a whole under RCU on every change */
+struct audit_ruleset {
+    uint32_t prog[AUDIT_NR_SYSCALLS];   /* Start of each syscall's program */
+    uint32_t nr_insns;
+    char *strings;
+    struct rcu_head rcu;
+    struct audit_insn insns[];
+};
+
+struct audit_ring {
+    volatile uint32_t head;     /* Consumer */
+    volatile uint32_t tail;     /* Producer: this CPU, preemption disabled */
+    uint32_t serial;
+    uint64_t recorded;
+    uint64_t lost;
+    struct audit_record records[AUDIT_RING_SIZE];
+} __aligned(64);
+
+uint64_t audit_syscall_mask[AUDIT_NR_SYSCALLS / 64];
+
+static struct audit_ruleset *audit_ruleset;
+static struct audit_ring audit_rings[MAX_CPUS];
+
+/* Rules in match order; the lock also serialises compilation */
+static spinlock_t audit_rules_lock;
+static struct audit_rule audit_rules[AUDIT_MAX_RULES];
+static uint16_t audit_rule_ids[AUDIT_MAX_RULES];
+static uint32_t nr_audit_rules;
+static uint16_t audit_next_id = 1;
+static uint64_t audit_rule_masks[AUDIT_NR_SYSCALLS];
+
+/* Consumers drain all rings in turn */
+static spinlock_t audit_read_lock;
+
+static bool audit_rule_has_syscall(const struct audit_rule *rule, uint32_t nr) {
+    bool any = false;
+    for (uint32_t i = 0; i < AUDIT_NR_SYSCALLS / 64; i++) {
+        any |= rule->syscalls[i] != 0;
+    }
+    return !any || ((rule->syscalls[nr / 64] >> (nr % 64)) & 1);
+}
+
+/*
+ * Emit the program for the rules in 'mask' at insns[start], or just
+ * count its instructions if insns is NULL. Path strings are appended to
+ * the pool at *str_len. Returns the number of instructions.
+ */
+static uint32_t audit_emit_program(struct audit_insn *insns, uint32_t start, uint64_t mask,
+                                   char *strings, uint32_t *str_len) {
+    uint32_t n = start;
+    
+    for (uint32_t r = 0; r < nr_audit_rules; r++) {
+        if (!((mask >> r) & 1)) {
+            continue;
+        }
+        
+        const struct audit_rule *rule = &audit_rules[r];
+        uint32_t next = n + rule->nr_fields + 1;
+        for (uint32_t f = 0; f < rule->nr_fields; f++, n++) {
+            const struct audit_field *field = &rule->fields[f];
+            if (!insns) {
+                *str_len += field->type == AUDIT_PATH ? strlen(field->path) : 0;
+                continue;
+            }
+            
+            struct audit_insn *insn = &insns[n];
+            insn->op = field->op;
+            insn->field = field->type;
+            insn->fail = next;
+            insn->value = field->value;
+            insn->arg = 0;
+            if (field->type == AUDIT_PATH) {
+                uint32_t len = strlen(field->path);
+                memcpy(strings + *str_len, field->path, len);
+                insn->value = *str_len;
+                insn->arg = len;
+                *str_len += len;
+            }
+        }
+        if (insns) {
+            insns[n] = (struct audit_insn){ .op = AUDIT_RET, .value = rule->action,
+                                            .arg = audit_rule_ids[r] };
+        }
+        n++;
+    }
+    
+    /* No rule matched */
+    if (insns) {
+        insns[n] = (struct audit_insn){ .op = AUDIT_RET, .value = AUDIT_NEVER };
+    }
+    n++;
+    
+    return n - start;
+}
+
+static void audit_ruleset_free(struct rcu_head *head) {
+    kfree(rcu_entry(head, struct audit_ruleset, rcu));
+}
+
+/*
+ * Compile the rule list and publish it. Syscalls matched by the same
+ * rules share one program. Instruction 0 always rejects, so syscalls
+ * without rules need no program. Called with audit_rules_lock held.
+ */
+static int audit_compile(void) {
+    uint32_t nr_insns = 1, str_len = 0;
+    uint64_t shared_from[AUDIT_NR_SYSCALLS / 64] = { 0 };
+    
+    for (uint32_t nr = 0; nr < AUDIT_NR_SYSCALLS; nr++) {
+        uint64_t mask = 0;
+        for (uint32_t r = 0; r < nr_audit_rules; r++) {
+            if (audit_rule_has_syscall(&audit_rules[r], nr)) {
+                mask |= 1ULL << r;
+            }
+        }
+        audit_rule_masks[nr] = mask;
+        if (!mask) {
+            continue;
+        }
+        
+        bool shared = false;
+        for (uint32_t prev = 0; prev < nr && !shared; prev++) {
+            shared = audit_rule_masks[prev] == mask;
+        }
+        if (shared) {
+            shared_from[nr / 64] |= 1ULL << (nr % 64);
+            continue;
+        }
+        nr_insns += audit_emit_program(NULL, 0, mask, NULL, &str_len);
+    }
+    
+    struct audit_ruleset *rs = kmalloc(sizeof(*rs) + nr_insns * sizeof(struct audit_insn) +
+                                       str_len + 1);
+    if (!rs) {
+        return -12; /* ENOMEM */
+    }
+    memset(rs, 0, sizeof(*rs));
+    rs->strings = (char *)&rs->insns[nr_insns];
+    rs->insns[0] = (struct audit_insn){ .op = AUDIT_RET, .value = AUDIT_NEVER };
+    
+    uint32_t n = 1;
+    str_len = 0;
+    uint64_t new_mask[AUDIT_NR_SYSCALLS / 64] = { 0 };
+    for (uint32_t nr = 0; nr < AUDIT_NR_SYSCALLS; nr++) {
+        uint64_t mask = audit_rule_masks[nr];
+        if (!mask) {
+            continue;
+        }
+        
+        new_mask[nr / 64] |= 1ULL << (nr % 64);
+        if ((shared_from[nr / 64] >> (nr % 64)) & 1) {
+            for (uint32_t prev = 0; prev < nr; prev++) {
+                if (audit_rule_masks[prev] == mask) {
+                    rs->prog[nr] = rs->prog[prev];
+                    break;
+                }
+            }
+            continue;
+        }
+        rs->prog[nr] = n;
+        n += audit_emit_program(rs->insns, n, mask, rs->strings, &str_len);
+    }
+    rs->nr_insns = n;
+    
+    /*
+     * Publish the programs before the bitmap. A syscall that sees a
+     * stale bit runs the new program, which rejects it if it has none.
+     */
+    struct audit_ruleset *old = audit_ruleset;
+    rcu_assign_pointer(audit_ruleset, rs);
+    for (uint32_t i = 0; i < AUDIT_NR_SYSCALLS / 64; i++) {
+        __atomic_store_n(&audit_syscall_mask[i], new_mask[i], __ATOMIC_RELEASE);
+    }
+    if (old) {
+        call_rcu(&old->rcu, audit_ruleset_free);
+    }
+    
+    return 0;
+}
+
+/* Is 'path' terminated within AUDIT_PATH_MAX bytes? */
+static bool audit_path_valid(const char *path) {
+    for (uint32_t i = 0; i < AUDIT_PATH_MAX; i++) {
+        if (!path[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int audit_check_rule(const struct audit_rule *rule) {
+    if (rule->action != AUDIT_NEVER && rule->action != AUDIT_ALWAYS) {
+        return -22; /* EINVAL */
+    }
+    if (rule->nr_fields > AUDIT_MAX_FIELDS) {
+        return -22; /* EINVAL */
+    }
+    for (uint32_t f = 0; f < rule->nr_fields; f++) {
+        const struct audit_field *field = &rule->fields[f];
+        if (field->type < AUDIT_UID || field->type > AUDIT_RESULT ||
+            field->op < AUDIT_EQ || field->op > AUDIT_PREFIX) {
+            return -22; /* EINVAL */
+        }
+        if ((field->op == AUDIT_PREFIX) != (field->type == AUDIT_PATH) ||
+            (field->type == AUDIT_PATH && !audit_path_valid(field->path))) {
+            return -22; /* EINVAL */
+        }
+    }
+    return 0;
+}
+
+/* Append a rule; returns its id, or a negative errno */
+int audit_add_rule(const struct audit_rule *rule) {
+    int ret = audit_check_rule(rule);
+    if (ret < 0) {
+        return ret;
+    }
+    
+    spin_lock(&audit_rules_lock);
+    if (nr_audit_rules >= AUDIT_MAX_RULES) {
+        spin_unlock(&audit_rules_lock);
+        return -28; /* ENOSPC */
+    }
+    
+    uint32_t r = nr_audit_rules++;
+    audit_rules[r] = *rule;
+    audit_rule_ids[r] = audit_next_id++;
+    if (!audit_next_id) {
+        audit_next_id = 1;
+    }
+    ret = audit_compile();
+    if (ret < 0) {
+        nr_audit_rules--;
+    } else {
+        ret = audit_rule_ids[r];
+    }
+    spin_unlock(&audit_rules_lock);
+    
+    return ret;
+}
+
+int audit_del_rule(int id) {
+    spin_lock(&audit_rules_lock);
+    for (uint32_t r = 0; r < nr_audit_rules; r++) {
+        if (audit_rule_ids[r] != id) {
+            continue;
+        }
+        
+        for (uint32_t i = r + 1; i < nr_audit_rules; i++) {
+            audit_rules[i - 1] = audit_rules[i];
+            audit_rule_ids[i - 1] = audit_rule_ids[i];
+        }
+        nr_audit_rules--;
+        int ret = audit_compile();
+        spin_unlock(&audit_rules_lock);
+        return ret;
+    }
+    spin_unlock(&audit_rules_lock);
+    
+    return -2; /* ENOENT */
+}
+
+void audit_clear_rules(void) {
+    spin_lock(&audit_rules_lock);
+    nr_audit_rules = 0;
+    audit_compile();
+    spin_unlock(&audit_rules_lock);
+}
+
+/*
+ * Boot policy: every syscall made at security level 2 or above, as
+ * syscall_handler() used to log unconditionally.
+ */
+void audit_default_rules(void) {
+    struct audit_rule rule;
+    
+    memset(&rule, 0, sizeof(rule));
+    rule.action = AUDIT_ALWAYS;
+    rule.nr_fields = 1;
+    rule.fields[0].type = AUDIT_LEVEL;
+    rule.fields[0].op = AUDIT_GE;
+    rule.fields[0].value = 2;
+    
+    audit_clear_rules();
+    audit_add_rule(&rule);
+}
+
+void audit_init(void) {
+    spin_lock_init(&audit_rules_lock);
+    spin_lock_init(&audit_read_lock);
+    memset(audit_rings, 0, sizeof(audit_rings));
+    audit_default_rules();
+    KLOG_INFO("Syscall audit: %u rules, %u records per CPU", nr_audit_rules, AUDIT_RING_SIZE);
+}
+
+static inline bool audit_compare(int64_t a, uint8_t op, int64_t b) {
+    switch (op) {
+        case AUDIT_EQ: return a == b;
+        case AUDIT_NE: return a != b;
+        case AUDIT_LT: return a < b;
+        case AUDIT_LE: return a <= b;
+        case AUDIT_GT: return a > b;
+        case AUDIT_GE: return a >= b;
+        default:       return false;
+    }
+}
+
+/* Run a decision program; returns the matching rule id, or 0 */
+static uint16_t audit_run(const struct audit_ruleset *rs, uint32_t pc,
+                          const struct audit_event *event) {
+    for (;;) {
+        const struct audit_insn *insn = &rs->insns[pc];
+        bool match;
+        
+        switch (insn->field) {
+            case AUDIT_UID:
+                match = audit_compare(event->uid, insn->op, insn->value);
+                break;
+            case AUDIT_LEVEL:
+                match = audit_compare(event->level, insn->op, insn->value);
+                break;
+            case AUDIT_RESULT:
+                match = audit_compare(event->result, insn->op, insn->value);
+                break;
+            case AUDIT_PATH:
+                match = event->path &&
+                        strncmp(event->path, rs->strings + insn->value, insn->arg) == 0;
+                break;
+            default:
+                /* AUDIT_RET */
+                return insn->value == AUDIT_ALWAYS ? (uint16_t)insn->arg : 0;
+        }
+        pc = match ? pc + 1 : insn->fail;
+    }
+}
+
+static void audit_record(const struct audit_event *event, uint16_t rule) {
+    preempt_disable();
+    uint32_t cpu = smp_processor_id();
+    struct audit_ring *ring = &audit_rings[cpu];
+    uint32_t tail = ring->tail;
+    
+    if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) >= AUDIT_RING_SIZE) {
+        ring->lost++;
+        preempt_enable();
+        return;
+    }
+    
+    struct audit_record *rec = &ring->records[tail % AUDIT_RING_SIZE];
+    rec->timestamp = ktime_get_ns();
+    rec->serial = ring->serial++;
+    rec->cpu = cpu;
+    rec->syscall = event->syscall;
+    rec->pid = event->pid;
+    rec->uid = event->uid;
+    rec->result = event->result;
+    rec->args[0] = event->args[0];
+    rec->args[1] = event->args[1];
+    rec->args[2] = event->args[2];
+    rec->level = event->level;
+    rec->rule = rule;
+    ring->recorded++;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    preempt_enable();
+}
+
+/* Filter a completed syscall whose bit is set in audit_syscall_mask */
+void audit_syscall_exit(const struct audit_event *event) {
+    if (event->syscall >= AUDIT_NR_SYSCALLS) {
+        return;
+    }
+    
+    rcu_read_lock();
+    struct audit_ruleset *rs = rcu_dereference(audit_ruleset);
+    uint16_t rule = rs ? audit_run(rs, rs->prog[event->syscall], event) : 0;
+    rcu_read_unlock();
+    
+    if (rule) {
+        audit_record(event, rule);
+    }
+}
+
+/* Move up to 'max' buffered records out of the rings, oldest first per CPU */
+uint32_t audit_read(struct audit_record *records, uint32_t max) {
+    uint32_t n = 0;
+    
+    spin_lock(&audit_read_lock);
+    for (uint32_t cpu = 0; cpu < smp_num_cpus() && n < max; cpu++) {
+        struct audit_ring *ring = &audit_rings[cpu];
+        uint32_t head = ring->head;
+        uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        
+        while (head != tail && n < max) {
+            records[n++] = ring->records[head % AUDIT_RING_SIZE];
+            head++;
+        }
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    }
+    spin_unlock(&audit_read_lock);
+    
+    return n;
+}
+
+int audit_format(const struct audit_record *record, char *buf, size_t size) {
+    return snprintf(buf, size,
+                    "audit(%lu:%u/%u): rule=%u syscall=%u pid=%u uid=%u level=%u "
+                    "result=%ld a0=%lx a1=%lx a2=%lx",
+                    record->timestamp, record->cpu, record->serial, record->rule,
+                    record->syscall, record->pid, record->uid, record->level,
+                    (long)record->result, record->args[0], record->args[1], record->args[2]);
+}
+
+void audit_get_stats(uint64_t *recorded, uint64_t *lost) {
+    uint64_t total_recorded = 0, total_lost = 0;
+    for (uint32_t cpu = 0; cpu < smp_num_cpus(); cpu++) {
+        total_recorded += audit_rings[cpu].recorded;
+        total_lost += audit_rings[cpu].lost;
+    }
+    
+    if (recorded) *recorded = total_recorded;
+    if (lost) *lost = total_lost;
+}
\ No newline at end of file
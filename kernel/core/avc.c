@@ -0,0 +1,172 @@
+/*
+ * SentinalOS Access Vector Cache
+ * Per-CPU Memoization of Security Decisions
+ */
+
+#include "kernel.h"
+#include "string.h"
+#include "smp.h"
+#include "avc.h"
+#include "preempt.h"
+
+/* Per-CPU cache geometry: AVC_SETS sets of AVC_WAYS entries */
+#define AVC_SETS                128
+#define AVC_WAYS                4
+
+/* Longest object name cached; decisions on longer ones are always computed */
+#define AVC_NAME_MAX            64
+
+struct avc_entry {
+    struct avc_key key;         /* key.name is not kept: see name */
+    int decision;
+    uint32_t seqno;             /* Policy generation the decision was made under */
+    char name[AVC_NAME_MAX];    /* Copy of the object name, "" if none */
+};
+
+struct avc_cache {
+    struct avc_entry entries[AVC_SETS][AVC_WAYS];
+    uint8_t victim[AVC_SETS];   /* Next way to replace, round robin */
+    uint64_t hits;
+    uint64_t misses;
+} __aligned(64);
+
+static struct avc_cache avc_caches[MAX_CPUS];
+
+/* Policy generation; starts at 1 so zeroed entries never match */
+static volatile uint32_t avc_seqno = 1;
+static volatile bool avc_enabled = true;
+static uint64_t avc_invalidations;
+
+/* FNV-1a over a string */
+static uint64_t avc_hash_string(const char *s) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    while (*s) {
+        hash ^= (uint8_t)*s++;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* Subject identifier for a security context string */
+uint64_t avc_context_sid(const char *context) {
+    return context ? avc_hash_string(context) : 0;
+}
+
+/* Object identifier for a path */
+uint64_t avc_path_hash(const char *path) {
+    return path ? avc_hash_string(path) : 0;
+}
+
+static inline uint32_t avc_hash(const struct avc_key *key) {
+    uint64_t h = key->ssid ^ (key->object * 0x9e3779b97f4a7c15ULL);
+    h ^= ((uint64_t)key->suid << 32) | ((uint64_t)key->op << 16) | ((uint64_t)key->tclass << 8) |
+         ((uint64_t)key->slevel << 4) | key->olevel;
+    h ^= h >> 29;
+    return (uint32_t)h & (AVC_SETS - 1);
+}
+
+static inline bool avc_key_equal(const struct avc_key *a, const struct avc_key *b) {
+    return a->ssid == b->ssid && a->object == b->object && a->suid == b->suid &&
+           a->op == b->op && a->tclass == b->tclass && a->slevel == b->slevel &&
+           a->olevel == b->olevel;
+}
+
+/* A cached decision applies to 'key' only for the very same object name */
+static inline bool avc_entry_match(const struct avc_entry *entry, const struct avc_key *key) {
+    return avc_key_equal(&entry->key, key) &&
+           strcmp(entry->name, key->name ? key->name : "") == 0;
+}
+
+/*
+ * Check a permission: return the cached decision for 'key' if it was made
+ * under the current policy, else compute it with compute(key, data) and
+ * cache the result on this CPU. Preemption is off while a CPU's cache is
+ * touched, but not across compute().
+ */
+int avc_has_perm(const struct avc_key *key, avc_compute_t compute, const void *data) {
+    if (!avc_enabled) {
+        return compute(key, data);
+    }
+    
+    uint32_t set = avc_hash(key);
+    uint32_t seqno = avc_seqno;
+    
+    preempt_disable();
+    struct avc_cache *cache = &avc_caches[smp_processor_id()];
+    for (uint32_t way = 0; way < AVC_WAYS; way++) {
+        struct avc_entry *entry = &cache->entries[set][way];
+        if (entry->seqno == seqno && avc_entry_match(entry, key)) {
+            int decision = entry->decision;
+            cache->hits++;
+            preempt_enable();
+            return decision;
+        }
+    }
+    cache->misses++;
+    preempt_enable();
+    
+    int decision = compute(key, data);
+    size_t name_len = key->name ? strlen(key->name) : 0;
+    if (name_len >= AVC_NAME_MAX) {
+        return decision;
+    }
+    
+    /* We may have moved to another CPU meanwhile */
+    preempt_disable();
+    cache = &avc_caches[smp_processor_id()];
+    struct avc_entry *entry = &cache->entries[set][cache->victim[set]];
+    cache->victim[set] = (cache->victim[set] + 1) % AVC_WAYS;
+    entry->key = *key;
+    entry->key.name = NULL;
+    memcpy(entry->name, key->name ? key->name : "", name_len + 1);
+    entry->decision = decision;
+    entry->seqno = seqno;   /* Read before computing: a racing change is not masked */
+    preempt_enable();
+    
+    return decision;
+}
+
+/* The policy changed: every cached decision is stale */
+void avc_policy_changed(void) {
+    __sync_fetch_and_add(&avc_seqno, 1);
+    __sync_fetch_and_add(&avc_invalidations, 1);
+}
+
+void avc_set_enabled(bool enabled) {
+    avc_enabled = enabled;
+}
+
+bool avc_is_enabled(void) {
+    return avc_enabled;
+}
+
+/* Get lookups answered from the cache and by the policy, over all CPUs */
+void avc_get_stats(uint64_t *hits, uint64_t *misses) {
+    uint64_t total_hits = 0, total_misses = 0;
+    for (uint32_t cpu = 0; cpu < smp_num_cpus(); cpu++) {
+        total_hits += avc_caches[cpu].hits;
+        total_misses += avc_caches[cpu].misses;
+    }
+    
+    if (hits) *hits = total_hits;
+    if (misses) *misses = total_misses;
+}
+
+void avc_report(void) {
+    uint64_t hits, misses;
+    avc_get_stats(&hits, &misses);
+    uint64_t lookups = hits + misses;
+    
+    KLOG_INFO("=== ACCESS VECTOR CACHE (%s, policy seqno %u) ===",
+              avc_enabled ? "enabled" : "disabled", avc_seqno);
+    KLOG_INFO("%lu lookups, %lu hits (%lu%%), %lu misses, %lu invalidations",
+              lookups, hits, lookups ? hits * 100 / lookups : 0, misses, avc_invalidations);
+    for (uint32_t cpu = 0; cpu < smp_num_cpus(); cpu++) {
+        struct avc_cache *cache = &avc_caches[cpu];
+        uint64_t cpu_lookups = cache->hits + cache->misses;
+        if (cpu_lookups) {
+            KLOG_INFO("  CPU %u: %lu hits, %lu misses (%lu%% hit)", cpu, cache->hits,
+                      cache->misses, cache->hits * 100 / cpu_lookups);
+        }
+    }
+}
\ No newline at end of file
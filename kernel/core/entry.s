@@ -0,0 +1,117 @@
+# SentinalOS System Call Entry
+# Pentagon-Level Security Operating System
+# SYSCALL/SYSRET fast path with per-CPU kernel stack switch
+
+.section .text
+.code64
+
+# struct percpu offsets (kernel/include/smp.h)
+.set PERCPU_KSTACK,     16
+.set PERCPU_USER_RSP,   24
+
+# User selectors with RPL 3 (boot.s GDT)
+.set USER_DS,           0x1b
+.set USER_CS,           0x23
+
+# struct pt_regs offsets (kernel/include/idt.h)
+.set PT_R15,    0
+.set PT_R14,    8
+.set PT_R13,    16
+.set PT_R12,    24
+.set PT_R11,    32
+.set PT_R10,    40
+.set PT_R9,     48
+.set PT_R8,     56
+.set PT_RBP,    64
+.set PT_RDI,    72
+.set PT_RSI,    80
+.set PT_RDX,    88
+.set PT_RCX,    96
+.set PT_RBX,    104
+.set PT_RAX,    112
+.set PT_RIP,    136
+.set PT_RFLAGS, 152
+.set PT_RSP,    160
+
+# SYSCALL lands here with interrupts masked by FMASK: RAX holds the number,
+# RDI RSI RDX R10 R8 R9 the arguments, RCX the user RIP and R11 its RFLAGS.
+# The frame has the struct pt_regs layout. The callee-saved slots are
+# written for clone() to copy, but not reloaded: the C code preserves
+# those registers.
+.global syscall_entry
+.type syscall_entry, @function
+syscall_entry:
+    swapgs
+    mov %rsp, %gs:PERCPU_USER_RSP
+    mov %gs:PERCPU_KSTACK, %rsp
+    
+    push $USER_DS               # ss
+    pushq %gs:PERCPU_USER_RSP   # rsp
+    push %r11                   # rflags
+    push $USER_CS               # cs
+    push %rcx                   # rip
+    push $0                     # error code
+    push %rax                   # vector slot: the syscall number
+    sub $120, %rsp
+    mov %rax, PT_RAX(%rsp)
+    mov %rcx, PT_RCX(%rsp)
+    mov %rdx, PT_RDX(%rsp)
+    mov %rsi, PT_RSI(%rsp)
+    mov %rdi, PT_RDI(%rsp)
+    mov %r8, PT_R8(%rsp)
+    mov %r9, PT_R9(%rsp)
+    mov %r10, PT_R10(%rsp)
+    mov %r11, PT_R11(%rsp)
+    mov %rbx, PT_RBX(%rsp)
+    mov %rbp, PT_RBP(%rsp)
+    mov %r12, PT_R12(%rsp)
+    mov %r13, PT_R13(%rsp)
+    mov %r14, PT_R14(%rsp)
+    mov %r15, PT_R15(%rsp)
+    
+    cld
+    mov %rsp, %rdi              # struct pt_regs *
+    call do_syscall             # Returns with interrupts off, nonzero if work is pending
+    test %eax, %eax
+    jz 1f
+    call syscall_exit_work      # Slow path: rescheduling or a pending kill
+1:
+    # SYSRET reloads RIP from RCX and RFLAGS from R11
+    mov PT_RAX(%rsp), %rax
+    mov PT_RDX(%rsp), %rdx
+    mov PT_RSI(%rsp), %rsi
+    mov PT_RDI(%rsp), %rdi
+    mov PT_R8(%rsp), %r8
+    mov PT_R9(%rsp), %r9
+    mov PT_R10(%rsp), %r10
+    mov PT_RIP(%rsp), %rcx
+    
+    # Intel SYSRET raises #GP in ring 0, on the user stack, if RCX is not
+    # canonical. Any RIP outside the user half returns by IRET instead,
+    # whose #GP arrives on this stack
+    mov %rcx, %r11
+    shr $47, %r11
+    jnz 2f
+    mov PT_RFLAGS(%rsp), %r11
+    mov PT_RSP(%rsp), %rsp
+    swapgs
+    sysretq
+2:
+    mov PT_RCX(%rsp), %rcx
+    mov PT_R11(%rsp), %r11
+    add $PT_RIP, %rsp           # The frame tail is an IRET frame
+    swapgs
+.global syscall_iret
+syscall_iret:
+    iretq                       # A fault here runs with the user GS base (isr.s)
+.size syscall_entry, . - syscall_entry
+
+# Benchmark target: a SYSCALL issued in ring 0 arrives here still in ring 0
+# and jumps straight back, timing the hardware entry alone
+.global syscall_bench_entry
+.type syscall_bench_entry, @function
+syscall_bench_entry:
+    push %r11
+    popfq
+    jmp *%rcx
+.size syscall_bench_entry, . - syscall_bench_entry
\ No newline at end of file
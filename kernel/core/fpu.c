@@ -0,0 +1,306 @@
+/*
+ * SentinalOS Extended State Management
+ * Lazy FPU/SSE/AVX Context Switching with XSAVE
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "string.h"
+#include "smp.h"
+#include "idt.h"
+#include "sched.h"
+#include "fpu.h"
+
+/* XSAVE state components managed for tasks */
+#define XFEATURE_X87            (1ULL << 0)
+#define XFEATURE_SSE            (1ULL << 1)
+#define XFEATURE_AVX            (1ULL << 2)
+#define XFEATURE_AVX512         (7ULL << 5)     /* Opmask, ZMM_Hi256, Hi16_ZMM */
+#define XFEATURE_USER_MASK      (XFEATURE_X87 | XFEATURE_SSE | XFEATURE_AVX | XFEATURE_AVX512)
+
+/* Legacy area layout */
+#define FXSAVE_SIZE             512
+#define FXSAVE_FCW_OFFSET       0
+#define FXSAVE_MXCSR_OFFSET     24
+#define XSAVE_HEADER_OFFSET     512
+#define XSAVE_XCOMP_BV_OFFSET   (XSAVE_HEADER_OFFSET + 8)
+#define XCOMP_BV_COMPACTED      (1ULL << 63)
+
+#define FCW_DEFAULT             0x037F
+#define MXCSR_DEFAULT           0x1F80
+
+/* Save instruction, best available first */
+enum fpu_method {
+    FPU_XSAVES,         /* Compacted format, init and modified optimizations */
+    FPU_XSAVEOPT,       /* Standard format, modified optimization */
+    FPU_XSAVE,
+    FPU_FXSAVE
+};
+
+static const char *method_names[] = { "XSAVES", "XSAVEOPT", "XSAVE", "FXSAVE" };
+
+static struct {
+    enum fpu_method method;
+    uint64_t xfeatures;     /* Components enabled in XCR0 */
+    uint32_t state_size;
+    bool initialized;
+    
+    /* Statistics */
+    uint64_t saves;
+    uint64_t restores;
+    uint64_t traps;
+    uint64_t lazy_hits;     /* Switch-ins that found their state still loaded */
+} fpu_state;
+
+static inline void clts(void) {
+    __asm__ __volatile__("clts" ::: "memory");
+}
+
+/* Set CR0.TS so the next FPU instruction raises #NM */
+static inline void stts(void) {
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+static inline void xsetbv(uint32_t index, uint64_t value) {
+    __asm__ __volatile__("xsetbv"
+                        :: "c" (index), "a" ((uint32_t)value), "d" ((uint32_t)(value >> 32)));
+}
+
+/* Save the live registers into a task's area */
+static void fpu_save(struct fpu *fpu) {
+    uint32_t lo = (uint32_t)fpu_state.xfeatures;
+    uint32_t hi = (uint32_t)(fpu_state.xfeatures >> 32);
+    
+    switch (fpu_state.method) {
+    case FPU_XSAVES:
+        __asm__ __volatile__("xsaves64 (%0)" :: "r" (fpu->state), "a" (lo), "d" (hi) : "memory");
+        break;
+    case FPU_XSAVEOPT:
+        __asm__ __volatile__("xsaveopt64 (%0)" :: "r" (fpu->state), "a" (lo), "d" (hi) : "memory");
+        break;
+    case FPU_XSAVE:
+        __asm__ __volatile__("xsave64 (%0)" :: "r" (fpu->state), "a" (lo), "d" (hi) : "memory");
+        break;
+    case FPU_FXSAVE:
+        __asm__ __volatile__("fxsave64 (%0)" :: "r" (fpu->state) : "memory");
+        break;
+    }
+    fpu_state.saves++;
+}
+
+/* Load a task's area into the registers */
+static void fpu_restore(struct fpu *fpu) {
+    uint32_t lo = (uint32_t)fpu_state.xfeatures;
+    uint32_t hi = (uint32_t)(fpu_state.xfeatures >> 32);
+    
+    switch (fpu_state.method) {
+    case FPU_XSAVES:
+        __asm__ __volatile__("xrstors64 (%0)" :: "r" (fpu->state), "a" (lo), "d" (hi) : "memory");
+        break;
+    case FPU_XSAVEOPT:
+    case FPU_XSAVE:
+        __asm__ __volatile__("xrstor64 (%0)" :: "r" (fpu->state), "a" (lo), "d" (hi) : "memory");
+        break;
+    case FPU_FXSAVE:
+        __asm__ __volatile__("fxrstor64 (%0)" :: "r" (fpu->state) : "memory");
+        break;
+    }
+    fpu_state.restores++;
+}
+
+/*
+ * Allocate a task's area holding the initial register state: an empty
+ * XSAVE header (all components in init state) with default control words.
+ */
+static int fpu_alloc_state(struct fpu *fpu) {
+    uint8_t *state = kmalloc_aligned(fpu_state.state_size, 64);
+    if (!state) {
+        return -12; /* ENOMEM */
+    }
+    
+    memset(state, 0, fpu_state.state_size);
+    *(uint16_t *)(state + FXSAVE_FCW_OFFSET) = FCW_DEFAULT;
+    *(uint32_t *)(state + FXSAVE_MXCSR_OFFSET) = MXCSR_DEFAULT;
+    if (fpu_state.method == FPU_XSAVES) {
+        *(uint64_t *)(state + XSAVE_XCOMP_BV_OFFSET) = XCOMP_BV_COMPACTED | fpu_state.xfeatures;
+    }
+    
+    fpu->state = state;
+    return 0;
+}
+
+/*
+ * #NM handler: the current task touched the FPU while CR0.TS was set.
+ * Any previous owner's state was saved when it was switched out, so the
+ * registers can simply be reloaded from the current task's area.
+ */
+static void fpu_device_not_available(struct pt_regs *regs) {
+    struct percpu *pc = this_cpu();
+    struct fpu *curr = sched_current_fpu();
+    
+    clts();
+    pc->fpu_trap_armed = false;
+    fpu_state.traps++;
+    
+    if (!curr) {
+        PANIC("FPU used outside task context at 0x%lx", regs->rip);
+    }
+    
+    if (pc->fpu_owner == curr && curr->last_cpu == pc->cpu_id) {
+        return;
+    }
+    
+    if (!curr->state && fpu_alloc_state(curr) < 0) {
+        PANIC("Out of memory for extended state at 0x%lx", regs->rip);
+    }
+    
+    fpu_restore(curr);
+    curr->used = true;
+    curr->last_cpu = pc->cpu_id;
+    pc->fpu_owner = curr;
+}
+
+/* Enable FPU/SSE/XSAVE on the executing CPU */
+void fpu_cpu_init(void) {
+    uint64_t cr0 = read_cr0();
+    cr0 &= ~CR0_EM;
+    cr0 |= CR0_MP | CR0_NE | CR0_TS;
+    write_cr0(cr0);
+    
+    uint64_t cr4 = read_cr4();
+    cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+    if (fpu_state.method != FPU_FXSAVE) {
+        cr4 |= CR4_OSXSAVE;
+    }
+    write_cr4(cr4);
+    
+    if (fpu_state.method != FPU_FXSAVE) {
+        xsetbv(0, fpu_state.xfeatures);
+    }
+    if (fpu_state.method == FPU_XSAVES) {
+        wrmsr(MSR_IA32_XSS, 0); /* No supervisor components */
+    }
+    
+    /* Nothing is loaded yet: trap on first use */
+    struct percpu *pc = this_cpu();
+    pc->fpu_owner = NULL;
+    pc->fpu_trap_armed = true;
+}
+
+void fpu_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    KLOG_INFO("Initializing extended state management...");
+    
+    memset(&fpu_state, 0, sizeof(fpu_state));
+    fpu_state.method = FPU_FXSAVE;
+    fpu_state.state_size = FXSAVE_SIZE;
+    
+    cpuid_count(1, 0, &eax, &ebx, &ecx, &edx);
+    bool has_xsave = ecx & (1 << 26);
+    
+    if (has_xsave) {
+        cpuid_count(0xD, 0, &eax, &ebx, &ecx, &edx);
+        uint64_t supported = ((uint64_t)edx << 32) | eax;
+        fpu_state.xfeatures = supported & XFEATURE_USER_MASK;
+        
+        /* AVX-512 components are only usable together */
+        if ((fpu_state.xfeatures & XFEATURE_AVX512) != XFEATURE_AVX512) {
+            fpu_state.xfeatures &= ~XFEATURE_AVX512;
+        }
+        
+        cpuid_count(0xD, 1, &eax, &ebx, &ecx, &edx);
+        if (eax & (1 << 3)) {
+            fpu_state.method = FPU_XSAVES;
+        } else if (eax & (1 << 0)) {
+            fpu_state.method = FPU_XSAVEOPT;
+        } else {
+            fpu_state.method = FPU_XSAVE;
+        }
+    }
+    
+    fpu_cpu_init();
+    
+    /* Area sizes depend on the components enabled above */
+    if (fpu_state.method == FPU_XSAVES) {
+        cpuid_count(0xD, 1, &eax, &ebx, &ecx, &edx);
+        fpu_state.state_size = ebx;
+    } else if (fpu_state.method != FPU_FXSAVE) {
+        cpuid_count(0xD, 0, &eax, &ebx, &ecx, &edx);
+        fpu_state.state_size = ebx;
+    }
+    
+    idt_register_handler(VEC_DEVICE_NOT_AVAIL, fpu_device_not_available);
+    fpu_state.initialized = true;
+    
+    KLOG_INFO("Extended state: %s, %u byte areas, XCR0 0x%lx",
+              method_names[fpu_state.method], fpu_state.state_size, fpu_state.xfeatures);
+}
+
+/* Prepare the extended state of a new task; the area is allocated lazily */
+void fpu_task_init(struct fpu *fpu) {
+    fpu->state = NULL;
+    fpu->last_cpu = CPU_INVALID;
+    fpu->used = false;
+}
+
+/* Drop a dead task's state */
+void fpu_task_exit(struct fpu *fpu) {
+    struct percpu *pc = this_cpu();
+    if (pc->fpu_owner == fpu) {
+        pc->fpu_owner = NULL;
+    }
+    
+    if (fpu->state) {
+        kfree(fpu->state);
+        fpu->state = NULL;
+    }
+    fpu->last_cpu = CPU_INVALID;
+    fpu->used = false;
+}
+
+/*
+ * Called for the outgoing task. If CR0.TS is still set the task did not
+ * touch the FPU during this slice and its area is already current. The
+ * registers are left loaded so the owner can resume without a restore.
+ */
+void fpu_switch_out(struct fpu *prev) {
+    struct percpu *pc = this_cpu();
+    
+    if (pc->fpu_trap_armed || pc->fpu_owner != prev) {
+        return;
+    }
+    fpu_save(prev);
+}
+
+/*
+ * Called for the incoming task. When it still owns this CPU's registers
+ * (the common case with a single FPU user) the restore is skipped entirely;
+ * otherwise the first FPU instruction traps and loads its state.
+ */
+void fpu_switch_in(struct fpu *next) {
+    struct percpu *pc = this_cpu();
+    
+    if (pc->fpu_owner == next && next->last_cpu == pc->cpu_id) {
+        if (pc->fpu_trap_armed) {
+            clts();
+            pc->fpu_trap_armed = false;
+        }
+        fpu_state.lazy_hits++;
+    } else if (!pc->fpu_trap_armed) {
+        stts();
+        pc->fpu_trap_armed = true;
+    }
+}
+
+/* Get extended state statistics */
+void fpu_get_stats(uint64_t *saves, uint64_t *restores, uint64_t *traps, uint64_t *lazy_hits) {
+    if (saves) *saves = fpu_state.saves;
+    if (restores) *restores = fpu_state.restores;
+    if (traps) *traps = fpu_state.traps;
+    if (lazy_hits) *lazy_hits = fpu_state.lazy_hits;
+}
+
+const char *fpu_save_method(void) {
+    return method_names[fpu_state.method];
+}
\ No newline at end of file
@@ -0,0 +1,275 @@
+/*
+ * SentinalOS Futexes
+ * Sleeping on User Memory Words
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "sched.h"
+#include "timer.h"
+#include "futex.h"
+#include "uaccess.h"
+#include "spinlock.h"
+
+/* One sleeping waiter, on the waiter's stack */
+struct futex_q {
+    uint64_t key;               /* Physical address of the futex word */
+    struct task *task;
+    bool queued;
+    struct futex_q *next;
+    struct futex_q *prev;
+};
+
+struct futex_bucket {
+    spinlock_t lock;
+    struct futex_q *head;
+};
+
+static struct futex_bucket futex_queues[FUTEX_HASH_BUCKETS];
+
+/* Futex statistics */
+static struct {
+    uint64_t waits;
+    uint64_t wakes;
+    uint64_t requeues;
+    uint64_t timeouts;
+} futex_stats;
+
+static inline struct futex_bucket *futex_hash(uint64_t key) {
+    /* Words are 4-byte aligned; fold the page number into the slot */
+    uint64_t hash = (key >> 2) ^ (key >> 12) ^ (key >> 22);
+    return &futex_queues[hash & (FUTEX_HASH_BUCKETS - 1)];
+}
+
+static uint64_t bucket_lock(struct futex_bucket *bucket) {
+    return spin_lock_irqsave(&bucket->lock);
+}
+
+static void bucket_unlock(struct futex_bucket *bucket, uint64_t flags) {
+    spin_unlock_irqrestore(&bucket->lock, flags);
+}
+
+/* Lock two buckets in address order (once if they are the same) */
+static uint64_t double_bucket_lock(struct futex_bucket *a, struct futex_bucket *b) {
+    uint64_t flags = local_irq_save();
+    if (a > b) {
+        struct futex_bucket *tmp = a;
+        a = b;
+        b = tmp;
+    }
+    spin_lock(&a->lock);
+    if (b != a) {
+        spin_lock(&b->lock);
+    }
+    return flags;
+}
+
+static void double_bucket_unlock(struct futex_bucket *a, struct futex_bucket *b, uint64_t flags) {
+    if (b != a) {
+        spin_unlock(&b->lock);
+    }
+    spin_unlock_irqrestore(&a->lock, flags);
+}
+
+/* Resolve a futex word to its key */
+static int futex_get_key(uint32_t *uaddr, uint64_t *key) {
+    if (!uaddr || ((uint64_t)uaddr & (sizeof(uint32_t) - 1))) {
+        return -22; /* EINVAL */
+    }
+    return mm_virt_to_phys((vaddr_t)uaddr, key);
+}
+
+static void futex_queue(struct futex_bucket *bucket, struct futex_q *q) {
+    q->prev = NULL;
+    q->next = bucket->head;
+    if (bucket->head) {
+        bucket->head->prev = q;
+    }
+    bucket->head = q;
+    q->queued = true;
+}
+
+static void futex_unqueue(struct futex_bucket *bucket, struct futex_q *q) {
+    if (q->prev) {
+        q->prev->next = q->next;
+    } else {
+        bucket->head = q->next;
+    }
+    if (q->next) {
+        q->next->prev = q->prev;
+    }
+    q->next = q->prev = NULL;
+    q->queued = false;
+}
+
+/*
+ * Sleep while *uaddr == val, for at most 'timeout' jiffies (0 = forever).
+ * The value is compared under the bucket lock, so a FUTEX_WAKE issued
+ * after the waker changed the word cannot be missed.
+ */
+long futex_wait(uint32_t *uaddr, uint32_t val, uint64_t timeout) {
+    uint64_t key;
+    int ret = futex_get_key(uaddr, &key);
+    if (ret < 0) {
+        return ret;
+    }
+    if (!sched_can_block()) {
+        return -11; /* EAGAIN */
+    }
+    
+    struct futex_bucket *bucket = futex_hash(key);
+    struct futex_q q = { .key = key, .task = sched_current() };
+    
+    uint64_t flags = bucket_lock(bucket);
+    uint32_t cur;
+    if (__copy_from_user(&cur, uaddr, sizeof(cur))) {
+        bucket_unlock(bucket, flags);
+        return -14; /* EFAULT */
+    }
+    if (cur != val) {
+        bucket_unlock(bucket, flags);
+        return -11; /* EAGAIN */
+    }
+    futex_queue(bucket, &q);
+    sched_prepare_to_block();
+    bucket_unlock(bucket, flags);
+    
+    futex_stats.waits++;
+    if (timeout) {
+        schedule_timeout(timeout);
+    } else {
+        schedule();
+    }
+    sched_set_running();
+    
+    /* Still queued means the timeout fired; a requeue may have moved us */
+    bool timed_out = false;
+    while (q.queued) {
+        uint64_t key_now = q.key;
+        bucket = futex_hash(key_now);
+        flags = bucket_lock(bucket);
+        if (q.key == key_now) {
+            timed_out = q.queued;
+            if (timed_out) {
+                futex_unqueue(bucket, &q);
+            }
+            bucket_unlock(bucket, flags);
+            break;
+        }
+        bucket_unlock(bucket, flags);
+    }
+    
+    if (timed_out && timeout) {
+        futex_stats.timeouts++;
+        return -110; /* ETIMEDOUT */
+    }
+    return 0;
+}
+
+/* Wake up to nr_wake waiters on uaddr; returns the number woken */
+long futex_wake(uint32_t *uaddr, uint32_t nr_wake) {
+    uint64_t key;
+    int ret = futex_get_key(uaddr, &key);
+    if (ret < 0) {
+        return ret;
+    }
+    
+    struct futex_bucket *bucket = futex_hash(key);
+    long woken = 0;
+    
+    uint64_t flags = bucket_lock(bucket);
+    struct futex_q *q = bucket->head;
+    while (q && woken < nr_wake) {
+        struct futex_q *next = q->next;
+        if (q->key == key) {
+            /* q lives on the waiter's stack: read it before unqueueing */
+            struct task *task = q->task;
+            futex_unqueue(bucket, q);
+            sched_wake_up(task);
+            woken++;
+        }
+        q = next;
+    }
+    bucket_unlock(bucket, flags);
+    
+    futex_stats.wakes += woken;
+    return woken;
+}
+
+/*
+ * Wake nr_wake waiters on uaddr and move up to nr_requeue of the rest to
+ * uaddr2, so a condition broadcast does not stampede the mutex.
+ */
+long futex_requeue(uint32_t *uaddr, uint32_t nr_wake, uint32_t *uaddr2, uint32_t nr_requeue) {
+    uint64_t key, key2;
+    int ret = futex_get_key(uaddr, &key);
+    if (ret < 0) {
+        return ret;
+    }
+    ret = futex_get_key(uaddr2, &key2);
+    if (ret < 0) {
+        return ret;
+    }
+    
+    struct futex_bucket *bucket = futex_hash(key);
+    struct futex_bucket *bucket2 = futex_hash(key2);
+    long woken = 0, moved = 0;
+    
+    uint64_t flags = double_bucket_lock(bucket, bucket2);
+    struct futex_q *q = bucket->head;
+    while (q && (woken < nr_wake || moved < nr_requeue)) {
+        struct futex_q *next = q->next;
+        if (q->key == key) {
+            struct task *task = q->task;
+            futex_unqueue(bucket, q);
+            if (woken < nr_wake) {
+                sched_wake_up(task);
+                woken++;
+            } else {
+                q->key = key2;
+                futex_queue(bucket2, q);
+                moved++;
+            }
+        }
+        q = next;
+    }
+    double_bucket_unlock(bucket, bucket2, flags);
+    
+    futex_stats.wakes += woken;
+    futex_stats.requeues += moved;
+    return woken + moved;
+}
+
+/* Syscall entry: arg4 is a relative timeout (WAIT) or a requeue count */
+long do_futex(uint32_t *uaddr, int op, uint32_t val, uint64_t arg4, uint32_t *uaddr2) {
+    switch (op) {
+        case FUTEX_WAIT: {
+            uint64_t timeout = 0;
+            if (arg4) {
+                const struct futex_timespec *ts = (const struct futex_timespec *)arg4;
+                if (ts->tv_sec < 0 || ts->tv_nsec < 0 || ts->tv_nsec >= (int64_t)NSEC_PER_SEC) {
+                    return -22; /* EINVAL */
+                }
+                timeout = (uint64_t)ts->tv_sec * HZ + (ts->tv_nsec + TICK_NSEC - 1) / TICK_NSEC;
+                if (!timeout) {
+                    return -110; /* ETIMEDOUT */
+                }
+            }
+            return futex_wait(uaddr, val, timeout);
+        }
+        case FUTEX_WAKE:
+            return futex_wake(uaddr, val);
+        case FUTEX_REQUEUE:
+            return futex_requeue(uaddr, val, uaddr2, (uint32_t)arg4);
+        default:
+            return -38; /* ENOSYS */
+    }
+}
+
+/* Get futex statistics */
+void futex_get_stats(uint64_t *waits, uint64_t *wakes, uint64_t *requeues, uint64_t *timeouts) {
+    if (waits) *waits = futex_stats.waits;
+    if (wakes) *wakes = futex_stats.wakes;
+    if (requeues) *requeues = futex_stats.requeues;
+    if (timeouts) *timeouts = futex_stats.timeouts;
+}
\ No newline at end of file
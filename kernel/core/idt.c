@@ -0,0 +1,210 @@
+/*
+ * SentinalOS Interrupt Descriptor Table
+ * Exception Vectors and Handler Dispatch
+ */
+
+#include "kernel.h"
+#include "string.h"
+#include "smp.h"
+#include "sched.h"
+#include "idt.h"
+#include "rcu.h"
+#include "preempt.h"
+#include "uaccess.h"
+
+/* Kernel code selector (boot.s GDT) */
+#define KERNEL_CS               0x08
+
+/* Legacy 8259 PIC ports */
+#define PIC1_CMD                0x20
+#define PIC1_DATA               0x21
+#define PIC2_CMD                0xA0
+#define PIC2_DATA               0xA1
+
+/* Gate types */
+#define IDT_GATE_INTERRUPT      0x8E    /* Present, DPL 0, 64-bit interrupt gate */
+
+/* IDT gate descriptor */
+struct idt_entry {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t ist;
+    uint8_t type_attr;
+    uint16_t offset_mid;
+    uint32_t offset_high;
+    uint32_t reserved;
+} __packed;
+
+struct idt_pointer {
+    uint16_t limit;
+    uint64_t base;
+} __packed;
+
+/* Entry stubs from isr.s */
+extern const uint64_t isr_stub_table[IDT_ENTRIES];
+
+/* The IRETQ of the SYSCALL exit, taken for a RIP outside the user half (entry.s) */
+extern const char syscall_iret[];
+
+static struct idt_entry idt[IDT_ENTRIES] __aligned(16);
+static interrupt_handler_t handlers[IDT_ENTRIES];
+
+static const char *exception_names[IDT_NUM_EXCEPTIONS] = {
+    "Divide Error", "Debug", "NMI", "Breakpoint", "Overflow",
+    "Bound Range Exceeded", "Invalid Opcode", "Device Not Available",
+    "Double Fault", "Coprocessor Segment Overrun", "Invalid TSS",
+    "Segment Not Present", "Stack Fault", "General Protection",
+    "Page Fault", "Reserved", "x87 FPU Error", "Alignment Check",
+    "Machine Check", "SIMD Floating-Point", "Virtualization",
+    "Control Protection", "Reserved", "Reserved", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Hypervisor Injection", "VMM Communication",
+    "Security Exception", "Reserved"
+};
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ __volatile__("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outb(uint16_t port, uint8_t val) {
+    __asm__ __volatile__("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+/*
+ * Move the 8259 pair off the exception vectors and mask every line. Out of
+ * reset it delivers IRQ0 on vector 8, so the first PIT tick after sti would
+ * look like a double fault; all timekeeping runs off the LAPIC instead.
+ */
+static void pic_init(void) {
+    outb(PIC1_CMD, 0x11);                   /* ICW1: edge, cascade, ICW4 */
+    outb(PIC2_CMD, 0x11);
+    outb(PIC1_DATA, PIC_IRQ_BASE);          /* ICW2: vector base */
+    outb(PIC2_DATA, PIC_IRQ_BASE + 8);
+    outb(PIC1_DATA, 0x04);                  /* ICW3: slave on IRQ2 */
+    outb(PIC2_DATA, 0x02);
+    outb(PIC1_DATA, 0x01);                  /* ICW4: 8086 mode */
+    outb(PIC2_DATA, 0x01);
+    
+    outb(PIC1_DATA, 0xFF);
+    outb(PIC2_DATA, 0xFF);
+}
+
+/* Let one legacy line through (and the cascade, for a line on the slave) */
+void pic_unmask_irq(uint8_t irq) {
+    if (irq >= 8) {
+        outb(PIC2_DATA, inb(PIC2_DATA) & ~(1U << (irq - 8)));
+        irq = 2;
+    }
+    outb(PIC1_DATA, inb(PIC1_DATA) & ~(1U << irq));
+}
+
+/* Acknowledge a legacy interrupt once its handler has run */
+void pic_eoi(uint8_t irq) {
+    if (irq >= 8) {
+        outb(PIC2_CMD, 0x20);
+    }
+    outb(PIC1_CMD, 0x20);
+}
+
+/* Install a gate for a vector */
+static void idt_set_gate(uint8_t vector, uint64_t handler, uint8_t type_attr) {
+    struct idt_entry *entry = &idt[vector];
+    
+    entry->offset_low = handler & 0xFFFF;
+    entry->selector = KERNEL_CS;
+    entry->ist = 0;
+    entry->type_attr = type_attr;
+    entry->offset_mid = (handler >> 16) & 0xFFFF;
+    entry->offset_high = handler >> 32;
+    entry->reserved = 0;
+}
+
+/* Load the IDT on the executing CPU */
+void idt_load(void) {
+    struct idt_pointer idtr = {
+        .limit = sizeof(idt) - 1,
+        .base = (uint64_t)idt
+    };
+    __asm__ __volatile__("lidt %0" :: "m" (idtr));
+}
+
+void idt_init(void) {
+    KLOG_INFO("Initializing interrupt descriptor table...");
+    
+    memset(idt, 0, sizeof(idt));
+    memset(handlers, 0, sizeof(handlers));
+    
+    for (int vector = 0; vector < IDT_ENTRIES; vector++) {
+        idt_set_gate(vector, isr_stub_table[vector], IDT_GATE_INTERRUPT);
+    }
+    
+    pic_init();
+    idt_load();
+    
+    KLOG_INFO("IDT loaded (%d vectors)", IDT_ENTRIES);
+}
+
+/* Register a C handler for a vector */
+int idt_register_handler(uint8_t vector, interrupt_handler_t handler) {
+    if (!handler) {
+        return -22; /* EINVAL */
+    }
+    if (handlers[vector]) {
+        return -16; /* EBUSY */
+    }
+    
+    handlers[vector] = handler;
+    return 0;
+}
+
+/* Common C entry point for all vectors, called from isr_common */
+void idt_dispatch(struct pt_regs *regs) {
+    /* The SYSCALL exit IRET refused the user frame: report the fault against that frame */
+    if (unlikely(regs->vector == VEC_GENERAL_PROTECTION && !user_mode(regs) &&
+                 regs->rip == (uint64_t)syscall_iret)) {
+        memcpy(&regs->rip, (const void *)regs->rsp, 5 * sizeof(uint64_t));
+    }
+    
+    interrupt_handler_t handler = handlers[regs->vector & 0xFF];
+    if (likely(handler)) {
+        /* Code interrupted in user mode holds no RCU readers */
+        if (user_mode(regs)) {
+            rcu_note_context_switch();
+        }
+        /* Exception handlers may sleep; only device interrupts count as hardirq */
+        bool hardirq = regs->vector >= IDT_NUM_EXCEPTIONS;
+        if (hardirq) {
+            preempt_count_add(HARDIRQ_OFFSET);
+        }
+        rcu_irq_enter();
+        handler(regs);
+        rcu_irq_exit();
+        if (hardirq) {
+            preempt_count_sub(HARDIRQ_OFFSET);
+        }
+        
+        /*
+         * Preemption point: returning to user mode is always safe, kernel
+         * code only if it held no locks and had interrupts enabled.
+         */
+        if (this_cpu()->need_resched &&
+            (user_mode(regs) || (preempt_count() == 0 && regs_irqs_enabled(regs)))) {
+            preempt_schedule_irq();
+        }
+        return;
+    }
+    
+    /* A user copy hit a bad address: the copy routine reports it instead */
+    if ((regs->vector == VEC_PAGE_FAULT || regs->vector == VEC_GENERAL_PROTECTION) &&
+        !user_mode(regs) && fixup_exception(regs)) {
+        return;
+    }
+    
+    if (regs->vector < IDT_NUM_EXCEPTIONS) {
+        PANIC("Unhandled exception %lu (%s) at 0x%lx, error 0x%lx",
+              regs->vector, exception_names[regs->vector], regs->rip, regs->error_code);
+    }
+    
+    KLOG_WARN("Spurious interrupt on vector %lu", regs->vector);
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+# SentinalOS Interrupt Entry
+# Pentagon-Level Security Operating System
+# Exception stubs and common register save path
+
+.section .text
+.code64
+
+# Exceptions without a CPU error code push a zero so every frame matches
+# struct pt_regs (kernel/include/idt.h)
+.macro ISR_NOERR vector
+isr_stub_\vector:
+    push $0
+    push $\vector
+    jmp isr_common
+.endm
+
+.macro ISR_ERR vector
+isr_stub_\vector:
+    push $\vector
+    jmp isr_common
+.endm
+
+ISR_NOERR 0
+ISR_NOERR 1
+ISR_NOERR 2
+ISR_NOERR 3
+ISR_NOERR 4
+ISR_NOERR 5
+ISR_NOERR 6
+ISR_NOERR 7
+ISR_ERR   8
+ISR_NOERR 9
+ISR_ERR   10
+ISR_ERR   11
+ISR_ERR   12
+ISR_ERR   13
+ISR_ERR   14
+ISR_NOERR 15
+ISR_NOERR 16
+ISR_ERR   17
+ISR_NOERR 18
+ISR_NOERR 19
+ISR_NOERR 20
+ISR_ERR   21
+ISR_NOERR 22
+ISR_NOERR 23
+ISR_NOERR 24
+ISR_NOERR 25
+ISR_NOERR 26
+ISR_NOERR 27
+ISR_NOERR 28
+ISR_ERR   29
+ISR_ERR   30
+ISR_NOERR 31
+
+# External and inter-processor interrupts (vectors 32-255)
+.altmacro
+.set vector, 32
+.rept 224
+ISR_NOERR %vector
+.set vector, vector + 1
+.endr
+
+# Save the general purpose registers and hand the frame to idt_dispatch
+isr_common:
+    testb $3, 24(%rsp)          # CS of the interrupted context
+    jnz 0f
+    cmpq $syscall_iret, 16(%rsp)    # Kernel mode, but past the SYSCALL exit swapgs
+    jne 1f
+0:
+    swapgs                      # Entered from user mode: load kernel GS base
+1:
+    push %rax
+    push %rbx
+    push %rcx
+    push %rdx
+    push %rsi
+    push %rdi
+    push %rbp
+    push %r8
+    push %r9
+    push %r10
+    push %r11
+    push %r12
+    push %r13
+    push %r14
+    push %r15
+    
+    cld
+    clac                        # Close any user copy window; IRETQ restores AC
+    mov %rsp, %rdi              # struct pt_regs *
+    call idt_dispatch
+    
+    pop %r15
+    pop %r14
+    pop %r13
+    pop %r12
+    pop %r11
+    pop %r10
+    pop %r9
+    pop %r8
+    pop %rbp
+    pop %rdi
+    pop %rsi
+    pop %rdx
+    pop %rcx
+    pop %rbx
+    pop %rax
+    
+    testb $3, 24(%rsp)
+    jnz 3f
+    cmpq $syscall_iret, 16(%rsp)
+    jne 2f
+3:
+    swapgs                      # Returning to user mode, or to the IRET that does
+2:
+    add $16, %rsp               # Vector and error code
+    iretq
+
+# Stub addresses, indexed by vector
+.macro ISR_STUB_ADDR vector
+.quad isr_stub_\vector
+.endm
+
+.section .rodata
+.align 8
+.global isr_stub_table
+isr_stub_table:
+.set vector, 0
+.rept 256
+ISR_STUB_ADDR %vector
+.set vector, vector + 1
+.endr
\ No newline at end of file
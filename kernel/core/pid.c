@@ -0,0 +1,212 @@
+/*
+ * SentinalOS PID Management
+ * Bitmap PID Allocation and PID Hash Lookup
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "string.h"
+#include "pid.h"
+
+/* Lookups take the table lock shared; allocation and hashing take it exclusive */
+static uint64_t pid_read_lock(struct pid_table *table) {
+    return read_lock_irqsave(&table->lock);
+}
+
+static void pid_read_unlock(struct pid_table *table, uint64_t flags) {
+    read_unlock_irqrestore(&table->lock, flags);
+}
+
+static uint64_t pid_write_lock(struct pid_table *table) {
+    return write_lock_irqsave(&table->lock);
+}
+
+static void pid_write_unlock(struct pid_table *table, uint64_t flags) {
+    write_unlock_irqrestore(&table->lock, flags);
+}
+
+static inline uint32_t pid_hashfn(const struct pid_table *table, uint32_t pid) {
+    /* PIDs are handed out sequentially, so the low bits spread evenly */
+    return pid & (table->nr_buckets - 1);
+}
+
+/* Set up an empty table for PIDs 1..max_pid-1 */
+int pid_table_init(struct pid_table *table, uint32_t max_pid) {
+    memset(table, 0, sizeof(*table));
+    
+    table->max_pid = max_pid;
+    table->nr_words = (max_pid + 63) / 64;
+    table->bitmap = kmalloc(table->nr_words * sizeof(uint64_t));
+    table->full = kmalloc(((table->nr_words + 63) / 64) * sizeof(uint64_t));
+    table->buckets = kmalloc(PID_HASH_MIN_BUCKETS * sizeof(struct pid_node *));
+    if (!table->bitmap || !table->full || !table->buckets) {
+        return -12; /* ENOMEM */
+    }
+    memset(table->bitmap, 0, table->nr_words * sizeof(uint64_t));
+    memset(table->full, 0, ((table->nr_words + 63) / 64) * sizeof(uint64_t));
+    memset(table->buckets, 0, PID_HASH_MIN_BUCKETS * sizeof(struct pid_node *));
+    table->nr_buckets = PID_HASH_MIN_BUCKETS;
+    
+    /* PID 0 belongs to the idle tasks; bits past max_pid are never free */
+    table->bitmap[0] = 1;
+    if (max_pid % 64) {
+        table->bitmap[table->nr_words - 1] |= ~0ULL << (max_pid % 64);
+    }
+    return 0;
+}
+
+/* First bitmap word at or after 'word' with a free PID, or nr_words */
+static uint32_t pid_find_word(struct pid_table *table, uint32_t word) {
+    while (word < table->nr_words) {
+        uint64_t full = table->full[word / 64] >> (word % 64);
+        if (~full) {
+            return word + __builtin_ctzll(~full);
+        }
+        word = (word / 64 + 1) * 64;
+    }
+    return table->nr_words;
+}
+
+/* Claim a free PID in 'word' at or after bit 'bit', or return -1 */
+static int pid_claim(struct pid_table *table, uint32_t word, uint32_t bit) {
+    uint64_t free = ~table->bitmap[word] & (~0ULL << bit);
+    if (!free) {
+        return -1;
+    }
+    
+    uint32_t pid = word * 64 + __builtin_ctzll(free);
+    table->bitmap[word] |= 1ULL << (pid % 64);
+    if (table->bitmap[word] == ~0ULL) {
+        table->full[word / 64] |= 1ULL << (word % 64);
+    }
+    return (int)pid;
+}
+
+/*
+ * Allocate the next free PID after the last one handed out, wrapping
+ * around, so recently freed PIDs are not reused immediately.
+ */
+int pid_alloc(struct pid_table *table) {
+    if (!table->bitmap) {
+        return -11; /* EAGAIN */
+    }
+    
+    uint64_t flags = pid_write_lock(table);
+    uint32_t start = table->last_pid + 1 < table->max_pid ? table->last_pid + 1 : 1;
+    
+    /* Rest of the current word, then whole words via the summary */
+    int pid = pid_claim(table, start / 64, start % 64);
+    for (uint32_t word = pid_find_word(table, start / 64 + 1);
+         pid < 0 && word < table->nr_words;
+         word = pid_find_word(table, word + 1)) {
+        pid = pid_claim(table, word, 0);
+    }
+    for (uint32_t word = pid_find_word(table, 0);
+         pid < 0 && word <= start / 64;
+         word = pid_find_word(table, word + 1)) {
+        pid = pid_claim(table, word, 0);
+    }
+    
+    if (pid > 0) {
+        table->last_pid = (uint32_t)pid;
+        table->nr_allocated++;
+    }
+    pid_write_unlock(table, flags);
+    
+    return pid > 0 ? pid : -11; /* EAGAIN */
+}
+
+void pid_free(struct pid_table *table, uint32_t pid) {
+    if (!pid || pid >= table->max_pid) {
+        return;
+    }
+    
+    uint64_t flags = pid_write_lock(table);
+    uint32_t word = pid / 64;
+    if (table->bitmap[word] & (1ULL << (pid % 64))) {
+        table->bitmap[word] &= ~(1ULL << (pid % 64));
+        table->full[word / 64] &= ~(1ULL << (word % 64));
+        table->nr_allocated--;
+    }
+    pid_write_unlock(table, flags);
+}
+
+/* Double the bucket array and rehash (caller holds the lock) */
+static void pid_hash_grow(struct pid_table *table) {
+    uint32_t nr_buckets = table->nr_buckets * 2;
+    struct pid_node **buckets = kmalloc(nr_buckets * sizeof(struct pid_node *));
+    if (!buckets) {
+        return; /* Keep the longer chains */
+    }
+    memset(buckets, 0, nr_buckets * sizeof(struct pid_node *));
+    
+    for (uint32_t i = 0; i < table->nr_buckets; i++) {
+        struct pid_node *node = table->buckets[i];
+        while (node) {
+            struct pid_node *next = node->next;
+            uint32_t bucket = node->pid & (nr_buckets - 1);
+            node->next = buckets[bucket];
+            buckets[bucket] = node;
+            node = next;
+        }
+    }
+    
+    kfree(table->buckets);
+    table->buckets = buckets;
+    table->nr_buckets = nr_buckets;
+}
+
+/* Make 'node' findable under 'pid' */
+int pid_hash_add(struct pid_table *table, struct pid_node *node, uint32_t pid) {
+    if (!table->buckets) {
+        return -22; /* EINVAL */
+    }
+    
+    uint64_t flags = pid_write_lock(table);
+    if (table->nr_hashed >= table->nr_buckets) {
+        pid_hash_grow(table);
+    }
+    
+    node->pid = pid;
+    uint32_t bucket = pid_hashfn(table, pid);
+    node->next = table->buckets[bucket];
+    table->buckets[bucket] = node;
+    table->nr_hashed++;
+    pid_write_unlock(table, flags);
+    
+    return 0;
+}
+
+void pid_hash_del(struct pid_table *table, struct pid_node *node) {
+    if (!table->buckets) {
+        return;
+    }
+    
+    uint64_t flags = pid_write_lock(table);
+    struct pid_node **link = &table->buckets[pid_hashfn(table, node->pid)];
+    while (*link && *link != node) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = node->next;
+        node->next = NULL;
+        table->nr_hashed--;
+    }
+    pid_write_unlock(table, flags);
+}
+
+/* Look up the object hashed under 'pid' (caller holds rcu_read_lock()) */
+struct pid_node *pid_hash_find(struct pid_table *table, uint32_t pid) {
+    if (!table->buckets) {
+        return NULL;
+    }
+    
+    uint64_t flags = pid_read_lock(table);
+    struct pid_node *node = table->buckets[pid_hashfn(table, pid)];
+    while (node && node->pid != pid) {
+        node = node->next;
+    }
+    pid_read_unlock(table, flags);
+    
+    return node;
+}
\ No newline at end of file
@@ -4,41 +4,112 @@
  */
 
 #include "../include/system.h"
+#include "../include/string.h"
+#include "../include/sched.h"
+#include "../include/pid.h"
+#include "../include/slab.h"
+#include "../include/cpu.h"
+#include "../include/spinlock.h"
+#include "../include/rcu.h"
+#include "../include/preempt.h"
+#include "../include/avc.h"
+#include "../include/workqueue.h"
+#include "../include/fdtable.h"
+#include "../include/futex.h"
+#include "../include/uaccess.h"
+#include "../include/idt.h"
 
 /* Global process management state */
 static struct process *current_process = NULL;
 static struct process *process_list = NULL;
 static struct process *ready_queue = NULL;
-static uint32_t next_pid = 1;
+static struct pid_table process_pids;
 static uint64_t scheduler_ticks = 0;
+static volatile bool process_resched_pending = false;
 
-/* Process scheduler lock */
-static volatile int scheduler_lock = 0;
+/* Object caches for the control block and its cold parts */
+static struct kmem_cache *process_cache;
+static struct kmem_cache *cred_cache;
+static struct kmem_cache *files_cache;
+static struct kmem_cache *acct_cache;
+static struct kmem_cache *mm_cache;
+
+/* Process scheduler lock; the timer interrupt only requests a reschedule */
+static spinlock_t scheduler_lock;
+
+/* Orphaned zombies are reaped by a worker, outside process_schedule() */
+static struct work_struct reap_work;
+static void process_reap_zombies(struct work_struct *work);
+static uint64_t *process_mm_alloc(struct process *proc);
+
+/* Unlink from the process list (scheduler_lock held); walkers may still be on it */
+static void process_list_del(struct process *proc) {
+    if (proc->prev) {
+        rcu_list_del(&proc->prev->next, proc, next);
+    } else {
+        rcu_list_del(&process_list, proc, next);
+    }
+    if (proc->next) {
+        proc->next->prev = proc->prev;
+    }
+}
+
+/* Make a new process visible to list walkers and the zombie reaper */
+void process_link(struct process *proc) {
+    uint64_t flags = spin_lock_irqsave(&scheduler_lock);
+    proc->prev = NULL;
+    proc->next = process_list;
+    if (process_list) {
+        process_list->prev = proc;
+    }
+    rcu_assign_pointer(process_list, proc);
+    spin_unlock_irqrestore(&scheduler_lock, flags);
+}
+
+/* Take a dead process off the list; free it with call_rcu(process_free_rcu) */
+void process_unlink(struct process *proc) {
+    uint64_t flags = spin_lock_irqsave(&scheduler_lock);
+    process_list_del(proc);
+    spin_unlock_irqrestore(&scheduler_lock, flags);
+}
+
+void process_free_rcu(struct rcu_head *head) {
+    process_free(rcu_entry(head, struct process, rcu));
+}
 
 /* Initialize process management */
 void process_init(void) {
     debug_print("Initializing process management system\n");
     
+    INIT_WORK(&reap_work, process_reap_zombies);
+    
+    if (pid_table_init(&process_pids, PID_MAX_DEFAULT) < 0) {
+        kernel_panic("Failed to allocate PID table");
+    }
+    
     /* Create init process (PID 1) */
-    struct process *init_proc = (struct process *)kmalloc(sizeof(struct process));
+    struct process *init_proc = process_alloc();
     if (!init_proc) {
         kernel_panic("Failed to allocate init process");
     }
     
-    /* Initialize init process */
-    init_proc->pid = 1;
+    /* Initialize init process: first PID handed out is 1 */
+    if (process_pid_attach(init_proc) < 0) {
+        kernel_panic("Failed to allocate init PID");
+    }
     init_proc->ppid = 0;
     init_proc->state = PROCESS_RUNNING;
     init_proc->priority = 10;
-    init_proc->uid = 0;
-    init_proc->gid = 0;
-    init_proc->euid = 0;
-    init_proc->egid = 0;
-    init_proc->security_level = 4; /* Pentagon level */
-    init_proc->security_flags = 0x07; /* All security features enabled */
-    strncpy(init_proc->name, "init", sizeof(init_proc->name));
-    strncpy(init_proc->security_context, "system_u:system_r:init_t", 
-            sizeof(init_proc->security_context));
+    init_proc->cred->uid = 0;
+    init_proc->cred->gid = 0;
+    init_proc->cred->euid = 0;
+    init_proc->cred->egid = 0;
+    init_proc->cred->security_level = 4; /* Pentagon level */
+    init_proc->cred->security_flags = 0x07; /* All security features enabled */
+    strncpy(init_proc->acct->name, "init", sizeof(init_proc->acct->name));
+    strncpy(init_proc->cred->security_context, "system_u:system_r:init_t", 
+            sizeof(init_proc->cred->security_context));
+    init_proc->cred->security_sid = avc_context_sid(init_proc->cred->security_context);
     
     /* Allocate page directory */
     init_proc->page_directory = get_page_directory();
@@ -53,11 +124,6 @@ void process_init(void) {
         kernel_panic("Failed to allocate init process context");
     }
     
-    /* Clear open files */
-    for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        init_proc->open_files[i] = 0;
-    }
-    
     /* Add to process list */
     init_proc->next = NULL;
     init_proc->prev = NULL;
@@ -70,51 +136,53 @@ void process_init(void) {
 /* Create a new process */
 int process_create(const char *name, void (*entry_point)(void)) {
     /* Acquire scheduler lock */
-    while (__sync_lock_test_and_set(&scheduler_lock, 1)) {
-        /* Spin wait */
-    }
+    uint64_t flags = spin_lock_irqsave(&scheduler_lock);
     
     /* Allocate process structure */
-    struct process *proc = (struct process *)kmalloc(sizeof(struct process));
+    struct process *proc = process_alloc();
     if (!proc) {
-        __sync_lock_release(&scheduler_lock);
+        spin_unlock_irqrestore(&scheduler_lock, flags);
         return -1;
     }
     
     /* Initialize process */
-    proc->pid = next_pid++;
+    if (process_pid_attach(proc) < 0) {
+        process_free(proc);
+        spin_unlock_irqrestore(&scheduler_lock, flags);
+        return -1;
+    }
     proc->ppid = current_process ? current_process->pid : 0;
     proc->state = PROCESS_READY;
     proc->priority = 20; /* Default priority */
-    proc->uid = current_process ? current_process->uid : 0;
-    proc->gid = current_process ? current_process->gid : 0;
-    proc->euid = proc->uid;
-    proc->egid = proc->gid;
-    proc->memory_usage = 0;
-    proc->cpu_time = 0;
+    proc->cred->uid = current_process ? current_process->cred->uid : 0;
+    proc->cred->gid = current_process ? current_process->cred->gid : 0;
+    proc->cred->euid = proc->cred->uid;
+    proc->cred->egid = proc->cred->gid;
     
     /* Security context inheritance */
     if (current_process) {
-        proc->security_level = current_process->security_level;
-        proc->security_flags = current_process->security_flags;
-        strncpy(proc->security_context, current_process->security_context,
-                sizeof(proc->security_context));
+        proc->cred->security_level = current_process->cred->security_level;
+        proc->cred->security_flags = current_process->cred->security_flags;
+        strncpy(proc->cred->security_context, current_process->cred->security_context,
+                sizeof(proc->cred->security_context));
+        proc->cred->security_sid = current_process->cred->security_sid;
     } else {
-        proc->security_level = 0;
-        proc->security_flags = 0;
-        strncpy(proc->security_context, "unconfined_u:unconfined_r:unconfined_t",
-                sizeof(proc->security_context));
+        proc->cred->security_level = 0;
+        proc->cred->security_flags = 0;
+        strncpy(proc->cred->security_context, "unconfined_u:unconfined_r:unconfined_t",
+                sizeof(proc->cred->security_context));
+        proc->cred->security_sid = avc_context_sid(proc->cred->security_context);
     }
     
     /* Set process name */
-    strncpy(proc->name, name, sizeof(proc->name) - 1);
-    proc->name[sizeof(proc->name) - 1] = '\0';
+    strncpy(proc->acct->name, name, sizeof(proc->acct->name) - 1);
+    proc->acct->name[sizeof(proc->acct->name) - 1] = '\0';
     
     /* Allocate page directory */
-    proc->page_directory = (uint64_t *)kmalloc(PAGE_SIZE);
-    if (!proc->page_directory) {
-        kfree(proc);
-        __sync_lock_release(&scheduler_lock);
+    if (!process_mm_alloc(proc)) {
+        process_pid_detach(proc);
+        process_free(proc);
+        spin_unlock_irqrestore(&scheduler_lock, flags);
         return -1;
     }
     
@@ -136,9 +204,9 @@ int process_create(const char *name, void (*entry_point)(void)) {
     /* Initialize CPU context */
     proc->context = (struct cpu_context *)kmalloc(sizeof(struct cpu_context));
     if (!proc->context) {
-        kfree(proc->page_directory);
-        kfree(proc);
-        __sync_lock_release(&scheduler_lock);
+        process_pid_detach(proc);
+        process_free(proc);
+        spin_unlock_irqrestore(&scheduler_lock, flags);
         return -1;
     }
     
@@ -156,23 +224,18 @@ int process_create(const char *name, void (*entry_point)(void)) {
     proc->context->r8 = proc->context->r9 = proc->context->r10 = proc->context->r11 = 0;
     proc->context->r12 = proc->context->r13 = proc->context->r14 = proc->context->r15 = 0;
     
-    /* Clear open files */
-    for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        proc->open_files[i] = 0;
-    }
-    
-    /* Add to process list */
+    /* Add to process list; walkers see it once it is fully initialised */
     proc->next = process_list;
     if (process_list) {
         process_list->prev = proc;
     }
     proc->prev = NULL;
-    process_list = proc;
+    rcu_assign_pointer(process_list, proc);
     
     /* Add to ready queue */
     add_to_ready_queue(proc);
     
-    __sync_lock_release(&scheduler_lock);
+    spin_unlock_irqrestore(&scheduler_lock, flags);
     
     debug_print("Created process '%s' with PID %d\n", name, proc->pid);
     security_audit_log("PROCESS_CREATE", proc->pid, name);
@@ -188,24 +251,24 @@ static void add_to_ready_queue(struct process *proc) {
     
     /* Insert by priority (higher priority first) */
     if (!ready_queue || proc->priority > ready_queue->priority) {
-        proc->next = ready_queue;
+        proc->rq_next = ready_queue;
         if (ready_queue) {
-            ready_queue->prev = proc;
+            ready_queue->rq_prev = proc;
         }
-        proc->prev = NULL;
+        proc->rq_prev = NULL;
         ready_queue = proc;
     } else {
         struct process *curr = ready_queue;
-        while (curr->next && curr->next->priority >= proc->priority) {
-            curr = curr->next;
+        while (curr->rq_next && curr->rq_next->priority >= proc->priority) {
+            curr = curr->rq_next;
         }
         
-        proc->next = curr->next;
-        if (curr->next) {
-            curr->next->prev = proc;
+        proc->rq_next = curr->rq_next;
+        if (curr->rq_next) {
+            curr->rq_next->rq_prev = proc;
         }
-        proc->prev = curr;
-        curr->next = proc;
+        proc->rq_prev = curr;
+        curr->rq_next = proc;
     }
 }
 
@@ -215,31 +278,23 @@ static void remove_from_ready_queue(struct process *proc) {
         return;
     }
     
-    if (proc->prev) {
-        proc->prev->next = proc->next;
+    if (proc->rq_prev) {
+        proc->rq_prev->rq_next = proc->rq_next;
     } else {
-        ready_queue = proc->next;
+        ready_queue = proc->rq_next;
     }
     
-    if (proc->next) {
-        proc->next->prev = proc->prev;
+    if (proc->rq_next) {
+        proc->rq_next->rq_prev = proc->rq_prev;
     }
     
-    proc->next = proc->prev = NULL;
+    proc->rq_next = proc->rq_prev = NULL;
 }
 
-/* Process scheduler */
+/* Process scheduler; called from task context only */
 void process_schedule(void) {
-    /* Check if scheduling is disabled */
-    if (scheduler_lock) {
-        return;
-    }
-    
-    /* Acquire scheduler lock */
-    while (__sync_lock_test_and_set(&scheduler_lock, 1)) {
-        /* Spin wait */
-    }
-    
+    uint64_t flags = spin_lock_irqsave(&scheduler_lock);
+    process_resched_pending = false;
     scheduler_ticks++;
     
     /* Save current process context if running */
@@ -252,30 +307,6 @@ void process_schedule(void) {
     /* Find next process to run */
     struct process *next_proc = ready_queue;
     
-    /* Clean up zombie processes */
-    struct process *proc = process_list;
-    while (proc) {
-        struct process *next = proc->next;
-        if (proc->state == PROCESS_ZOMBIE) {
-            /* Remove from process list */
-            if (proc->prev) {
-                proc->prev->next = proc->next;
-            } else {
-                process_list = proc->next;
-            }
-            
-            if (proc->next) {
-                proc->next->prev = proc->prev;
-            }
-            
-            debug_print("Cleaning up zombie process %d\n", proc->pid);
-            kfree(proc->context);
-            kfree(proc->page_directory);
-            kfree(proc);
-        }
-        proc = next;
-    }
-    
     /* Select next process */
     if (next_proc) {
         remove_from_ready_queue(next_proc);
@@ -284,16 +315,24 @@ void process_schedule(void) {
         
         /* Switch to new process context */
         /* In a real implementation, this would load CPU registers and CR3 */
+        write_fs_base(next_proc->fs_base);
         
         debug_print("Switched to process %d (%s)\n", 
-                   next_proc->pid, next_proc->name);
+                   next_proc->pid, next_proc->acct->name);
     } else {
         /* No processes to run - idle */
         current_process = NULL;
         debug_print("No processes to schedule - idling\n");
     }
     
-    __sync_lock_release(&scheduler_lock);
+    spin_unlock_irqrestore(&scheduler_lock, flags);
+}
+
+/* Preemption point: run the rotation the timer tick asked for */
+void process_resched(void) {
+    if (process_resched_pending) {
+        process_schedule();
+    }
 }
 
 /* Destroy a process */
@@ -305,54 +344,45 @@ int process_destroy(uint32_t pid) {
     
     /* Security check */
     if (current_process && 
-        proc->uid != current_process->uid && 
-        current_process->uid != 0) {
+        proc->cred->uid != current_process->cred->uid && 
+        current_process->cred->uid != 0) {
         return -1; /* Permission denied */
     }
     
-    debug_print("Destroying process %d (%s)\n", pid, proc->name);
-    security_audit_log("PROCESS_DESTROY", pid, proc->name);
-    
-    /* Close all open files */
-    for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        if (proc->open_files[i]) {
-            /* Close file descriptor */
-            proc->open_files[i] = 0;
-        }
-    }
-    
-    /* Free memory */
-    if (proc->context) {
-        kfree(proc->context);
-    }
+    debug_print("Destroying process %d (%s)\n", pid, proc->acct->name);
+    security_audit_log("PROCESS_DESTROY", pid, proc->acct->name);
     
-    if (proc->page_directory) {
-        kfree(proc->page_directory);
-    }
+    /* Wake a joiner; drop open files and address space unless other threads share them */
+    process_exit_mm(proc);
     
-    /* Remove from queues */
+    /* Off the ready queue and out of the scheduler's hands before anything is freed */
+    uint64_t flags = spin_lock_irqsave(&scheduler_lock);
     if (proc->state == PROCESS_READY) {
         remove_from_ready_queue(proc);
     }
-    
-    /* Remove from process list */
-    if (proc->prev) {
-        proc->prev->next = proc->next;
-    } else {
-        process_list = proc->next;
+    proc->state = PROCESS_TERMINATED;
+    struct cpu_context *context = proc->context;
+    proc->context = NULL;
+    bool was_current = proc == current_process;
+    if (was_current) {
+        current_process = NULL;
     }
+    spin_unlock_irqrestore(&scheduler_lock, flags);
     
-    if (proc->next) {
-        proc->next->prev = proc->prev;
+    if (context) {
+        kfree(context);
     }
     
+    /* Remove from process list */
+    process_unlink(proc);
+    process_pid_detach(proc);
+    
     /* If this was the current process, schedule next */
-    if (proc == current_process) {
-        current_process = NULL;
+    if (was_current) {
         process_schedule();
     }
     
-    kfree(proc);
+    call_rcu(&proc->rcu, process_free_rcu);
     return 0;
 }
 
@@ -361,18 +391,385 @@ struct process *process_get_current(void) {
     return current_process;
 }
 
-/* Find process by PID */
+/* Find process by PID; the result stays valid until the caller's rcu_read_unlock() */
 struct process *process_find_by_pid(uint32_t pid) {
-    struct process *proc = process_list;
+    struct pid_node *node = pid_hash_find(&process_pids, pid);
+    return node ? pid_entry(node, struct process, pid_node) : NULL;
+}
+
+/* Allocate a PID for a new process and make it findable by that PID */
+int process_pid_attach(struct process *proc) {
+    int pid = pid_alloc(&process_pids);
+    if (pid < 0) {
+        return pid;
+    }
+    
+    proc->pid = (uint32_t)pid;
+    proc->tgid = proc->pid;     /* Leads its own thread group until clone() says otherwise */
+    if (pid_hash_add(&process_pids, &proc->pid_node, proc->pid) < 0) {
+        pid_free(&process_pids, proc->pid);
+        return -11; /* EAGAIN */
+    }
+    return pid;
+}
+
+/* Release the PID of a process that is being freed */
+void process_pid_detach(struct process *proc) {
+    pid_hash_del(&process_pids, &proc->pid_node);
+    pid_free(&process_pids, proc->pid);
+}
+
+static bool process_caches_init(void) {
+    process_cache = kmem_cache_create("process", sizeof(struct process), 64);
+    cred_cache = kmem_cache_create("process_cred", sizeof(struct process_cred), 0);
+    files_cache = kmem_cache_create("process_files", sizeof(struct process_files), 64);
+    acct_cache = kmem_cache_create("process_acct", sizeof(struct process_acct), 0);
+    mm_cache = kmem_cache_create("process_mm", sizeof(struct process_mm), 0);
+    return process_cache && cred_cache && files_cache && acct_cache && mm_cache;
+}
+
+/* Allocate a zeroed control block together with its cold parts */
+struct process *process_alloc(void) {
+    if (!process_cache && !process_caches_init()) {
+        return NULL;
+    }
+    
+    struct process *proc = kmem_cache_zalloc(process_cache);
+    if (!proc) {
+        return NULL;
+    }
+    proc->cred = kmem_cache_zalloc(cred_cache);
+    proc->files = kmem_cache_zalloc(files_cache);
+    proc->acct = kmem_cache_zalloc(acct_cache);
+    if (proc->files) {
+        files_init(proc->files);
+    }
+    if (!proc->cred || !proc->files || !proc->acct) {
+        process_free(proc);
+        return NULL;
+    }
+    return proc;
+}
+
+/* Give 'proc' a page directory of its own, uninitialised; NULL if out of memory */
+static uint64_t *process_mm_alloc(struct process *proc) {
+    struct process_mm *mm = kmem_cache_zalloc(mm_cache);
+    uint64_t *page_directory = kmalloc(PAGE_SIZE);
+    if (!mm || !page_directory) {
+        kmem_cache_free(mm_cache, mm);
+        kfree(page_directory);
+        return NULL;
+    }
+    mm->page_directory = page_directory;
+    mm->users = 1;
+    proc->mm = mm;
+    proc->page_directory = page_directory;
+    return page_directory;
+}
+
+/* Hold an address space for a thread sharing it or a ring mapped into it */
+void process_mm_get(struct process_mm *mm) {
+    __atomic_fetch_add(&mm->users, 1, __ATOMIC_RELAXED);
+}
+
+/* Drop a hold on an address space; the last user frees it */
+void process_mm_drop(struct process_mm *mm) {
+    if (__atomic_sub_fetch(&mm->users, 1, __ATOMIC_ACQ_REL) == 0) {
+        kfree(mm->page_directory);
+        kmem_cache_free(mm_cache, mm);
+    }
+}
+
+/* Drop 'proc's hold on its address space */
+static void process_mm_put(struct process *proc) {
+    if (proc->mm) {
+        process_mm_drop(proc->mm);
+    }
+    proc->mm = NULL;
+    proc->page_directory = NULL;
+}
+
+/* Drop a pin on a descriptor table (files_pin()); the last hold frees it */
+void process_files_unpin(struct process_files *files) {
+    if (files_unpin(files)) {
+        kmem_cache_free(files_cache, files);
+    }
+}
+
+/* Drop 'proc's share of its descriptor table, which is closed with its last user */
+static void process_files_put(struct process *proc) {
+    struct process_files *files = proc->files;
+    if (files && files_put(files)) {
+        files_release(files);
+        process_files_unpin(files);
+    }
+    proc->files = NULL;
+}
+
+/*
+ * Allocate a copy of 'parent' with private copies of its cold parts. The
+ * descriptor table and address space are shared instead with CLONE_FILES
+ * and CLONE_VM.
+ */
+struct process *process_clone(const struct process *parent, uint64_t flags) {
+    struct process *proc = process_alloc();
+    if (!proc) {
+        return NULL;
+    }
+    
+    struct process_cred *cred = proc->cred;
+    struct process_files *files = proc->files;
+    struct process_acct *acct = proc->acct;
+    
+    *proc = *parent;
+    *cred = *parent->cred;
+    *acct = *parent->acct;
+    
+    proc->cred = cred;
+    proc->files = files;
+    proc->acct = acct;
+    proc->next = proc->prev = NULL;
+    proc->rq_next = proc->rq_prev = NULL;
+    proc->context = NULL;
+    proc->user_regs = NULL;
+    proc->mm = NULL;
+    proc->page_directory = NULL;
+    proc->clear_child_tid = NULL;
+    proc->kill_signal = 0;
+    init_waitqueue_head(&proc->wait_child);
+    
+    /* A fork shares the parent's open files, not its descriptor table */
+    if (flags & CLONE_FILES) {
+        kmem_cache_free(files_cache, files);
+        proc->files = parent->files;
+        files_get(proc->files);
+    } else if (files_copy(files, parent->files) < 0) {
+        process_free(proc);
+        return NULL;
+    }
     
-    while (proc) {
-        if (proc->pid == pid) {
-            return proc;
+    if (flags & CLONE_VM) {
+        proc->mm = parent->mm;
+        proc->page_directory = parent->page_directory;
+        if (proc->mm) {
+            process_mm_get(proc->mm);
         }
-        proc = proc->next;
+    } else if (parent->page_directory) {
+        if (!process_mm_alloc(proc)) {
+            process_free(proc);
+            return NULL;
+        }
+        
+        /* Copy memory space (simplified) */
+        for (int i = 0; i < 512; i++) {
+            proc->page_directory[i] = parent->page_directory[i];
+        }
+    }
+    return proc;
+}
+
+/*
+ * The child's first return to user mode: the registers of the parent's
+ * clone() call, with 0 returned and 'stack' as the stack pointer if
+ * given. The TLS base travels in fs_base. A caller from the kernel has
+ * no user frame to copy, and gets a cleared one.
+ */
+static struct cpu_context *clone_context(const struct process *parent,
+                                         const struct process *child, uint64_t stack) {
+    struct cpu_context *ctx = kmalloc(sizeof(*ctx));
+    if (!ctx) {
+        return NULL;
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    
+    const struct pt_regs *regs = parent->user_regs;
+    if (regs) {
+        ctx->rbx = regs->rbx;
+        ctx->rcx = regs->rcx;
+        ctx->rdx = regs->rdx;
+        ctx->rsi = regs->rsi;
+        ctx->rdi = regs->rdi;
+        ctx->rbp = regs->rbp;
+        ctx->rsp = regs->rsp;
+        ctx->r8 = regs->r8;
+        ctx->r9 = regs->r9;
+        ctx->r10 = regs->r10;
+        ctx->r11 = regs->r11;
+        ctx->r12 = regs->r12;
+        ctx->r13 = regs->r13;
+        ctx->r14 = regs->r14;
+        ctx->r15 = regs->r15;
+        ctx->rip = regs->rip;
+        ctx->rflags = regs->rflags;
+        ctx->cs = regs->cs;
+        ctx->ss = ctx->ds = ctx->es = regs->ss;
+    } else {
+        ctx->rflags = 0x202; /* Enable interrupts */
+    }
+    ctx->rax = 0;
+    if (stack) {
+        ctx->rsp = stack;
+    }
+    ctx->cr3 = (uint64_t)child->page_directory;
+    return ctx;
+}
+
+/*
+ * clone(): a thread or process created from 'parent', returning its TID.
+ * A CLONE_THREAD child joins the parent's thread group and reports to the
+ * group's parent, which never waits for it: it is reaped on exit. The TID
+ * words are written here, before the child can run.
+ */
+long do_clone(struct process *parent, uint64_t flags, uint64_t stack, uint32_t *ptid,
+              uint32_t *ctid, uint64_t tls) {
+    const uint64_t supported = CLONE_VM | CLONE_FILES | CLONE_THREAD | CLONE_SETTLS |
+                               CLONE_PARENT_SETTID | CLONE_CHILD_CLEARTID | CLONE_CHILD_SETTID;
+    if ((flags & ~(supported | 0xFF)) || ((flags & CLONE_THREAD) && !(flags & CLONE_VM))) {
+        return -22; /* EINVAL */
+    }
+    if ((flags & CLONE_SETTLS) && tls > USER_ADDR_MAX) {
+        return -1; /* EPERM */
+    }
+    if (((flags & CLONE_PARENT_SETTID) && !access_ok(ptid, sizeof(*ptid))) ||
+        ((flags & (CLONE_CHILD_SETTID | CLONE_CHILD_CLEARTID)) &&
+         !access_ok(ctid, sizeof(*ctid)))) {
+        return -14; /* EFAULT */
+    }
+    
+    struct process *child = process_clone(parent, flags);
+    if (!child) {
+        return -12; /* ENOMEM */
+    }
+    child->context = clone_context(parent, child, stack);
+    if (!child->context) {
+        process_free(child);
+        return -12; /* ENOMEM */
+    }
+    if (process_pid_attach(child) < 0) {
+        kfree(child->context);
+        process_free(child);
+        return -11; /* EAGAIN */
+    }
+    
+    if (flags & CLONE_THREAD) {
+        child->tgid = parent->tgid;
+        child->ppid = parent->ppid;
+    } else {
+        child->ppid = parent->pid;
+    }
+    if (stack) {
+        child->user_stack = stack;
+    }
+    if (flags & CLONE_SETTLS) {
+        child->fs_base = tls;
+    }
+    if (flags & CLONE_CHILD_CLEARTID) {
+        child->clear_child_tid = ctid;
+    }
+    
+    /* A fault leaves the word unset, as on Linux; the TID is still returned */
+    uint32_t tid = child->pid;
+    if (flags & CLONE_PARENT_SETTID) {
+        __copy_to_user(ptid, &tid, sizeof(tid));
+    }
+    if (flags & CLONE_CHILD_SETTID) {
+        __copy_to_user(ctid, &tid, sizeof(tid));
+    }
+    
+    /* Visible to list walkers first, then runnable */
+    child->state = PROCESS_READY;
+    process_link(child);
+    uint64_t irqflags = spin_lock_irqsave(&scheduler_lock);
+    add_to_ready_queue(child);
+    spin_unlock_irqrestore(&scheduler_lock, irqflags);
+    return tid;
+}
+
+/*
+ * Exit-time release of what a process may share with its threads: zero
+ * its clear_child_tid word and wake one joiner on it, then drop the
+ * descriptor table and address space, which the last user frees.
+ */
+void process_exit_mm(struct process *proc) {
+    if (proc->clear_child_tid) {
+        uint32_t zero = 0;
+        if (!copy_to_user(proc->clear_child_tid, &zero, sizeof(zero))) {
+            futex_wake(proc->clear_child_tid, 1);
+        }
+        proc->clear_child_tid = NULL;
+    }
+    process_files_put(proc);
+    process_mm_put(proc);
+}
+
+/* exit_group(): terminate the other threads of 'proc's group at their syscall exit */
+void process_kill_group(struct process *proc, uint32_t sig) {
+    rcu_read_lock();
+    struct process *p;
+    rcu_list_for_each(p, process_list, next) {
+        if (p != proc && p->tgid == proc->tgid && p->state != PROCESS_ZOMBIE) {
+            __atomic_store_n(&p->kill_signal, sig, __ATOMIC_RELAXED);
+        }
+    }
+    rcu_read_unlock();
+}
+
+/*
+ * A process became a zombie: wake a parent sleeping in waitpid() on it.
+ * A worker reaps it if it has no parent, along with any of its own
+ * zombie children that have now lost theirs.
+ */
+void process_notify_parent(struct process *proc) {
+    rcu_read_lock();
+    struct process *parent = process_find_by_pid(proc->ppid);
+    if (parent) {
+        wake_up_all(&parent->wait_child);
+    }
+    rcu_read_unlock();
+    queue_work(system_unbound_wq, &reap_work);
+}
+
+/* Free zombie threads, and zombie processes whose parent has exited (system_unbound_wq) */
+static void process_reap_zombies(struct work_struct *work) {
+    (void)work;
+    
+    uint64_t flags = spin_lock_irqsave(&scheduler_lock);
+    
+    /* Reaping a zombie orphans its own zombie children: repeat until stable */
+    bool reaped;
+    do {
+        reaped = false;
+        struct process *proc = process_list;
+        while (proc) {
+            struct process *next = proc->next;
+            if (proc->state == PROCESS_ZOMBIE &&
+                (proc->tgid != proc->pid || !process_find_by_pid(proc->ppid))) {
+                process_list_del(proc);
+                
+                debug_print("Cleaning up zombie process %d\n", proc->pid);
+                process_pid_detach(proc);
+                kfree(proc->context);
+                call_rcu(&proc->rcu, process_free_rcu);
+                reaped = true;
+            }
+            proc = next;
+        }
+    } while (reaped);
+    
+    spin_unlock_irqrestore(&scheduler_lock, flags);
+}
+
+/* Return a control block and its cold parts to their caches */
+void process_free(struct process *proc) {
+    if (!proc) {
+        return;
     }
     
-    return NULL;
+    process_files_put(proc);
+    process_mm_put(proc);
+    kmem_cache_free(cred_cache, proc->cred);
+    kmem_cache_free(acct_cache, proc->acct);
+    kmem_cache_free(process_cache, proc);
 }
 
 /* Get process statistics */
@@ -380,8 +777,9 @@ void process_get_stats(uint32_t *total_processes, uint32_t *running_processes,
                       uint32_t *zombie_processes) {
     uint32_t total = 0, running = 0, zombie = 0;
     
-    struct process *proc = process_list;
-    while (proc) {
+    rcu_read_lock();
+    struct process *proc;
+    rcu_list_for_each(proc, process_list, next) {
         total++;
         switch (proc->state) {
             case PROCESS_RUNNING:
@@ -394,8 +792,8 @@ void process_get_stats(uint32_t *total_processes, uint32_t *running_processes,
             default:
                 break;
         }
-        proc = proc->next;
     }
+    rcu_read_unlock();
     
     if (total_processes) *total_processes = total;
     if (running_processes) *running_processes = running;
@@ -408,36 +806,46 @@ void process_list_all(void) {
     debug_print("PID\tPPID\tState\tPriority\tName\t\tSecurity Level\n");
     debug_print("---\t----\t-----\t--------\t----\t\t--------------\n");
     
-    struct process *proc = process_list;
-    while (proc) {
+    rcu_read_lock();
+    struct process *proc;
+    rcu_list_for_each(proc, process_list, next) {
         const char *state_names[] = {"READY", "RUNNING", "BLOCKED", "ZOMBIE", "TERMINATED"};
         debug_print("%d\t%d\t%s\t%d\t\t%s\t\t%d\n",
                    proc->pid, proc->ppid, 
                    state_names[proc->state], 
                    proc->priority, 
-                   proc->name,
-                   proc->security_level);
-        proc = proc->next;
+                   proc->acct->name,
+                   proc->cred->security_level);
     }
+    rcu_read_unlock();
     
     debug_print("===================\n\n");
 }
 
-/* Timer interrupt handler for scheduling */
-void scheduler_timer_interrupt(void) {
+/* Timer interrupt handler for scheduling; 'ticks' periods elapsed since the last call */
+void scheduler_timer_interrupt(uint64_t ticks) {
+    static uint64_t timer_ticks = 0;
     static uint64_t last_schedule = 0;
     
+    /* Per-CPU accounting and load balancing */
+    sched_tick(ticks);
+    timer_ticks += ticks;
+    
     /* Schedule every 10ms (100Hz) */
-    if (scheduler_ticks - last_schedule >= 10) {
-        last_schedule = scheduler_ticks;
+    if (timer_ticks - last_schedule >= 10) {
+        last_schedule = timer_ticks;
         
         /* Update current process CPU time */
         if (current_process) {
-            current_process->cpu_time++;
+            current_process->acct->cpu_time++;
         }
         
-        /* Preemptive scheduling */
-        process_schedule();
+        /*
+         * Preemptive scheduling, deferred to the next preemption point:
+         * the interrupted code may hold scheduler_lock.
+         */
+        process_resched_pending = true;
+        set_need_resched();
     }
 }
 
@@ -448,13 +856,224 @@ void process_exit(int status) {
     }
     
     debug_print("Process %d (%s) exiting with status %d\n", 
-               current_process->pid, current_process->name, status);
+               current_process->pid, current_process->acct->name, status);
     
-    security_audit_log("PROCESS_EXIT", current_process->pid, current_process->name);
+    security_audit_log("PROCESS_EXIT", current_process->pid, current_process->acct->name);
+    process_exit_mm(current_process);
     
     /* Set to zombie state for parent to collect */
     current_process->state = PROCESS_ZOMBIE;
+    process_notify_parent(current_process);
     
     /* Schedule next process */
     process_schedule();
+}
+
+/* Control block layout before the hot/cold split, kept for comparison */
+struct process_flat {
+    uint32_t pid;
+    uint32_t ppid;
+    process_state_t state;
+    uint32_t priority;
+    uint64_t *page_directory;
+    uint64_t kernel_stack;
+    uint64_t user_stack;
+    struct cpu_context *context;
+    uint32_t uid, gid;
+    uint32_t euid, egid;
+    char name[64];
+    uint64_t memory_usage;
+    uint64_t cpu_time;
+    uint32_t open_files[MAX_OPEN_FILES];
+    struct process_flat *next;
+    struct process_flat *prev;
+    uint8_t security_level;
+    uint32_t security_flags;
+    char security_context[128];
+};
+
+/* Flush caches and start counting LLC misses if the PMU allows */
+static void walk_begin(bool pmc) {
+    __asm__ __volatile__("wbinvd" ::: "memory");
+    if (pmc) {
+        pmc0_start(PERF_EVENT_LLC_MISSES);
+    }
+}
+
+static uint64_t walk_end(bool pmc) {
+    return pmc ? pmc0_stop() : 0;
+}
+
+/*
+ * Run-queue walk benchmark: read state and priority of nr_processes
+ * control blocks linked in random order, as process_get_stats() does,
+ * once in the old flat layout and once in the split layout.
+ */
+void process_benchmark_walk(uint32_t nr_processes) {
+    debug_print("=== PROCESS WALK BENCHMARK (%u processes) ===\n", nr_processes);
+    
+    struct process_flat *flat = kmalloc(sizeof(struct process_flat) * nr_processes);
+    struct process **split = kmalloc(sizeof(struct process *) * nr_processes);
+    uint32_t *order = kmalloc(sizeof(uint32_t) * nr_processes);
+    if (!flat || !split || !order || !nr_processes) {
+        debug_print("Process walk benchmark: out of memory\n");
+        return;
+    }
+    
+    uint32_t nr_split = 0;
+    for (; nr_split < nr_processes; nr_split++) {
+        split[nr_split] = process_alloc();
+        if (!split[nr_split]) {
+            break;
+        }
+    }
+    
+    /* Same random link order for both layouts */
+    uint64_t seed = get_ticks() | 1;
+    for (uint32_t i = 0; i < nr_split; i++) {
+        order[i] = i;
+    }
+    for (uint32_t i = nr_split; i > 1; i--) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t j = (seed >> 33) % i;
+        uint32_t tmp = order[i - 1];
+        order[i - 1] = order[j];
+        order[j] = tmp;
+    }
+    for (uint32_t i = 0; i < nr_split; i++) {
+        struct process_flat *f = &flat[order[i]];
+        struct process *p = split[order[i]];
+        f->state = p->state = (i % 3) ? PROCESS_READY : PROCESS_BLOCKED;
+        f->priority = p->priority = i % 40;
+        f->next = i + 1 < nr_split ? &flat[order[i + 1]] : NULL;
+        p->next = i + 1 < nr_split ? split[order[i + 1]] : NULL;
+    }
+    
+    bool pmc = pmc_arch_event_available(PERF_ARCH_LLC_MISSES);
+    uint32_t runnable = 0;
+    uint64_t prio_sum = 0;
+    
+    walk_begin(pmc);
+    uint64_t start = get_ticks();
+    for (struct process_flat *f = nr_split ? &flat[order[0]] : NULL; f; f = f->next) {
+        runnable += f->state == PROCESS_READY;
+        prio_sum += f->priority;
+    }
+    uint64_t flat_cycles = get_ticks() - start;
+    uint64_t flat_misses = walk_end(pmc);
+    
+    walk_begin(pmc);
+    start = get_ticks();
+    for (struct process *p = nr_split ? split[order[0]] : NULL; p; p = p->next) {
+        runnable += p->state == PROCESS_READY;
+        prio_sum += p->priority;
+    }
+    uint64_t split_cycles = get_ticks() - start;
+    uint64_t split_misses = walk_end(pmc);
+    
+    debug_print("flat  (%lu B/entry): %lu cycles/entry, %lu LLC misses\n",
+                sizeof(struct process_flat), flat_cycles / (nr_split ? nr_split : 1), flat_misses);
+    debug_print("split (%lu B/entry): %lu cycles/entry, %lu LLC misses\n",
+                sizeof(struct process), split_cycles / (nr_split ? nr_split : 1), split_misses);
+    if (!pmc) {
+        debug_print("LLC miss counter unavailable; cycles only\n");
+    }
+    debug_print("(%u runnable, priority sum %lu)\n", runnable / 2, prio_sum / 2);
+    
+    for (uint32_t i = 0; i < nr_split; i++) {
+        process_free(split[i]);
+    }
+    kfree(order);
+    kfree(split);
+    kfree(flat);
+}
+
+/*
+ * Thread create/join latency: clone() children of a scratch parent with
+ * CLONE_BENCH_FDS open files, then run each child's exit and the
+ * parent's futex join on its clear_child_tid word. Once as a fork, with
+ * private copies of the descriptor table and page directory, and once as
+ * a thread sharing both. The children never run, so this is the kernel
+ * bookkeeping without the context switches.
+ */
+#define CLONE_BENCH_FDS 32
+
+void process_benchmark_clone(uint32_t iterations) {
+    static const struct {
+        const char *name;
+        uint64_t flags;
+    } modes[] = {
+        { "fork", 0 },
+        { "thread", CLONE_VM | CLONE_FILES | CLONE_THREAD | CLONE_SETTLS },
+    };
+    const uint64_t join_flags = CLONE_PARENT_SETTID | CLONE_CHILD_SETTID | CLONE_CHILD_CLEARTID;
+    
+    debug_print("=== CLONE BENCHMARK (%u iterations, %u open files) ===\n",
+                iterations, CLONE_BENCH_FDS);
+    
+    struct process *parent = process_alloc();
+    if (!parent || !process_mm_alloc(parent) || process_pid_attach(parent) < 0) {
+        debug_print("Clone benchmark: out of memory\n");
+        process_free(parent);
+        return;
+    }
+    for (int i = 0; i < 512; i++) {
+        parent->page_directory[i] = 0;
+    }
+    for (uint32_t i = 0; i < CLONE_BENCH_FDS; i++) {
+        struct file_descriptor *file = file_alloc(NULL, 0, 0);
+        int fd = file ? fd_alloc(parent->files, 0) : -12;
+        if (fd < 0) {
+            if (file) {
+                file_put(file);
+            }
+            break;
+        }
+        fd_install(parent->files, fd, file);
+    }
+    
+    /* The TID words live on this stack */
+    bool was_kernel = sched_set_uaccess_kernel(true);
+    
+    for (uint32_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        uint64_t create = 0, join = 0;
+        uint32_t done = 0;
+        for (; done < iterations; done++) {
+            uint32_t ptid = 0, ctid = 0;
+            uint64_t start = get_ticks();
+            long tid = do_clone(parent, modes[m].flags | join_flags, 0, &ptid, &ctid, 0);
+            uint64_t created = get_ticks();
+            struct process *child = tid > 0 ? process_find_by_pid(tid) : NULL;
+            if (!child || ptid != (uint32_t)tid || ctid != (uint32_t)tid) {
+                debug_print("%s: clone() returned %ld\n", modes[m].name, tid);
+                break;
+            }
+            
+            /* The child exits; the parent joins once the kernel has cleared ctid */
+            process_exit_mm(child);
+            for (uint32_t val; (val = __atomic_load_n(&ctid, __ATOMIC_ACQUIRE)) != 0;) {
+                futex_wait(&ctid, val, 0);
+            }
+            uint64_t joined = get_ticks();
+            create += created - start;
+            join += joined - created;
+            
+            uint64_t flags = spin_lock_irqsave(&scheduler_lock);
+            if (child->state == PROCESS_READY) {
+                remove_from_ready_queue(child);
+            }
+            spin_unlock_irqrestore(&scheduler_lock, flags);
+            process_unlink(child);
+            process_pid_detach(child);
+            kfree(child->context);
+            call_rcu(&child->rcu, process_free_rcu);
+        }
+        
+        debug_print("%-6s: create %lu cycles, exit+join %lu cycles\n", modes[m].name,
+                    create / (done ? done : 1), join / (done ? done : 1));
+    }
+    
+    sched_set_uaccess_kernel(was_kernel);
+    process_pid_detach(parent);
+    process_free(parent);
 }
\ No newline at end of file
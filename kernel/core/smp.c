@@ -0,0 +1,226 @@
+/*
+ * SentinalOS SMP Support
+ * Per-CPU Data Areas and CPU Topology Discovery
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "string.h"
+#include "smp.h"
+
+/* Per-CPU areas and topology */
+static struct percpu percpu_areas[MAX_CPUS];
+static struct cpu_topology cpu_topology[MAX_CPUS];
+
+/* Topology shifts derived from CPUID (identical for all CPUs) */
+static struct {
+    uint32_t smt_shift;     /* APIC ID bits selecting the SMT thread */
+    uint32_t package_shift; /* APIC ID bits below the package ID */
+    uint32_t llc_shift;     /* APIC ID bits below the LLC ID */
+    uint32_t num_cpus;
+    bool initialized;
+} smp_state;
+
+/* Number of APIC ID bits needed to enumerate 'count' IDs */
+static uint32_t count_to_shift(uint32_t count) {
+    uint32_t shift = 0;
+    while ((1U << shift) < count) {
+        shift++;
+    }
+    return shift;
+}
+
+/* Read the initial APIC ID of the executing CPU */
+static uint32_t read_apic_id(void) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    cpuid_count(0, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 0xB) {
+        cpuid_count(0xB, 0, &eax, &ebx, &ecx, &edx);
+        if (ebx != 0) {
+            return edx; /* x2APIC ID */
+        }
+    }
+    
+    cpuid_count(1, 0, &eax, &ebx, &ecx, &edx);
+    return ebx >> 24;
+}
+
+/* Discover SMT, package and last-level cache shifts */
+static void detect_topology_shifts(void) {
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t max_leaf, max_ext_leaf;
+    
+    cpuid_count(0, 0, &max_leaf, &ebx, &ecx, &edx);
+    cpuid_count(0x80000000, 0, &max_ext_leaf, &ebx, &ecx, &edx);
+    
+    smp_state.smt_shift = 0;
+    smp_state.package_shift = 0;
+    
+    /* Extended topology enumeration (leaf 0xB) */
+    if (max_leaf >= 0xB) {
+        cpuid_count(0xB, 0, &eax, &ebx, &ecx, &edx);
+        if (ebx != 0) {
+            for (uint32_t level = 0; level < 8; level++) {
+                cpuid_count(0xB, level, &eax, &ebx, &ecx, &edx);
+                uint32_t type = (ecx >> 8) & 0xFF;
+                if (type == 0) {
+                    break;
+                }
+                if (type == 1) {
+                    smp_state.smt_shift = eax & 0x1F;
+                } else if (type == 2) {
+                    smp_state.package_shift = eax & 0x1F;
+                }
+            }
+        }
+    }
+    
+    /* Legacy fallback: logical processor count from leaf 1 */
+    if (smp_state.package_shift == 0) {
+        cpuid_count(1, 0, &eax, &ebx, &ecx, &edx);
+        if (edx & (1 << 28)) { /* HTT */
+            smp_state.package_shift = count_to_shift((ebx >> 16) & 0xFF);
+        }
+    }
+    
+    /*
+     * Deterministic cache parameters: AMD leaf 0x8000001D where TOPOEXT
+     * says it is valid (AMD reports leaf 4 as reserved), else Intel leaf 4
+     */
+    bool topoext = false;
+    if (max_ext_leaf >= 0x80000001) {
+        cpuid_count(0x80000001, 0, &eax, &ebx, &ecx, &edx);
+        topoext = ecx & (1 << 22);
+    }
+    
+    uint32_t cache_leaf = 0;
+    if (topoext && max_ext_leaf >= 0x8000001D) {
+        cache_leaf = 0x8000001D;
+    } else if (max_leaf >= 4) {
+        cache_leaf = 4;
+    }
+    
+    smp_state.llc_shift = smp_state.package_shift;
+    if (cache_leaf) {
+        uint32_t best_level = 0;
+        for (uint32_t index = 0; index < 16; index++) {
+            cpuid_count(cache_leaf, index, &eax, &ebx, &ecx, &edx);
+            uint32_t type = eax & 0x1F;
+            if (type == 0) {
+                break;
+            }
+            uint32_t level = (eax >> 5) & 0x7;
+            if (level > best_level) {
+                best_level = level;
+                smp_state.llc_shift = count_to_shift(((eax >> 14) & 0xFFF) + 1);
+            }
+        }
+    }
+}
+
+/* Fill the topology entry for a CPU from its APIC ID */
+static void fill_topology(uint32_t cpu, uint32_t apic_id) {
+    struct cpu_topology *topo = &cpu_topology[cpu];
+    
+    topo->apic_id = apic_id;
+    topo->smt_id = apic_id & ((1U << smp_state.smt_shift) - 1);
+    topo->core_id = (apic_id >> smp_state.smt_shift) &
+                    ((1U << (smp_state.package_shift - smp_state.smt_shift)) - 1);
+    topo->package_id = apic_id >> smp_state.package_shift;
+    topo->llc_id = apic_id >> smp_state.llc_shift;
+    
+    /* Until an SRAT entry says otherwise, one node per package */
+    topo->numa_node = topo->package_id % MAX_NUMA_NODES;
+    topo->online = true;
+}
+
+/* Point the executing CPU's GS base at its per-CPU area */
+static void load_percpu_base(struct percpu *pc) {
+    wrmsr(MSR_GS_BASE, (uint64_t)pc);
+}
+
+/* Bring up SMP bookkeeping on the boot CPU */
+void smp_init(void) {
+    KLOG_INFO("Initializing SMP topology...");
+    
+    memset(percpu_areas, 0, sizeof(percpu_areas));
+    memset(cpu_topology, 0, sizeof(cpu_topology));
+    
+    detect_topology_shifts();
+    
+    smp_state.num_cpus = 0;
+    smp_state.initialized = true;
+    
+    /* The boot CPU is always CPU 0 */
+    smp_cpu_online(read_apic_id());
+    
+    KLOG_INFO("Topology: SMT shift %u, LLC shift %u, package shift %u",
+              smp_state.smt_shift, smp_state.llc_shift, smp_state.package_shift);
+}
+
+/*
+ * Register the executing CPU. Called by the BSP from smp_init and by each
+ * application processor from its startup path. Returns the CPU index.
+ */
+int smp_cpu_online(uint32_t apic_id) {
+    if (!smp_state.initialized || smp_state.num_cpus >= MAX_CPUS) {
+        return -1;
+    }
+    
+    uint32_t cpu = __sync_fetch_and_add(&smp_state.num_cpus, 1);
+    if (cpu >= MAX_CPUS) {
+        return -1;
+    }
+    
+    struct percpu *pc = &percpu_areas[cpu];
+    pc->self = pc;
+    pc->cpu_id = cpu;
+    pc->apic_id = apic_id;
+    load_percpu_base(pc);
+    
+    fill_topology(cpu, apic_id);
+    
+    KLOG_INFO("CPU %u online (APIC %u, package %u, core %u, LLC %u, node %u)",
+              cpu, apic_id, cpu_topology[cpu].package_id, cpu_topology[cpu].core_id,
+              cpu_topology[cpu].llc_id, cpu_topology[cpu].numa_node);
+    
+    return cpu;
+}
+
+uint32_t smp_num_cpus(void) {
+    return smp_state.num_cpus ? smp_state.num_cpus : 1;
+}
+
+struct percpu *smp_percpu(uint32_t cpu) {
+    if (cpu >= MAX_CPUS) {
+        return NULL;
+    }
+    return &percpu_areas[cpu];
+}
+
+const struct cpu_topology *smp_cpu_topology(uint32_t cpu) {
+    if (cpu >= MAX_CPUS) {
+        return NULL;
+    }
+    return &cpu_topology[cpu];
+}
+
+/* Record the proximity domain of a CPU (from an ACPI SRAT processor entry) */
+void smp_set_numa_node(uint32_t apic_id, uint32_t node) {
+    for (uint32_t cpu = 0; cpu < smp_num_cpus(); cpu++) {
+        if (cpu_topology[cpu].apic_id == apic_id) {
+            cpu_topology[cpu].numa_node = node % MAX_NUMA_NODES;
+            return;
+        }
+    }
+}
+
+bool smp_cpus_share_llc(uint32_t cpu_a, uint32_t cpu_b) {
+    return cpu_topology[cpu_a].llc_id == cpu_topology[cpu_b].llc_id &&
+           cpu_topology[cpu_a].package_id == cpu_topology[cpu_b].package_id;
+}
+
+bool smp_cpus_share_node(uint32_t cpu_a, uint32_t cpu_b) {
+    return cpu_topology[cpu_a].numa_node == cpu_topology[cpu_b].numa_node;
+}
\ No newline at end of file
@@ -0,0 +1,375 @@
+/*
+ * SentinalOS Syscall Tracing
+ * Per-CPU Latency Histograms and Trace Rings
+ */
+
+#include "../include/system.h"
+#include "../include/string.h"
+#include "../include/smp.h"
+#include "../include/preempt.h"
+#include "../include/procfs.h"
+#include "../include/systrace.h"
+#include "../include/uaccess.h"
+
+#define SYSTRACE_RING_BYTES     (SYSTRACE_RING_PAGES * PAGE_SIZE)
+#define SYSTRACE_RING_RECORDS \
+    ((SYSTRACE_RING_BYTES - sizeof(struct systrace_ring)) / sizeof(struct systrace_record))
+
+int snprintf(char *buf, size_t size, const char *fmt, ...);
+
+_Static_assert(sizeof(struct systrace_ring) == 64, "ring header is one cache line");
+
+/*
+ * One CPU's ring indices. The mapped header only mirrors them, so nothing
+ * userland writes can steer the producer; a line each since the CPU
+ * writes head and lost while readers write tail.
+ */
+struct systrace_ring_state {
+    uint64_t head;
+    uint64_t tail;
+    uint64_t lost;
+    uint64_t pad[5];
+};
+
+/* One CPU's counters; only that CPU writes them, with preemption disabled */
+struct systrace_cpu {
+    uint64_t count[SYSTRACE_NR_SYSCALLS];
+    uint64_t cycles[SYSTRACE_NR_SYSCALLS];
+    uint32_t hist[SYSTRACE_NR_SYSCALLS][SYSTRACE_HIST_BUCKETS];
+};
+
+volatile uint32_t systrace_flags;
+
+/* Allocated on first enable and kept, so a stale flag never sees NULL */
+static struct systrace_cpu *systrace_stats;
+static void *systrace_region_alloc;
+static uint8_t *systrace_region;        /* Page aligned: the rings, back to back */
+static struct systrace_ring_state *systrace_state;
+static uint32_t systrace_nr_cpus;
+
+static struct mutex systrace_lock;      /* Enabling and allocation */
+static spinlock_t systrace_read_lock;   /* read() consumers */
+
+static const struct proc_entry syscalls_proc_entry;
+static const struct proc_entry systrace_proc_entry;
+
+static inline struct systrace_ring *systrace_ring(uint32_t cpu) {
+    return (struct systrace_ring *)(systrace_region + (size_t)cpu * SYSTRACE_RING_BYTES);
+}
+
+static inline struct systrace_record *systrace_ring_records(struct systrace_ring *ring) {
+    return (struct systrace_record *)(ring + 1);
+}
+
+void systrace_init(void) {
+    mutex_init(&systrace_lock);
+    spin_lock_init(&systrace_read_lock);
+    proc_register(&syscalls_proc_entry);
+    proc_register(&systrace_proc_entry);
+}
+
+static int systrace_alloc_stats(void) {
+    size_t size = systrace_nr_cpus * sizeof(struct systrace_cpu);
+    struct systrace_cpu *stats = kmalloc(size);
+    if (!stats) {
+        return -12; /* ENOMEM */
+    }
+    memset(stats, 0, size);
+    systrace_stats = stats;
+    return 0;
+}
+
+static int systrace_alloc_rings(void) {
+    size_t size = (size_t)systrace_nr_cpus * SYSTRACE_RING_BYTES;
+    size_t state_size = systrace_nr_cpus * sizeof(struct systrace_ring_state);
+    void *alloc = kmalloc(size + PAGE_SIZE);
+    struct systrace_ring_state *state = kmalloc(state_size);
+    if (!alloc || !state) {
+        kfree(state);
+        kfree(alloc);
+        return -12; /* ENOMEM */
+    }
+    uint8_t *region = (uint8_t *)(((uint64_t)alloc + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+    memset(region, 0, size);
+    memset(state, 0, state_size);
+    systrace_region_alloc = alloc;
+    systrace_state = state;
+    systrace_region = region;
+    for (uint32_t cpu = 0; cpu < systrace_nr_cpus; cpu++) {
+        struct systrace_ring *ring = systrace_ring(cpu);
+        ring->nr_records = SYSTRACE_RING_RECORDS;
+        ring->record_size = sizeof(struct systrace_record);
+    }
+    return 0;
+}
+
+/* Switch statistics and tracing to exactly 'flags', allocating on first use */
+int systrace_enable(uint32_t flags) {
+    if (flags & ~(SYSTRACE_STATS | SYSTRACE_TRACE)) {
+        return -22; /* EINVAL */
+    }
+    
+    mutex_lock(&systrace_lock);
+    if (!systrace_nr_cpus) {
+        systrace_nr_cpus = smp_num_cpus();
+    }
+    int ret = 0;
+    if ((flags & SYSTRACE_STATS) && !systrace_stats) {
+        ret = systrace_alloc_stats();
+    }
+    if (!ret && (flags & SYSTRACE_TRACE) && !systrace_region) {
+        ret = systrace_alloc_rings();
+    }
+    if (!ret) {
+        /* Pairs with the acquire in systrace_syscall_exit() */
+        __atomic_store_n(&systrace_flags, flags, __ATOMIC_RELEASE);
+    }
+    mutex_unlock(&systrace_lock);
+    return ret;
+}
+
+/* Zero the counters and lost counts; updates racing with this may survive it */
+void systrace_reset(void) {
+    mutex_lock(&systrace_lock);
+    if (systrace_stats) {
+        memset(systrace_stats, 0, systrace_nr_cpus * sizeof(struct systrace_cpu));
+    }
+    for (uint32_t cpu = 0; systrace_region && cpu < systrace_nr_cpus; cpu++) {
+        systrace_state[cpu].lost = 0;
+        systrace_ring(cpu)->lost = 0;
+    }
+    mutex_unlock(&systrace_lock);
+}
+
+static inline uint32_t systrace_bucket(uint64_t cycles) {
+    uint32_t b = cycles ? 63 - __builtin_clzll(cycles) : 0;
+    return b < SYSTRACE_HIST_BUCKETS ? b : SYSTRACE_HIST_BUCKETS - 1;
+}
+
+/* A syscall that began at TSC 'start' returned 'ret'; called only while systrace_flags is set */
+void systrace_syscall_exit(uint32_t pid, uint32_t nr, const uint64_t *args, long ret,
+                           uint64_t start) {
+    uint64_t cycles = get_ticks() - start;
+    uint32_t flags = __atomic_load_n(&systrace_flags, __ATOMIC_ACQUIRE);
+    
+    preempt_disable();
+    uint32_t cpu = smp_processor_id();
+    if (cpu >= systrace_nr_cpus) {
+        preempt_enable();
+        return;
+    }
+    
+    if ((flags & SYSTRACE_STATS) && nr < SYSTRACE_NR_SYSCALLS) {
+        struct systrace_cpu *stats = &systrace_stats[cpu];
+        stats->count[nr]++;
+        stats->cycles[nr] += cycles;
+        stats->hist[nr][systrace_bucket(cycles)]++;
+    }
+    
+    if (flags & SYSTRACE_TRACE) {
+        struct systrace_ring_state *state = &systrace_state[cpu];
+        struct systrace_ring *ring = systrace_ring(cpu);
+        uint64_t head = state->head;
+        if (head - __atomic_load_n(&state->tail, __ATOMIC_ACQUIRE) >= SYSTRACE_RING_RECORDS) {
+            ring->lost = ++state->lost;
+        } else {
+            struct systrace_record *rec =
+                &systrace_ring_records(ring)[head % SYSTRACE_RING_RECORDS];
+            rec->timestamp = start;
+            rec->pid = pid;
+            rec->duration = cycles > UINT32_MAX ? UINT32_MAX : (uint32_t)cycles;
+            rec->nr = nr;
+            rec->cpu = cpu;
+            rec->resv = 0;
+            rec->ret = ret;
+            memcpy(rec->args, args, sizeof(rec->args));
+            state->head = head + 1;
+            __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+        }
+    }
+    preempt_enable();
+}
+
+/* Totals over all CPUs for syscall 'nr' */
+void systrace_get_stats(uint32_t nr, uint64_t *count, uint64_t *cycles,
+                        uint64_t hist[SYSTRACE_HIST_BUCKETS]) {
+    *count = 0;
+    *cycles = 0;
+    memset(hist, 0, SYSTRACE_HIST_BUCKETS * sizeof(uint64_t));
+    if (!systrace_stats || nr >= SYSTRACE_NR_SYSCALLS) {
+        return;
+    }
+    
+    for (uint32_t cpu = 0; cpu < systrace_nr_cpus; cpu++) {
+        struct systrace_cpu *stats = &systrace_stats[cpu];
+        *count += stats->count[nr];
+        *cycles += stats->cycles[nr];
+        for (uint32_t b = 0; b < SYSTRACE_HIST_BUCKETS; b++) {
+            hist[b] += stats->hist[nr][b];
+        }
+    }
+}
+
+/*
+ * /proc/syscalls: the switches, then a line per syscall that ran:
+ * number, calls, mean TSC cycles and "bucket:count" for each non-empty
+ * log2 bucket.
+ */
+static int syscalls_proc_show(char *buf, size_t size) {
+    uint32_t flags = systrace_active();
+    uint64_t lost = 0;
+    for (uint32_t cpu = 0; systrace_region && cpu < systrace_nr_cpus; cpu++) {
+        lost += systrace_state[cpu].lost;
+    }
+    
+    size_t len = snprintf(buf, size, "stats %s trace %s lost %lu\n",
+                          (flags & SYSTRACE_STATS) ? "on" : "off",
+                          (flags & SYSTRACE_TRACE) ? "on" : "off", lost);
+    for (uint32_t nr = 0; nr < SYSTRACE_NR_SYSCALLS && len < size; nr++) {
+        uint64_t count, cycles, hist[SYSTRACE_HIST_BUCKETS];
+        systrace_get_stats(nr, &count, &cycles, hist);
+        if (!count) {
+            continue;
+        }
+        len += snprintf(buf + len, size - len, "%u %lu %lu", nr, count, cycles / count);
+        for (uint32_t b = 0; b < SYSTRACE_HIST_BUCKETS && len < size; b++) {
+            if (hist[b]) {
+                len += snprintf(buf + len, size - len, " %u:%lu", b, hist[b]);
+            }
+        }
+        if (len < size) {
+            len += snprintf(buf + len, size - len, "\n");
+        }
+    }
+    return len < size ? (int)len : (int)size - 1;
+}
+
+/* Commands: "stats on|off", "trace on|off", "reset" */
+static long syscalls_proc_write(const char *buf, size_t count) {
+    char cmd[16];
+    size_t len = count < sizeof(cmd) - 1 ? count : sizeof(cmd) - 1;
+    memcpy(cmd, buf, len);
+    while (len && (cmd[len - 1] == '\n' || cmd[len - 1] == ' ')) {
+        len--;
+    }
+    cmd[len] = '\0';
+    
+    uint32_t flags = systrace_active();
+    int ret;
+    if (strcmp(cmd, "stats on") == 0) {
+        ret = systrace_enable(flags | SYSTRACE_STATS);
+    } else if (strcmp(cmd, "stats off") == 0) {
+        ret = systrace_enable(flags & ~SYSTRACE_STATS);
+    } else if (strcmp(cmd, "trace on") == 0) {
+        ret = systrace_enable(flags | SYSTRACE_TRACE);
+    } else if (strcmp(cmd, "trace off") == 0) {
+        ret = systrace_enable(flags & ~SYSTRACE_TRACE);
+    } else if (strcmp(cmd, "reset") == 0) {
+        systrace_reset();
+        ret = 0;
+    } else {
+        ret = -22; /* EINVAL */
+    }
+    return ret < 0 ? ret : (long)count;
+}
+
+static const struct proc_entry syscalls_proc_entry = {
+    .name = "syscalls",
+    .show = syscalls_proc_show,
+    .write = syscalls_proc_write,
+    .privileged = true,
+};
+
+/* Consume one CPU's ring up to 'tail' (systrace_read_lock held) */
+static void systrace_set_tail(uint32_t cpu, uint64_t tail) {
+    __atomic_store_n(&systrace_state[cpu].tail, tail, __ATOMIC_RELEASE);
+    __atomic_store_n(&systrace_ring(cpu)->tail, tail, __ATOMIC_RELAXED);
+}
+
+/*
+ * /proc/systrace read(): whole records, draining each CPU's ring in
+ * turn. Readers that mmap() the rings consume through write() instead
+ * and should not mix in read().
+ */
+static long systrace_read(struct file_descriptor *file, void *buf, size_t count) {
+    (void)file;
+    if (!systrace_region) {
+        return 0;
+    }
+    
+    struct systrace_record *dst = buf;
+    size_t max = count / sizeof(struct systrace_record), n = 0;
+    uint64_t flags = spin_lock_irqsave(&systrace_read_lock);
+    for (uint32_t cpu = 0; cpu < systrace_nr_cpus && n < max; cpu++) {
+        struct systrace_record *records = systrace_ring_records(systrace_ring(cpu));
+        uint64_t head = __atomic_load_n(&systrace_state[cpu].head, __ATOMIC_ACQUIRE);
+        uint64_t tail = systrace_state[cpu].tail;
+        while (tail != head && n < max) {
+            dst[n++] = records[tail % SYSTRACE_RING_RECORDS];
+            tail++;
+        }
+        systrace_set_tail(cpu, tail);
+    }
+    spin_unlock_irqrestore(&systrace_read_lock, flags);
+    return n * sizeof(struct systrace_record);
+}
+
+/* mmap() readers hand back consumed records; a tail outside [tail, head] is refused */
+static long systrace_write(struct file_descriptor *file, const void *buf, size_t count) {
+    (void)file;
+    const struct systrace_consume *consume = buf;
+    size_t n = count / sizeof(struct systrace_consume);
+    if (!systrace_region || !n) {
+        return -22; /* EINVAL */
+    }
+    
+    long ret = 0;
+    uint64_t flags = spin_lock_irqsave(&systrace_read_lock);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t cpu = consume[i].cpu;
+        if (cpu >= systrace_nr_cpus) {
+            ret = -22; /* EINVAL */
+            break;
+        }
+        uint64_t tail = systrace_state[cpu].tail;
+        uint64_t head = __atomic_load_n(&systrace_state[cpu].head, __ATOMIC_ACQUIRE);
+        if (consume[i].tail - tail > head - tail) {
+            ret = -22; /* EINVAL */
+            break;
+        }
+        systrace_set_tail(cpu, consume[i].tail);
+        ret += sizeof(struct systrace_consume);
+    }
+    spin_unlock_irqrestore(&systrace_read_lock, flags);
+    return ret;
+}
+
+/* Map every CPU's ring, in CPU order and read-only, at 'addr'; tracing must have been on once */
+static long systrace_mmap(struct file_descriptor *file, uint64_t addr, uint64_t length) {
+    (void)file;
+    if (!systrace_region) {
+        return -19; /* ENODEV */
+    }
+    uint64_t size = (uint64_t)systrace_nr_cpus * SYSTRACE_RING_BYTES;
+    if ((addr & (PAGE_SIZE - 1)) || length == 0 || length > size ||
+        addr + length > USER_ADDR_MAX || addr + length < addr) {
+        return -22; /* EINVAL */
+    }
+    
+    for (uint64_t off = 0; off < length; off += PAGE_SIZE) {
+        map_page(addr + off, (uint64_t)systrace_region + off, 0x05); /* Present, user */
+    }
+    return addr;
+}
+
+static const struct file_operations systrace_fops = {
+    .read = systrace_read,
+    .write = systrace_write,
+    .mmap = systrace_mmap,
+};
+
+static const struct proc_entry systrace_proc_entry = {
+    .name = "systrace",
+    .fops = &systrace_fops,
+    .privileged = true,
+};
\ No newline at end of file
@@ -5,11 +5,14 @@
 
 #include "kernel.h"
 #include "string.h"
+#include "tty.h"
+#include "smp.h"
+#include "idt.h"
 
 /* Driver function prototypes */
 void keyboard_init(void);
 void e1000_init(uint64_t mmio_base);
-void ahci_init(uint64_t mmio_base);
+void ahci_init(uint64_t mmio_base, bool msi);
 
 /* PCI Configuration Space Access */
 #define PCI_CONFIG_ADDRESS 0xCF8
@@ -38,6 +41,43 @@ static void pci_write32(uint8_t bus, uint8_t device, uint8_t function, uint8_t o
     __asm__ __volatile__("outl %0, %1" : : "a"(value), "Nd"(PCI_CONFIG_DATA));
 }
 
+/* PCI capability IDs */
+#define PCI_CAP_ID_MSI     0x05
+
+/*
+ * Route a function's MSI to 'vector' on the boot CPU and turn off its INTx
+ * line. Returns false if the function has no MSI capability.
+ */
+static bool pci_enable_msi(uint8_t bus, uint8_t device, uint8_t function, uint8_t vector) {
+    uint32_t status = pci_read32(bus, device, function, 0x04) >> 16;
+    if (!(status & 0x10)) {
+        return false; /* No capability list */
+    }
+    
+    uint8_t cap = pci_read32(bus, device, function, 0x34) & 0xFC;
+    while (cap) {
+        uint32_t header = pci_read32(bus, device, function, cap);
+        if ((header & 0xFF) == PCI_CAP_ID_MSI) {
+            bool is64 = header & (1U << 23);
+            pci_write32(bus, device, function, cap + 4, 0xFEE00000 | (this_cpu()->apic_id << 12));
+            if (is64) {
+                pci_write32(bus, device, function, cap + 8, 0);
+            }
+            pci_write32(bus, device, function, cap + (is64 ? 12 : 8), vector);
+            
+            /* One message, enabled */
+            header &= ~(0x70U << 16);
+            pci_write32(bus, device, function, cap, header | (1U << 16));
+            
+            uint32_t command = pci_read32(bus, device, function, 0x04);
+            pci_write32(bus, device, function, 0x04, command | 0x400); /* INTx Disable */
+            return true;
+        }
+        cap = (header >> 8) & 0xFC;
+    }
+    return false;
+}
+
 static void scan_pci_devices(void) {
     KLOG_INFO("Scanning PCI devices...");
     
@@ -98,7 +138,8 @@ static void scan_pci_devices(void) {
                         command |= 0x06; /* Memory Space Enable | Bus Master Enable */
                         pci_write32(bus, device, function, 0x04, command);
                         
-                        ahci_init(mmio_base);
+                        bool msi = pci_enable_msi(bus, device, function, AHCI_MSI_VECTOR);
+                        ahci_init(mmio_base, msi);
                     }
                 }
             }
@@ -109,6 +150,9 @@ static void scan_pci_devices(void) {
 void drivers_init(void) {
     KLOG_INFO("Initializing Pentagon-level device drivers...");
     
+    /* Console TTY before the keyboard that feeds it */
+    tty_init();
+    
     /* Initialize PS/2 keyboard first (no PCI scan needed) */
     keyboard_init();
     
@@ -0,0 +1,693 @@
+/*
+ * SentinalOS Event Poll
+ * Ready Lists Fed by Wait Queue Callbacks
+ */
+
+#include "../include/system.h"
+#include "../include/string.h"
+#include "../include/slab.h"
+#include "../include/ktime.h"
+#include "../include/timer.h"
+#include "../include/kthread.h"
+#include "../include/fdtable.h"
+#include "../include/pipe.h"
+#include "../include/tty.h"
+#include "../include/eventpoll.h"
+
+/* Initial hash buckets; the table doubles once it holds as many items */
+#define EP_HASH_MIN         16
+
+/* Event bits that are flags rather than events */
+#define EP_PRIVATE_BITS     (EPOLLONESHOT | EPOLLET)
+
+/* Rounds per measurement in the benchmark */
+#define EP_BENCH_ROUNDS     1000
+
+struct eventpoll;
+
+/* A watched (file, fd) pair */
+struct epitem {
+    struct epitem *hash_next;
+    struct epitem *rdl_next;        /* Ready list, under ep->lock */
+    struct epitem *rdl_prev;
+    struct epitem *f_next;          /* file->f_ep, under ep_file_lock */
+    struct eventpoll *ep;
+    struct file_descriptor *file;   /* Not referenced: eventpoll_release() unhooks us */
+    uint32_t fd;
+    bool ready;
+    struct epoll_event event;       /* Only EP_PRIVATE_BITS left: disarmed one-shot */
+    struct wait_queue_head *whead;
+    struct wait_queue_entry wait;
+};
+
+/*
+ * 'mtx' serialises epoll_ctl() and event delivery. 'lock' guards the
+ * ready list; wake callbacks take it from inside other queues' locks, so
+ * nothing that can sleep or wake runs under it.
+ */
+struct eventpoll {
+    struct mutex mtx;
+    spinlock_t lock;
+    struct epitem *rdl_head;
+    struct epitem *rdl_tail;
+    volatile uint32_t nr_ready;
+    struct wait_queue_head wq;          /* epoll_wait() sleepers */
+    struct wait_queue_head poll_wait;   /* Epoll files watching this one */
+    struct epitem **hash;
+    uint32_t hash_size;                 /* Power of two */
+    uint32_t nr_items;
+    uint32_t nr_nested;                 /* Items that are epoll files */
+    struct file_descriptor *file;
+};
+
+static struct kmem_cache *ep_cache;
+static struct kmem_cache *epitem_cache;
+
+/* Held while items are torn down from the watched file's side, or with the epoll file */
+static struct mutex epmutex;
+static spinlock_t ep_file_lock;
+
+static const struct file_operations eventpoll_fops;
+
+void eventpoll_init(void) {
+    ep_cache = kmem_cache_create("eventpoll", sizeof(struct eventpoll), 0);
+    epitem_cache = kmem_cache_create("epitem", sizeof(struct epitem), 0);
+    mutex_init(&epmutex);
+    spin_lock_init(&ep_file_lock);
+}
+
+static inline bool is_file_epoll(struct file_descriptor *file) {
+    return file->f_op == &eventpoll_fops;
+}
+
+static inline bool ep_events_available(struct eventpoll *ep) {
+    return ep->nr_ready != 0;
+}
+
+static inline uint32_t ep_hash(struct eventpoll *ep, struct file_descriptor *file, uint32_t fd) {
+    uint64_t key = ((uint64_t)file >> 6) ^ ((uint64_t)fd * 0x9E3779B97F4A7C15ULL);
+    return (uint32_t)(key ^ (key >> 32)) & (ep->hash_size - 1);
+}
+
+static struct epitem *ep_find(struct eventpoll *ep, struct file_descriptor *file, uint32_t fd) {
+    struct epitem *epi = ep->hash[ep_hash(ep, file, fd)];
+    while (epi && (epi->file != file || epi->fd != fd)) {
+        epi = epi->hash_next;
+    }
+    return epi;
+}
+
+/* Double the hash table (ep->mtx held); on failure the chains just get longer */
+static void ep_hash_grow(struct eventpoll *ep) {
+    uint32_t old_size = ep->hash_size;
+    struct epitem **old = ep->hash;
+    struct epitem **hash = kmalloc(old_size * 2 * sizeof(*hash));
+    if (!hash) {
+        return;
+    }
+    memset(hash, 0, old_size * 2 * sizeof(*hash));
+    
+    ep->hash = hash;
+    ep->hash_size = old_size * 2;
+    for (uint32_t i = 0; i < old_size; i++) {
+        struct epitem *epi = old[i];
+        while (epi) {
+            struct epitem *next = epi->hash_next;
+            uint32_t bucket = ep_hash(ep, epi->file, epi->fd);
+            epi->hash_next = hash[bucket];
+            hash[bucket] = epi;
+            epi = next;
+        }
+    }
+    kfree(old);
+}
+
+/* Ready list helpers (ep->lock held) */
+static void ep_ready_add(struct eventpoll *ep, struct epitem *epi) {
+    if (epi->ready) {
+        return;
+    }
+    epi->rdl_next = NULL;
+    epi->rdl_prev = ep->rdl_tail;
+    if (ep->rdl_tail) {
+        ep->rdl_tail->rdl_next = epi;
+    } else {
+        ep->rdl_head = epi;
+    }
+    ep->rdl_tail = epi;
+    epi->ready = true;
+    ep->nr_ready++;
+}
+
+static void ep_ready_del(struct eventpoll *ep, struct epitem *epi) {
+    if (!epi->ready) {
+        return;
+    }
+    if (epi->rdl_prev) {
+        epi->rdl_prev->rdl_next = epi->rdl_next;
+    } else {
+        ep->rdl_head = epi->rdl_next;
+    }
+    if (epi->rdl_next) {
+        epi->rdl_next->rdl_prev = epi->rdl_prev;
+    } else {
+        ep->rdl_tail = epi->rdl_prev;
+    }
+    epi->rdl_next = epi->rdl_prev = NULL;
+    epi->ready = false;
+    ep->nr_ready--;
+}
+
+/* Queue 'epi' and wake a waiter; safe from wake callbacks */
+static void ep_mark_ready(struct eventpoll *ep, struct epitem *epi) {
+    uint64_t flags = spin_lock_irqsave(&ep->lock);
+    ep_ready_add(ep, epi);
+    spin_unlock_irqrestore(&ep->lock, flags);
+    
+    wake_up(&ep->wq);
+    wake_up_all(&ep->poll_wait);
+}
+
+/* Runs under the watched file's queue lock whenever its readiness may have changed */
+static void ep_poll_callback(struct wait_queue_entry *wait) {
+    struct epitem *epi = wait->private;
+    if (!(epi->event.events & ~EP_PRIVATE_BITS)) {
+        return;     /* Disarmed one-shot */
+    }
+    ep_mark_ready(epi->ep, epi);
+}
+
+/* Events 'epi' would report now */
+static inline uint32_t ep_item_poll(struct epitem *epi) {
+    return file_poll(epi->file) & epi->event.events & ~EP_PRIVATE_BITS;
+}
+
+/* Start watching (ep->mtx held) */
+static long ep_insert(struct eventpoll *ep, struct file_descriptor *file, uint32_t fd,
+                      const struct epoll_event *event) {
+    bool nested = is_file_epoll(file);
+    if (nested) {
+        /* One level of nesting at most, so wakeups cannot loop */
+        struct eventpoll *target = file->private_data;
+        uint64_t flags = spin_lock_irqsave(&ep_file_lock);
+        bool deep = target->nr_nested || ep->file->f_ep;
+        spin_unlock_irqrestore(&ep_file_lock, flags);
+        if (deep) {
+            return -40; /* ELOOP */
+        }
+    }
+    
+    struct epitem *epi = kmem_cache_zalloc(epitem_cache);
+    if (!epi) {
+        return -12; /* ENOMEM */
+    }
+    epi->ep = ep;
+    epi->file = file;
+    epi->fd = fd;
+    epi->event = *event;
+    init_waitqueue_func_entry(&epi->wait, ep_poll_callback, epi);
+    
+    if (ep->nr_items >= ep->hash_size) {
+        ep_hash_grow(ep);
+    }
+    uint32_t bucket = ep_hash(ep, file, fd);
+    epi->hash_next = ep->hash[bucket];
+    ep->hash[bucket] = epi;
+    ep->nr_items++;
+    ep->nr_nested += nested;
+    
+    uint64_t flags = spin_lock_irqsave(&ep_file_lock);
+    epi->f_next = file->f_ep;
+    file->f_ep = epi;
+    spin_unlock_irqrestore(&ep_file_lock, flags);
+    
+    /* Hook the queue first so no change after the poll below is missed */
+    epi->whead = file->f_op->poll_queue(file);
+    add_wait_queue(epi->whead, &epi->wait);
+    
+    if (ep_item_poll(epi)) {
+        ep_mark_ready(ep, epi);
+    }
+    return 0;
+}
+
+/* Stop watching (ep->mtx held) */
+static void ep_remove(struct eventpoll *ep, struct epitem *epi) {
+    /* Once off the queue the callback is not running and cannot start */
+    remove_wait_queue(epi->whead, &epi->wait);
+    
+    uint64_t flags = spin_lock_irqsave(&ep_file_lock);
+    struct epitem **link = &epi->file->f_ep;
+    while (*link != epi) {
+        link = &(*link)->f_next;
+    }
+    *link = epi->f_next;
+    spin_unlock_irqrestore(&ep_file_lock, flags);
+    
+    link = &ep->hash[ep_hash(ep, epi->file, epi->fd)];
+    while (*link != epi) {
+        link = &(*link)->hash_next;
+    }
+    *link = epi->hash_next;
+    ep->nr_items--;
+    ep->nr_nested -= is_file_epoll(epi->file);
+    
+    flags = spin_lock_irqsave(&ep->lock);
+    ep_ready_del(ep, epi);
+    spin_unlock_irqrestore(&ep->lock, flags);
+    
+    kmem_cache_free(epitem_cache, epi);
+}
+
+/* Change the watched events, re-arming a one-shot (ep->mtx held) */
+static void ep_modify(struct eventpoll *ep, struct epitem *epi, const struct epoll_event *event) {
+    epi->event = *event;
+    
+    if (ep_item_poll(epi)) {
+        ep_mark_ready(ep, epi);
+    }
+}
+
+/*
+ * Report up to maxevents ready items. Each item on the list when we start
+ * is looked at once: those no longer ready drop off, level-triggered ones
+ * that are go back on the tail, so busy fds cannot starve the rest.
+ */
+static int ep_send_events(struct eventpoll *ep, struct epoll_event *events, int maxevents) {
+    int n = 0;
+    
+    mutex_lock(&ep->mtx);
+    uint32_t budget = ep->nr_ready;
+    while (budget-- && n < maxevents) {
+        uint64_t flags = spin_lock_irqsave(&ep->lock);
+        struct epitem *epi = ep->rdl_head;
+        if (epi) {
+            ep_ready_del(ep, epi);
+        }
+        spin_unlock_irqrestore(&ep->lock, flags);
+        if (!epi) {
+            break;
+        }
+        
+        /* A wakeup from here on requeues the item, so no edge is lost */
+        uint32_t revents = ep_item_poll(epi);
+        if (!revents) {
+            continue;
+        }
+        events[n].events = revents;
+        events[n].data = epi->event.data;
+        n++;
+        
+        if (epi->event.events & EPOLLONESHOT) {
+            epi->event.events &= EP_PRIVATE_BITS;
+        } else if (!(epi->event.events & EPOLLET)) {
+            flags = spin_lock_irqsave(&ep->lock);
+            ep_ready_add(ep, epi);
+            spin_unlock_irqrestore(&ep->lock, flags);
+        }
+    }
+    mutex_unlock(&ep->mtx);
+    return n;
+}
+
+/* Ready if anything is queued; items are only re-checked by epoll_wait() */
+static uint32_t ep_eventpoll_poll(struct file_descriptor *file) {
+    struct eventpoll *ep = file->private_data;
+    return ep_events_available(ep) ? POLLIN : 0;
+}
+
+static struct wait_queue_head *ep_eventpoll_poll_queue(struct file_descriptor *file) {
+    struct eventpoll *ep = file->private_data;
+    return &ep->poll_wait;
+}
+
+/* The epoll file is gone: drop every item */
+static void ep_eventpoll_release(struct file_descriptor *file) {
+    struct eventpoll *ep = file->private_data;
+    
+    mutex_lock(&epmutex);
+    mutex_lock(&ep->mtx);
+    for (uint32_t i = 0; i < ep->hash_size; i++) {
+        while (ep->hash[i]) {
+            ep_remove(ep, ep->hash[i]);
+        }
+    }
+    mutex_unlock(&ep->mtx);
+    mutex_unlock(&epmutex);
+    
+    kfree(ep->hash);
+    kmem_cache_free(ep_cache, ep);
+}
+
+static const struct file_operations eventpoll_fops = {
+    .poll = ep_eventpoll_poll,
+    .poll_queue = ep_eventpoll_poll_queue,
+    .release = ep_eventpoll_release,
+};
+
+/*
+ * The last reference to a watched file is going: unhook it from every
+ * epoll that watches it. Called by file_put() before f_op->release.
+ */
+void eventpoll_release(struct file_descriptor *file) {
+    mutex_lock(&epmutex);
+    for (;;) {
+        uint64_t flags = spin_lock_irqsave(&ep_file_lock);
+        struct epitem *epi = file->f_ep;
+        spin_unlock_irqrestore(&ep_file_lock, flags);
+        if (!epi) {
+            break;
+        }
+        
+        /* epmutex keeps the epoll from being freed under us */
+        struct eventpoll *ep = epi->ep;
+        mutex_lock(&ep->mtx);
+        ep_remove(ep, epi);
+        mutex_unlock(&ep->mtx);
+    }
+    mutex_unlock(&epmutex);
+}
+
+/* EPOLL_CLOEXEC is accepted; descriptors are not closed on exec yet */
+long ksys_epoll_create(struct process_files *files, uint32_t flags) {
+    if (flags & ~EPOLL_CLOEXEC) {
+        return -22; /* EINVAL */
+    }
+    
+    struct eventpoll *ep = kmem_cache_zalloc(ep_cache);
+    if (!ep) {
+        return -12; /* ENOMEM */
+    }
+    ep->hash = kmalloc(EP_HASH_MIN * sizeof(*ep->hash));
+    struct file_descriptor *file = file_alloc(NULL, 0x02, 0); /* O_RDWR */
+    if (!ep->hash || !file) {
+        if (file) {
+            file_put(file);
+        }
+        kfree(ep->hash);
+        kmem_cache_free(ep_cache, ep);
+        return -12; /* ENOMEM */
+    }
+    memset(ep->hash, 0, EP_HASH_MIN * sizeof(*ep->hash));
+    ep->hash_size = EP_HASH_MIN;
+    mutex_init(&ep->mtx);
+    spin_lock_init(&ep->lock);
+    init_waitqueue_head(&ep->wq);
+    init_waitqueue_head(&ep->poll_wait);
+    ep->file = file;
+    file->f_op = &eventpoll_fops;
+    file->private_data = ep;
+    
+    int fd = fd_alloc(files, 3);
+    if (fd < 0) {
+        file_put(file);
+        return fd;
+    }
+    fd_install(files, fd, file);
+    return fd;
+}
+
+long ksys_epoll_ctl(struct process_files *files, uint32_t epfd, int op, uint32_t fd,
+                    const struct epoll_event *event) {
+    struct epoll_event ev = { 0, 0 };
+    if (op != EPOLL_CTL_DEL) {
+        if (!event) {
+            return -14; /* EFAULT */
+        }
+        ev = *event;
+        ev.events |= EPOLL_ALWAYS;
+    }
+    
+    struct file_descriptor *file = fd_get(files, epfd);
+    if (!file) {
+        return -9; /* EBADF */
+    }
+    struct file_descriptor *tfile = fd_get_stdio(files, fd);
+    if (!tfile) {
+        file_put(file);
+        return -9; /* EBADF */
+    }
+    
+    long ret;
+    if (!is_file_epoll(file) || file == tfile) {
+        ret = -22; /* EINVAL */
+    } else if (!tfile->f_op || !tfile->f_op->poll_queue) {
+        ret = -1; /* EPERM: never signals readiness changes */
+    } else {
+        struct eventpoll *ep = file->private_data;
+        mutex_lock(&ep->mtx);
+        struct epitem *epi = ep_find(ep, tfile, fd);
+        switch (op) {
+        case EPOLL_CTL_ADD:
+            ret = epi ? -17 /* EEXIST */ : ep_insert(ep, tfile, fd, &ev);
+            break;
+        case EPOLL_CTL_DEL:
+            if (epi) {
+                ep_remove(ep, epi);
+            }
+            ret = epi ? 0 : -2; /* ENOENT */
+            break;
+        case EPOLL_CTL_MOD:
+            if (epi) {
+                ep_modify(ep, epi, &ev);
+            }
+            ret = epi ? 0 : -2; /* ENOENT */
+            break;
+        default:
+            ret = -22; /* EINVAL */
+            break;
+        }
+        mutex_unlock(&ep->mtx);
+    }
+    
+    /* After ep->mtx: a last put tears items down and needs it */
+    file_put(tfile);
+    file_put(file);
+    return ret;
+}
+
+/*
+ * Wait up to 'timeout' ms (forever if negative, not at all if 0) for
+ * ready items and report up to maxevents of them. Sleepers are woken one
+ * at a time, by the callbacks that fill the ready list or by the timer.
+ */
+long ksys_epoll_wait(struct process_files *files, uint32_t epfd, struct epoll_event *events,
+                     int maxevents, int timeout) {
+    if (maxevents <= 0 || (uint32_t)maxevents > EPOLL_MAX_EVENTS) {
+        return -22; /* EINVAL */
+    }
+    if (!events) {
+        return -14; /* EFAULT */
+    }
+    struct file_descriptor *file = fd_get(files, epfd);
+    if (!file) {
+        return -9; /* EBADF */
+    }
+    if (!is_file_epoll(file)) {
+        file_put(file);
+        return -22; /* EINVAL */
+    }
+    struct eventpoll *ep = file->private_data;
+    
+    uint64_t deadline = timeout > 0 ? jiffies + msecs_to_jiffies(timeout) : 0;
+    struct wait_queue_entry wait;
+    init_wait_entry(&wait, WQ_FLAG_EXCLUSIVE);
+    
+    long ret;
+    for (;;) {
+        ret = ep_send_events(ep, events, maxevents);
+        if (ret || timeout == 0) {
+            break;
+        }
+        int64_t left = timeout > 0 ? (int64_t)(deadline - jiffies) : 1;
+        if (left <= 0) {
+            break;
+        }
+        if (!sched_can_block()) {
+            cpu_relax();
+            continue;
+        }
+        
+        prepare_to_wait(&ep->wq, &wait);
+        if (!ep_events_available(ep)) {
+            if (timeout < 0) {
+                schedule();
+            } else {
+                schedule_timeout(left);
+            }
+        }
+        finish_wait(&ep->wq, &wait);
+    }
+    
+    file_put(file);
+    return ret;
+}
+
+/* Benchmark state shared with the waiter thread */
+struct ep_bench {
+    struct process_files *files;
+    int epfd;
+    int *rfds;
+    volatile uint64_t stamp;        /* ktime_get_ns() just before the write */
+    uint64_t total_ns;
+    uint64_t max_ns;
+    struct completion done;
+};
+
+/* Wakeup latency: block in epoll_wait(), time the wakeup, drain the pipe */
+static int ep_bench_waiter(void *data) {
+    struct ep_bench *bench = data;
+    struct epoll_event event;
+    uint8_t byte;
+    
+    for (uint32_t seen = 0; seen < EP_BENCH_ROUNDS && !kthread_should_stop();) {
+        /* A timeout, so kthread_stop() is noticed even if a wakeup never comes */
+        long n = ksys_epoll_wait(bench->files, bench->epfd, &event, 1, 100);
+        if (n < 0) {
+            break;
+        }
+        if (!n) {
+            continue;
+        }
+        seen++;
+        uint64_t ns = ktime_get_ns() - bench->stamp;
+        bench->total_ns += ns;
+        bench->max_ns = ns > bench->max_ns ? ns : bench->max_ns;
+        ksys_read(bench->files, bench->rfds[event.data], &byte, 1, -1);
+        complete(&bench->done);
+    }
+    return 0;
+}
+
+/*
+ * Watch a growing number of pipes, up to nr_fds, and compare finding the
+ * one ready pipe with epoll_wait() against polling every fd, as poll()
+ * and select() must. Then time how long a pipe write takes to wake a
+ * thread blocked in epoll_wait().
+ */
+void epoll_benchmark(uint32_t nr_fds) {
+    static const uint8_t byte = 'x';
+    struct process_files *files = kmalloc(sizeof(*files));
+    int *rfds = kmalloc(nr_fds * sizeof(int));
+    int *wfds = kmalloc(nr_fds * sizeof(int));
+    struct epoll_event events[16];
+    uint8_t buf[16];
+    
+    debug_print("=== EPOLL BENCHMARK (%u fds) ===\n", nr_fds);
+    if (!files || !rfds || !wfds) {
+        debug_print("epoll benchmark: out of memory\n");
+        kfree(wfds);
+        kfree(rfds);
+        kfree(files);
+        return;
+    }
+    files_init(files);
+    
+    int epfd = ksys_epoll_create(files, 0);
+    if (epfd < 0) {
+        debug_print("epoll benchmark: epoll_create failed\n");
+        goto out;
+    }
+    
+    uint32_t watched = 0;
+    uint64_t seed = get_ticks() | 1;
+    for (uint32_t target = 10; watched < nr_fds; target *= 10) {
+        target = target < nr_fds ? target : nr_fds;
+        uint32_t first = watched;
+        uint64_t start = get_ticks();
+        for (; watched < target; watched++) {
+            int fds[2];
+            if (pipe_create(files, fds, 0x800) < 0) { /* O_NONBLOCK */
+                break;
+            }
+            rfds[watched] = fds[0];
+            wfds[watched] = fds[1];
+            struct epoll_event ev = { EPOLLIN, watched };
+            ksys_epoll_ctl(files, epfd, EPOLL_CTL_ADD, fds[0], &ev);
+        }
+        uint64_t add_cycles = get_ticks() - start;
+        if (watched < target) {
+            debug_print("epoll benchmark: out of fds at %u\n", watched);
+            break;
+        }
+        
+        uint64_t wait_cycles = 0, scan_cycles = 0;
+        uint32_t missed = 0;
+        for (uint32_t i = 0; i < EP_BENCH_ROUNDS; i++) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            uint32_t k = (seed >> 33) % watched;
+            
+            ksys_write(files, wfds[k], &byte, 1, -1);
+            start = get_ticks();
+            long n = ksys_epoll_wait(files, epfd, events, 16, 0);
+            wait_cycles += get_ticks() - start;
+            missed += n != 1 || events[0].data != k;
+            
+            start = get_ticks();
+            uint32_t found = watched;
+            for (uint32_t j = 0; j < watched; j++) {
+                struct file_descriptor *file = fd_get(files, rfds[j]);
+                uint32_t revents = file ? file_poll(file) : 0;
+                if (file) {
+                    file_put(file);
+                }
+                if ((revents & POLLIN) && found == watched) {
+                    found = j;
+                }
+            }
+            scan_cycles += get_ticks() - start;
+            missed += found != k;
+            
+            /* Level-triggered: the drained pipe drops off at the next wait */
+            ksys_read(files, rfds[k], buf, sizeof(buf), -1);
+        }
+        
+        debug_print("%u fds: add %lu ns/fd, epoll_wait %lu ns, poll scan %lu ns%s\n", watched,
+                    tsc_cycles_to_ns(add_cycles) / (target - first),
+                    tsc_cycles_to_ns(wait_cycles) / EP_BENCH_ROUNDS,
+                    tsc_cycles_to_ns(scan_cycles) / EP_BENCH_ROUNDS,
+                    missed ? " (MISSED EVENTS)" : "");
+        if (watched == nr_fds) {
+            break;
+        }
+    }
+    ksys_epoll_wait(files, epfd, events, 16, 0);
+    
+    if (!watched || !sched_can_block()) {
+        debug_print("Wakeup latency: skipped (cannot block)\n");
+        goto out;
+    }
+    struct ep_bench bench = { .files = files, .epfd = epfd, .rfds = rfds };
+    init_completion(&bench.done);
+    struct kthread *waiter = kthread_create(ep_bench_waiter, &bench, "epoll_bench");
+    if (!waiter) {
+        debug_print("Wakeup latency: no thread\n");
+        goto out;
+    }
+    
+    uint32_t rounds = 0;
+    for (; rounds < EP_BENCH_ROUNDS; rounds++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t k = (seed >> 33) % watched;
+        
+        /* Let the waiter block before we write */
+        msleep(1);
+        bench.stamp = ktime_get_ns();
+        ksys_write(files, wfds[k], &byte, 1, -1);
+        if (!wait_for_completion_timeout(&bench.done, msecs_to_jiffies(100))) {
+            break;
+        }
+    }
+    kthread_stop(waiter);
+    
+    if (rounds) {
+        debug_print("Wakeup latency: avg %lu ns, max %lu ns over %u wakeups\n",
+                    bench.total_ns / rounds, bench.max_ns, rounds);
+    }
+
+out:
+    files_release(files);
+    kfree(wfds);
+    kfree(rfds);
+    kfree(files);
+}
\ No newline at end of file
@@ -0,0 +1,556 @@
+/*
+ * SentinalOS File Descriptor Tables
+ * Per-Process Descriptor Allocation and Lock-Free Lookup
+ */
+
+#include "../include/system.h"
+#include "../include/string.h"
+#include "../include/slab.h"
+#include "../include/fdtable.h"
+#include "../include/eventpoll.h"
+
+static struct kmem_cache *file_cache;
+
+/* Create the cache open file descriptions come from */
+void fdtable_init(void) {
+    file_cache = kmem_cache_create("file", sizeof(struct file_descriptor), 0);
+}
+
+/* Allocate an open file description holding one reference */
+struct file_descriptor *file_alloc(struct inode *inode, uint32_t flags, uint32_t mode) {
+    struct file_descriptor *file = file_cache ? kmem_cache_zalloc(file_cache) : NULL;
+    if (!file) {
+        return NULL;
+    }
+    
+    file->inode = inode;
+    file->flags = flags;
+    file->mode = mode;
+    file->ref_count = 1;
+    return file;
+}
+
+void file_get(struct file_descriptor *file) {
+    __sync_fetch_and_add(&file->ref_count, 1);
+}
+
+/* Take a reference unless the last one is already gone (RCU lookups) */
+static bool file_get_unless_zero(struct file_descriptor *file) {
+    uint32_t count = file->ref_count;
+    while (count) {
+        uint32_t seen = __sync_val_compare_and_swap(&file->ref_count, count, count + 1);
+        if (seen == count) {
+            return true;
+        }
+        count = seen;
+    }
+    return false;
+}
+
+static void file_free_rcu(struct rcu_head *head) {
+    kmem_cache_free(file_cache, rcu_entry(head, struct file_descriptor, rcu));
+}
+
+/*
+ * Drop a reference. The last one releases the file, which may sleep;
+ * lock-free lookups may still hold the pointer for a grace period.
+ */
+void file_put(struct file_descriptor *file) {
+    if (__sync_sub_and_fetch(&file->ref_count, 1) == 0) {
+        if (file->f_ep) {
+            eventpoll_release(file);
+        }
+        if (file->f_op && file->f_op->release) {
+            file->f_op->release(file);
+        }
+        call_rcu(&file->rcu, file_free_rcu);
+    }
+}
+
+/* Events ready on a file; regular files never block */
+uint32_t file_poll(struct file_descriptor *file) {
+    if (file->f_op && file->f_op->poll) {
+        return file->f_op->poll(file);
+    }
+    return POLLIN | POLLOUT;
+}
+
+/* Summary words for a table of max_fds descriptors */
+static inline uint32_t fdt_full_words(uint32_t max_fds) {
+    return (max_fds / 64 + 63) / 64;
+}
+
+static inline bool fdt_is_open(const struct fdtable *fdt, uint32_t fd) {
+    return fdt->open_fds[fd / 64] & (1ULL << (fd % 64));
+}
+
+static inline void fdt_set_open(struct fdtable *fdt, uint32_t fd) {
+    uint32_t word = fd / 64;
+    fdt->open_fds[word] |= 1ULL << (fd % 64);
+    if (fdt->open_fds[word] == ~0ULL) {
+        fdt->full_fds[word / 64] |= 1ULL << (word % 64);
+    }
+}
+
+static inline void fdt_clear_open(struct fdtable *fdt, uint32_t fd) {
+    uint32_t word = fd / 64;
+    fdt->open_fds[word] &= ~(1ULL << (fd % 64));
+    fdt->full_fds[word / 64] &= ~(1ULL << (word % 64));
+}
+
+/* Lowest free fd at or after 'start': the rest of its word, then the summary */
+static uint32_t fdt_find_free(const struct fdtable *fdt, uint32_t start) {
+    uint32_t nr_words = fdt->max_fds / 64;
+    uint32_t word = start / 64;
+    if (word >= nr_words) {
+        return fdt->max_fds;
+    }
+    
+    uint64_t free = ~fdt->open_fds[word] & (~0ULL << (start % 64));
+    if (free) {
+        return word * 64 + __builtin_ctzll(free);
+    }
+    
+    for (word++; word < nr_words; word = (word / 64 + 1) * 64) {
+        uint64_t free_words = ~fdt->full_fds[word / 64] & (~0ULL << (word % 64));
+        if (free_words) {
+            word = (word / 64) * 64 + __builtin_ctzll(free_words);
+            break;
+        }
+    }
+    
+    /* Summary bits past the last word are clear, so may point beyond it */
+    if (word >= nr_words) {
+        return fdt->max_fds;
+    }
+    return word * 64 + __builtin_ctzll(~fdt->open_fds[word]);
+}
+
+/* Lowest fd in use at or after 'fd', or max_fds */
+static uint32_t fdt_next_open(const struct fdtable *fdt, uint32_t fd) {
+    uint32_t nr_words = fdt->max_fds / 64;
+    uint32_t word = fd / 64;
+    if (word >= nr_words) {
+        return fdt->max_fds;
+    }
+    
+    uint64_t open = fdt->open_fds[word] & (~0ULL << (fd % 64));
+    while (!open) {
+        if (++word >= nr_words) {
+            return fdt->max_fds;
+        }
+        open = fdt->open_fds[word];
+    }
+    return word * 64 + __builtin_ctzll(open);
+}
+
+/* An empty table using the arrays embedded in 'files' */
+void files_init(struct process_files *files) {
+    memset(files, 0, sizeof(*files));
+    spin_lock_init(&files->lock);
+    files->fdtab.max_fds = NR_OPEN_DEFAULT;
+    files->fdtab.fd = files->fd_array;
+    files->fdtab.open_fds = files->open_fds_init;
+    files->fdtab.full_fds = files->full_fds_init;
+    files->fdt = &files->fdtab;
+    files->users = 1;
+    files->refs = 1;
+}
+
+static void fdtable_free(struct fdtable *fdt) {
+    kfree(fdt->fd);
+    kfree(fdt->open_fds);
+    kfree(fdt->full_fds);
+    kfree(fdt);
+}
+
+static void fdtable_free_rcu(struct rcu_head *head) {
+    fdtable_free(rcu_entry(head, struct fdtable, rcu));
+}
+
+static struct fdtable *fdtable_alloc(uint32_t max_fds) {
+    struct fdtable *fdt = kmalloc(sizeof(*fdt));
+    if (!fdt) {
+        return NULL;
+    }
+    
+    fdt->max_fds = max_fds;
+    fdt->fd = kmalloc(max_fds * sizeof(struct file_descriptor *));
+    fdt->open_fds = kmalloc(max_fds / 64 * sizeof(uint64_t));
+    fdt->full_fds = kmalloc(fdt_full_words(max_fds) * sizeof(uint64_t));
+    if (!fdt->fd || !fdt->open_fds || !fdt->full_fds) {
+        fdtable_free(fdt);
+        return NULL;
+    }
+    memset(fdt->fd, 0, max_fds * sizeof(struct file_descriptor *));
+    memset(fdt->open_fds, 0, max_fds / 64 * sizeof(uint64_t));
+    memset(fdt->full_fds, 0, fdt_full_words(max_fds) * sizeof(uint64_t));
+    return fdt;
+}
+
+/*
+ * Grow the table to hold 'fd' (files->lock held). Lookups that already
+ * loaded the old table keep using it until the grace period ends.
+ */
+static int fdtable_expand(struct process_files *files, uint32_t fd) {
+    if (fd >= NR_OPEN_MAX) {
+        return -24; /* EMFILE */
+    }
+    
+    struct fdtable *old = files->fdt;
+    uint32_t max_fds = old->max_fds;
+    while (max_fds <= fd) {
+        max_fds *= 2;
+    }
+    
+    struct fdtable *fdt = fdtable_alloc(max_fds);
+    if (!fdt) {
+        return -12; /* ENOMEM */
+    }
+    memcpy(fdt->fd, old->fd, old->max_fds * sizeof(struct file_descriptor *));
+    memcpy(fdt->open_fds, old->open_fds, old->max_fds / 64 * sizeof(uint64_t));
+    memcpy(fdt->full_fds, old->full_fds, fdt_full_words(old->max_fds) * sizeof(uint64_t));
+    
+    rcu_assign_pointer(files->fdt, fdt);
+    if (old != &files->fdtab) {
+        call_rcu(&old->rcu, fdtable_free_rcu);
+    }
+    return 0;
+}
+
+/* Reserve the lowest free fd at or after 'start'; fd_install() fills it */
+int fd_alloc(struct process_files *files, uint32_t start) {
+    spin_lock(&files->lock);
+    struct fdtable *fdt = files->fdt;
+    if (!fdt) {
+        spin_unlock(&files->lock);
+        return -9; /* EBADF: the table was released under a ring */
+    }
+    uint32_t fd = fdt_find_free(fdt, start);
+    
+    if (fd >= fdt->max_fds) {
+        fd = start > fdt->max_fds ? start : fdt->max_fds;
+        int err = fdtable_expand(files, fd);
+        if (err) {
+            spin_unlock(&files->lock);
+            return err;
+        }
+        fdt = files->fdt;
+    }
+    
+    fdt_set_open(fdt, fd);
+    files->nr_open++;
+    spin_unlock(&files->lock);
+    return (int)fd;
+}
+
+/* Publish 'file' at a reserved fd, handing over the caller's reference */
+void fd_install(struct process_files *files, uint32_t fd, struct file_descriptor *file) {
+    spin_lock(&files->lock);
+    struct fdtable *fdt = files->fdt;
+    if (fdt) {
+        rcu_assign_pointer(fdt->fd[fd], file);
+    }
+    spin_unlock(&files->lock);
+    
+    if (!fdt) {
+        file_put(file);
+    }
+}
+
+/* Give back a reserved fd that will not be installed */
+void fd_release(struct process_files *files, uint32_t fd) {
+    spin_lock(&files->lock);
+    if (files->fdt) {
+        fdt_clear_open(files->fdt, fd);
+        files->nr_open--;
+    }
+    spin_unlock(&files->lock);
+}
+
+/* Look up an fd without locking; returns a reference the caller must put */
+struct file_descriptor *fd_get(struct process_files *files, uint32_t fd) {
+    struct file_descriptor *file = NULL;
+    
+    rcu_read_lock();
+    struct fdtable *fdt = rcu_dereference(files->fdt);
+    if (fdt && fd < fdt->max_fds) {
+        file = rcu_dereference(fdt->fd[fd]);
+        if (file && !file_get_unless_zero(file)) {
+            file = NULL;
+        }
+    }
+    rcu_read_unlock();
+    return file;
+}
+
+int fd_close(struct process_files *files, uint32_t fd) {
+    spin_lock(&files->lock);
+    struct fdtable *fdt = files->fdt;
+    struct file_descriptor *file = fdt && fd < fdt->max_fds ? fdt->fd[fd] : NULL;
+    if (!file) {
+        spin_unlock(&files->lock);
+        return -9; /* EBADF */
+    }
+    
+    rcu_assign_pointer(fdt->fd[fd], NULL);
+    fdt_clear_open(fdt, fd);
+    files->nr_open--;
+    spin_unlock(&files->lock);
+    
+    file_put(file);
+    return 0;
+}
+
+/* Lowest free fd at or after 'start' sharing oldfd's open file */
+int fd_dup(struct process_files *files, uint32_t oldfd, uint32_t start) {
+    struct file_descriptor *file = fd_get(files, oldfd);
+    if (!file) {
+        return -9; /* EBADF */
+    }
+    
+    int fd = fd_alloc(files, start);
+    if (fd < 0) {
+        file_put(file);
+        return fd;
+    }
+    fd_install(files, fd, file);
+    return fd;
+}
+
+/* Make newfd share oldfd's open file, closing what newfd held */
+int fd_dup2(struct process_files *files, uint32_t oldfd, uint32_t newfd) {
+    if (newfd >= NR_OPEN_MAX) {
+        return -9; /* EBADF */
+    }
+    
+    struct file_descriptor *file = fd_get(files, oldfd);
+    if (!file) {
+        return -9; /* EBADF */
+    }
+    if (oldfd == newfd) {
+        file_put(file);
+        return newfd;
+    }
+    
+    spin_lock(&files->lock);
+    if (newfd >= files->fdt->max_fds) {
+        int err = fdtable_expand(files, newfd);
+        if (err) {
+            spin_unlock(&files->lock);
+            file_put(file);
+            return err;
+        }
+    }
+    
+    struct fdtable *fdt = files->fdt;
+    struct file_descriptor *old = fdt->fd[newfd];
+    if (!old && fdt_is_open(fdt, newfd)) {
+        /* Reserved by an open() that has not installed its file yet */
+        spin_unlock(&files->lock);
+        file_put(file);
+        return -16; /* EBUSY */
+    }
+    
+    rcu_assign_pointer(fdt->fd[newfd], file);
+    if (!old) {
+        fdt_set_open(fdt, newfd);
+        files->nr_open++;
+    }
+    spin_unlock(&files->lock);
+    
+    if (old) {
+        file_put(old);
+    }
+    return newfd;
+}
+
+/*
+ * Fill 'dst' with the descriptors of 'src' for fork(): both tables share
+ * the open files, so offsets and flags stay common to parent and child.
+ */
+int files_copy(struct process_files *dst, struct process_files *src) {
+    files_init(dst);
+    
+    spin_lock(&src->lock);
+    struct fdtable *old = src->fdt;
+    struct fdtable *fdt = &dst->fdtab;
+    if (old->max_fds > NR_OPEN_DEFAULT) {
+        fdt = fdtable_alloc(old->max_fds);
+        if (!fdt) {
+            spin_unlock(&src->lock);
+            return -12; /* ENOMEM */
+        }
+        dst->fdt = fdt;
+    }
+    
+    /* Reserved fds with no file installed yet stay free in the copy */
+    for (uint32_t word = 0; word < old->max_fds / 64; word++) {
+        for (uint64_t open = old->open_fds[word]; open; open &= open - 1) {
+            uint32_t fd = word * 64 + __builtin_ctzll(open);
+            struct file_descriptor *file = old->fd[fd];
+            if (file) {
+                file_get(file);
+                fdt->fd[fd] = file;
+                fdt_set_open(fdt, fd);
+                dst->nr_open++;
+            }
+        }
+    }
+    spin_unlock(&src->lock);
+    return 0;
+}
+
+/* Close every descriptor, as on exit; files are put outside the lock */
+void files_close_all(struct process_files *files) {
+    if (!files->fdt) {
+        return;     /* Never initialised */
+    }
+    
+    for (uint32_t fd = 0;; fd++) {
+        spin_lock(&files->lock);
+        struct fdtable *fdt = files->fdt;
+        fd = fdt_next_open(fdt, fd);
+        if (fd >= fdt->max_fds) {
+            spin_unlock(&files->lock);
+            break;
+        }
+        
+        struct file_descriptor *file = fdt->fd[fd];
+        rcu_assign_pointer(fdt->fd[fd], NULL);
+        fdt_clear_open(fdt, fd);
+        files->nr_open--;
+        spin_unlock(&files->lock);
+        
+        if (file) {
+            file_put(file);
+        }
+    }
+}
+
+/*
+ * Close everything and detach the table. A ring pinning 'files' may
+ * still look fds up or install one, so the table is unpublished under
+ * the lock, swept once more for late installs and freed after a grace
+ * period; lookups on a released table find nothing.
+ */
+void files_release(struct process_files *files) {
+    files_close_all(files);
+    
+    spin_lock(&files->lock);
+    struct fdtable *fdt = files->fdt;
+    rcu_assign_pointer(files->fdt, NULL);
+    spin_unlock(&files->lock);
+    if (!fdt) {
+        return;
+    }
+    
+    for (uint32_t fd = 0; (fd = fdt_next_open(fdt, fd)) < fdt->max_fds; fd++) {
+        struct file_descriptor *file = fdt->fd[fd];
+        if (file) {
+            file_put(file);
+        }
+    }
+    if (fdt != &files->fdtab) {
+        call_rcu(&fdt->rcu, fdtable_free_rcu);
+    }
+}
+
+/* Share the table with another process (clone(CLONE_FILES)) */
+void files_get(struct process_files *files) {
+    __atomic_fetch_add(&files->users, 1, __ATOMIC_RELAXED);
+}
+
+/* Drop a process's share; true if it was the last and the table must be released */
+bool files_put(struct process_files *files) {
+    return __atomic_sub_fetch(&files->users, 1, __ATOMIC_ACQ_REL) == 0;
+}
+
+/*
+ * Keep the memory of 'files' (not its descriptors) alive for an I/O ring
+ * submitting to it. A users reference would never drop: the ring's own
+ * fd lives in the table and is only closed when the table is released.
+ */
+void files_pin(struct process_files *files) {
+    __atomic_fetch_add(&files->refs, 1, __ATOMIC_RELAXED);
+}
+
+/* Drop a pin; true if it was the last hold and the caller frees 'files' */
+bool files_unpin(struct process_files *files) {
+    return __atomic_sub_fetch(&files->refs, 1, __ATOMIC_ACQ_REL) == 0;
+}
+
+/*
+ * Descriptor benchmark: open nr_fds descriptors in a private table,
+ * look each up, close and reopen random ones with the table full (the
+ * lowest free fd must come back), then close them all.
+ */
+void fdtable_benchmark(uint32_t nr_fds) {
+    debug_print("=== FD TABLE BENCHMARK (%u fds) ===\n", nr_fds);
+    
+    struct process_files *files = kmalloc(sizeof(struct process_files));
+    struct file_descriptor *file = file_alloc(NULL, 0, 0);
+    if (!files || !file || !nr_fds) {
+        debug_print("FD table benchmark: out of memory\n");
+        return;
+    }
+    files_init(files);
+    
+    uint64_t start = get_ticks();
+    uint32_t opened = 0;
+    for (; opened < nr_fds; opened++) {
+        int fd = fd_alloc(files, 0);
+        if (fd < 0) {
+            break;
+        }
+        file_get(file);
+        fd_install(files, fd, file);
+    }
+    uint64_t open_cycles = get_ticks() - start;
+    uint32_t max_fds = files->fdt->max_fds;
+    
+    start = get_ticks();
+    for (uint32_t fd = 0; fd < opened; fd++) {
+        struct file_descriptor *f = fd_get(files, fd);
+        if (f) {
+            file_put(f);
+        }
+    }
+    uint64_t lookup_cycles = get_ticks() - start;
+    
+    uint32_t reuses = opened < 10000 ? opened : 10000;
+    uint32_t misses = 0;
+    uint64_t seed = get_ticks() | 1;
+    start = get_ticks();
+    for (uint32_t i = 0; i < reuses; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t victim = (seed >> 33) % opened;
+        fd_close(files, victim);
+        int fd = fd_alloc(files, 0);
+        file_get(file);
+        fd_install(files, fd, file);
+        misses += fd != (int)victim;
+    }
+    uint64_t reuse_cycles = get_ticks() - start;
+    
+    start = get_ticks();
+    for (uint32_t fd = 0; fd < opened; fd++) {
+        fd_close(files, fd);
+    }
+    uint64_t close_cycles = get_ticks() - start;
+    
+    files_release(files);
+    file_put(file);
+    kfree(files);
+    
+    if (!opened) {
+        return;
+    }
+    debug_print("%u fds opened, table grew to %u\n", opened, max_fds);
+    debug_print("open %lu, lookup %lu, close %lu cycles per fd\n", open_cycles / opened,
+                lookup_cycles / opened, close_cycles / opened);
+    if (reuses) {
+        debug_print("close+reopen in a full table %lu cycles, %u not given the lowest fd\n",
+                    reuse_cycles / reuses, misses);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,321 @@
+/*
+ * SentinalOS Pipes
+ * Page-Buffer Rings Between Descriptors
+ */
+
+#include "../include/system.h"
+#include "../include/string.h"
+#include "../include/slab.h"
+#include "../include/fdtable.h"
+#include "../include/pipe.h"
+
+static struct kmem_cache *pipe_cache;
+static struct kmem_cache *pipe_page_cache;
+static struct kmem_cache *pipe_data_cache;
+
+static const struct file_operations pipe_read_fops;
+static const struct file_operations pipe_write_fops;
+
+/* Create the caches pipes and their pages come from */
+void pipe_init(void) {
+    pipe_cache = kmem_cache_create("pipe", sizeof(struct pipe), 0);
+    pipe_page_cache = kmem_cache_create("pipe_page", sizeof(struct pipe_page), 0);
+    pipe_data_cache = kmem_cache_create("pipe_data", PAGE_SIZE, PAGE_SIZE);
+}
+
+static void pipe_page_free(struct pipe_page *page) {
+    kmem_cache_free(pipe_data_cache, page->data);
+    kmem_cache_free(pipe_page_cache, page);
+}
+
+/* A fresh page holding one reference */
+struct pipe_page *pipe_page_alloc(void) {
+    struct pipe_page *page = kmem_cache_alloc(pipe_page_cache);
+    if (!page) {
+        return NULL;
+    }
+    
+    page->data = kmem_cache_alloc(pipe_data_cache);
+    if (!page->data) {
+        kmem_cache_free(pipe_page_cache, page);
+        return NULL;
+    }
+    page->ref_count = 1;
+    page->release = pipe_page_free;
+    page->private_data = NULL;
+    return page;
+}
+
+void pipe_page_get(struct pipe_page *page) {
+    __sync_fetch_and_add(&page->ref_count, 1);
+}
+
+void pipe_page_put(struct pipe_page *page) {
+    if (__sync_sub_and_fetch(&page->ref_count, 1) == 0 && page->release) {
+        page->release(page);
+    }
+}
+
+struct pipe *pipe_alloc(void) {
+    struct pipe *pipe = kmem_cache_zalloc(pipe_cache);
+    if (!pipe) {
+        return NULL;
+    }
+    
+    mutex_init(&pipe->lock);
+    init_waitqueue_head(&pipe->rd_wait);
+    init_waitqueue_head(&pipe->wr_wait);
+    return pipe;
+}
+
+/* Drop every buffered page */
+void pipe_release_buffers(struct pipe *pipe) {
+    while (!pipe_empty(pipe)) {
+        pipe_page_put(pipe->bufs[pipe->tail % PIPE_DEF_BUFFERS].page);
+        pipe->tail++;
+    }
+}
+
+void pipe_free(struct pipe *pipe) {
+    pipe_release_buffers(pipe);
+    kmem_cache_free(pipe_cache, pipe);
+}
+
+/* The pipe behind either end, or NULL if 'file' is not a pipe */
+struct pipe *file_pipe(struct file_descriptor *file) {
+    if (file->f_op != &pipe_read_fops && file->f_op != &pipe_write_fops) {
+        return NULL;
+    }
+    return file->private_data;
+}
+
+/*
+ * Wait, with pipe->lock held, until the pipe has data. Returns > 0 if it
+ * has, 0 at end of file (no writers left), or a negative errno.
+ */
+long pipe_wait_data(struct pipe *pipe, bool nonblock) {
+    while (pipe_empty(pipe)) {
+        if (!pipe->writers) {
+            return 0;
+        }
+        if (nonblock) {
+            return -11; /* EAGAIN */
+        }
+        mutex_unlock(&pipe->lock);
+        wait_event(&pipe->rd_wait, !pipe_empty(pipe) || !pipe->writers);
+        mutex_lock(&pipe->lock);
+    }
+    return 1;
+}
+
+/* Wait, with pipe->lock held, for a free buffer. Returns 0 or a negative errno */
+long pipe_wait_space(struct pipe *pipe, bool nonblock) {
+    while (pipe_full(pipe)) {
+        if (!pipe->readers) {
+            return -32; /* EPIPE */
+        }
+        if (nonblock) {
+            return -11; /* EAGAIN */
+        }
+        mutex_unlock(&pipe->lock);
+        wait_event(&pipe->wr_wait, !pipe_full(pipe) || !pipe->readers);
+        mutex_lock(&pipe->lock);
+    }
+    return pipe->readers ? 0 : -32; /* EPIPE */
+}
+
+static inline bool file_nonblock(struct file_descriptor *file) {
+    return file->flags & 0x800; /* O_NONBLOCK */
+}
+
+static long pipe_read(struct file_descriptor *file, void *buf, size_t count) {
+    struct pipe *pipe = file->private_data;
+    uint8_t *dst = buf;
+    
+    mutex_lock(&pipe->lock);
+    long ret = pipe_wait_data(pipe, file_nonblock(file));
+    if (ret <= 0) {
+        mutex_unlock(&pipe->lock);
+        return ret;
+    }
+    
+    size_t copied = 0;
+    while (!pipe_empty(pipe) && copied < count) {
+        struct pipe_buffer *pbuf = &pipe->bufs[pipe->tail % PIPE_DEF_BUFFERS];
+        size_t n = count - copied < pbuf->len ? count - copied : pbuf->len;
+        memcpy(dst + copied, pbuf->page->data + pbuf->offset, n);
+        pbuf->offset += n;
+        pbuf->len -= n;
+        copied += n;
+        if (!pbuf->len) {
+            pipe_page_put(pbuf->page);
+            pipe->tail++;
+        }
+    }
+    mutex_unlock(&pipe->lock);
+    
+    wake_up(&pipe->wr_wait);
+    return copied;
+}
+
+/* Blocks until everything is written, unless the pipe is non-blocking or the readers go */
+static long pipe_write(struct file_descriptor *file, const void *buf, size_t count) {
+    struct pipe *pipe = file->private_data;
+    const uint8_t *src = buf;
+    size_t copied = 0;
+    long ret = 0;
+    
+    mutex_lock(&pipe->lock);
+    if (!pipe->readers) {
+        mutex_unlock(&pipe->lock);
+        return -32; /* EPIPE */
+    }
+    
+    /* Top up the last buffer if the page is ours */
+    if (!pipe_empty(pipe)) {
+        struct pipe_buffer *last = &pipe->bufs[(pipe->head - 1) % PIPE_DEF_BUFFERS];
+        uint32_t end = last->offset + last->len;
+        if ((last->flags & PIPE_BUF_CAN_MERGE) && end < PAGE_SIZE) {
+            size_t n = count < PAGE_SIZE - end ? count : PAGE_SIZE - end;
+            memcpy(last->page->data + end, src, n);
+            last->len += n;
+            copied = n;
+        }
+    }
+    
+    while (copied < count) {
+        ret = pipe_wait_space(pipe, file_nonblock(file));
+        if (ret < 0) {
+            break;
+        }
+        
+        struct pipe_page *page = pipe_page_alloc();
+        if (!page) {
+            ret = -12; /* ENOMEM */
+            break;
+        }
+        size_t n = count - copied < PAGE_SIZE ? count - copied : PAGE_SIZE;
+        memcpy(page->data, src + copied, n);
+        pipe->bufs[pipe->head % PIPE_DEF_BUFFERS] = (struct pipe_buffer){
+            .page = page, .offset = 0, .len = n, .flags = PIPE_BUF_CAN_MERGE };
+        pipe->head++;
+        copied += n;
+        
+        /* Let a reader drain while we wait for more space */
+        wake_up(&pipe->rd_wait);
+    }
+    mutex_unlock(&pipe->lock);
+    
+    if (copied) {
+        wake_up(&pipe->rd_wait);
+    }
+    return copied ? (long)copied : ret;
+}
+
+static uint32_t pipe_read_poll(struct file_descriptor *file) {
+    struct pipe *pipe = file->private_data;
+    uint32_t events = pipe_empty(pipe) ? 0 : POLLIN;
+    return pipe->writers ? events : events | POLLHUP;
+}
+
+static uint32_t pipe_write_poll(struct file_descriptor *file) {
+    struct pipe *pipe = file->private_data;
+    if (!pipe->readers) {
+        return POLLERR;
+    }
+    return pipe_full(pipe) ? 0 : POLLOUT;
+}
+
+static struct wait_queue_head *pipe_read_poll_queue(struct file_descriptor *file) {
+    struct pipe *pipe = file->private_data;
+    return &pipe->rd_wait;
+}
+
+static struct wait_queue_head *pipe_write_poll_queue(struct file_descriptor *file) {
+    struct pipe *pipe = file->private_data;
+    return &pipe->wr_wait;
+}
+
+/*
+ * Close one end and wake the other side. The pipe goes with the last
+ * reference, dropped only once this closer is done with the lock and
+ * the wait queues.
+ */
+static void pipe_release(struct file_descriptor *file) {
+    struct pipe *pipe = file->private_data;
+    
+    mutex_lock(&pipe->lock);
+    if (file->f_op == &pipe_read_fops) {
+        pipe->readers--;
+    } else {
+        pipe->writers--;
+    }
+    bool last = !pipe->readers && !pipe->writers;
+    mutex_unlock(&pipe->lock);
+    
+    if (!last) {
+        wake_up_all(&pipe->rd_wait);
+        wake_up_all(&pipe->wr_wait);
+    }
+    if (__atomic_sub_fetch(&pipe->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        pipe_free(pipe);
+    }
+}
+
+static const struct file_operations pipe_read_fops = {
+    .read = pipe_read,
+    .poll = pipe_read_poll,
+    .poll_queue = pipe_read_poll_queue,
+    .release = pipe_release,
+};
+
+static const struct file_operations pipe_write_fops = {
+    .write = pipe_write,
+    .poll = pipe_write_poll,
+    .poll_queue = pipe_write_poll_queue,
+    .release = pipe_release,
+};
+
+/* Open a pipe on the two lowest free fds of 'files': fds[0] reads, fds[1] writes */
+long pipe_create(struct process_files *files, int *fds, uint32_t flags) {
+    if (flags & ~0x800U) { /* Only O_NONBLOCK */
+        return -22; /* EINVAL */
+    }
+    
+    struct pipe *pipe = pipe_alloc();
+    if (!pipe) {
+        return -12; /* ENOMEM */
+    }
+    struct file_descriptor *rfile = file_alloc(NULL, flags, 0);
+    struct file_descriptor *wfile = file_alloc(NULL, flags | 0x01, 0); /* O_WRONLY */
+    if (!rfile || !wfile) {
+        if (rfile) file_put(rfile);
+        if (wfile) file_put(wfile);
+        kmem_cache_free(pipe_cache, pipe);
+        return -12; /* ENOMEM */
+    }
+    rfile->f_op = &pipe_read_fops;
+    rfile->private_data = pipe;
+    wfile->f_op = &pipe_write_fops;
+    wfile->private_data = pipe;
+    pipe->readers = 1;
+    pipe->writers = 1;
+    pipe->refs = 2;
+    
+    int rfd = fd_alloc(files, 3);
+    int wfd = rfd < 0 ? rfd : fd_alloc(files, 3);
+    if (wfd < 0) {
+        if (rfd >= 0) {
+            fd_release(files, rfd);
+        }
+        file_put(rfile);
+        file_put(wfile);
+        return wfd;
+    }
+    fd_install(files, rfd, rfile);
+    fd_install(files, wfd, wfile);
+    
+    fds[0] = rfd;
+    fds[1] = wfd;
+    return 0;
+}
\ No newline at end of file
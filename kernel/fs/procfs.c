@@ -0,0 +1,131 @@
+/*
+ * SentinalOS Process Filesystem
+ * Kernel State as Files Under /proc
+ */
+
+#include "../include/system.h"
+#include "../include/string.h"
+#include "../include/fdtable.h"
+#include "../include/procfs.h"
+
+/* An open text entry: the snapshot show() produced at open */
+struct proc_file {
+    const struct proc_entry *entry;
+    char *buf;
+    size_t len;
+};
+
+static const struct proc_entry *proc_entries[PROC_MAX_ENTRIES];
+static uint32_t nr_proc_entries;
+static spinlock_t proc_lock;
+
+void procfs_init(void) {
+    spin_lock_init(&proc_lock);
+}
+
+/* Entries live for good; 'entry' must too */
+int proc_register(const struct proc_entry *entry) {
+    int ret = 0;
+    uint64_t flags = spin_lock_irqsave(&proc_lock);
+    for (uint32_t i = 0; i < nr_proc_entries; i++) {
+        if (strcmp(proc_entries[i]->name, entry->name) == 0) {
+            ret = -17; /* EEXIST */
+        }
+    }
+    if (!ret && nr_proc_entries == PROC_MAX_ENTRIES) {
+        ret = -28; /* ENOSPC */
+    }
+    if (!ret) {
+        proc_entries[nr_proc_entries++] = entry;
+    }
+    spin_unlock_irqrestore(&proc_lock, flags);
+    return ret;
+}
+
+static const struct proc_entry *proc_lookup(const char *name) {
+    const struct proc_entry *entry = NULL;
+    uint64_t flags = spin_lock_irqsave(&proc_lock);
+    for (uint32_t i = 0; i < nr_proc_entries && !entry; i++) {
+        if (strcmp(proc_entries[i]->name, name) == 0) {
+            entry = proc_entries[i];
+        }
+    }
+    spin_unlock_irqrestore(&proc_lock, flags);
+    return entry;
+}
+
+static long proc_read(struct file_descriptor *file, void *buf, size_t count) {
+    struct proc_file *pf = file->private_data;
+    if (file->offset >= pf->len) {
+        return 0;
+    }
+    
+    size_t n = pf->len - file->offset < count ? pf->len - file->offset : count;
+    memcpy(buf, pf->buf + file->offset, n);
+    file->offset += n;
+    return n;
+}
+
+static long proc_write(struct file_descriptor *file, const void *buf, size_t count) {
+    struct proc_file *pf = file->private_data;
+    if (!pf->entry->write) {
+        return -5; /* EIO */
+    }
+    return pf->entry->write(buf, count);
+}
+
+static void proc_release(struct file_descriptor *file) {
+    struct proc_file *pf = file->private_data;
+    kfree(pf->buf);
+    kfree(pf);
+}
+
+static const struct file_operations proc_fops = {
+    .read = proc_read,
+    .write = proc_write,
+    .release = proc_release,
+};
+
+/* Open /proc/<name> on the lowest free fd from 3 */
+long procfs_open(struct process_files *files, const char *name, uint32_t flags) {
+    const struct proc_entry *entry = proc_lookup(name);
+    if (!entry) {
+        return -2; /* ENOENT */
+    }
+    struct process *proc = process_get_current();
+    if (entry->privileged && proc && proc->cred->uid != 0) {
+        return -13; /* EACCES */
+    }
+    
+    struct file_descriptor *file = file_alloc(NULL, flags, 0);
+    if (!file) {
+        return -12; /* ENOMEM */
+    }
+    if (entry->fops) {
+        file->f_op = entry->fops;
+        file->private_data = entry->data;
+    } else {
+        struct proc_file *pf = kmalloc(sizeof(*pf));
+        char *buf = kmalloc(PROC_BUF_SIZE);
+        if (!pf || !buf) {
+            kfree(buf);
+            kfree(pf);
+            file_put(file);
+            return -12; /* ENOMEM */
+        }
+        int len = entry->show(buf, PROC_BUF_SIZE);
+        pf->entry = entry;
+        pf->buf = buf;
+        pf->len = len < 0 ? 0 : (len < PROC_BUF_SIZE ? (size_t)len : PROC_BUF_SIZE - 1);
+        file->f_op = &proc_fops;
+        file->private_data = pf;
+    }
+    
+    int fd = fd_alloc(files, 3);
+    if (fd < 0) {
+        file_put(file);
+        return fd;
+    }
+    fd_install(files, fd, file);
+    return fd;
+}
\ No newline at end of file
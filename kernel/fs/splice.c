@@ -0,0 +1,520 @@
+/*
+ * SentinalOS Splice and Sendfile
+ * Moving Pages Between Descriptors by Reference
+ */
+
+#include "../include/system.h"
+#include "../include/string.h"
+#include "../include/ktime.h"
+#include "../include/fdtable.h"
+#include "../include/pipe.h"
+
+/* Benchmark source size: pages the in-memory file cycles through */
+#define SPLICE_BENCH_PAGES      16
+
+static inline bool file_nonblock(struct file_descriptor *file) {
+    return file->flags & 0x800; /* O_NONBLOCK */
+}
+
+/*
+ * Fill free buffers of 'pipe' from 'file' by copying, for files that
+ * cannot lend their pages. Inode files are read at *pos, which advances.
+ * Called with pipe->lock held and at least one buffer free.
+ */
+static long splice_read_copy(struct file_descriptor *file, int64_t *pos, struct pipe *pipe,
+                             size_t len) {
+    size_t done = 0;
+    
+    while (done < len && !pipe_full(pipe)) {
+        struct pipe_page *page = pipe_page_alloc();
+        if (!page) {
+            return done ? (long)done : -12; /* ENOMEM */
+        }
+        
+        size_t n = len - done < PAGE_SIZE ? len - done : PAGE_SIZE;
+        long ret;
+        if (file->f_op) {
+            ret = file->f_op->read ? file->f_op->read(file, page->data, n) : -22; /* EINVAL */
+        } else {
+            ret = fs_read_inode(file->inode, *pos, page->data, n);
+            if (ret > 0) {
+                *pos += ret;
+            }
+        }
+        if (ret <= 0) {
+            pipe_page_put(page);
+            return done ? (long)done : ret;
+        }
+        
+        pipe->bufs[pipe->head % PIPE_DEF_BUFFERS] = (struct pipe_buffer){
+            .page = page, .offset = 0, .len = ret, .flags = PIPE_BUF_CAN_MERGE };
+        pipe->head++;
+        done += ret;
+        if ((size_t)ret < n) {
+            break;
+        }
+    }
+    return done;
+}
+
+/* Drain buffers of 'pipe' into 'file' by copying; pipe->lock held, pipe not empty */
+static long splice_write_copy(struct pipe *pipe, struct file_descriptor *file, int64_t *pos,
+                              size_t len) {
+    size_t done = 0;
+    
+    while (done < len && !pipe_empty(pipe)) {
+        struct pipe_buffer *buf = &pipe->bufs[pipe->tail % PIPE_DEF_BUFFERS];
+        size_t n = len - done < buf->len ? len - done : buf->len;
+        const void *data = buf->page->data + buf->offset;
+        long ret;
+        if (file->f_op) {
+            ret = file->f_op->write ? file->f_op->write(file, data, n) : -22; /* EINVAL */
+        } else {
+            ret = fs_write_inode(file->inode, *pos, data, n);
+            if (ret > 0) {
+                *pos += ret;
+            }
+        }
+        if (ret <= 0) {
+            return done ? (long)done : ret;
+        }
+        
+        buf->offset += ret;
+        buf->len -= ret;
+        done += ret;
+        if (!buf->len) {
+            pipe_page_put(buf->page);
+            pipe->tail++;
+        }
+        if ((size_t)ret < n) {
+            break;
+        }
+    }
+    return done;
+}
+
+/* File to pipe: by reference if the file supports it. pipe->lock held, space free */
+static long splice_file_to_pipe(struct file_descriptor *in, int64_t *pos, struct pipe *pipe,
+                                size_t len) {
+    if (in->f_op && in->f_op->splice_read) {
+        return in->f_op->splice_read(in, pos, pipe, len);
+    }
+    return splice_read_copy(in, pos, pipe, len);
+}
+
+/* Pipe to file: by reference if the file supports it. pipe->lock held, data present */
+static long splice_pipe_to_file(struct pipe *pipe, struct file_descriptor *out, int64_t *pos,
+                                size_t len) {
+    if (out->f_op && out->f_op->splice_write) {
+        return out->f_op->splice_write(pipe, out, pos, len);
+    }
+    return splice_write_copy(pipe, out, pos, len);
+}
+
+/*
+ * Pipe to pipe: whole buffers move over, a partial one shares its page.
+ * Waits for data in 'ipipe' and space in 'opipe' unless nonblock.
+ */
+static long splice_pipe_to_pipe(struct pipe *ipipe, struct pipe *opipe, size_t len,
+                                bool nonblock) {
+    if (ipipe == opipe) {
+        return -22; /* EINVAL */
+    }
+    
+    for (;;) {
+        mutex_lock(&ipipe->lock);
+        long ret = pipe_wait_data(ipipe, nonblock);
+        mutex_unlock(&ipipe->lock);
+        if (ret <= 0) {
+            return ret;
+        }
+        
+        mutex_lock(&opipe->lock);
+        ret = pipe_wait_space(opipe, nonblock);
+        mutex_unlock(&opipe->lock);
+        if (ret < 0) {
+            return ret;
+        }
+        
+        /* Both locks, in address order */
+        struct pipe *first = ipipe < opipe ? ipipe : opipe;
+        struct pipe *second = ipipe < opipe ? opipe : ipipe;
+        mutex_lock(&first->lock);
+        mutex_lock(&second->lock);
+        
+        size_t done = 0;
+        while (done < len && !pipe_empty(ipipe) && !pipe_full(opipe)) {
+            struct pipe_buffer *ibuf = &ipipe->bufs[ipipe->tail % PIPE_DEF_BUFFERS];
+            struct pipe_buffer *obuf = &opipe->bufs[opipe->head % PIPE_DEF_BUFFERS];
+            
+            if (ibuf->len <= len - done) {
+                *obuf = *ibuf;
+                ipipe->tail++;
+            } else {
+                /* Share the page: neither side may append to it now */
+                pipe_page_get(ibuf->page);
+                *obuf = (struct pipe_buffer){
+                    .page = ibuf->page, .offset = ibuf->offset, .len = len - done };
+                ibuf->offset += len - done;
+                ibuf->len -= len - done;
+                ibuf->flags &= ~PIPE_BUF_CAN_MERGE;
+            }
+            opipe->head++;
+            done += obuf->len;
+        }
+        bool readers = opipe->readers;
+        
+        mutex_unlock(&second->lock);
+        mutex_unlock(&first->lock);
+        
+        if (done) {
+            wake_up(&ipipe->wr_wait);
+            wake_up(&opipe->rd_wait);
+            return done;
+        }
+        if (!readers) {
+            return -32; /* EPIPE */
+        }
+    }
+}
+
+/* Resolve the position of a non-pipe side: *off if given, else the file offset */
+static long splice_get_pos(struct file_descriptor *file, const int64_t *off, int64_t *pos) {
+    if (off && *off < 0) {
+        return -22; /* EINVAL */
+    }
+    *pos = off ? *off : (int64_t)file->offset;
+    return 0;
+}
+
+static void splice_put_pos(struct file_descriptor *file, int64_t *off, int64_t pos) {
+    if (off) {
+        *off = pos;
+    } else if (!file->f_op) {
+        file->offset = pos;
+    }
+}
+
+/*
+ * Move up to 'len' bytes between two fds of 'files', at least one of them
+ * a pipe. The other side is read or written at *off, which advances, or
+ * at its file offset if off is NULL; pipes take no offset.
+ */
+long ksys_splice(struct process_files *files, uint32_t fd_in, int64_t *off_in, uint32_t fd_out,
+                 int64_t *off_out, size_t len) {
+    struct file_descriptor *in = fd_get(files, fd_in);
+    struct file_descriptor *out = in ? fd_get(files, fd_out) : NULL;
+    if (!out) {
+        if (in) {
+            file_put(in);
+        }
+        return -9; /* EBADF */
+    }
+    
+    struct pipe *ipipe = file_pipe(in);
+    struct pipe *opipe = file_pipe(out);
+    long ret;
+    int64_t pos;
+    
+    if ((ipipe && !in->f_op->read) || (opipe && !out->f_op->write)) {
+        ret = -9; /* EBADF: wrong end of a pipe */
+    } else if ((ipipe && off_in) || (opipe && off_out)) {
+        ret = -29; /* ESPIPE */
+    } else if (!len) {
+        ret = 0;
+    } else if (ipipe && opipe) {
+        ret = splice_pipe_to_pipe(ipipe, opipe, len, file_nonblock(in) || file_nonblock(out));
+    } else if (opipe) {
+        ret = splice_get_pos(in, off_in, &pos);
+        if (ret == 0) {
+            mutex_lock(&opipe->lock);
+            ret = pipe_wait_space(opipe, file_nonblock(out));
+            if (ret == 0) {
+                ret = splice_file_to_pipe(in, &pos, opipe, len);
+            }
+            mutex_unlock(&opipe->lock);
+            if (ret > 0) {
+                splice_put_pos(in, off_in, pos);
+                wake_up(&opipe->rd_wait);
+            }
+        }
+    } else if (ipipe) {
+        ret = splice_get_pos(out, off_out, &pos);
+        if (ret == 0) {
+            mutex_lock(&ipipe->lock);
+            ret = pipe_wait_data(ipipe, file_nonblock(in));
+            if (ret > 0) {
+                ret = splice_pipe_to_file(ipipe, out, &pos, len);
+            }
+            mutex_unlock(&ipipe->lock);
+            if (ret > 0) {
+                splice_put_pos(out, off_out, pos);
+                wake_up(&ipipe->wr_wait);
+            }
+        }
+    } else {
+        ret = -22; /* EINVAL */
+    }
+    
+    file_put(out);
+    file_put(in);
+    return ret;
+}
+
+/*
+ * Copy up to 'count' bytes from in_fd to out_fd without a trip through
+ * userspace. Pages go through a private pipe, by reference where both
+ * files allow it. in_fd is read at *offset, which advances, or at its
+ * file offset if offset is NULL.
+ */
+long ksys_sendfile(struct process_files *files, uint32_t out_fd, uint32_t in_fd, int64_t *offset,
+                   size_t count) {
+    struct file_descriptor *in = fd_get(files, in_fd);
+    struct file_descriptor *out = in ? fd_get(files, out_fd) : NULL;
+    if (!out) {
+        if (in) {
+            file_put(in);
+        }
+        return -9; /* EBADF */
+    }
+    
+    int64_t pos;
+    long ret = splice_get_pos(in, offset, &pos);
+    struct pipe *pipe = ret == 0 ? pipe_alloc() : NULL;
+    if (ret == 0 && !pipe) {
+        ret = -12; /* ENOMEM */
+    }
+    if (ret < 0) {
+        file_put(out);
+        file_put(in);
+        return ret;
+    }
+    pipe->readers = pipe->writers = 1;
+    
+    struct pipe *opipe = file_pipe(out);
+    int64_t out_pos = out->offset;
+    size_t done = 0;
+    while (done < count) {
+        /* Private pipe: never shared, so its lock cannot contend */
+        mutex_lock(&pipe->lock);
+        ret = splice_file_to_pipe(in, &pos, pipe, count - done);
+        mutex_unlock(&pipe->lock);
+        if (ret <= 0) {
+            break;
+        }
+        
+        size_t chunk = ret;
+        size_t sent = 0;
+        while (sent < chunk) {
+            if (opipe) {
+                ret = splice_pipe_to_pipe(pipe, opipe, chunk - sent, file_nonblock(out));
+            } else {
+                mutex_lock(&pipe->lock);
+                ret = splice_pipe_to_file(pipe, out, &out_pos, chunk - sent);
+                mutex_unlock(&pipe->lock);
+            }
+            if (ret <= 0) {
+                break;
+            }
+            sent += ret;
+        }
+        done += sent;
+        if (sent < chunk) {
+            /* The unsent part was read: step back over it */
+            pos -= chunk - sent;
+            break;
+        }
+    }
+    
+    if (!out->f_op && !opipe) {
+        out->offset = out_pos;
+    }
+    splice_put_pos(in, offset, pos);
+    pipe_free(pipe);
+    
+    file_put(out);
+    file_put(in);
+    return done ? (long)done : ret;
+}
+
+/*
+ * Benchmark files. The source cycles through SPLICE_BENCH_PAGES pages it
+ * owns and lends them out by reference; the sink stands in for a socket,
+ * copying on write() and taking pages by reference on splice.
+ */
+static struct pipe_page splice_bench_pages[SPLICE_BENCH_PAGES];
+static uint32_t splice_bench_next;
+static uint8_t splice_bench_wire[PAGE_SIZE];
+
+static long splice_src_read(struct file_descriptor *file, void *buf, size_t count) {
+    (void)file;
+    uint8_t *dst = buf;
+    size_t done = 0;
+    while (done < count) {
+        size_t n = count - done < PAGE_SIZE ? count - done : PAGE_SIZE;
+        struct pipe_page *page = &splice_bench_pages[splice_bench_next++ % SPLICE_BENCH_PAGES];
+        memcpy(dst + done, page->data, n);
+        done += n;
+    }
+    return count;
+}
+
+static long splice_src_splice_read(struct file_descriptor *file, int64_t *pos, struct pipe *pipe,
+                                   size_t len) {
+    (void)file;
+    (void)pos;
+    size_t done = 0;
+    while (done < len && !pipe_full(pipe)) {
+        struct pipe_page *page = &splice_bench_pages[splice_bench_next++ % SPLICE_BENCH_PAGES];
+        size_t n = len - done < PAGE_SIZE ? len - done : PAGE_SIZE;
+        pipe_page_get(page);
+        pipe->bufs[pipe->head % PIPE_DEF_BUFFERS] = (struct pipe_buffer){
+            .page = page, .offset = 0, .len = n };
+        pipe->head++;
+        done += n;
+    }
+    return done;
+}
+
+static long splice_sink_write(struct file_descriptor *file, const void *buf, size_t count) {
+    (void)file;
+    const uint8_t *src = buf;
+    for (size_t done = 0; done < count; done += PAGE_SIZE) {
+        size_t n = count - done < PAGE_SIZE ? count - done : PAGE_SIZE;
+        memcpy(splice_bench_wire, src + done, n);
+    }
+    return count;
+}
+
+/* "Transmit" buffered pages: the references are simply dropped */
+static long splice_sink_splice_write(struct pipe *pipe, struct file_descriptor *file,
+                                     int64_t *pos, size_t len) {
+    (void)file;
+    (void)pos;
+    size_t done = 0;
+    while (done < len && !pipe_empty(pipe)) {
+        struct pipe_buffer *buf = &pipe->bufs[pipe->tail % PIPE_DEF_BUFFERS];
+        if (buf->len > len - done) {
+            buf->offset += len - done;
+            buf->len -= len - done;
+            done = len;
+            break;
+        }
+        done += buf->len;
+        pipe_page_put(buf->page);
+        pipe->tail++;
+    }
+    return done;
+}
+
+static const struct file_operations splice_src_fops = {
+    .read = splice_src_read,
+    .splice_read = splice_src_splice_read,
+};
+
+/* The same source without splice_read, to time the copy fallback */
+static const struct file_operations splice_src_copy_fops = {
+    .read = splice_src_read,
+};
+
+static const struct file_operations splice_sink_fops = {
+    .write = splice_sink_write,
+    .splice_write = splice_sink_splice_write,
+};
+
+static int splice_bench_open(struct process_files *files, const struct file_operations *fops) {
+    struct file_descriptor *file = file_alloc(NULL, 0, 0);
+    if (!file) {
+        return -12; /* ENOMEM */
+    }
+    file->f_op = fops;
+    
+    int fd = fd_alloc(files, 3);
+    if (fd < 0) {
+        file_put(file);
+        return fd;
+    }
+    fd_install(files, fd, file);
+    return fd;
+}
+
+static uint64_t splice_bench_mbps(uint64_t bytes, uint64_t cycles) {
+    return cycles ? bytes * tsc_khz() * 1000 / cycles / (1024 * 1024) : 0;
+}
+
+/*
+ * Throughput benchmark: total_kb KiB from an in-memory file to a
+ * socket-like sink, with a read()/write() loop through a 64 KiB buffer,
+ * sendfile() by reference and with the copy fallback, and splice()
+ * through a pipe. All calls go through syscall_handler().
+ */
+void splice_benchmark(uint32_t total_kb) {
+    static uint8_t data[SPLICE_BENCH_PAGES][PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+    static uint8_t buf[PIPE_DEF_BUFFERS * PAGE_SIZE];
+    uint64_t total = (uint64_t)total_kb * 1024;
+    uint64_t chunk = sizeof(buf);
+    
+    debug_print("=== SPLICE BENCHMARK (%u KiB) ===\n", total_kb);
+    
+    for (uint32_t i = 0; i < SPLICE_BENCH_PAGES; i++) {
+        memset(data[i], 'A' + i, PAGE_SIZE);
+        splice_bench_pages[i] = (struct pipe_page){ .ref_count = 1, .data = data[i] };
+    }
+    
+    struct process_files *files = current_files();
+    int src = splice_bench_open(files, &splice_src_fops);
+    int src_copy = splice_bench_open(files, &splice_src_copy_fops);
+    int sink = splice_bench_open(files, &splice_sink_fops);
+    int fds[2] = { -1, -1 };
+    if (src < 0 || src_copy < 0 || sink < 0 || pipe_create(files, fds, 0) < 0) {
+        debug_print("splice benchmark: setup failed\n");
+        goto out;
+    }
+    
+    uint64_t start = get_ticks();
+    for (uint64_t done = 0; done < total; done += chunk) {
+        uint64_t n = total - done < chunk ? total - done : chunk;
+        syscall_handler(SYS_READ, src, (uint64_t)buf, n, 0, 0);
+        syscall_handler(SYS_WRITE, sink, (uint64_t)buf, n, 0, 0);
+    }
+    uint64_t rw_cycles = get_ticks() - start;
+    
+    start = get_ticks();
+    syscall_handler(SYS_SENDFILE, sink, src, 0, total, 0);
+    uint64_t sendfile_cycles = get_ticks() - start;
+    
+    start = get_ticks();
+    syscall_handler(SYS_SENDFILE, sink, src_copy, 0, total, 0);
+    uint64_t copy_cycles = get_ticks() - start;
+    
+    start = get_ticks();
+    for (uint64_t done = 0; done < total;) {
+        long n = syscall_handler(SYS_SPLICE, src, 0, fds[1], 0, total - done);
+        if (n <= 0) {
+            break;
+        }
+        for (long sent = 0; sent < n;) {
+            long ret = syscall_handler(SYS_SPLICE, fds[0], 0, sink, 0, n - sent);
+            if (ret <= 0) {
+                break;
+            }
+            sent += ret;
+        }
+        done += n;
+    }
+    uint64_t splice_cycles = get_ticks() - start;
+    
+    debug_print("read/write:       %lu MiB/s\n", splice_bench_mbps(total, rw_cycles));
+    debug_print("sendfile:         %lu MiB/s\n", splice_bench_mbps(total, sendfile_cycles));
+    debug_print("sendfile (copy):  %lu MiB/s\n", splice_bench_mbps(total, copy_cycles));
+    debug_print("splice via pipe:  %lu MiB/s\n", splice_bench_mbps(total, splice_cycles));
+
+out:
+    if (fds[0] >= 0) {
+        ksys_close(files, fds[0]);
+        ksys_close(files, fds[1]);
+    }
+    if (sink >= 0) ksys_close(files, sink);
+    if (src_copy >= 0) ksys_close(files, src_copy);
+    if (src >= 0) ksys_close(files, src);
+}
\ No newline at end of file
@@ -0,0 +1,481 @@
+/*
+ * SentinalOS Terminals
+ * Buffered Console Output and Line Discipline
+ */
+
+#include "../include/system.h"
+#include "../include/string.h"
+#include "../include/ktime.h"
+#include "../include/fdtable.h"
+#include "../include/tty.h"
+
+/* Serial console on COM1 */
+#define SERIAL_PORT         0x3F8
+#define SERIAL_LSR_THRE     0x20    /* Transmit holding register empty */
+#define SERIAL_TIMEOUT      100000  /* Polls of LSR per byte before giving up */
+
+void console_write(const char *buf, size_t len);
+int snprintf(char *buf, size_t size, const char *fmt, ...);
+
+static struct tty console;
+static struct file_descriptor console_file;
+static bool serial_present;
+
+static const struct file_operations tty_fops;
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ __volatile__("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outb(uint16_t port, uint8_t val) {
+    __asm__ __volatile__("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+/* 115200 8N1 with FIFOs; the scratch register tells us whether a UART is there */
+static void serial_init(void) {
+    outb(SERIAL_PORT + 7, 0x5A);
+    if (inb(SERIAL_PORT + 7) != 0x5A) {
+        return;
+    }
+    outb(SERIAL_PORT + 1, 0x00);    /* No interrupts */
+    outb(SERIAL_PORT + 3, 0x80);    /* DLAB */
+    outb(SERIAL_PORT + 0, 0x01);    /* Divisor 1: 115200 baud */
+    outb(SERIAL_PORT + 1, 0x00);
+    outb(SERIAL_PORT + 3, 0x03);    /* 8N1 */
+    outb(SERIAL_PORT + 2, 0xC7);    /* FIFOs on, cleared, 14-byte threshold */
+    outb(SERIAL_PORT + 4, 0x03);    /* DTR, RTS */
+    serial_present = true;
+}
+
+static void serial_putc(char c) {
+    for (uint32_t i = 0; !(inb(SERIAL_PORT + 5) & SERIAL_LSR_THRE); i++) {
+        if (i == SERIAL_TIMEOUT) {
+            return;
+        }
+    }
+    outb(SERIAL_PORT, c);
+}
+
+/* Serial terminals want CR LF */
+static void serial_write(const char *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] == '\n') {
+            serial_putc('\r');
+        }
+        serial_putc(buf[i]);
+    }
+}
+
+static void console_tty_write(struct tty *tty, const char *buf, size_t len) {
+    (void)tty;
+    console_write(buf, len);
+    if (serial_present) {
+        serial_write(buf, len);
+    }
+}
+
+static const struct tty_operations console_tty_ops = {
+    .write = console_tty_write,
+};
+
+/* Ring helpers (tty->lock held) */
+static inline uint32_t ring_used(const struct tty_ring *ring) {
+    return ring->head - ring->tail;
+}
+
+static inline uint32_t ring_space(const struct tty_ring *ring) {
+    return TTY_BUF_SIZE - ring_used(ring);
+}
+
+static uint32_t ring_put(struct tty_ring *ring, const char *buf, uint32_t len) {
+    uint32_t n = len < ring_space(ring) ? len : ring_space(ring);
+    for (uint32_t i = 0; i < n; i++) {
+        ring->buf[(ring->head + i) % TTY_BUF_SIZE] = buf[i];
+    }
+    ring->head += n;
+    return n;
+}
+
+static void tty_flush_work(struct work_struct *work) {
+    tty_flush(work_entry(work, struct tty, flush_work));
+}
+
+void tty_setup(struct tty *tty, const char *name, const struct tty_operations *ops,
+               void *driver_data, uint32_t lflag) {
+    memset(tty, 0, sizeof(*tty));
+    tty->name = name;
+    tty->ops = ops;
+    tty->driver_data = driver_data;
+    tty->lflag = lflag;
+    spin_lock_init(&tty->lock);
+    mutex_init(&tty->flush_lock);
+    init_waitqueue_head(&tty->read_wait);
+    init_waitqueue_head(&tty->write_wait);
+    init_waitqueue_head(&tty->poll_wait);
+    INIT_WORK(&tty->flush_work, tty_flush_work);
+    tty->initialized = true;
+}
+
+/* The console: VGA plus COM1, canonical with echo. Unopened stdio fds reach it from here on */
+void tty_init(void) {
+    serial_init();
+    tty_setup(&console, "console", &console_tty_ops, NULL, TTY_ICANON | TTY_ECHO);
+    
+    console_file.ref_count = 1;     /* Never released */
+    console_file.flags = 0x02;      /* O_RDWR */
+    console_file.f_op = &tty_fops;
+    console_file.private_data = &console;
+}
+
+struct tty *console_tty(void) {
+    return &console;
+}
+
+/*
+ * Hand everything buffered to the driver. The driver reads straight out
+ * of the ring: writers only ever add at the head, and only we move the
+ * tail, after each piece is out.
+ */
+void tty_flush(struct tty *tty) {
+    mutex_lock(&tty->flush_lock);
+    for (;;) {
+        uint64_t flags = spin_lock_irqsave(&tty->lock);
+        uint32_t tail = tty->out.tail;
+        uint32_t used = ring_used(&tty->out);
+        spin_unlock_irqrestore(&tty->lock, flags);
+        if (!used) {
+            break;
+        }
+        
+        /* Up to the end of the buffer; the rest on the next pass */
+        uint32_t offset = tail % TTY_BUF_SIZE;
+        uint32_t n = used < TTY_BUF_SIZE - offset ? used : TTY_BUF_SIZE - offset;
+        tty->ops->write(tty, tty->out.buf + offset, n);
+        
+        flags = spin_lock_irqsave(&tty->lock);
+        tty->out.tail += n;
+        tty->bytes_flushed += n;
+        tty->flushes++;
+        spin_unlock_irqrestore(&tty->lock, flags);
+        
+        wake_up_all(&tty->write_wait);
+        if (waitqueue_active(&tty->poll_wait)) {
+            wake_up_all(&tty->poll_wait);
+        }
+    }
+    mutex_unlock(&tty->flush_lock);
+}
+
+/*
+ * Queue output for the flush worker. Blocks while the ring is full,
+ * unless 'nonblock'; callers that cannot sleep flush it themselves.
+ * Returns the bytes queued, or -EAGAIN if none fit.
+ */
+long tty_write(struct tty *tty, const char *buf, size_t count, bool nonblock) {
+    size_t done = 0;
+    while (done < count) {
+        uint64_t flags = spin_lock_irqsave(&tty->lock);
+        uint32_t chunk = count - done < TTY_BUF_SIZE ? count - done : TTY_BUF_SIZE;
+        uint32_t n = ring_put(&tty->out, buf + done, chunk);
+        tty->bytes_written += n;
+        spin_unlock_irqrestore(&tty->lock, flags);
+        
+        done += n;
+        if (done == count) {
+            break;
+        }
+        if (!sched_can_block()) {
+            tty_flush(tty);
+            continue;
+        }
+        if (nonblock) {
+            break;
+        }
+        schedule_work(&tty->flush_work);
+        wait_event(&tty->write_wait, ring_space(&tty->out) != 0);
+    }
+    
+    if (done) {
+        schedule_work(&tty->flush_work);
+    }
+    return done ? (long)done : -11; /* EAGAIN */
+}
+
+/* Echo a character (tty->lock held); dropped if the output ring is full */
+static void tty_echo(struct tty *tty, char c) {
+    if (c == TTY_CHAR_BS) {
+        ring_put(&tty->out, "\b \b", 3);
+    } else {
+        ring_put(&tty->out, &c, 1);
+    }
+}
+
+/* Move the edited line to the input ring (tty->lock held) */
+static void tty_commit_line(struct tty *tty) {
+    if (ring_space(&tty->in) < tty->line_len) {
+        tty->input_dropped += tty->line_len;
+    } else {
+        ring_put(&tty->in, tty->line, tty->line_len);
+    }
+    tty->line_len = 0;
+}
+
+/* Canonical line discipline for one character (tty->lock held); true if input is ready */
+static bool tty_receive_canon(struct tty *tty, char c) {
+    bool echo = tty->lflag & TTY_ECHO;
+    
+    switch (c) {
+    case TTY_CHAR_BS:
+    case TTY_CHAR_ERASE:
+        if (tty->line_len) {
+            tty->line_len--;
+            if (echo) {
+                tty_echo(tty, TTY_CHAR_BS);
+            }
+        }
+        return false;
+    case TTY_CHAR_KILL:
+        for (; tty->line_len; tty->line_len--) {
+            if (echo) {
+                tty_echo(tty, TTY_CHAR_BS);
+            }
+        }
+        return false;
+    case TTY_CHAR_EOF:
+        /* Ends the line without a newline; on an empty line read() returns 0 */
+        if (!tty->line_len) {
+            tty->eof++;
+        }
+        tty_commit_line(tty);
+        return true;
+    case '\r':
+        c = '\n';
+        break;
+    default:
+        break;
+    }
+    
+    /* Keep the last slot for the newline */
+    if (c != '\n' && tty->line_len >= TTY_LINE_MAX - 1) {
+        return false;
+    }
+    tty->line[tty->line_len++] = c;
+    if (echo) {
+        tty_echo(tty, c);
+    }
+    if (c == '\n') {
+        tty_commit_line(tty);
+        return true;
+    }
+    return false;
+}
+
+/* Input from the driver; safe from interrupt context */
+void tty_receive(struct tty *tty, const char *buf, size_t len) {
+    if (!tty->initialized) {
+        return;
+    }
+    
+    bool ready = false;
+    uint64_t flags = spin_lock_irqsave(&tty->lock);
+    uint32_t echoed = tty->out.head;
+    for (size_t i = 0; i < len; i++) {
+        if (tty->lflag & TTY_ICANON) {
+            ready |= tty_receive_canon(tty, buf[i]);
+        } else if (ring_put(&tty->in, &buf[i], 1)) {
+            ready = true;
+            if (tty->lflag & TTY_ECHO) {
+                tty_echo(tty, buf[i]);
+            }
+        } else {
+            tty->input_dropped++;
+        }
+    }
+    echoed = tty->out.head != echoed;
+    spin_unlock_irqrestore(&tty->lock, flags);
+    
+    if (ready) {
+        wake_up(&tty->read_wait);
+        if (waitqueue_active(&tty->poll_wait)) {
+            wake_up_all(&tty->poll_wait);
+        }
+    }
+    if (echoed) {
+        schedule_work(&tty->flush_work);
+    }
+}
+
+static inline bool tty_readable(struct tty *tty) {
+    return ring_used(&tty->in) || tty->eof;
+}
+
+/*
+ * Read input. In canonical mode a read returns at most one line, and 0
+ * for an end-of-file. Blocks until there is something, unless 'nonblock'.
+ */
+long tty_read(struct tty *tty, char *buf, size_t count, bool nonblock) {
+    if (!count) {
+        return 0;
+    }
+    
+    for (;;) {
+        uint64_t flags = spin_lock_irqsave(&tty->lock);
+        size_t n = 0;
+        while (n < count && ring_used(&tty->in)) {
+            char c = tty->in.buf[tty->in.tail++ % TTY_BUF_SIZE];
+            buf[n++] = c;
+            if (c == '\n' && (tty->lflag & TTY_ICANON)) {
+                break;
+            }
+        }
+        bool eof = !n && tty->eof;
+        if (eof) {
+            tty->eof--;
+        }
+        spin_unlock_irqrestore(&tty->lock, flags);
+        
+        if (n || eof) {
+            return n;
+        }
+        if (nonblock) {
+            return -11; /* EAGAIN */
+        }
+        wait_event(&tty->read_wait, tty_readable(tty));
+    }
+}
+
+static inline bool file_nonblock(struct file_descriptor *file) {
+    return file->flags & 0x800; /* O_NONBLOCK */
+}
+
+static long tty_file_read(struct file_descriptor *file, void *buf, size_t count) {
+    return tty_read(file->private_data, buf, count, file_nonblock(file));
+}
+
+static long tty_file_write(struct file_descriptor *file, const void *buf, size_t count) {
+    return tty_write(file->private_data, buf, count, file_nonblock(file));
+}
+
+static uint32_t tty_file_poll(struct file_descriptor *file) {
+    struct tty *tty = file->private_data;
+    uint32_t events = tty_readable(tty) ? POLLIN : 0;
+    return ring_space(&tty->out) ? events | POLLOUT : events;
+}
+
+static struct wait_queue_head *tty_file_poll_queue(struct file_descriptor *file) {
+    struct tty *tty = file->private_data;
+    return &tty->poll_wait;
+}
+
+static const struct file_operations tty_fops = {
+    .read = tty_file_read,
+    .write = tty_file_write,
+    .poll = tty_file_poll,
+    .poll_queue = tty_file_poll_queue,
+};
+
+/* A new open file on 'tty'; O_NONBLOCK in 'flags' makes its reads and writes non-blocking */
+long tty_open(struct process_files *files, struct tty *tty, uint32_t flags) {
+    struct file_descriptor *file = file_alloc(NULL, flags, 0);
+    if (!file) {
+        return -12; /* ENOMEM */
+    }
+    file->f_op = &tty_fops;
+    file->private_data = tty;
+    
+    int fd = fd_alloc(files, 3);
+    if (fd < 0) {
+        file_put(file);
+        return fd;
+    }
+    fd_install(files, fd, file);
+    return fd;
+}
+
+/* Look up 'fd'; stdin, stdout and stderr are the console unless dup2() put a file there */
+struct file_descriptor *fd_get_stdio(struct process_files *files, uint32_t fd) {
+    struct file_descriptor *file = fd_get(files, fd);
+    if (!file && fd <= 2 && console_file.f_op) {
+        file = &console_file;
+        file_get(file);
+    }
+    return file;
+}
+
+/* Memory sink for the benchmark, so the numbers are the TTY layer's and not the screen's */
+static uint64_t tty_sink_bytes;
+
+static void tty_sink_write(struct tty *tty, const char *buf, size_t len) {
+    (void)tty;
+    (void)buf;
+    tty_sink_bytes += len;
+}
+
+static const struct tty_operations tty_sink_ops = {
+    .write = tty_sink_write,
+};
+
+static uint64_t tty_bench_kbps(uint64_t bytes, uint64_t cycles) {
+    return cycles ? bytes * tsc_khz() * 1000 / cycles / 1024 : 0;
+}
+
+/*
+ * Console write throughput for total_kb KiB: the old path of one
+ * formatted, synchronous write per byte; the TTY with 1-byte and 80-byte
+ * writes, counted until the flush completes; then 80-byte lines through
+ * SYS_WRITE to the real console, timed to return and to reach the screen.
+ */
+void tty_benchmark(uint32_t total_kb) {
+    static struct tty sink;
+    char line[80];
+    uint64_t total = (uint64_t)total_kb * 1024;
+    
+    debug_print("=== TTY BENCHMARK (%u KiB) ===\n", total_kb);
+    
+    for (uint32_t i = 0; i < sizeof(line) - 1; i++) {
+        line[i] = 'a' + i % 26;
+    }
+    line[sizeof(line) - 1] = '\n';
+    tty_setup(&sink, "bench", &tty_sink_ops, NULL, 0);
+    
+    uint64_t start = get_ticks();
+    for (uint64_t i = 0; i < total; i++) {
+        char tmp[2];
+        snprintf(tmp, sizeof(tmp), "%c", line[i % sizeof(line)]);
+        tty_sink_write(&sink, tmp, 1);
+    }
+    uint64_t bytewise_cycles = get_ticks() - start;
+    
+    start = get_ticks();
+    for (uint64_t i = 0; i < total; i++) {
+        tty_write(&sink, &line[i % sizeof(line)], 1, false);
+    }
+    tty_flush(&sink);
+    uint64_t byte_cycles = get_ticks() - start;
+    
+    start = get_ticks();
+    for (uint64_t done = 0; done < total; done += sizeof(line)) {
+        tty_write(&sink, line, sizeof(line), false);
+    }
+    tty_flush(&sink);
+    uint64_t line_cycles = get_ticks() - start;
+    
+    uint64_t flushes = console.flushes;
+    start = get_ticks();
+    for (uint64_t done = 0; done < total; done += sizeof(line)) {
+        syscall_handler(SYS_WRITE, 1, (uint64_t)line, sizeof(line), 0, 0);
+    }
+    uint64_t return_cycles = get_ticks() - start;
+    tty_flush(&console);
+    uint64_t screen_cycles = get_ticks() - start;
+    
+    debug_print("per-byte printf:   %lu KiB/s\n", tty_bench_kbps(total, bytewise_cycles));
+    debug_print("tty, 1-byte:       %lu KiB/s\n", tty_bench_kbps(total, byte_cycles));
+    debug_print("tty, 80-byte:      %lu KiB/s (%lu flushes)\n",
+                tty_bench_kbps(total, line_cycles), sink.flushes);
+    debug_print("console write():   %lu KiB/s to return, %lu KiB/s to screen (%lu flushes)\n",
+                tty_bench_kbps(total, return_cycles), tty_bench_kbps(total, screen_cycles),
+                console.flushes - flushes);
+}
\ No newline at end of file
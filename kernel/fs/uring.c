@@ -0,0 +1,670 @@
+/*
+ * SentinalOS Asynchronous I/O Rings
+ * Shared Submission and Completion Queues
+ */
+
+#include "../include/system.h"
+#include "../include/string.h"
+#include "../include/sched.h"
+#include "../include/kthread.h"
+#include "../include/ktime.h"
+#include "../include/timer.h"
+#include "../include/fdtable.h"
+#include "../include/uaccess.h"
+#include "../include/uring.h"
+
+/* SQEs per uring_enter() in the benchmark */
+#define URING_BENCH_BATCH       32
+
+/*
+ * Ring header in the shared region. Userspace writes the SQ tail and the
+ * CQ head, the kernel the other two; each index has a cache line to
+ * itself.
+ */
+struct uring_ring {
+    volatile uint32_t head;
+    uint32_t pad0[15];
+    volatile uint32_t tail;
+    uint32_t pad1[15];
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    volatile uint32_t flags;
+    volatile uint32_t dropped;  /* SQ: entries with an invalid index */
+    uint32_t pad2[12];
+};
+
+/* An armed POLL request, completed once its fd is ready */
+struct uring_poll {
+    struct uring_poll *next;
+    uint64_t user_data;
+    int32_t fd;
+    uint32_t events;
+};
+
+struct uring_ctx {
+    struct process_files *files;    /* Table the fds in SQEs refer to, pinned */
+    struct process_mm *mm;          /* Submitter's address space, held (NULL: kernel) */
+    uint32_t flags;
+    void *region_alloc;
+    void *region;                   /* Page aligned, shared with userspace */
+    uint32_t region_size;
+    struct process_mm *map_mm;      /* Where the region is mapped, held */
+    uint64_t map_addr;
+    uint64_t map_len;
+    struct uring_ring *sq;
+    struct uring_ring *cq;
+    uint32_t *sq_array;
+    struct uring_sqe *sqes;
+    struct uring_cqe *cqes;
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    bool uaccess_kernel;            /* Set up in-kernel: SQE buffers may be kernel memory */
+    struct mutex uring_lock;        /* Consuming SQEs and posting CQEs */
+    struct uring_poll *polls;
+    struct wait_queue_head cq_wait;
+    struct kthread *sq_thread;
+    struct wait_queue_head sq_wait;
+    uint64_t sq_thread_idle;        /* TSC cycles */
+    uint64_t submitted;
+    uint64_t completed;
+};
+
+static const struct file_operations uring_fops;
+
+static inline uint32_t uring_sq_ready(struct uring_ctx *ctx) {
+    return __atomic_load_n(&ctx->sq->tail, __ATOMIC_ACQUIRE) - ctx->sq->head;
+}
+
+static inline uint32_t uring_cq_ready(struct uring_ctx *ctx) {
+    return ctx->cq->tail - __atomic_load_n(&ctx->cq->head, __ATOMIC_ACQUIRE);
+}
+
+/* Free CQ slots; a bogus head from userspace reads as a full ring */
+static inline uint32_t uring_cq_space(struct uring_ctx *ctx) {
+    uint32_t used = uring_cq_ready(ctx);
+    return used < ctx->cq_entries ? ctx->cq_entries - used : 0;
+}
+
+/* Post a completion (uring_lock held, uring_cq_space() checked) */
+static void uring_cqe_post(struct uring_ctx *ctx, uint64_t user_data, int32_t res) {
+    uint32_t tail = ctx->cq->tail;
+    struct uring_cqe *cqe = &ctx->cqes[tail & (ctx->cq_entries - 1)];
+    cqe->user_data = user_data;
+    cqe->res = res;
+    cqe->flags = 0;
+    __atomic_store_n(&ctx->cq->tail, tail + 1, __ATOMIC_RELEASE);
+    ctx->completed++;
+}
+
+static bool uring_is_ring(struct process_files *files, int32_t fd) {
+    struct file_descriptor *file = fd_get(files, (uint32_t)fd);
+    bool ring = file && file->f_op == &uring_fops;
+    if (file) {
+        file_put(file);
+    }
+    return ring;
+}
+
+/* Carry out a request synchronously; returns the CQE result */
+static int32_t uring_issue(struct uring_ctx *ctx, const struct uring_sqe *sqe) {
+    switch (sqe->opcode) {
+    case URING_OP_NOP:
+        return 0;
+    case URING_OP_READ:
+        return ksys_read_user(ctx->files, sqe->fd, (void *)sqe->addr, sqe->len, sqe->off);
+    case URING_OP_WRITE:
+        return ksys_write_user(ctx->files, sqe->fd, (const void *)sqe->addr, sqe->len, sqe->off);
+    case URING_OP_OPEN:
+        return ksys_open_user(ctx->files, (const char *)sqe->addr, sqe->op_flags, sqe->mode);
+    case URING_OP_CLOSE:
+        /* The ring's own fd would be released from under us */
+        if (uring_is_ring(ctx->files, sqe->fd)) {
+            return -9; /* EBADF */
+        }
+        return ksys_close(ctx->files, sqe->fd);
+    case URING_OP_FSYNC:
+        return ksys_fsync(ctx->files, sqe->fd);
+    default:
+        return -22; /* EINVAL */
+    }
+}
+
+/* Complete 'poll' if its fd is ready or gone (uring_lock held); false if it stays armed */
+static bool uring_poll_check(struct uring_ctx *ctx, struct uring_poll *poll) {
+    if (!uring_cq_space(ctx)) {
+        return false;
+    }
+    
+    int32_t res = -9; /* EBADF */
+    struct file_descriptor *file = fd_get(ctx->files, (uint32_t)poll->fd);
+    if (file) {
+        res = file_poll(file) & (poll->events | POLLERR | POLLHUP);
+        file_put(file);
+        if (!res) {
+            return false;
+        }
+    }
+    uring_cqe_post(ctx, poll->user_data, res);
+    return true;
+}
+
+static void uring_poll_arm(struct uring_ctx *ctx, const struct uring_sqe *sqe) {
+    struct uring_poll *poll = kmalloc(sizeof(struct uring_poll));
+    if (!poll) {
+        uring_cqe_post(ctx, sqe->user_data, -12); /* ENOMEM */
+        return;
+    }
+    
+    poll->user_data = sqe->user_data;
+    poll->fd = sqe->fd;
+    poll->events = sqe->op_flags;
+    if (uring_poll_check(ctx, poll)) {
+        kfree(poll);
+        return;
+    }
+    poll->next = ctx->polls;
+    ctx->polls = poll;
+}
+
+/* Re-check armed polls (uring_lock held); returns how many completed */
+static uint32_t uring_poll_service(struct uring_ctx *ctx) {
+    uint32_t done = 0;
+    struct uring_poll **link = &ctx->polls;
+    
+    while (*link) {
+        struct uring_poll *poll = *link;
+        if (uring_poll_check(ctx, poll)) {
+            *link = poll->next;
+            kfree(poll);
+            done++;
+        } else {
+            link = &poll->next;
+        }
+    }
+    return done;
+}
+
+/*
+ * Consume up to 'nr' SQEs (uring_lock held), stopping while the CQ is
+ * full so no completion is ever dropped. Returns how many were consumed.
+ */
+static uint32_t uring_submit(struct uring_ctx *ctx, uint32_t nr) {
+    uint32_t head = ctx->sq->head;
+    uint32_t tail = __atomic_load_n(&ctx->sq->tail, __ATOMIC_ACQUIRE);
+    uint32_t submitted = 0;
+    
+    while (submitted < nr && head != tail && uring_cq_space(ctx)) {
+        uint32_t index = ctx->sq_array[head & (ctx->sq_entries - 1)];
+        head++;
+        submitted++;
+        if (index >= ctx->sq_entries) {
+            ctx->sq->dropped++;
+            continue;
+        }
+        
+        /* Userspace may reuse the entry once head passes it: work on a copy */
+        struct uring_sqe sqe = ctx->sqes[index];
+        __atomic_store_n(&ctx->sq->head, head, __ATOMIC_RELEASE);
+        
+        if (sqe.opcode == URING_OP_POLL) {
+            uring_poll_arm(ctx, &sqe);
+        } else {
+            uring_cqe_post(ctx, sqe.user_data, uring_issue(ctx, &sqe));
+        }
+    }
+    __atomic_store_n(&ctx->sq->head, head, __ATOMIC_RELEASE);
+    ctx->submitted += submitted;
+    return submitted;
+}
+
+/* Borrow the page tables of 'mm' for the current task; returns what to restore */
+static uint64_t uring_use_mm(struct process_mm *mm) {
+    return sched_set_cr3((uint64_t)mm->page_directory);
+}
+
+/* Kernel threads go back to the kernel page tables, never a borrowed set */
+static void uring_unuse_mm(uint64_t old) {
+    sched_set_cr3(old ? old : (uint64_t)get_page_directory());
+}
+
+/*
+ * SQ polling thread: picks up SQEs as they are queued, so a busy process
+ * submits without system calls. After sq_thread_idle without work it
+ * sets URING_SQ_NEED_WAKEUP and sleeps until uring_enter() wakes it.
+ * User buffers in SQEs resolve in the submitter's address space, which
+ * the thread runs on.
+ */
+static int uring_sq_thread(void *data) {
+    struct uring_ctx *ctx = data;
+    uint64_t last_work = get_ticks();
+    sched_set_uaccess_kernel(ctx->uaccess_kernel);
+    uint64_t old_cr3 = ctx->mm ? uring_use_mm(ctx->mm) : 0;
+    
+    while (!kthread_should_stop()) {
+        mutex_lock(&ctx->uring_lock);
+        uint32_t done = uring_submit(ctx, URING_MAX_ENTRIES);
+        done += uring_poll_service(ctx);
+        mutex_unlock(&ctx->uring_lock);
+        
+        if (done) {
+            if (waitqueue_active(&ctx->cq_wait)) {
+                wake_up_all(&ctx->cq_wait);
+            }
+            last_work = get_ticks();
+            cond_resched();
+            continue;
+        }
+        
+        if (get_ticks() - last_work < ctx->sq_thread_idle) {
+            cpu_relax();
+            cond_resched();
+            continue;
+        }
+        
+        /* Armed polls have no wakeup source: keep checking, but slowly */
+        if (ctx->polls) {
+            schedule_timeout(1);
+            continue;
+        }
+        
+        /* Ask for a wakeup, then look once more so a racing submission is not missed */
+        __atomic_or_fetch(&ctx->sq->flags, URING_SQ_NEED_WAKEUP, __ATOMIC_SEQ_CST);
+        wait_event(&ctx->sq_wait, kthread_should_stop() || uring_sq_ready(ctx));
+        __atomic_and_fetch(&ctx->sq->flags, ~URING_SQ_NEED_WAKEUP, __ATOMIC_SEQ_CST);
+        last_work = get_ticks();
+    }
+    
+    if (ctx->mm) {
+        uring_unuse_mm(old_cr3);
+    }
+    return 0;
+}
+
+/* Wait until at least min_complete CQEs are ready, or nothing more can complete */
+static void uring_wait_cqes(struct uring_ctx *ctx, uint32_t min_complete) {
+    if (min_complete > ctx->cq_entries) {
+        min_complete = ctx->cq_entries;
+    }
+    
+    if (ctx->flags & URING_SETUP_SQPOLL) {
+        wait_event(&ctx->cq_wait, uring_cq_ready(ctx) >= min_complete);
+        return;
+    }
+    
+    for (;;) {
+        mutex_lock(&ctx->uring_lock);
+        uint32_t done = uring_poll_service(ctx);
+        bool armed = ctx->polls != NULL;
+        mutex_unlock(&ctx->uring_lock);
+        
+        /* The ring's fd may be watched by epoll */
+        if (done && waitqueue_active(&ctx->cq_wait)) {
+            wake_up_all(&ctx->cq_wait);
+        }
+        
+        /* Everything else completes inline, during submission */
+        if (uring_cq_ready(ctx) >= min_complete || !armed) {
+            return;
+        }
+        schedule_timeout(1);
+    }
+}
+
+static uint32_t uring_file_poll(struct file_descriptor *file) {
+    struct uring_ctx *ctx = file->private_data;
+    return uring_cq_ready(ctx) ? POLLIN : 0;
+}
+
+/*
+ * Map the rings and SQE array into the caller's user half at 'addr'.
+ * The region is mapped once; release unmaps it before freeing it.
+ */
+static long uring_mmap(struct file_descriptor *file, uint64_t addr, uint64_t length) {
+    struct uring_ctx *ctx = file->private_data;
+    struct process *proc = process_get_current();
+    if ((addr & (PAGE_SIZE - 1)) || length == 0 || length > ctx->region_size ||
+        addr + length > USER_ADDR_MAX || addr + length < addr) {
+        return -22; /* EINVAL */
+    }
+    if (!proc || !proc->mm) {
+        return -19; /* ENODEV: no user address space */
+    }
+    
+    mutex_lock(&ctx->uring_lock);
+    if (ctx->map_mm) {
+        mutex_unlock(&ctx->uring_lock);
+        return -16; /* EBUSY */
+    }
+    for (uint64_t off = 0; off < length; off += PAGE_SIZE) {
+        map_page(addr + off, (uint64_t)ctx->region + off, 0x07); /* Present, writable, user */
+    }
+    ctx->map_mm = proc->mm;
+    ctx->map_addr = addr;
+    ctx->map_len = length;
+    process_mm_get(ctx->map_mm);
+    mutex_unlock(&ctx->uring_lock);
+    return addr;
+}
+
+/* Take the region out of the address space it was mapped into */
+static void uring_unmap_region(struct uring_ctx *ctx) {
+    uint64_t old_cr3 = uring_use_mm(ctx->map_mm);
+    for (uint64_t off = 0; off < ctx->map_len; off += PAGE_SIZE) {
+        unmap_page(ctx->map_addr + off);
+    }
+    uring_unuse_mm(old_cr3);
+    process_mm_drop(ctx->map_mm);
+}
+
+static void uring_release(struct file_descriptor *file) {
+    struct uring_ctx *ctx = file->private_data;
+    
+    if (ctx->sq_thread) {
+        kthread_stop(ctx->sq_thread);
+    }
+    while (ctx->polls) {
+        struct uring_poll *poll = ctx->polls;
+        ctx->polls = poll->next;
+        kfree(poll);
+    }
+    if (ctx->map_mm) {
+        uring_unmap_region(ctx);
+    }
+    if (ctx->mm) {
+        process_mm_drop(ctx->mm);
+    }
+    process_files_unpin(ctx->files);
+    kfree(ctx->region_alloc);
+    kfree(ctx);
+}
+
+static struct wait_queue_head *uring_file_poll_queue(struct file_descriptor *file) {
+    struct uring_ctx *ctx = file->private_data;
+    return &ctx->cq_wait;
+}
+
+static const struct file_operations uring_fops = {
+    .poll = uring_file_poll,
+    .poll_queue = uring_file_poll_queue,
+    .mmap = uring_mmap,
+    .release = uring_release,
+};
+
+/* Carve the shared region into rings and SQE array, filling in the offsets */
+static int uring_alloc_region(struct uring_ctx *ctx, struct uring_params *p) {
+    uint32_t sq_array = 2 * sizeof(struct uring_ring);
+    uint32_t cqes = (sq_array + ctx->sq_entries * sizeof(uint32_t) + 63) & ~63U;
+    uint32_t sqes = (cqes + ctx->cq_entries * sizeof(struct uring_cqe) + 63) & ~63U;
+    uint32_t size = (sqes + ctx->sq_entries * sizeof(struct uring_sqe) + PAGE_SIZE - 1) &
+                    ~(PAGE_SIZE - 1);
+    
+    ctx->region_alloc = kmalloc(size + PAGE_SIZE);
+    if (!ctx->region_alloc) {
+        return -12; /* ENOMEM */
+    }
+    ctx->region = (void *)(((uint64_t)ctx->region_alloc + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+    ctx->region_size = size;
+    memset(ctx->region, 0, size);
+    
+    ctx->sq = (struct uring_ring *)ctx->region;
+    ctx->cq = ctx->sq + 1;
+    ctx->sq_array = (uint32_t *)((char *)ctx->region + sq_array);
+    ctx->cqes = (struct uring_cqe *)((char *)ctx->region + cqes);
+    ctx->sqes = (struct uring_sqe *)((char *)ctx->region + sqes);
+    ctx->sq->ring_mask = ctx->sq_entries - 1;
+    ctx->sq->ring_entries = ctx->sq_entries;
+    ctx->cq->ring_mask = ctx->cq_entries - 1;
+    ctx->cq->ring_entries = ctx->cq_entries;
+    
+    p->ring_size = size;
+    p->sq_off.head = offsetof(struct uring_ring, head);
+    p->sq_off.tail = offsetof(struct uring_ring, tail);
+    p->sq_off.ring_mask = offsetof(struct uring_ring, ring_mask);
+    p->sq_off.ring_entries = offsetof(struct uring_ring, ring_entries);
+    p->sq_off.flags = offsetof(struct uring_ring, flags);
+    p->sq_off.dropped = offsetof(struct uring_ring, dropped);
+    p->sq_off.array = sq_array;
+    p->sq_off.sqes = sqes;
+    p->cq_off.head = sizeof(struct uring_ring) + offsetof(struct uring_ring, head);
+    p->cq_off.tail = sizeof(struct uring_ring) + offsetof(struct uring_ring, tail);
+    p->cq_off.ring_mask = sizeof(struct uring_ring) + offsetof(struct uring_ring, ring_mask);
+    p->cq_off.ring_entries = sizeof(struct uring_ring) + offsetof(struct uring_ring, ring_entries);
+    p->cq_off.cqes = cqes;
+    return 0;
+}
+
+/*
+ * Create a ring of at least 'entries' SQEs (1..URING_MAX_ENTRIES) on the
+ * lowest free fd of 'files'. SQEs name fds in that same table.
+ */
+long uring_setup(struct process_files *files, uint32_t entries, struct uring_params *uparams) {
+    struct uring_params p = *uparams;
+    if (p.flags & ~(URING_SETUP_SQPOLL | URING_SETUP_SQ_AFF)) {
+        return -22; /* EINVAL */
+    }
+    if ((p.flags & URING_SETUP_SQ_AFF) &&
+        (!(p.flags & URING_SETUP_SQPOLL) || p.sq_thread_cpu >= smp_num_cpus())) {
+        return -22; /* EINVAL */
+    }
+    
+    struct uring_ctx *ctx = kmalloc(sizeof(struct uring_ctx));
+    if (!ctx) {
+        return -12; /* ENOMEM */
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->flags = p.flags;
+    ctx->sq_entries = 1;
+    while (ctx->sq_entries < entries) {
+        ctx->sq_entries *= 2;
+    }
+    ctx->cq_entries = 2 * ctx->sq_entries;
+    ctx->uaccess_kernel = sched_uaccess_kernel();
+    mutex_init(&ctx->uring_lock);
+    init_waitqueue_head(&ctx->cq_wait);
+    init_waitqueue_head(&ctx->sq_wait);
+    
+    int err = uring_alloc_region(ctx, &p);
+    struct file_descriptor *file = err ? NULL : file_alloc(NULL, 0x02, 0); /* O_RDWR */
+    if (!file) {
+        kfree(ctx->region_alloc);
+        kfree(ctx);
+        return err ? err : -12; /* ENOMEM */
+    }
+    file->f_op = &uring_fops;
+    file->private_data = ctx;
+    
+    /* Hold the table and the address space the ring works on while it lives */
+    struct process *proc = process_get_current();
+    ctx->files = files;
+    files_pin(files);
+    if (proc && proc->mm) {
+        ctx->mm = proc->mm;
+        process_mm_get(ctx->mm);
+    }
+    
+    if (p.flags & URING_SETUP_SQPOLL) {
+        ctx->sq_thread_idle = tsc_ns_to_cycles((p.sq_thread_idle ? p.sq_thread_idle : 1) *
+                                               NSEC_PER_MSEC);
+        ctx->sq_thread = (p.flags & URING_SETUP_SQ_AFF) ?
+            kthread_create_on_cpu(uring_sq_thread, ctx, p.sq_thread_cpu, "uring-sq") :
+            kthread_create(uring_sq_thread, ctx, "uring-sq");
+        if (!ctx->sq_thread) {
+            file_put(file);
+            return -11; /* EAGAIN */
+        }
+    }
+    
+    int fd = fd_alloc(files, 0);
+    if (fd < 0) {
+        file_put(file);
+        return fd;
+    }
+    
+    p.sq_entries = ctx->sq_entries;
+    p.cq_entries = ctx->cq_entries;
+    *uparams = p;
+    fd_install(files, fd, file);
+    return fd;
+}
+
+/*
+ * Submit up to to_submit queued SQEs (the SQ thread does that itself
+ * with SQPOLL) and, with URING_ENTER_GETEVENTS, wait for min_complete
+ * CQEs. Returns the number of SQEs consumed.
+ */
+long uring_enter(struct process_files *files, uint32_t fd, uint32_t to_submit,
+                 uint32_t min_complete, uint32_t flags) {
+    struct file_descriptor *file = fd_get(files, fd);
+    if (!file || file->f_op != &uring_fops) {
+        if (file) {
+            file_put(file);
+        }
+        return -9; /* EBADF */
+    }
+    struct uring_ctx *ctx = file->private_data;
+    
+    long ret = 0;
+    if (ctx->flags & URING_SETUP_SQPOLL) {
+        if (flags & URING_ENTER_SQ_WAKEUP) {
+            wake_up_all(&ctx->sq_wait);
+        }
+        ret = to_submit;
+    } else if (to_submit) {
+        mutex_lock(&ctx->uring_lock);
+        ret = uring_submit(ctx, to_submit);
+        mutex_unlock(&ctx->uring_lock);
+        if (waitqueue_active(&ctx->cq_wait)) {
+            wake_up_all(&ctx->cq_wait);
+        }
+    }
+    
+    if (flags & URING_ENTER_GETEVENTS) {
+        uring_wait_cqes(ctx, min_complete);
+    }
+    
+    file_put(file);
+    return ret;
+}
+
+/* In-memory file for the benchmark */
+static long uring_null_read(struct file_descriptor *file, void *buf, size_t count) {
+    (void)file;
+    memset(buf, 0, count);
+    return count;
+}
+
+static const struct file_operations uring_null_fops = {
+    .read = uring_null_read,
+};
+
+/* Push nr_ops reads of 'fd' through a fresh ring; returns the TSC cycles taken */
+static uint64_t uring_bench_ring(struct process_files *files, int fd, void *buf, uint32_t len,
+                                 uint32_t nr_ops, uint32_t flags) {
+    struct uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = flags;
+    params.sq_thread_idle = 10;
+    
+    long ring_fd = uring_setup(files, URING_BENCH_BATCH, &params);
+    if (ring_fd < 0) {
+        return 0;
+    }
+    struct file_descriptor *ring = fd_get(files, ring_fd);
+    struct uring_ctx *ctx = ring->private_data;
+    
+    /* With one CPU the SQ thread only runs while we sleep in uring_enter() */
+    bool spin = (flags & URING_SETUP_SQPOLL) && smp_num_cpus() > 1;
+    
+    uint64_t start = get_ticks();
+    for (uint32_t done = 0; done < nr_ops;) {
+        uint32_t batch = nr_ops - done < URING_BENCH_BATCH ? nr_ops - done : URING_BENCH_BATCH;
+        uint32_t tail = ctx->sq->tail;
+        for (uint32_t i = 0; i < batch; i++) {
+            uint32_t index = (tail + i) & (ctx->sq_entries - 1);
+            struct uring_sqe *sqe = &ctx->sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = URING_OP_READ;
+            sqe->fd = fd;
+            sqe->off = -1;
+            sqe->addr = (uint64_t)buf;
+            sqe->len = len;
+            sqe->user_data = done + i;
+            ctx->sq_array[index] = index;
+        }
+        __atomic_store_n(&ctx->sq->tail, tail + batch, __ATOMIC_RELEASE);
+        
+        if (!(flags & URING_SETUP_SQPOLL)) {
+            syscall_handler(SYS_URING_ENTER, ring_fd, batch, batch, URING_ENTER_GETEVENTS, 0);
+        } else if (spin) {
+            if (ctx->sq->flags & URING_SQ_NEED_WAKEUP) {
+                syscall_handler(SYS_URING_ENTER, ring_fd, 0, 0, URING_ENTER_SQ_WAKEUP, 0);
+            }
+            while (uring_cq_ready(ctx) < batch) {
+                cpu_relax();
+            }
+        } else {
+            syscall_handler(SYS_URING_ENTER, ring_fd, 0, batch,
+                            URING_ENTER_GETEVENTS | URING_ENTER_SQ_WAKEUP, 0);
+        }
+        
+        /* Reap */
+        done += uring_cq_ready(ctx);
+        __atomic_store_n(&ctx->cq->head, ctx->cq->tail, __ATOMIC_RELEASE);
+    }
+    uint64_t cycles = get_ticks() - start;
+    
+    file_put(ring);
+    ksys_close(files, ring_fd);
+    return cycles;
+}
+
+static uint64_t uring_ops_per_sec(uint32_t nr_ops, uint64_t cycles) {
+    return cycles ? (uint64_t)nr_ops * tsc_khz() * 1000 / cycles : 0;
+}
+
+/*
+ * Throughput benchmark: nr_ops 512-byte reads of an in-memory file, as
+ * one read() each, through a ring with URING_BENCH_BATCH SQEs per
+ * uring_enter(), and through an SQPOLL ring. All system calls go through
+ * syscall_handler(), so the SYSCALL instruction itself (measured by
+ * syscall_benchmark_entry()) is left out of every figure.
+ */
+void uring_benchmark(uint32_t nr_ops) {
+    static uint8_t buf[512];
+    debug_print("=== URING BENCHMARK (%u reads of %u bytes) ===\n", nr_ops, (uint32_t)sizeof(buf));
+    
+    struct process_files *files = current_files();
+    struct file_descriptor *file = file_alloc(NULL, 0, 0);
+    if (!file || !nr_ops) {
+        debug_print("uring benchmark: out of memory\n");
+        return;
+    }
+    file->f_op = &uring_null_fops;
+    int fd = fd_alloc(files, 3);
+    if (fd < 0) {
+        file_put(file);
+        debug_print("uring benchmark: no free fd\n");
+        return;
+    }
+    fd_install(files, fd, file);
+    
+    /* The read buffer is kernel memory, including for the SQPOLL thread */
+    bool was_kernel = sched_set_uaccess_kernel(true);
+    
+    uint64_t start = get_ticks();
+    for (uint32_t i = 0; i < nr_ops; i++) {
+        syscall_handler(SYS_READ, fd, (uint64_t)buf, sizeof(buf), 0, 0);
+    }
+    uint64_t sync_cycles = get_ticks() - start;
+    
+    uint64_t ring_cycles = uring_bench_ring(files, fd, buf, sizeof(buf), nr_ops, 0);
+    uint64_t sqpoll_cycles = uring_bench_ring(files, fd, buf, sizeof(buf), nr_ops,
+                                              URING_SETUP_SQPOLL);
+    sched_set_uaccess_kernel(was_kernel);
+    ksys_close(files, fd);
+    
+    debug_print("read():      %lu ops/s\n", uring_ops_per_sec(nr_ops, sync_cycles));
+    debug_print("ring:        %lu ops/s (%u per uring_enter)\n",
+                uring_ops_per_sec(nr_ops, ring_cycles), URING_BENCH_BATCH);
+    debug_print("SQPOLL ring: %lu ops/s\n", uring_ops_per_sec(nr_ops, sqpoll_cycles));
+}
\ No newline at end of file
@@ -4,6 +4,9 @@
  */
 
 #include "../include/system.h"
+#include "../include/spinlock.h"
+#include "../include/rcu.h"
+#include "../include/avc.h"
 #include <string.h>
 
 /* VFS constants */
@@ -109,12 +112,12 @@ static struct mount_point *mount_points = NULL;
 static struct super_block *root_sb = NULL;
 static struct inode_cache_entry *inode_cache[INODE_CACHE_SIZE];
 static uint32_t next_inode_num = 1;
-static volatile int vfs_lock = 0;
+static spinlock_t vfs_lock;    /* Mount list and registry writers; readers use RCU */
 
 /* Forward declarations */
 static struct inode *inode_cache_get(struct super_block *sb, uint32_t inode_num);
 static void inode_cache_put(struct inode *inode);
-static struct mount_point *find_mount_point(const char *path);
+static struct super_block *find_mount_sb(const char *path);
 static int resolve_path(const char *path, struct inode **parent, char *name);
 static int check_path_security(const char *path, uint32_t operation);
 
@@ -146,13 +149,16 @@ int vfs_register_filesystem(struct filesystem_ops *fs_ops) {
     }
     
     /* Find free slot */
+    spin_lock(&vfs_lock);
     for (int i = 0; i < MAX_FILESYSTEMS; i++) {
         if (registered_filesystems[i] == NULL) {
-            registered_filesystems[i] = fs_ops;
+            rcu_assign_pointer(registered_filesystems[i], fs_ops);
+            spin_unlock(&vfs_lock);
             debug_print("Registered filesystem: %s\n", fs_ops->name);
             return 0;
         }
     }
+    spin_unlock(&vfs_lock);
     
     return -1; /* No free slots */
 }
@@ -165,12 +171,12 @@ int vfs_mount(const char *device, const char *mountpoint, const char *fstype, ui
     
     debug_print("Mounting %s on %s (type: %s)\n", device, mountpoint, fstype);
     
-    /* Find filesystem */
+    /* Find filesystem; registrations are never removed, so no read section is needed */
     struct filesystem_ops *fs_ops = NULL;
     for (int i = 0; i < MAX_FILESYSTEMS; i++) {
-        if (registered_filesystems[i] && 
-            strcmp(registered_filesystems[i]->name, fstype) == 0) {
-            fs_ops = registered_filesystems[i];
+        struct filesystem_ops *ops = rcu_dereference(registered_filesystems[i]);
+        if (ops && strcmp(ops->name, fstype) == 0) {
+            fs_ops = ops;
             break;
         }
     }
@@ -195,7 +201,7 @@ int vfs_mount(const char *device, const char *mountpoint, const char *fstype, ui
     strncpy(mp->path, mountpoint, sizeof(mp->path) - 1);
     mp->path[sizeof(mp->path) - 1] = '\0';
     mp->flags = flags;
-    mp->security_level = current_process ? current_process->security_level : 0;
+    mp->security_level = current_process ? current_process->cred->security_level : 0;
     
     /* Mount filesystem */
     if (fs_ops->mount && fs_ops->mount(device, mountpoint, flags) != 0) {
@@ -211,8 +217,9 @@ int vfs_mount(const char *device, const char *mountpoint, const char *fstype, ui
     }
     
     /* Add to mount list */
-    mp->next = mount_points;
-    mount_points = mp;
+    spin_lock(&vfs_lock);
+    rcu_list_add(mount_points, mp, next);
+    spin_unlock(&vfs_lock);
     
     /* Set as root if mounting at / */
     if (strcmp(mountpoint, "/") == 0) {
@@ -234,18 +241,17 @@ int vfs_unmount(const char *mountpoint) {
     debug_print("Unmounting %s\n", mountpoint);
     
     /* Find mount point */
-    struct mount_point *mp = mount_points;
-    struct mount_point *prev = NULL;
-    
-    while (mp) {
+    rcu_read_lock();
+    struct mount_point *mp;
+    rcu_list_for_each(mp, mount_points, next) {
         if (strcmp(mp->path, mountpoint) == 0) {
             break;
         }
-        prev = mp;
-        mp = mp->next;
     }
+    struct super_block *sb = mp ? mp->sb : NULL;
+    rcu_read_unlock();
     
-    if (!mp) {
+    if (!sb) {
         return -1; /* Mount point not found */
     }
     
@@ -256,22 +262,33 @@ int vfs_unmount(const char *mountpoint) {
     }
     
     /* Unmount filesystem */
-    if (mp->sb->ops->unmount && mp->sb->ops->unmount(mountpoint) != 0) {
+    if (sb->ops->unmount && sb->ops->unmount(mountpoint) != 0) {
         return -1;
     }
     
     /* Remove from mount list */
-    if (prev) {
-        prev->next = mp->next;
-    } else {
-        mount_points = mp->next;
+    spin_lock(&vfs_lock);
+    struct mount_point **link = &mount_points;
+    while (*link && *link != mp) {
+        link = &(*link)->next;
+    }
+    bool unlinked = *link != NULL;
+    if (unlinked) {
+        rcu_list_del(link, mp, next);
+    }
+    spin_unlock(&vfs_lock);
+    
+    if (!unlinked) {
+        return -1; /* Unmounted concurrently */
     }
     
     /* Clear root if unmounting / */
-    if (mp->sb == root_sb) {
+    if (sb == root_sb) {
         root_sb = NULL;
     }
     
+    /* Lookups may still be walking past it */
+    synchronize_rcu();
     kfree(mp);
     
     security_audit_log("FILESYSTEM_UNMOUNTED", 0, mountpoint);
@@ -295,8 +312,8 @@ struct file *vfs_open(const char *path, uint32_t flags, uint32_t mode) {
     }
     
     /* Find mount point */
-    struct mount_point *mp = find_mount_point(path);
-    if (!mp) {
+    struct super_block *sb = find_mount_sb(path);
+    if (!sb) {
         debug_print("No mount point for path: %s\n", path);
         return NULL;
     }
@@ -322,14 +339,14 @@ struct file *vfs_open(const char *path, uint32_t flags, uint32_t mode) {
     /* Initialize inode */
     inode->inode_num = next_inode_num++;
     inode->mode = mode;
-    inode->uid = current_process ? current_process->uid : 0;
-    inode->gid = current_process ? current_process->gid : 0;
+    inode->uid = current_process ? current_process->cred->uid : 0;
+    inode->gid = current_process ? current_process->cred->gid : 0;
     inode->size = 0;
     inode->blocks = 0;
     inode->atime = inode->mtime = inode->ctime = get_timestamp();
     inode->links_count = 1;
     inode->flags = 0;
-    inode->security_level = current_process ? current_process->security_level : 0;
+    inode->security_level = current_process ? current_process->cred->security_level : 0;
     
     /* Create file structure */
     struct file *file = (struct file *)kmalloc(sizeof(struct file));
@@ -343,11 +360,11 @@ struct file *vfs_open(const char *path, uint32_t flags, uint32_t mode) {
     file->flags = flags;
     file->mode = mode;
     file->ref_count = 1;
-    file->sb = mp->sb;
+    file->sb = sb;
     file->private_data = NULL;
     
     /* Call filesystem open operation */
-    if (mp->sb->ops->open && mp->sb->ops->open(inode, file) != 0) {
+    if (sb->ops->open && sb->ops->open(inode, file) != 0) {
         kfree(file);
         kfree(inode);
         return NULL;
@@ -437,8 +454,8 @@ int vfs_mkdir(const char *path, uint32_t mode) {
     }
     
     /* Find mount point */
-    struct mount_point *mp = find_mount_point(path);
-    if (!mp) {
+    struct super_block *sb = find_mount_sb(path);
+    if (!sb) {
         return -1;
     }
     
@@ -451,8 +468,8 @@ int vfs_mkdir(const char *path, uint32_t mode) {
     }
     
     /* Call filesystem mkdir operation */
-    if (mp->sb->ops->mkdir) {
-        int result = mp->sb->ops->mkdir(parent_inode, dirname, mode);
+    if (sb->ops->mkdir) {
+        int result = sb->ops->mkdir(parent_inode, dirname, mode);
         if (result == 0) {
             security_audit_log("DIRECTORY_CREATED", 0, path);
         }
@@ -477,8 +494,8 @@ int vfs_rmdir(const char *path) {
     }
     
     /* Find mount point */
-    struct mount_point *mp = find_mount_point(path);
-    if (!mp) {
+    struct super_block *sb = find_mount_sb(path);
+    if (!sb) {
         return -1;
     }
     
@@ -491,8 +508,8 @@ int vfs_rmdir(const char *path) {
     }
     
     /* Call filesystem rmdir operation */
-    if (mp->sb->ops->rmdir) {
-        int result = mp->sb->ops->rmdir(parent_inode, dirname);
+    if (sb->ops->rmdir) {
+        int result = sb->ops->rmdir(parent_inode, dirname);
         if (result == 0) {
             security_audit_log("DIRECTORY_REMOVED", 0, path);
         }
@@ -502,22 +519,34 @@ int vfs_rmdir(const char *path) {
     return -1; /* Not supported */
 }
 
-/* Find mount point for a path */
-static struct mount_point *find_mount_point(const char *path) {
+/*
+ * Super block of the mount covering a path. The mount list is walked
+ * under RCU; the super block belongs to the file system and outlives the
+ * mount point structure, so it is safe to use after the read section.
+ */
+static struct super_block *find_mount_sb(const char *path) {
     struct mount_point *best_match = NULL;
     size_t best_match_len = 0;
+    struct super_block *sb = NULL;
     
-    struct mount_point *mp = mount_points;
-    while (mp) {
+    rcu_read_lock();
+    struct mount_point *mp;
+    rcu_list_for_each(mp, mount_points, next) {
         size_t mp_len = strlen(mp->path);
         if (strncmp(path, mp->path, mp_len) == 0 && mp_len > best_match_len) {
             best_match = mp;
             best_match_len = mp_len;
         }
-        mp = mp->next;
     }
+    if (!best_match && root_sb) {
+        best_match = rcu_dereference(mount_points);
+    }
+    if (best_match) {
+        sb = best_match->sb;
+    }
+    rcu_read_unlock();
     
-    return best_match ? best_match : (root_sb ? mount_points : NULL);
+    return sb;
 }
 
 /* Resolve path to parent inode and filename */
@@ -556,14 +585,12 @@ static int resolve_path(const char *path, struct inode **parent, char *name) {
     return 0;
 }
 
-/* Check path security */
-static int check_path_security(const char *path, uint32_t operation) {
-    if (!current_process) {
-        return 0; /* Kernel operations allowed */
-    }
+/* Path policy, evaluated on an access vector cache miss */
+static int path_policy_compute(const struct avc_key *key, const void *data) {
+    const char *path = data;
     
     /* Pentagon-level path security checks */
-    if (current_process->security_level < 2) {
+    if (key->slevel < 2) {
         /* Restricted access for low clearance */
         if (strstr(path, "/classified/") || 
             strstr(path, "/secret/") ||
@@ -573,8 +600,8 @@ static int check_path_security(const char *path, uint32_t operation) {
     }
     
     /* Additional security checks based on operation */
-    if (operation & 0x02) { /* Write access */
-        if (strstr(path, "/system/") && current_process->uid != 0) {
+    if (key->op & 0x02) { /* Write access */
+        if (strstr(path, "/system/") && key->suid != 0) {
             return -1; /* Only root can write to system */
         }
     }
@@ -582,25 +609,44 @@ static int check_path_security(const char *path, uint32_t operation) {
     return 0; /* Access allowed */
 }
 
+/* Check path security */
+static int check_path_security(const char *path, uint32_t operation) {
+    if (!current_process) {
+        return 0; /* Kernel operations allowed */
+    }
+    
+    /* One pass to hash the path instead of a scan per restricted prefix */
+    struct avc_key key = {
+        .ssid = current_process->cred->security_sid,
+        .object = avc_path_hash(path),
+        .name = path,
+        .suid = current_process->cred->uid,
+        .op = operation,
+        .tclass = AVC_CLASS_PATH,
+        .slevel = current_process->cred->security_level,
+    };
+    return avc_has_perm(&key, path_policy_compute, path);
+}
+
 /* Get file system statistics */
 int vfs_statfs(const char *path, struct statfs *buf) {
     if (!path || !buf) {
         return -1;
     }
     
-    struct mount_point *mp = find_mount_point(path);
-    if (!mp || !mp->sb) {
+    struct super_block *sb = find_mount_sb(path);
+    if (!sb) {
         return -1;
     }
     
     /* Fill statistics */
-    buf->f_type = mp->sb->magic;
-    buf->f_bsize = mp->sb->block_size;
-    buf->f_blocks = mp->sb->total_blocks;
-    buf->f_bfree = mp->sb->free_blocks;
-    buf->f_bavail = mp->sb->free_blocks;
-    buf->f_files = mp->sb->total_inodes;
-    buf->f_ffree = mp->sb->free_inodes;
+    buf->f_type = sb->magic;
+    buf->f_bsize = sb->block_size;
+    buf->f_blocks = sb->total_blocks;
+    buf->f_bfree = sb->free_blocks;
+    buf->f_bavail = sb->free_blocks;
+    buf->f_files = sb->total_inodes;
+    buf->f_ffree = sb->free_inodes;
     
     return 0;
 }
@@ -611,15 +657,16 @@ void vfs_list_mounts(void) {
     debug_print("Device\t\tMount Point\tType\tSecurity Level\n");
     debug_print("------\t\t-----------\t----\t--------------\n");
     
-    struct mount_point *mp = mount_points;
-    while (mp) {
+    rcu_read_lock();
+    struct mount_point *mp;
+    rcu_list_for_each(mp, mount_points, next) {
         debug_print("%s\t\t%s\t\t%d\t%d\n",
                    mp->sb->device_name,
                    mp->path,
                    mp->sb->fs_type,
                    mp->security_level);
-        mp = mp->next;
     }
+    rcu_read_unlock();
     
     debug_print("============================\n\n");
 }
\ No newline at end of file
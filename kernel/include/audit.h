@@ -0,0 +1,106 @@
+#ifndef _AUDIT_H
+#define _AUDIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Syscall audit (kernel/core/audit.c). Each rule names a set of syscalls
+ * and up to AUDIT_MAX_FIELDS conditions on the caller and the outcome.
+ * The rule list compiles into a bitmap of audited syscalls and a short
+ * comparison program for each syscall. The syscall path tests the bit
+ * and runs the program after the call. The first matching rule decides:
+ * AUDIT_ALWAYS writes a fixed-size binary record to a per-CPU ring and
+ * AUDIT_NEVER suppresses the event. Records are only formatted when a
+ * consumer drains the rings.
+ */
+#define AUDIT_NR_SYSCALLS       256
+#define AUDIT_MAX_RULES         64
+#define AUDIT_MAX_FIELDS        4
+#define AUDIT_PATH_MAX          64
+
+/* Rule fields */
+#define AUDIT_UID               1
+#define AUDIT_LEVEL             2       /* Caller's security level */
+#define AUDIT_PATH              3       /* Path argument of open and execve */
+#define AUDIT_RESULT            4       /* Return value */
+
+/* Comparisons; AUDIT_PREFIX is for AUDIT_PATH only */
+#define AUDIT_EQ                1
+#define AUDIT_NE                2
+#define AUDIT_LT                3
+#define AUDIT_LE                4
+#define AUDIT_GT                5
+#define AUDIT_GE                6
+#define AUDIT_PREFIX            7
+
+/* Actions */
+#define AUDIT_NEVER             0
+#define AUDIT_ALWAYS            1
+
+struct audit_field {
+    uint32_t type;
+    uint32_t op;
+    int64_t value;
+    char path[AUDIT_PATH_MAX];  /* For AUDIT_PATH */
+};
+
+struct audit_rule {
+    uint64_t syscalls[AUDIT_NR_SYSCALLS / 64];  /* All clear: every syscall */
+    uint32_t action;
+    uint32_t nr_fields;
+    struct audit_field fields[AUDIT_MAX_FIELDS];
+};
+
+/* An audited syscall, one cache line */
+struct audit_record {
+    uint64_t timestamp;         /* ktime_get_ns() at syscall exit */
+    uint32_t serial;            /* Per CPU */
+    uint16_t cpu;
+    uint16_t syscall;
+    uint32_t pid;
+    uint32_t uid;
+    int64_t result;
+    uint64_t args[3];
+    uint8_t level;
+    uint8_t resv;
+    uint16_t rule;              /* Id of the rule that matched */
+    uint32_t resv2;
+};
+
+/* A completed syscall, as handed to the filter */
+struct audit_event {
+    uint32_t syscall;
+    uint32_t pid;
+    uint32_t uid;
+    uint8_t level;
+    const char *path;           /* NULL unless the syscall takes one */
+    int64_t result;
+    uint64_t args[3];
+};
+
+extern uint64_t audit_syscall_mask[AUDIT_NR_SYSCALLS / 64];
+
+/* Could any rule match 'nr'? Tested on every syscall before building an event */
+static inline bool audit_syscall_audited(uint32_t nr) {
+    return nr < AUDIT_NR_SYSCALLS && ((audit_syscall_mask[nr / 64] >> (nr % 64)) & 1);
+}
+
+static inline void audit_rule_add_syscall(struct audit_rule *rule, uint32_t nr) {
+    rule->syscalls[nr / 64] |= 1ULL << (nr % 64);
+}
+
+void audit_init(void);
+void audit_default_rules(void);
+int audit_add_rule(const struct audit_rule *rule);
+int audit_del_rule(int id);
+void audit_clear_rules(void);
+void audit_syscall_exit(const struct audit_event *event);
+
+/* Consumer side */
+uint32_t audit_read(struct audit_record *records, uint32_t max);
+int audit_format(const struct audit_record *record, char *buf, size_t size);
+void audit_get_stats(uint64_t *recorded, uint64_t *lost);
+
+#endif /* _AUDIT_H */
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef _AVC_H
+#define _AVC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Access vector cache (kernel/core/avc.c). Memoizes security decisions in
+ * a per-CPU hash keyed by subject and object labels and the operation.
+ * Objects named by a string also carry the string, which a hit must
+ * match: hashes collide, decisions must not. Any policy change bumps a
+ * global sequence number, which invalidates every cached decision at
+ * once. Not for use from interrupt handlers.
+ */
+
+/* Object classes */
+#define AVC_CLASS_SYSCALL       1
+#define AVC_CLASS_PATH          2
+
+struct avc_key {
+    uint64_t ssid;              /* Subject context, avc_context_sid() */
+    uint64_t object;            /* Syscall number, avc_path_hash(), ... */
+    uint32_t suid;
+    uint32_t op;
+    uint16_t tclass;
+    uint8_t slevel;             /* Subject clearance */
+    uint8_t olevel;             /* Object classification */
+    const char *name;           /* String 'object' was hashed from, or NULL */
+};
+
+/* Policy decision on a cache miss: 0 to allow, negative to deny */
+typedef int (*avc_compute_t)(const struct avc_key *key, const void *data);
+
+uint64_t avc_context_sid(const char *context);
+uint64_t avc_path_hash(const char *path);
+int avc_has_perm(const struct avc_key *key, avc_compute_t compute, const void *data);
+void avc_policy_changed(void);
+
+void avc_set_enabled(bool enabled);
+bool avc_is_enabled(void);
+void avc_get_stats(uint64_t *hits, uint64_t *misses);
+void avc_report(void);
+
+#endif /* _AVC_H */
\ No newline at end of file
@@ -0,0 +1,164 @@
+#ifndef _CPU_H
+#define _CPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Model-specific registers */
+#define MSR_APIC_BASE           0x1B
+#define MSR_TSC_DEADLINE        0x6E0
+#define MSR_IA32_XSS            0xDA0
+#define MSR_EFER                0xC0000080
+#define MSR_STAR                0xC0000081
+#define MSR_LSTAR               0xC0000082
+#define MSR_FMASK               0xC0000084
+#define MSR_FS_BASE             0xC0000100
+#define MSR_GS_BASE             0xC0000101
+#define MSR_PMC0                0xC1
+#define MSR_PERFEVTSEL0         0x186
+#define MSR_PERF_GLOBAL_CTRL    0x38F
+
+/* EFER and RFLAGS bits */
+#define EFER_SCE                (1UL << 0)
+#define RFLAGS_TF               (1UL << 8)
+#define RFLAGS_IF               (1UL << 9)
+#define RFLAGS_DF               (1UL << 10)
+#define RFLAGS_IOPL             (3UL << 12)
+#define RFLAGS_NT               (1UL << 14)
+#define RFLAGS_AC               (1UL << 18)
+
+/* Control register bits */
+#define CR0_MP                  (1UL << 1)
+#define CR0_EM                  (1UL << 2)
+#define CR0_TS                  (1UL << 3)
+#define CR0_NE                  (1UL << 5)
+#define CR4_OSFXSR              (1UL << 9)
+#define CR4_OSXMMEXCPT          (1UL << 10)
+#define CR4_FSGSBASE            (1UL << 16)
+#define CR4_OSXSAVE             (1UL << 18)
+
+/* Architectural performance events: CPUID.0AH:EBX bit and PERFEVTSEL encoding */
+#define PERF_ARCH_LLC_MISSES    4
+#define PERF_EVENT_LLC_MISSES   0x412E
+#define PERFEVTSEL_OS           (1UL << 17)
+#define PERFEVTSEL_EN           (1UL << 22)
+
+static inline void cpuid_count(uint32_t leaf, uint32_t subleaf, uint32_t *eax,
+                               uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    __asm__ __volatile__("cpuid"
+                        : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+                        : "a" (leaf), "c" (subleaf));
+}
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdmsr" : "=a" (lo), "=d" (hi) : "c" (msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ __volatile__("wrmsr"
+                        :: "c" (msr), "a" ((uint32_t)value), "d" ((uint32_t)(value >> 32))
+                        : "memory");
+}
+
+static inline uint64_t read_cr0(void) {
+    uint64_t cr0;
+    __asm__ __volatile__("mov %%cr0, %0" : "=r" (cr0));
+    return cr0;
+}
+
+static inline void write_cr0(uint64_t cr0) {
+    __asm__ __volatile__("mov %0, %%cr0" :: "r" (cr0) : "memory");
+}
+
+static inline uint64_t read_cr3(void) {
+    uint64_t cr3;
+    __asm__ __volatile__("mov %%cr3, %0" : "=r" (cr3));
+    return cr3;
+}
+
+static inline uint64_t read_cr4(void) {
+    uint64_t cr4;
+    __asm__ __volatile__("mov %%cr4, %0" : "=r" (cr4));
+    return cr4;
+}
+
+static inline void write_cr4(uint64_t cr4) {
+    __asm__ __volatile__("mov %0, %%cr4" :: "r" (cr4) : "memory");
+}
+
+/* User TLS base: WRFSBASE once CR4.FSGSBASE is on, else the slower MSR write */
+static inline void write_fs_base(uint64_t base) {
+    if (read_cr4() & CR4_FSGSBASE) {
+        __asm__ __volatile__("wrfsbase %0" :: "r" (base) : "memory");
+    } else {
+        wrmsr(MSR_FS_BASE, base);
+    }
+}
+
+/* Disable interrupts, returning the previous flags */
+static inline uint64_t local_irq_save(void) {
+    uint64_t flags;
+    __asm__ __volatile__("pushfq; pop %0; cli" : "=r" (flags) :: "memory");
+    return flags;
+}
+
+static inline void local_irq_restore(uint64_t flags) {
+    __asm__ __volatile__("push %0; popfq" :: "r" (flags) : "memory", "cc");
+}
+
+static inline void local_irq_enable(void) {
+    __asm__ __volatile__("sti" ::: "memory");
+}
+
+static inline void local_irq_disable(void) {
+    __asm__ __volatile__("cli" ::: "memory");
+}
+
+static inline bool irqs_disabled(void) {
+    uint64_t flags;
+    __asm__ __volatile__("pushfq; pop %0" : "=r" (flags));
+    return !(flags & RFLAGS_IF);
+}
+
+/* Whether architectural event 'index' can be counted on PMC0 */
+static inline bool pmc_arch_event_available(uint32_t index) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid_count(0, 0, &eax, &ebx, &ecx, &edx);
+    if (eax < 0xA) {
+        return false;
+    }
+    
+    cpuid_count(0xA, 0, &eax, &ebx, &ecx, &edx);
+    uint32_t version = eax & 0xFF;
+    uint32_t counters = (eax >> 8) & 0xFF;
+    uint32_t events = (eax >> 24) & 0xFF;
+    return version && counters && index < events && !(ebx & (1U << index));
+}
+
+/* Count 'event' in kernel mode on PMC0 from zero */
+static inline void pmc0_start(uint64_t event) {
+    wrmsr(MSR_PERFEVTSEL0, 0);
+    wrmsr(MSR_PMC0, 0);
+    wrmsr(MSR_PERFEVTSEL0, event | PERFEVTSEL_OS | PERFEVTSEL_EN);
+    
+    /* Version 2 and later also gate each counter globally */
+    uint32_t eax, ebx, ecx, edx;
+    cpuid_count(0xA, 0, &eax, &ebx, &ecx, &edx);
+    if ((eax & 0xFF) >= 2) {
+        wrmsr(MSR_PERF_GLOBAL_CTRL, rdmsr(MSR_PERF_GLOBAL_CTRL) | 1);
+    }
+}
+
+static inline uint64_t pmc0_stop(void) {
+    uint64_t count = rdmsr(MSR_PMC0);
+    wrmsr(MSR_PERFEVTSEL0, 0);
+    return count;
+}
+
+static inline void cpu_relax(void) {
+    __asm__ __volatile__("pause" ::: "memory");
+}
+
+#endif /* _CPU_H */
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef _CPUMASK_H
+#define _CPUMASK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "smp.h"
+
+/* Set of CPUs, one bit per CPU index */
+#define CPUMASK_WORDS   ((MAX_CPUS + 63) / 64)
+
+typedef struct {
+    uint64_t bits[CPUMASK_WORDS];
+} cpumask_t;
+
+static inline void cpumask_clear(cpumask_t *mask) {
+    for (int i = 0; i < CPUMASK_WORDS; i++) {
+        mask->bits[i] = 0;
+    }
+}
+
+static inline void cpumask_set_cpu(uint32_t cpu, cpumask_t *mask) {
+    if (cpu < MAX_CPUS) {
+        mask->bits[cpu / 64] |= 1ULL << (cpu % 64);
+    }
+}
+
+static inline void cpumask_clear_cpu(uint32_t cpu, cpumask_t *mask) {
+    if (cpu < MAX_CPUS) {
+        mask->bits[cpu / 64] &= ~(1ULL << (cpu % 64));
+    }
+}
+
+static inline bool cpumask_test_cpu(uint32_t cpu, const cpumask_t *mask) {
+    return cpu < MAX_CPUS && (mask->bits[cpu / 64] & (1ULL << (cpu % 64)));
+}
+
+/* dst = a & b; returns false if the result is empty */
+static inline bool cpumask_and(cpumask_t *dst, const cpumask_t *a, const cpumask_t *b) {
+    uint64_t any = 0;
+    for (int i = 0; i < CPUMASK_WORDS; i++) {
+        dst->bits[i] = a->bits[i] & b->bits[i];
+        any |= dst->bits[i];
+    }
+    return any != 0;
+}
+
+static inline bool cpumask_empty(const cpumask_t *mask) {
+    for (int i = 0; i < CPUMASK_WORDS; i++) {
+        if (mask->bits[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline bool cpumask_subset(const cpumask_t *sub, const cpumask_t *mask) {
+    for (int i = 0; i < CPUMASK_WORDS; i++) {
+        if (sub->bits[i] & ~mask->bits[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline uint32_t cpumask_weight(const cpumask_t *mask) {
+    uint32_t weight = 0;
+    for (int i = 0; i < CPUMASK_WORDS; i++) {
+        weight += __builtin_popcountll(mask->bits[i]);
+    }
+    return weight;
+}
+
+/* Lowest CPU in the mask, or CPU_INVALID if it is empty */
+static inline uint32_t cpumask_first(const cpumask_t *mask) {
+    for (int i = 0; i < CPUMASK_WORDS; i++) {
+        if (mask->bits[i]) {
+            return i * 64 + __builtin_ctzll(mask->bits[i]);
+        }
+    }
+    return CPU_INVALID;
+}
+
+/* All CPUs that are currently online */
+static inline void cpumask_online(cpumask_t *mask) {
+    cpumask_clear(mask);
+    for (uint32_t cpu = 0; cpu < smp_num_cpus(); cpu++) {
+        if (smp_cpu_topology(cpu)->online) {
+            cpumask_set_cpu(cpu, mask);
+        }
+    }
+}
+
+#endif /* _CPUMASK_H */
\ No newline at end of file
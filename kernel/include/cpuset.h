@@ -0,0 +1,36 @@
+#ifndef _CPUSET_H
+#define _CPUSET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpumask.h"
+
+#define CPUSET_MAX          32
+#define CPUSET_ROOT         0       /* Every CPU and memory node */
+
+/*
+ * CPU sets (kernel/sched/cpuset.c). Every task belongs to one set and may
+ * only run on its CPUs; tasks it creates start in the same set. Sets nest:
+ * a set is limited to CPUs and memory nodes of its parent.
+ */
+struct cpuset {
+    int id;
+    char name[32];
+    cpumask_t cpus;
+    uint64_t mems;                  /* NUMA node mask */
+    struct cpuset *parent;
+    volatile uint32_t nr_tasks;
+    uint32_t nr_children;
+    bool in_use;
+};
+
+void cpuset_init(void);
+int cpuset_create(const char *name, int parent, const cpumask_t *cpus, uint64_t mems);
+int cpuset_destroy(int id);
+int cpuset_attach(uint64_t pid, int id);
+struct cpuset *cpuset_root(void);
+void cpuset_hold(struct cpuset *cs);
+void cpuset_release(struct cpuset *cs);
+void cpuset_report(void);
+
+#endif /* _CPUSET_H */
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef _EVENTPOLL_H
+#define _EVENTPOLL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Events; the low bits match POLLIN and friends */
+#define EPOLLIN             0x001
+#define EPOLLPRI            0x002
+#define EPOLLOUT            0x004
+#define EPOLLERR            0x008
+#define EPOLLHUP            0x010
+#define EPOLLRDNORM         0x040
+#define EPOLLWRNORM         0x100
+#define EPOLLONESHOT        (1U << 30)  /* Disarm after one report, until EPOLL_CTL_MOD */
+#define EPOLLET             (1U << 31)  /* Edge triggered */
+
+/* Reported whether asked for or not */
+#define EPOLL_ALWAYS        (EPOLLERR | EPOLLHUP)
+
+/* epoll_create flags */
+#define EPOLL_CLOEXEC       0x80000
+
+/* epoll_ctl operations */
+#define EPOLL_CTL_ADD       1
+#define EPOLL_CTL_DEL       2
+#define EPOLL_CTL_MOD       3
+
+/* Most events one epoll_wait() returns */
+#define EPOLL_MAX_EVENTS    (1U << 16)
+
+/* Packed, as on Linux x86_64, so the ABI matches */
+struct epoll_event {
+    uint32_t events;
+    uint64_t data;
+} __attribute__((packed));
+
+struct process_files;
+struct file_descriptor;
+
+/*
+ * Event poll (kernel/fs/eventpoll.c). An epoll file keeps an item per
+ * watched (file, fd) pair in a hash table. Each item hangs a callback
+ * entry on the file's poll_queue(), so a wakeup of that queue puts the
+ * item on the ready list in O(1); epoll_wait() only looks at ready items
+ * and never scans the watched set. Level-triggered items go back on the
+ * list after they are reported and drop off once poll() says they are no
+ * longer ready; edge-triggered ones wait for the next wakeup.
+ */
+void eventpoll_init(void);
+void eventpoll_release(struct file_descriptor *file);
+
+long ksys_epoll_create(struct process_files *files, uint32_t flags);
+long ksys_epoll_ctl(struct process_files *files, uint32_t epfd, int op, uint32_t fd,
+                    const struct epoll_event *event);
+long ksys_epoll_wait(struct process_files *files, uint32_t epfd, struct epoll_event *events,
+                     int maxevents, int timeout);
+
+void epoll_benchmark(uint32_t nr_fds);
+
+#endif /* _EVENTPOLL_H */
\ No newline at end of file
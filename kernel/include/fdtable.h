@@ -0,0 +1,76 @@
+#ifndef _FDTABLE_H
+#define _FDTABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "spinlock.h"
+#include "rcu.h"
+
+/* Descriptors per process: the embedded table, and the most it may grow to */
+#define NR_OPEN_DEFAULT     64
+#define NR_OPEN_MAX         (1U << 20)
+
+struct file_descriptor;
+struct inode;
+
+/*
+ * Descriptor table (kernel/fs/fdtable.c). Slot 'fd' holds the open file
+ * or NULL; an fd is in use from allocation on, even before its file is
+ * installed. A bitmap with a summary of full words finds the lowest free
+ * fd. The table doubles when it fills: the new one is published with
+ * rcu_assign_pointer() and the old one freed after a grace period, so
+ * lookups take no lock.
+ */
+struct fdtable {
+    uint32_t max_fds;           /* Multiple of 64 */
+    struct file_descriptor **fd;
+    uint64_t *open_fds;         /* One bit per fd in use */
+    uint64_t *full_fds;         /* One bit per open_fds word with no free fd */
+    struct rcu_head rcu;
+};
+
+/*
+ * Per-process open files; the lock serialises allocation, install and
+ * close. Threads created with CLONE_FILES share one table.
+ */
+struct process_files {
+    spinlock_t lock;
+    struct fdtable *fdt;
+    uint32_t nr_open;
+    uint32_t users;             /* Processes sharing the table */
+    uint32_t refs;              /* Holds on the memory: one for all users, one per ring */
+    struct fdtable fdtab;       /* Initial table, embedded */
+    struct file_descriptor *fd_array[NR_OPEN_DEFAULT];
+    uint64_t open_fds_init[NR_OPEN_DEFAULT / 64];
+    uint64_t full_fds_init[1];
+};
+
+void fdtable_init(void);
+struct process_files *current_files(void);
+void files_init(struct process_files *files);
+int files_copy(struct process_files *dst, struct process_files *src);
+void files_close_all(struct process_files *files);
+void files_release(struct process_files *files);
+void files_get(struct process_files *files);
+bool files_put(struct process_files *files);
+void files_pin(struct process_files *files);
+bool files_unpin(struct process_files *files);
+
+/* Open file descriptions, shared by fork() and dup() */
+struct file_descriptor *file_alloc(struct inode *inode, uint32_t flags, uint32_t mode);
+void file_get(struct file_descriptor *file);
+void file_put(struct file_descriptor *file);
+uint32_t file_poll(struct file_descriptor *file);
+
+int fd_alloc(struct process_files *files, uint32_t start);
+void fd_install(struct process_files *files, uint32_t fd, struct file_descriptor *file);
+void fd_release(struct process_files *files, uint32_t fd);
+struct file_descriptor *fd_get(struct process_files *files, uint32_t fd);
+int fd_close(struct process_files *files, uint32_t fd);
+int fd_dup(struct process_files *files, uint32_t oldfd, uint32_t start);
+int fd_dup2(struct process_files *files, uint32_t oldfd, uint32_t newfd);
+
+void fdtable_benchmark(uint32_t nr_fds);
+
+#endif /* _FDTABLE_H */
\ No newline at end of file
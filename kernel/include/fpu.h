@@ -0,0 +1,29 @@
+#ifndef _FPU_H
+#define _FPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Per-task extended register state (x87, SSE, AVX, AVX-512). The kernel
+ * itself is built without SSE, so this state only ever belongs to tasks.
+ */
+struct fpu {
+    uint8_t *state;         /* XSAVE/FXSAVE area, allocated on first use */
+    uint32_t last_cpu;      /* CPU whose registers were last loaded from 'state' */
+    bool used;              /* Task has executed an FPU/SIMD instruction */
+};
+
+/* Extended state management */
+void fpu_init(void);
+void fpu_cpu_init(void);
+void fpu_task_init(struct fpu *fpu);
+void fpu_task_exit(struct fpu *fpu);
+void fpu_switch_out(struct fpu *prev);
+void fpu_switch_in(struct fpu *next);
+
+/* Statistics */
+void fpu_get_stats(uint64_t *saves, uint64_t *restores, uint64_t *traps, uint64_t *lazy_hits);
+const char *fpu_save_method(void);
+
+#endif /* _FPU_H */
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef _FUTEX_H
+#define _FUTEX_H
+
+#include <stdint.h>
+
+/* Operations (Linux-compatible values) */
+#define FUTEX_WAIT          0
+#define FUTEX_WAKE          1
+#define FUTEX_REQUEUE       3
+
+#define FUTEX_HASH_BUCKETS  256
+
+/* Relative FUTEX_WAIT timeout, laid out like struct timespec */
+struct futex_timespec {
+    int64_t tv_sec;
+    int64_t tv_nsec;
+};
+
+/*
+ * Fast userspace mutex support (kernel/core/futex.c). Waiters are hashed
+ * by the physical address of the futex word, so a word shared between
+ * address spaces reaches the same queue.
+ */
+long futex_wait(uint32_t *uaddr, uint32_t val, uint64_t timeout);
+long futex_wake(uint32_t *uaddr, uint32_t nr_wake);
+long futex_requeue(uint32_t *uaddr, uint32_t nr_wake, uint32_t *uaddr2, uint32_t nr_requeue);
+long do_futex(uint32_t *uaddr, int op, uint32_t val, uint64_t arg4, uint32_t *uaddr2);
+void futex_get_stats(uint64_t *waits, uint64_t *wakes, uint64_t *requeues, uint64_t *timeouts);
+
+#endif /* _FUTEX_H */
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef _IDT_H
+#define _IDT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exception vectors */
+#define VEC_DIVIDE_ERROR        0
+#define VEC_DEBUG               1
+#define VEC_NMI                 2
+#define VEC_BREAKPOINT          3
+#define VEC_INVALID_OPCODE      6
+#define VEC_DEVICE_NOT_AVAIL    7
+#define VEC_DOUBLE_FAULT        8
+#define VEC_GENERAL_PROTECTION  13
+#define VEC_PAGE_FAULT          14
+#define VEC_X87_FPU             16
+#define VEC_SIMD_FPU            19
+
+/* Legacy 8259 PIC lines, remapped past the exceptions */
+#define PIC_IRQ_BASE            0x20
+
+/* Device MSI vectors */
+#define AHCI_MSI_VECTOR         0x40
+
+/* Local APIC vectors */
+#define LOCAL_TIMER_VECTOR      0xEF
+#define RESCHEDULE_VECTOR       0xFD
+#define SPURIOUS_APIC_VECTOR    0xFF
+
+#define IDT_ENTRIES             256
+#define IDT_NUM_EXCEPTIONS      32
+
+/* Register frame built by the interrupt entry stubs (kernel/core/isr.s) */
+struct pt_regs {
+    uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+    uint64_t rbp, rdi, rsi, rdx, rcx, rbx, rax;
+    uint64_t vector;
+    uint64_t error_code;
+    
+    /* Pushed by the CPU */
+    uint64_t rip;
+    uint64_t cs;
+    uint64_t rflags;
+    uint64_t rsp;
+    uint64_t ss;
+};
+
+typedef void (*interrupt_handler_t)(struct pt_regs *regs);
+
+/* Interrupt descriptor table interface */
+void idt_init(void);
+void idt_load(void);
+int idt_register_handler(uint8_t vector, interrupt_handler_t handler);
+void idt_dispatch(struct pt_regs *regs);
+
+/* Legacy PIC lines, delivered on PIC_IRQ_BASE + irq */
+void pic_unmask_irq(uint8_t irq);
+void pic_eoi(uint8_t irq);
+
+/* Did the interrupted context run in user mode? */
+static inline bool user_mode(const struct pt_regs *regs) {
+    return (regs->cs & 3) != 0;
+}
+
+/* Were interrupts enabled in the interrupted context? */
+static inline bool regs_irqs_enabled(const struct pt_regs *regs) {
+    return (regs->rflags & (1 << 9)) != 0;
+}
+
+#endif /* _IDT_H */
\ No newline at end of file
@@ -45,6 +45,7 @@ void kernel_panic(const char *file, int line, const char *fmt, ...);
 void early_console_init(void);
 void console_putc(char c);
 void console_puts(const char *s);
+void console_write(const char *buf, size_t len);
 int console_printf(const char *fmt, ...);
 
 /* Memory management */
@@ -52,6 +53,7 @@ void mm_init(void);
 void *kmalloc(size_t size);
 void kfree(void *ptr);
 void *kmalloc_aligned(size_t size, size_t alignment);
+int mm_virt_to_phys(vaddr_t vaddr, paddr_t *paddr);
 
 /* Security functions */
 void security_init(void);
@@ -0,0 +1,19 @@
+#ifndef _KTHREAD_H
+#define _KTHREAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Kernel threads (kernel/sched/kthread.c). A thread runs fn(data) as soon
+ * as it is created; kthread_stop() asks it to return and waits for it.
+ */
+struct kthread;
+
+struct kthread *kthread_create(int (*fn)(void *data), void *data, const char *name);
+struct kthread *kthread_create_on_cpu(int (*fn)(void *data), void *data, uint32_t cpu,
+                                      const char *name);
+int kthread_stop(struct kthread *k);
+bool kthread_should_stop(void);
+
+#endif /* _KTHREAD_H */
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef _KTIME_H
+#define _KTIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct pt_regs;
+
+/* Time units */
+#define NSEC_PER_USEC           1000ULL
+#define NSEC_PER_MSEC           1000000ULL
+#define NSEC_PER_SEC            1000000000ULL
+
+/* Scheduler tick: 1000 Hz, so time slices count milliseconds */
+#define HZ                      1000
+#define TICK_NSEC               (NSEC_PER_SEC / HZ)
+
+/* Longest a CPU may run without a tick (idle or single task) */
+#define TICK_NOHZ_MAX_DEFER     NSEC_PER_SEC
+
+/* Jiffies since boot, kept current by whichever CPU takes a tick */
+extern volatile uint64_t jiffies;
+
+/* TSC clocksource (kernel/time/tsc.c) */
+void tsc_init(void);
+uint64_t ktime_get_ns(void);
+uint64_t tsc_cycles_to_ns(uint64_t cycles);
+uint64_t tsc_ns_to_cycles(uint64_t ns);
+uint64_t tsc_ktime_to_tsc(uint64_t ktime_ns);
+uint32_t tsc_khz(void);
+
+/* One-shot event device, programmed with absolute ktime deadlines */
+#define CLOCK_EVT_FEAT_ONESHOT  (1 << 0)
+#define CLOCK_EVT_FEAT_DEADLINE (1 << 1)    /* Hardware compares against the TSC */
+
+struct clock_event_device {
+    const char *name;
+    uint32_t features;
+    uint64_t min_delta_ns;
+    uint64_t max_delta_ns;
+    int (*set_next_event)(uint64_t expires_ns);
+    void (*shutdown)(void);
+    void (*event_handler)(struct pt_regs *regs);
+};
+
+/* Local APIC (kernel/time/lapic.c) */
+int lapic_init(void);
+void lapic_eoi(void);
+void lapic_send_reschedule(uint32_t cpu);
+
+/* Clock events and tick management (kernel/time/tick.c) */
+void clockevents_register_device(struct clock_event_device *dev);
+int clockevents_program_event(uint64_t expires_ns);
+uint64_t tick_nohz_idle_enter(void);
+void tick_nohz_idle_exit(void);
+void tick_nohz_kick(void);
+void tick_nohz_dep_changed(uint32_t cpu);
+void tick_nohz_timer_added(uint64_t expires_ns);
+void tick_get_idle_stats(uint32_t cpu, uint64_t *wakeups, uint64_t *idle_ns,
+                         uint64_t *elapsed_ns);
+void tick_report(void);
+
+/* Idle loop (kernel/sched/idle.c) */
+void idle_init(void);
+void cpu_idle_loop(void);
+void idle_get_stats(uint64_t *mwait_entries, uint64_t *deep_entries, uint64_t *hlt_entries);
+
+#endif /* _KTIME_H */
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef _PID_H
+#define _PID_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "spinlock.h"
+
+/* PID space: 0 is reserved for the idle tasks */
+#define PID_MAX_DEFAULT     (1U << 17)
+#define PID_HASH_MIN_BUCKETS 256
+
+/* Hash link embedded in the object a PID names */
+struct pid_node {
+    struct pid_node *next;
+    uint32_t pid;
+};
+
+#define pid_entry(node, type, member) \
+    ((type *)((char *)(node) - offsetof(type, member)))
+
+/*
+ * PID allocator and PID -> object map. A bitmap with a summary of full
+ * words finds free PIDs; a chained hash table that doubles with the
+ * population maps them back to their objects. Lookups take no reference:
+ * callers use the result under rcu_read_lock(), and owners free an object
+ * with call_rcu() after pid_hash_del().
+ */
+struct pid_table {
+    rwlock_t lock;
+    uint32_t max_pid;
+    uint32_t last_pid;          /* Allocation resumes after this PID */
+    uint32_t nr_allocated;
+    uint64_t *bitmap;           /* One bit per PID */
+    uint64_t *full;             /* One bit per bitmap word with no free PID */
+    uint32_t nr_words;
+    struct pid_node **buckets;
+    uint32_t nr_buckets;        /* Power of two */
+    uint32_t nr_hashed;
+};
+
+int pid_table_init(struct pid_table *table, uint32_t max_pid);
+int pid_alloc(struct pid_table *table);
+void pid_free(struct pid_table *table, uint32_t pid);
+int pid_hash_add(struct pid_table *table, struct pid_node *node, uint32_t pid);
+void pid_hash_del(struct pid_table *table, struct pid_node *node);
+struct pid_node *pid_hash_find(struct pid_table *table, uint32_t pid);
+
+#endif /* _PID_H */
\ No newline at end of file
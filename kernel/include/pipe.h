@@ -0,0 +1,82 @@
+#ifndef _PIPE_H
+#define _PIPE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "wait.h"
+
+/* Buffers per pipe; each holds up to a page */
+#define PIPE_DEF_BUFFERS        16
+
+/*
+ * A reference-counted page of data. Pipes, and files that splice by
+ * reference, pass these around instead of copying; 'release' runs when
+ * the last reference goes.
+ */
+struct pipe_page {
+    volatile uint32_t ref_count;
+    void (*release)(struct pipe_page *page);
+    uint8_t *data;              /* PAGE_SIZE bytes */
+    void *private_data;
+};
+
+/* Buffer flags */
+#define PIPE_BUF_CAN_MERGE      0x01    /* Page is the pipe's own: write() may append */
+
+struct pipe_buffer {
+    struct pipe_page *page;
+    uint32_t offset;
+    uint32_t len;
+    uint32_t flags;
+};
+
+/*
+ * Pipe (kernel/fs/pipe.c): a ring of page buffers between a read end and
+ * a write end. 'lock' serialises every change to the ring; readers and
+ * writers sleep on rd_wait and wr_wait.
+ */
+struct pipe {
+    struct mutex lock;
+    struct wait_queue_head rd_wait;     /* Waiting for data */
+    struct wait_queue_head wr_wait;     /* Waiting for space */
+    volatile uint32_t head;             /* Next buffer to fill */
+    volatile uint32_t tail;             /* Next buffer to drain */
+    volatile uint32_t readers;
+    volatile uint32_t writers;
+    uint32_t refs;                      /* Ends not yet out of pipe_release() */
+    struct pipe_buffer bufs[PIPE_DEF_BUFFERS];
+};
+
+struct file_descriptor;
+struct process_files;
+
+static inline bool pipe_empty(const struct pipe *pipe) {
+    return pipe->head == pipe->tail;
+}
+
+static inline bool pipe_full(const struct pipe *pipe) {
+    return pipe->head - pipe->tail >= PIPE_DEF_BUFFERS;
+}
+
+void pipe_init(void);
+struct pipe_page *pipe_page_alloc(void);
+void pipe_page_get(struct pipe_page *page);
+void pipe_page_put(struct pipe_page *page);
+
+struct pipe *pipe_alloc(void);
+void pipe_free(struct pipe *pipe);
+void pipe_release_buffers(struct pipe *pipe);
+struct pipe *file_pipe(struct file_descriptor *file);
+long pipe_create(struct process_files *files, int *fds, uint32_t flags);
+long pipe_wait_space(struct pipe *pipe, bool nonblock);
+long pipe_wait_data(struct pipe *pipe, bool nonblock);
+
+/* Zero-copy transfers (kernel/fs/splice.c) */
+long ksys_splice(struct process_files *files, uint32_t fd_in, int64_t *off_in, uint32_t fd_out,
+                 int64_t *off_out, size_t len);
+long ksys_sendfile(struct process_files *files, uint32_t out_fd, uint32_t in_fd, int64_t *offset,
+                   size_t count);
+void splice_benchmark(uint32_t total_kb);
+
+#endif /* _PIPE_H */
\ No newline at end of file
@@ -0,0 +1,97 @@
+#ifndef _PREEMPT_H
+#define _PREEMPT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "cpu.h"
+#include "smp.h"
+
+/*
+ * Kernel preemption control. Each CPU keeps a preempt count in its
+ * per-CPU area; the running task may be switched out whenever the count
+ * is zero and interrupts are enabled:
+ *
+ *   - on return from an interrupt, if need_resched is set
+ *   - in preempt_enable() (and so in every spin_unlock()) when the count
+ *     drops back to zero with need_resched set
+ *
+ * Spinlocks and RCU readers disable preemption, so code holding them
+ * stays on its CPU and may use per-CPU data. The count is per CPU, not
+ * per task: code must not call schedule() with preemption disabled.
+ */
+#define PREEMPT_MASK            0x000000FFU     /* preempt_disable() depth */
+#define HARDIRQ_OFFSET          0x00010000U     /* Interrupt handler nesting */
+#define HARDIRQ_MASK            0x00FF0000U
+
+/* Worst-case non-preemptible section tracer (kernel/sched/latency.c) */
+extern volatile bool latency_tracing;
+
+void latency_trace_off(void);
+void latency_trace_on(void);
+
+static inline uint32_t preempt_count(void) {
+    uint32_t count;
+    __asm__ __volatile__("movl %%gs:%c1, %0"
+                         : "=r" (count)
+                         : "i" (offsetof(struct percpu, preempt_count)));
+    return count;
+}
+
+/* A single %gs-relative add: safe against interrupts and migration */
+static inline void preempt_count_add(uint32_t val) {
+    __asm__ __volatile__("addl %1, %%gs:%c0"
+                         :: "i" (offsetof(struct percpu, preempt_count)), "r" (val)
+                         : "memory", "cc");
+    if (__builtin_expect(latency_tracing, 0) && preempt_count() == val) {
+        latency_trace_off();
+    }
+}
+
+static inline void preempt_count_sub(uint32_t val) {
+    if (__builtin_expect(latency_tracing, 0) && preempt_count() == val) {
+        latency_trace_on();
+    }
+    __asm__ __volatile__("subl %1, %%gs:%c0"
+                         :: "i" (offsetof(struct percpu, preempt_count)), "r" (val)
+                         : "memory", "cc");
+}
+
+static inline bool preemptible(void) {
+    return preempt_count() == 0 && !irqs_disabled();
+}
+
+static inline bool in_irq(void) {
+    return preempt_count() & HARDIRQ_MASK;
+}
+
+/* Ask the scheduler to run at the next preemption point on this CPU */
+static inline void set_need_resched(void) {
+    this_cpu()->need_resched = 1;
+}
+
+void preempt_schedule(void);
+void preempt_schedule_irq(void);
+
+static inline void preempt_disable(void) {
+    preempt_count_add(1);
+}
+
+/* Re-enable without a preemption point, for paths about to schedule anyway */
+static inline void preempt_enable_no_resched(void) {
+    preempt_count_sub(1);
+}
+
+static inline void preempt_enable(void) {
+    preempt_count_sub(1);
+    if (__builtin_expect(this_cpu()->need_resched, 0) && preempt_count() == 0) {
+        preempt_schedule();
+    }
+}
+
+/* Latency tracer control and report */
+void latency_tracer_start(void);
+void latency_tracer_stop(void);
+void latency_tracer_report(void);
+
+#endif /* _PREEMPT_H */
\ No newline at end of file
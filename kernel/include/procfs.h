@@ -0,0 +1,34 @@
+#ifndef _PROCFS_H
+#define _PROCFS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Registered entries, and the most text one snapshot holds */
+#define PROC_MAX_ENTRIES    16
+#define PROC_BUF_SIZE       (32 * 1024)
+
+struct file_operations;
+struct process_files;
+
+/*
+ * A /proc file (kernel/fs/procfs.c). Text entries implement show(), run
+ * once per open into a snapshot that read() walks, and optionally
+ * write() for control commands. Entries with their own 'fops' get a
+ * plain file with private_data set to 'data' instead.
+ */
+struct proc_entry {
+    const char *name;                               /* Without the "/proc/" */
+    int (*show)(char *buf, size_t size);            /* Returns the length written */
+    long (*write)(const char *buf, size_t count);
+    const struct file_operations *fops;
+    void *data;
+    bool privileged;                                /* Only uid 0 (or the kernel) may open it */
+};
+
+void procfs_init(void);
+int proc_register(const struct proc_entry *entry);
+long procfs_open(struct process_files *files, const char *name, uint32_t flags);
+
+#endif /* _PROCFS_H */
\ No newline at end of file
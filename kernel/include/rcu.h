@@ -0,0 +1,77 @@
+#ifndef _RCU_H
+#define _RCU_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "preempt.h"
+
+/*
+ * Read-copy-update (kernel/sched/rcu.c). Readers walk shared structures
+ * without locks or atomics; writers publish with rcu_assign_pointer() and
+ * free what they unlinked only after a grace period, once every CPU has
+ * passed a quiescent state (context switch, idle or user mode).
+ *
+ * Read side critical sections run with preemption disabled, so they
+ * must not sleep or call cond_resched().
+ */
+struct rcu_head {
+    struct rcu_head *next;
+    void (*func)(struct rcu_head *head);
+};
+
+#define rcu_entry(head, type, member) \
+    ((type *)((char *)(head) - offsetof(type, member)))
+
+static inline void rcu_read_lock(void) {
+    preempt_disable();
+    this_cpu()->rcu_nesting++;
+    __asm__ __volatile__("" ::: "memory");
+}
+
+static inline void rcu_read_unlock(void) {
+    __asm__ __volatile__("" ::: "memory");
+    this_cpu()->rcu_nesting--;
+    preempt_enable();
+}
+
+/* Load an RCU-protected pointer inside a read side critical section */
+#define rcu_dereference(p)          __atomic_load_n(&(p), __ATOMIC_CONSUME)
+
+/* Publish a pointer: initialisation of the pointee is visible first */
+#define rcu_assign_pointer(p, v)    __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/*
+ * Intrusive singly linked lists, linked through 'member'. Writers
+ * serialise among themselves; readers use rcu_list_for_each() under
+ * rcu_read_lock().
+ */
+#define rcu_list_add(head, node, member) do {                                   \
+    (node)->member = (head);                                                    \
+    rcu_assign_pointer((head), (node));                                         \
+} while (0)
+
+/* Unlink 'node' found at *link; readers already on it still see its successor */
+#define rcu_list_del(link, node, member) \
+    __atomic_store_n((link), (node)->member, __ATOMIC_RELAXED)
+
+#define rcu_list_for_each(pos, head, member) \
+    for ((pos) = rcu_dereference(head); (pos); (pos) = rcu_dereference((pos)->member))
+
+void rcu_init(void);
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head));
+void synchronize_rcu(void);
+
+/* Quiescent state hooks for the scheduler, idle loop and interrupt entry */
+void rcu_note_context_switch(void);
+void rcu_sched_clock_irq(bool quiescent);
+void rcu_idle_enter(void);
+void rcu_idle_exit(void);
+void rcu_irq_enter(void);
+void rcu_irq_exit(void);
+bool rcu_needs_cpu(void);
+
+void rcu_get_stats(uint64_t *grace_periods, uint64_t *callbacks);
+void rcu_benchmark(uint32_t iterations);
+
+#endif /* _RCU_H */
\ No newline at end of file
@@ -0,0 +1,102 @@
+#ifndef _SCHED_H
+#define _SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpumask.h"
+
+/* Schedulable entity, private to kernel/sched/scheduler.c */
+struct task;
+struct fpu;
+struct cpuset;
+struct wait_queue_entry;
+
+/* Load-balancing domain levels, nearest first */
+enum sched_domain_level {
+    SD_LLC = 0,     /* CPUs sharing the last-level cache */
+    SD_NODE,        /* CPUs in the same NUMA node */
+    SD_SYSTEM,      /* All online CPUs */
+    SD_LEVELS
+};
+
+/* Scheduling policies (Linux-compatible values) */
+#define SCHED_NORMAL        0
+#define SCHED_FIFO          1
+#define SCHED_RR            2
+#define SCHED_DEADLINE      6
+
+/* Real-time priorities: 1 (lowest) to MAX_RT_PRIO - 1 */
+#define MAX_RT_PRIO         100
+
+/* Scheduling attributes, laid out like Linux struct sched_attr */
+struct sched_attr {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;    /* SCHED_FIFO/SCHED_RR */
+    uint64_t sched_runtime;     /* SCHED_DEADLINE, nanoseconds */
+    uint64_t sched_deadline;
+    uint64_t sched_period;      /* 0 means equal to sched_deadline */
+};
+
+#define SCHED_ATTR_SIZE_VER0    48
+
+/* Core scheduler interface */
+void scheduler_init(void);
+void schedule(void);
+void sched_tick(uint64_t ticks);
+bool sched_can_stop_tick(void);
+void sched_cpu_online(uint32_t cpu);
+struct task *sched_current(void);
+struct fpu *sched_current_fpu(void);
+void sched_wake_up(struct task *task);
+void sched_prepare_to_block(void);
+void sched_set_running(void);
+void sched_set_wait_entry(struct wait_queue_entry *entry);
+void sched_block_current(void);
+bool sched_can_block(void);
+
+/* Scheduling classes; pid 0 is the calling task */
+int sched_setscheduler(uint64_t pid, uint32_t policy, uint32_t priority);
+int sched_getscheduler(uint64_t pid);
+int sched_setattr(uint64_t pid, const struct sched_attr *attr);
+void cond_resched(void);
+
+/* CPU affinity and cpusets (kernel/sched/cpuset.c); pid 0 is the calling task */
+int sched_setaffinity(uint64_t pid, const cpumask_t *mask);
+int sched_getaffinity(uint64_t pid, cpumask_t *mask);
+int sched_set_cpuset(uint64_t pid, struct cpuset *cs);
+
+/* Kernel thread support (kernel/sched/kthread.c) */
+struct task *sched_create_kthread(const char *name, void (*entry)(void *), void *arg,
+                                  void *kthread, int cpu);
+void *sched_current_kthread(void);
+
+/* Kernel pointers in user copies (kernel/mm/uaccess.c) */
+bool sched_set_uaccess_kernel(bool enable);
+bool sched_uaccess_kernel(void);
+uint64_t sched_set_cr3(uint64_t cr3);
+
+/* Called from switch.s on a new task's stack */
+void sched_task_start(struct task *prev);
+void sched_task_exit(void);
+
+/* Timer tick entry point and deferred process rotation (kernel/core/process.c) */
+void scheduler_timer_interrupt(uint64_t ticks);
+void process_resched(void);
+
+/* Statistics */
+void sched_get_stats(uint64_t *processes, uint64_t *context_switches);
+void sched_get_balance_stats(uint64_t *migrations, uint64_t *steals, uint64_t *imbalances);
+void sched_get_cpu_stats(uint32_t cpu, uint32_t *nr_running, uint64_t *migrations,
+                         uint64_t *steals, uint64_t *imbalances);
+
+/* Benchmarks */
+void sched_benchmark(uint32_t iterations);
+void sched_benchmark_switch(uint32_t iterations);
+void sched_benchmark_pid(uint32_t nr_tasks);
+void sched_benchmark_lock(uint32_t nr_tasks, uint32_t iterations, uint32_t hold_cycles);
+void sched_benchmark_latency(uint32_t loops, uint32_t interval_us, uint32_t nr_hogs);
+
+#endif /* _SCHED_H */
\ No newline at end of file
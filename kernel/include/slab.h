@@ -0,0 +1,18 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Object caches for fixed-size kernel structures (kernel/mm/slab.c) */
+struct kmem_cache;
+
+struct kmem_cache *kmem_cache_create(const char *name, size_t size, size_t align);
+void *kmem_cache_alloc(struct kmem_cache *cache);
+void *kmem_cache_zalloc(struct kmem_cache *cache);
+void kmem_cache_free(struct kmem_cache *cache, void *obj);
+void kmem_cache_get_stats(struct kmem_cache *cache, uint64_t *active, uint64_t *total,
+                          uint64_t *slabs);
+void kmem_cache_report(void);
+
+#endif /* _SLAB_H */
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef _SMP_H
+#define _SMP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+struct fpu;
+
+/* SMP configuration */
+#define MAX_CPUS            64
+#define MAX_NUMA_NODES      8
+#define CPU_INVALID         0xFFFFFFFFU
+
+/* CPU topology, filled from CPUID (and ACPI SRAT for NUMA nodes) */
+struct cpu_topology {
+    uint32_t apic_id;
+    uint32_t package_id;
+    uint32_t core_id;
+    uint32_t smt_id;
+    uint32_t llc_id;        /* CPUs with equal llc_id share the last-level cache */
+    uint32_t numa_node;
+    bool online;
+};
+
+/*
+ * Per-CPU data area. The GS base of every CPU points at its own copy, so
+ * fields are read with a single %gs-relative load.
+ */
+struct percpu {
+    struct percpu *self;
+    uint32_t cpu_id;
+    uint32_t apic_id;
+    uint64_t kernel_stack;      /* Top of the running task's stack, for SYSCALL entry */
+    uint64_t user_rsp;          /* SYSCALL entry scratch */
+    struct fpu *fpu_owner;      /* Extended state currently loaded in the registers */
+    bool fpu_trap_armed;        /* CR0.TS is set on this CPU */
+    
+    /* Rescheduling and idle state */
+    volatile uint32_t need_resched;     /* Ask this CPU to call schedule() */
+    volatile bool polling;              /* Idle in MWAIT on need_resched: no IPI needed */
+    uint32_t preempt_count;             /* See preempt.h; 0 means preemptible */
+    uint32_t rcu_nesting;               /* rcu_read_lock() depth */
+} __attribute__((aligned(64)));
+
+#define PERCPU_OFFSET_SELF      0
+#define PERCPU_OFFSET_CPU_ID    8
+#define PERCPU_OFFSET_KSTACK    16      /* Also hardcoded in core/entry.s */
+#define PERCPU_OFFSET_USER_RSP  24
+
+/* Current CPU index (0 .. smp_num_cpus() - 1) */
+static inline uint32_t smp_processor_id(void) {
+    uint32_t cpu;
+    __asm__ __volatile__("movl %%gs:%c1, %0"
+                         : "=r" (cpu)
+                         : "i" (PERCPU_OFFSET_CPU_ID));
+    return cpu;
+}
+
+/* Current CPU's per-CPU area */
+static inline struct percpu *this_cpu(void) {
+    struct percpu *pc;
+    __asm__ __volatile__("movq %%gs:%c1, %0"
+                         : "=r" (pc)
+                         : "i" (PERCPU_OFFSET_SELF));
+    return pc;
+}
+
+/* SMP and topology interface */
+void smp_init(void);
+int smp_cpu_online(uint32_t apic_id);
+uint32_t smp_num_cpus(void);
+struct percpu *smp_percpu(uint32_t cpu);
+const struct cpu_topology *smp_cpu_topology(uint32_t cpu);
+void smp_set_numa_node(uint32_t apic_id, uint32_t node);
+bool smp_cpus_share_llc(uint32_t cpu_a, uint32_t cpu_b);
+bool smp_cpus_share_node(uint32_t cpu_a, uint32_t cpu_b);
+
+#endif /* _SMP_H */
\ No newline at end of file
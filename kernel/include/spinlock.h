@@ -0,0 +1,334 @@
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+#include "preempt.h"
+
+/*
+ * Kernel locking library. Every lock is unlocked when zeroed, so locks in
+ * static or memset() storage need no initialisation.
+ *
+ *   spinlock_t   ticket lock: waiters are served in arrival order
+ *   mcs_lock_t   queued lock: each waiter spins on its own node, so a
+ *                contended handoff touches one remote cache line
+ *   rwlock_t     shared readers or one writer; a waiting writer holds
+ *                off new readers
+ *   seqcount_t   lock-free readers that retry if a writer overlapped
+ *   seqlock_t    seqcount plus a spinlock serialising the writers
+ *
+ * Locks also taken from interrupt handlers must use the _irqsave variants
+ * everywhere, or a handler can spin forever on its own CPU's lock.
+ *
+ * Holding any lock disables preemption, and releasing the last one is a
+ * preemption point. The raw_ spinlock operations leave the preempt count
+ * alone, for the preemption code itself.
+ */
+
+/* Ticket spinlock */
+typedef union {
+    volatile uint32_t val;
+    struct {
+        volatile uint16_t owner;    /* Ticket now being served */
+        volatile uint16_t next;     /* Next ticket handed out */
+    } tickets;
+} spinlock_t;
+
+#define SPINLOCK_TICKET         (1U << 16)
+
+static inline void spin_lock_init(spinlock_t *lock) {
+    lock->val = 0;
+}
+
+static inline void raw_spin_lock(spinlock_t *lock) {
+    uint16_t ticket = __atomic_fetch_add(&lock->tickets.next, 1, __ATOMIC_RELAXED);
+    while (__atomic_load_n(&lock->tickets.owner, __ATOMIC_ACQUIRE) != ticket) {
+        cpu_relax();
+    }
+}
+
+static inline bool raw_spin_trylock(spinlock_t *lock) {
+    uint32_t old = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+    if ((uint16_t)old != (uint16_t)(old >> 16)) {
+        return false;
+    }
+    return __atomic_compare_exchange_n(&lock->val, &old, old + SPINLOCK_TICKET, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static inline void raw_spin_unlock(spinlock_t *lock) {
+    /* Only the holder writes 'owner' */
+    __atomic_store_n(&lock->tickets.owner, (uint16_t)(lock->tickets.owner + 1), __ATOMIC_RELEASE);
+}
+
+static inline void spin_lock(spinlock_t *lock) {
+    preempt_disable();
+    raw_spin_lock(lock);
+}
+
+static inline bool spin_trylock(spinlock_t *lock) {
+    preempt_disable();
+    if (raw_spin_trylock(lock)) {
+        return true;
+    }
+    preempt_enable();
+    return false;
+}
+
+static inline void spin_unlock(spinlock_t *lock) {
+    raw_spin_unlock(lock);
+    preempt_enable();
+}
+
+static inline bool spin_is_locked(spinlock_t *lock) {
+    uint32_t val = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+    return (uint16_t)val != (uint16_t)(val >> 16);
+}
+
+/* Is anyone waiting behind the holder? */
+static inline bool spin_is_contended(spinlock_t *lock) {
+    uint32_t val = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+    return (uint16_t)((val >> 16) - val) > 1;
+}
+
+static inline uint64_t spin_lock_irqsave(spinlock_t *lock) {
+    uint64_t flags = local_irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+/* Interrupts are restored first so the preemption point can switch */
+static inline void spin_unlock_irqrestore(spinlock_t *lock, uint64_t flags) {
+    raw_spin_unlock(lock);
+    local_irq_restore(flags);
+    preempt_enable();
+}
+
+/* MCS queued lock; the node must stay valid until the matching unlock */
+struct mcs_node {
+    struct mcs_node *volatile next;
+    volatile int locked;
+};
+
+typedef struct {
+    struct mcs_node *volatile tail;
+} mcs_lock_t;
+
+static inline void mcs_lock(mcs_lock_t *lock, struct mcs_node *node) {
+    preempt_disable();
+    node->next = NULL;
+    node->locked = 0;
+    
+    struct mcs_node *prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    if (!prev) {
+        return;
+    }
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)) {
+        cpu_relax();
+    }
+}
+
+static inline bool mcs_trylock(mcs_lock_t *lock, struct mcs_node *node) {
+    struct mcs_node *expected = NULL;
+    node->next = NULL;
+    node->locked = 0;
+    preempt_disable();
+    if (__atomic_compare_exchange_n(&lock->tail, &expected, node, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return true;
+    }
+    preempt_enable();
+    return false;
+}
+
+static inline void raw_mcs_unlock(mcs_lock_t *lock, struct mcs_node *node) {
+    struct mcs_node *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    if (!next) {
+        struct mcs_node *expected = node;
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, NULL, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        /* A waiter swapped itself in but has not linked up yet */
+        while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE))) {
+            cpu_relax();
+        }
+    }
+    __atomic_store_n(&next->locked, 1, __ATOMIC_RELEASE);
+}
+
+static inline void mcs_unlock(mcs_lock_t *lock, struct mcs_node *node) {
+    raw_mcs_unlock(lock, node);
+    preempt_enable();
+}
+
+static inline uint64_t mcs_lock_irqsave(mcs_lock_t *lock, struct mcs_node *node) {
+    uint64_t flags = local_irq_save();
+    mcs_lock(lock, node);
+    return flags;
+}
+
+static inline void mcs_unlock_irqrestore(mcs_lock_t *lock, struct mcs_node *node, uint64_t flags) {
+    raw_mcs_unlock(lock, node);
+    local_irq_restore(flags);
+    preempt_enable();
+}
+
+/* Reader-writer lock: bit 0 writer holds it, bit 1 writer waiting, readers count from bit 2 */
+typedef struct {
+    volatile uint32_t cnt;
+} rwlock_t;
+
+#define RW_WRITER               1U
+#define RW_WAITING              2U
+#define RW_READER               4U
+
+static inline void rwlock_init(rwlock_t *lock) {
+    lock->cnt = 0;
+}
+
+static inline void read_lock(rwlock_t *lock) {
+    preempt_disable();
+    for (;;) {
+        uint32_t cnt = __atomic_load_n(&lock->cnt, __ATOMIC_RELAXED);
+        if (!(cnt & (RW_WRITER | RW_WAITING)) &&
+            __atomic_compare_exchange_n(&lock->cnt, &cnt, cnt + RW_READER, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        cpu_relax();
+    }
+}
+
+static inline void raw_read_unlock(rwlock_t *lock) {
+    __atomic_fetch_sub(&lock->cnt, RW_READER, __ATOMIC_RELEASE);
+}
+
+static inline void read_unlock(rwlock_t *lock) {
+    raw_read_unlock(lock);
+    preempt_enable();
+}
+
+static inline void write_lock(rwlock_t *lock) {
+    preempt_disable();
+    for (;;) {
+        uint32_t cnt = __atomic_load_n(&lock->cnt, __ATOMIC_RELAXED);
+        if ((cnt & ~RW_WAITING) == 0) {
+            if (__atomic_compare_exchange_n(&lock->cnt, &cnt, RW_WRITER, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return;
+            }
+            continue;
+        }
+        if (!(cnt & RW_WAITING)) {
+            __atomic_fetch_or(&lock->cnt, RW_WAITING, __ATOMIC_RELAXED);
+        }
+        cpu_relax();
+    }
+}
+
+static inline void raw_write_unlock(rwlock_t *lock) {
+    /* Keep RW_WAITING: other writers may still be queued behind us */
+    __atomic_fetch_and(&lock->cnt, ~RW_WRITER, __ATOMIC_RELEASE);
+}
+
+static inline void write_unlock(rwlock_t *lock) {
+    raw_write_unlock(lock);
+    preempt_enable();
+}
+
+static inline uint64_t read_lock_irqsave(rwlock_t *lock) {
+    uint64_t flags = local_irq_save();
+    read_lock(lock);
+    return flags;
+}
+
+static inline void read_unlock_irqrestore(rwlock_t *lock, uint64_t flags) {
+    raw_read_unlock(lock);
+    local_irq_restore(flags);
+    preempt_enable();
+}
+
+static inline uint64_t write_lock_irqsave(rwlock_t *lock) {
+    uint64_t flags = local_irq_save();
+    write_lock(lock);
+    return flags;
+}
+
+static inline void write_unlock_irqrestore(rwlock_t *lock, uint64_t flags) {
+    raw_write_unlock(lock);
+    local_irq_restore(flags);
+    preempt_enable();
+}
+
+/* Sequence counter: writers must already be serialised (one CPU, or a lock) */
+typedef struct {
+    volatile uint32_t sequence;
+} seqcount_t;
+
+static inline uint32_t read_seqcount_begin(const seqcount_t *s) {
+    uint32_t seq;
+    while ((seq = __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE)) & 1) {
+        cpu_relax();
+    }
+    return seq;
+}
+
+/* True if the data read since read_seqcount_begin() may be torn */
+static inline bool read_seqcount_retry(const seqcount_t *s, uint32_t start) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&s->sequence, __ATOMIC_RELAXED) != start;
+}
+
+static inline void write_seqcount_begin(seqcount_t *s) {
+    __atomic_store_n(&s->sequence, s->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void write_seqcount_end(seqcount_t *s) {
+    __atomic_store_n(&s->sequence, s->sequence + 1, __ATOMIC_RELEASE);
+}
+
+/* Sequence lock */
+typedef struct {
+    seqcount_t seq;
+    spinlock_t lock;
+} seqlock_t;
+
+static inline uint32_t read_seqbegin(const seqlock_t *sl) {
+    return read_seqcount_begin(&sl->seq);
+}
+
+static inline bool read_seqretry(const seqlock_t *sl, uint32_t start) {
+    return read_seqcount_retry(&sl->seq, start);
+}
+
+static inline void write_seqlock(seqlock_t *sl) {
+    spin_lock(&sl->lock);
+    write_seqcount_begin(&sl->seq);
+}
+
+static inline void write_sequnlock(seqlock_t *sl) {
+    write_seqcount_end(&sl->seq);
+    spin_unlock(&sl->lock);
+}
+
+static inline uint64_t write_seqlock_irqsave(seqlock_t *sl) {
+    uint64_t flags = local_irq_save();
+    write_seqlock(sl);
+    return flags;
+}
+
+static inline void write_sequnlock_irqrestore(seqlock_t *sl, uint64_t flags) {
+    write_seqcount_end(&sl->seq);
+    raw_spin_unlock(&sl->lock);
+    local_irq_restore(flags);
+    preempt_enable();
+}
+
+/* Contention benchmark (kernel/lib/spinlock.c) */
+void spinlock_benchmark(uint32_t iterations, uint32_t hold_cycles);
+
+#endif /* _SPINLOCK_H */
\ No newline at end of file
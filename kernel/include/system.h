@@ -4,6 +4,10 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include "pid.h"
+#include "wait.h"
+#include "rcu.h"
+#include "fdtable.h"
 
 /* System constants */
 #define KERNEL_VIRTUAL_BASE 0xFFFFFFFF80000000UL
@@ -21,7 +25,7 @@ typedef enum {
     PROCESS_TERMINATED
 } process_state_t;
 
-/* System call numbers */
+/* System call numbers, mirrored for userland in userland/libc/include/sys/syscall.h: append only */
 typedef enum {
     SYS_EXIT = 0,
     SYS_FORK,
@@ -93,33 +97,109 @@ typedef enum {
     SYS_STATFS,
     SYS_FSTATFS,
     SYS_SOCKETCALL,
+    SYS_FUTEX,
+    SYS_SCHED_SETSCHEDULER,
+    SYS_SCHED_GETSCHEDULER,
+    SYS_SCHED_SETATTR,
+    SYS_SCHED_SETAFFINITY,
+    SYS_SCHED_GETAFFINITY,
+    SYS_CPUSET_CREATE,
+    SYS_CPUSET_DESTROY,
+    SYS_CPUSET_ATTACH,
+    SYS_DUP2,
+    SYS_URING_SETUP,
+    SYS_URING_ENTER,
+    SYS_READV,
+    SYS_WRITEV,
+    SYS_PREADV,
+    SYS_PWRITEV,
+    SYS_SPLICE,
+    SYS_SENDFILE,
+    SYS_EPOLL_CREATE,
+    SYS_EPOLL_CTL,
+    SYS_EPOLL_WAIT,
+    SYS_CLONE,
+    SYS_GETTID,
+    SYS_SET_TID_ADDRESS,
+    SYS_ARCH_PRCTL,
+    SYS_EXIT_GROUP,
     SYS_MAX
 } syscall_t;
 
-/* Process Control Block */
+/* clone() flags (Linux-compatible values); the low byte, the exit signal, is ignored */
+#define CLONE_VM                0x00000100  /* Share the address space */
+#define CLONE_FILES             0x00000400  /* Share the descriptor table */
+#define CLONE_THREAD            0x00010000  /* Join the caller's thread group */
+#define CLONE_SETTLS            0x00080000  /* Start with FS base 'tls' */
+#define CLONE_PARENT_SETTID     0x00100000  /* Store the child's TID at 'ptid' */
+#define CLONE_CHILD_CLEARTID    0x00200000  /* Clear 'ctid' and wake it at exit */
+#define CLONE_CHILD_SETTID      0x01000000  /* Store the child's TID at 'ctid' */
+
+/* arch_prctl() codes */
+#define ARCH_SET_FS             0x1002
+#define ARCH_GET_FS             0x1003
+
+/* Credentials and security labels (cold) */
+struct process_cred {
+    uint32_t uid, gid;
+    uint32_t euid, egid;
+    uint8_t security_level;
+    uint32_t security_flags;
+    char security_context[128];
+    uint64_t security_sid;      /* avc_context_sid(security_context) */
+};
+
+/* Address space; CLONE_VM threads share one (cold) */
+struct process_mm {
+    uint64_t *page_directory;
+    uint32_t users;
+};
+
+/* Identification and resource accounting (cold) */
+struct process_acct {
+    char name[64];
+    uint64_t memory_usage;
+    uint64_t cpu_time;
+};
+
+struct pt_regs;
+
+/*
+ * Process control block. The first cache line holds everything the
+ * scheduler and list walks touch; the rest is reached through pointers
+ * to separately cached objects.
+ */
 struct process {
+    /* Hot: scheduling and list linkage */
     uint32_t pid;
     uint32_t ppid;
     process_state_t state;
     uint32_t priority;
+    struct process *next;
+    struct process *prev;
+    struct process *rq_next;    /* Ready queue links */
+    struct process *rq_prev;
+    struct cpu_context *context;
     uint64_t *page_directory;
+    
+    /* Cold */
     uint64_t kernel_stack;
     uint64_t user_stack;
-    struct cpu_context *context;
-    uint32_t uid, gid;
-    uint32_t euid, egid;
-    char name[64];
-    uint64_t memory_usage;
-    uint64_t cpu_time;
-    uint32_t open_files[MAX_OPEN_FILES];
-    struct process *next;
-    struct process *prev;
+    struct pid_node pid_node;   /* PID hash link */
+    struct wait_queue_head wait_child;  /* waitpid() sleepers */
+    struct rcu_head rcu;        /* Deferred free once list walkers are done */
+    struct process_cred *cred;
+    struct process_files *files;
+    struct process_acct *acct;
+    uint32_t kill_signal;       /* Nonzero once kill() hits; acted on at syscall exit */
     
-    /* Security context */
-    uint8_t security_level;
-    uint32_t security_flags;
-    char security_context[128];
-};
+    /* Threads: page_directory above caches mm->page_directory */
+    uint32_t tgid;              /* Thread group, the pid of its first thread; getpid() */
+    struct process_mm *mm;      /* NULL while on the kernel page tables */
+    uint64_t fs_base;           /* TLS base, loaded when switched in */
+    uint32_t *clear_child_tid;  /* Zeroed and futex-woken at exit, for join */
+    struct pt_regs *user_regs;  /* Frame of the syscall in progress, copied by clone() */
+} __attribute__((aligned(64)));
 
 /* CPU context for process switching */
 struct cpu_context {
@@ -161,12 +241,59 @@ struct inode {
     uint32_t security_level;
 };
 
+/* poll() events (Linux-compatible values) */
+#define POLLIN  0x001
+#define POLLOUT 0x004
+#define POLLERR 0x008
+#define POLLHUP 0x010
+
+/* Scatter/gather segment, as passed to readv() and writev() */
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+
+#define UIO_MAXIOV      1024    /* Most segments per call */
+#define UIO_FASTIOV     8       /* Segments copied in on the stack */
+
+struct file_descriptor;
+struct pipe;
+struct epitem;
+
+/*
+ * Files that are not backed by an inode (rings, pipes, ...) bring their
+ * own operations. readv and writev are optional; without them a vector
+ * is issued one segment at a time. splice_read and splice_write move
+ * pages to and from a pipe by reference, with the pipe locked; without
+ * them splice() and sendfile() copy through read and write.
+ */
+struct file_operations {
+    long (*read)(struct file_descriptor *file, void *buf, size_t count);
+    long (*write)(struct file_descriptor *file, const void *buf, size_t count);
+    long (*readv)(struct file_descriptor *file, const struct iovec *iov, uint32_t iovcnt);
+    long (*writev)(struct file_descriptor *file, const struct iovec *iov, uint32_t iovcnt);
+    long (*splice_read)(struct file_descriptor *file, int64_t *pos, struct pipe *pipe,
+                        size_t len);
+    long (*splice_write)(struct pipe *pipe, struct file_descriptor *file, int64_t *pos,
+                         size_t len);
+    uint32_t (*poll)(struct file_descriptor *file);
+    /* Queue woken whenever poll() may have changed; epoll needs one */
+    struct wait_queue_head *(*poll_queue)(struct file_descriptor *file);
+    long (*mmap)(struct file_descriptor *file, uint64_t addr, uint64_t length);
+    void (*release)(struct file_descriptor *file);  /* Last reference dropped */
+};
+
+/* Open file description, shared by the fds fork() and dup() make from one open() */
 struct file_descriptor {
     struct inode *inode;
     uint64_t offset;
     uint32_t flags;
     uint32_t mode;
-    uint32_t ref_count;
+    volatile uint32_t ref_count;
+    const struct file_operations *f_op;
+    void *private_data;
+    struct epitem *f_ep;            /* epoll items watching this file */
+    struct rcu_head rcu;
 };
 
 struct directory_entry {
@@ -207,8 +334,27 @@ struct socket {
 int process_create(const char *name, void (*entry_point)(void));
 int process_destroy(uint32_t pid);
 void process_schedule(void);
+void process_exit(int status);
 struct process *process_get_current(void);
 struct process *process_find_by_pid(uint32_t pid);
+int process_pid_attach(struct process *proc);
+void process_pid_detach(struct process *proc);
+struct process *process_alloc(void);
+struct process *process_clone(const struct process *parent, uint64_t flags);
+void process_free(struct process *proc);
+void process_notify_parent(struct process *proc);
+void process_link(struct process *proc);
+void process_unlink(struct process *proc);
+void process_free_rcu(struct rcu_head *head);
+long do_clone(struct process *parent, uint64_t flags, uint64_t stack, uint32_t *ptid,
+              uint32_t *ctid, uint64_t tls);
+void process_exit_mm(struct process *proc);
+void process_mm_get(struct process_mm *mm);
+void process_mm_drop(struct process_mm *mm);
+void process_files_unpin(struct process_files *files);
+void process_kill_group(struct process *proc, uint32_t sig);
+void process_benchmark_walk(uint32_t nr_processes);
+void process_benchmark_clone(uint32_t iterations);
 
 /* Memory management */
 void *kmalloc(size_t size);
@@ -218,14 +364,44 @@ int map_page(uint64_t virtual_addr, uint64_t physical_addr, uint32_t flags);
 int unmap_page(uint64_t virtual_addr);
 
 /* System calls */
+void syscall_init(void);
+void syscall_cpu_init(void);
 long syscall_handler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, 
                     uint64_t arg3, uint64_t arg4, uint64_t arg5);
+void syscall_benchmark_entry(uint32_t iterations);
+
+/* File system calls on a given descriptor table, for in-kernel callers */
+long ksys_read(struct process_files *files, uint32_t fd, void *buf, size_t count, int64_t pos);
+long ksys_write(struct process_files *files, uint32_t fd, const void *buf, size_t count,
+                int64_t pos);
+long ksys_open(struct process_files *files, const char *path, uint32_t flags, uint32_t mode);
+long ksys_close(struct process_files *files, uint32_t fd);
+long ksys_fsync(struct process_files *files, uint32_t fd);
+long ksys_readv(struct process_files *files, uint32_t fd, const struct iovec *uiov,
+                uint32_t iovcnt, int64_t pos);
+long ksys_writev(struct process_files *files, uint32_t fd, const struct iovec *uiov,
+                 uint32_t iovcnt, int64_t pos);
+long ksys_read_user(struct process_files *files, uint32_t fd, void *ubuf, size_t count,
+                    int64_t pos);
+long ksys_write_user(struct process_files *files, uint32_t fd, const void *ubuf, size_t count,
+                     int64_t pos);
+long ksys_open_user(struct process_files *files, const char *upath, uint32_t flags,
+                    uint32_t mode);
+void syscall_benchmark_writev(uint32_t nr_records);
+
+/* SYSCALL entry and slow exit path, called from core/entry.s */
+struct pt_regs;
+bool do_syscall(struct pt_regs *regs);
+void syscall_exit_work(void);
 
 /* File system */
 int fs_init(void);
 struct inode *fs_get_inode(uint32_t inode_num);
 int fs_read_inode(struct inode *inode, uint64_t offset, void *buffer, size_t count);
 int fs_write_inode(struct inode *inode, uint64_t offset, const void *buffer, size_t count);
+long fs_readv_inode(struct inode *inode, uint64_t offset, const struct iovec *iov, uint32_t iovcnt);
+long fs_writev_inode(struct inode *inode, uint64_t offset, const struct iovec *iov,
+                     uint32_t iovcnt);
 int fs_create_file(const char *path, uint32_t mode);
 int fs_delete_file(const char *path);
 
@@ -251,12 +427,18 @@ void interrupt_disable(void);
 /* Security functions */
 int security_check_access(struct process *proc, uint32_t resource, uint32_t operation);
 int security_validate_syscall(uint32_t syscall_num, struct process *proc);
+int security_set_syscall_level(uint32_t syscall_num, uint8_t level);
+int security_deny_syscall(const char *type, uint32_t syscall_num);
+void syscall_benchmark_avc(uint32_t iterations);
+void syscall_benchmark_audit(uint32_t iterations);
+void syscall_benchmark_trace(uint32_t iterations);
 void security_audit_log(const char *event, uint32_t pid, const char *details);
 
 /* Utility functions */
 void kernel_panic(const char *message);
 void debug_print(const char *format, ...);
 uint64_t get_timestamp(void);
+uint64_t get_ticks(void);
 void delay_ms(uint32_t milliseconds);
 
 #endif /* _SYSTEM_H */
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef _SYSTRACE_H
+#define _SYSTRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Runtime switches, in systrace_flags */
+#define SYSTRACE_STATS          0x01    /* Per-CPU counts and latency histograms */
+#define SYSTRACE_TRACE          0x02    /* A record per syscall in the per-CPU rings */
+
+#define SYSTRACE_NR_SYSCALLS    256
+#define SYSTRACE_HIST_BUCKETS   32      /* Bucket b: 2^b <= TSC cycles < 2^(b+1) */
+
+/* Per-CPU ring size, header included; the rings sit back to back in the mmap() region */
+#define SYSTRACE_RING_PAGES     16
+
+/* A traced syscall */
+struct systrace_record {
+    uint64_t timestamp;         /* TSC at entry */
+    uint32_t pid;
+    uint32_t duration;          /* TSC cycles, saturated */
+    uint16_t nr;
+    uint16_t cpu;
+    uint32_t resv;
+    int64_t ret;
+    uint64_t args[5];
+};
+
+/*
+ * Start of each CPU's ring. 'nr_records' records of 'record_size' bytes
+ * follow the header. The mapping is read-only: the header mirrors the
+ * kernel's own indices, and the kernel drops records while head - tail
+ * equals nr_records. A reader consumes from 'tail' and hands the records
+ * back by write()ing a struct systrace_consume to /proc/systrace.
+ */
+struct systrace_ring {
+    volatile uint64_t head;     /* Next record the kernel fills */
+    volatile uint64_t tail;     /* Oldest record not yet consumed */
+    uint64_t lost;
+    uint32_t nr_records;
+    uint32_t record_size;
+    uint32_t pad[8];
+};
+
+/* Advance one CPU's ring to 'tail', which must lie between its tail and head */
+struct systrace_consume {
+    uint32_t cpu;
+    uint32_t resv;
+    uint64_t tail;
+};
+
+/*
+ * Syscall statistics and tracing (kernel/core/systrace.c), exposed as
+ * /proc/syscalls and /proc/systrace. The syscall path tests
+ * systrace_flags once and takes no timestamps while it is zero.
+ */
+extern volatile uint32_t systrace_flags;
+
+static inline uint32_t systrace_active(void) {
+    return __atomic_load_n(&systrace_flags, __ATOMIC_RELAXED);
+}
+
+void systrace_init(void);
+int systrace_enable(uint32_t flags);
+void systrace_reset(void);
+void systrace_syscall_exit(uint32_t pid, uint32_t nr, const uint64_t *args, long ret,
+                           uint64_t start);
+void systrace_get_stats(uint32_t nr, uint64_t *count, uint64_t *cycles,
+                        uint64_t hist[SYSTRACE_HIST_BUCKETS]);
+
+#endif /* _SYSTRACE_H */
\ No newline at end of file
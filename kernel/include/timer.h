@@ -0,0 +1,102 @@
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+#include "ktime.h"
+
+#define TIMER_NO_EXPIRY         UINT64_MAX
+
+/*
+ * Low-resolution timer on the per-CPU timer wheel. Expiry is in jiffies;
+ * the callback runs in interrupt context on the CPU that armed the timer.
+ */
+struct timer_list {
+    struct timer_list *next;
+    struct timer_list **pprev;  /* Slot link pointing at us; NULL when not pending */
+    uint64_t expires;
+    void (*function)(struct timer_list *timer);
+    void *data;
+    uint32_t cpu;
+};
+
+/*
+ * High-resolution timer on the per-CPU expiry heap. Expiry is absolute
+ * ktime in nanoseconds; the clock event device is programmed for it.
+ */
+struct hrtimer {
+    uint64_t expires;
+    void (*function)(struct hrtimer *timer);
+    void *data;
+    int32_t index;              /* Heap slot, -1 when not queued */
+    uint32_t cpu;
+};
+
+/* Timer wheel (kernel/time/timer.c) */
+void timers_init(void);
+void timer_setup(struct timer_list *timer, void (*function)(struct timer_list *), void *data);
+int mod_timer(struct timer_list *timer, uint64_t expires);
+void add_timer(struct timer_list *timer);
+int del_timer(struct timer_list *timer);
+int del_timer_sync(struct timer_list *timer);
+void timer_run_local(void);
+uint64_t timer_next_expiry(void);
+
+static inline bool timer_pending(const struct timer_list *timer) {
+    return timer->pprev != NULL;
+}
+
+/* High-resolution timers (kernel/time/hrtimer.c) */
+void hrtimer_setup(struct hrtimer *timer, void (*function)(struct hrtimer *), void *data);
+int hrtimer_start(struct hrtimer *timer, uint64_t expires_ns);
+int hrtimer_cancel(struct hrtimer *timer);
+int hrtimer_cancel_sync(struct hrtimer *timer);
+void hrtimer_run_local(uint64_t now);
+uint64_t hrtimer_next_expiry(void);
+uint32_t hrtimer_pending_count(void);
+
+/* Conversions */
+static inline uint64_t msecs_to_jiffies(uint64_t ms) {
+    return (ms * HZ + 999) / 1000;
+}
+
+static inline uint64_t usecs_to_jiffies(uint64_t us) {
+    return (us * HZ + 999999) / 1000000;
+}
+
+/* Sleeping and delays */
+uint64_t schedule_timeout(uint64_t timeout);
+void msleep(uint32_t ms);
+void usleep(uint32_t us);
+void udelay(uint32_t us);
+
+/*
+ * Poll 'cond' until it is true or timeout_us elapses. Between polls the
+ * caller sleeps for sleep_us (busy-waits if 0 or if it cannot block).
+ * Evaluates to 0 on success or -110 (ETIMEDOUT).
+ */
+#define poll_timeout(cond, sleep_us, timeout_us) ({                             \
+    uint64_t __deadline = ktime_get_ns() + (uint64_t)(timeout_us) * NSEC_PER_USEC; \
+    int __ret = 0;                                                              \
+    for (;;) {                                                                  \
+        if (cond) {                                                             \
+            break;                                                              \
+        }                                                                       \
+        if (ktime_get_ns() > __deadline) {                                      \
+            __ret = (cond) ? 0 : -110;                                          \
+            break;                                                              \
+        }                                                                       \
+        if (sleep_us) {                                                         \
+            usleep(sleep_us);                                                   \
+        } else {                                                                \
+            cpu_relax();                                                        \
+        }                                                                       \
+    }                                                                           \
+    __ret;                                                                      \
+})
+
+/* Benchmarks */
+void timer_benchmark(uint32_t nr_timers);
+
+#endif /* _TIMER_H */
\ No newline at end of file
@@ -0,0 +1,91 @@
+#ifndef _TTY_H
+#define _TTY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "spinlock.h"
+#include "wait.h"
+#include "workqueue.h"
+
+/* Bytes per ring; a power of two */
+#define TTY_BUF_SIZE        4096
+
+/* Longest line the canonical line discipline edits */
+#define TTY_LINE_MAX        256
+
+/* Local modes */
+#define TTY_ICANON          0x01    /* Line at a time, with erase, kill and EOF */
+#define TTY_ECHO            0x02
+
+/* Control characters in canonical mode */
+#define TTY_CHAR_EOF        0x04    /* Ctrl-D */
+#define TTY_CHAR_KILL       0x15    /* Ctrl-U */
+#define TTY_CHAR_ERASE      0x7F
+#define TTY_CHAR_BS         '\b'
+
+/* Free-running indices; the byte at i lives at buf[i % TTY_BUF_SIZE] */
+struct tty_ring {
+    char buf[TTY_BUF_SIZE];
+    uint32_t head;              /* Next byte in */
+    uint32_t tail;              /* Next byte out */
+};
+
+struct tty;
+
+/* The hardware side; write() runs from the flush worker and may be slow */
+struct tty_operations {
+    void (*write)(struct tty *tty, const char *buf, size_t len);
+};
+
+/*
+ * Terminal (kernel/fs/tty.c). Writers append to 'out' and return; the
+ * flush worker hands whatever has accumulated to the driver in bulk, so
+ * many small writes cost one trip to the hardware. Input arrives through
+ * tty_receive(), usually from an interrupt. With TTY_ICANON it is edited
+ * in 'line' and reaches 'in' a line at a time; otherwise it goes straight
+ * to 'in'.
+ */
+struct tty {
+    const char *name;
+    const struct tty_operations *ops;
+    void *driver_data;
+    spinlock_t lock;                    /* Rings and line state; taken from IRQs */
+    struct mutex flush_lock;            /* One flusher, so output stays in order */
+    struct tty_ring out;
+    struct tty_ring in;
+    char line[TTY_LINE_MAX];
+    uint32_t line_len;
+    uint32_t eof;                       /* Pending end-of-file reads */
+    uint32_t lflag;
+    struct wait_queue_head read_wait;   /* Waiting for input */
+    struct wait_queue_head write_wait;  /* Waiting for room in 'out' */
+    struct wait_queue_head poll_wait;   /* Either changed; for epoll */
+    struct work_struct flush_work;
+    bool initialized;
+    uint64_t bytes_written;
+    uint64_t bytes_flushed;
+    uint64_t flushes;
+    uint64_t input_dropped;
+};
+
+struct file_descriptor;
+struct process_files;
+
+void tty_init(void);
+void tty_setup(struct tty *tty, const char *name, const struct tty_operations *ops,
+               void *driver_data, uint32_t lflag);
+struct tty *console_tty(void);
+
+long tty_write(struct tty *tty, const char *buf, size_t count, bool nonblock);
+long tty_read(struct tty *tty, char *buf, size_t count, bool nonblock);
+void tty_receive(struct tty *tty, const char *buf, size_t len);
+void tty_flush(struct tty *tty);
+long tty_open(struct process_files *files, struct tty *tty, uint32_t flags);
+
+/* fd lookup that falls back to the console for unopened 0, 1 and 2 */
+struct file_descriptor *fd_get_stdio(struct process_files *files, uint32_t fd);
+
+void tty_benchmark(uint32_t total_kb);
+
+#endif /* _TTY_H */
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef _UACCESS_H
+#define _UACCESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Highest user address; the last canonical page is never mapped */
+#define USER_ADDR_MAX           0x00007FFFFFFFF000UL
+
+/*
+ * Exception table entry: an instruction that may fault on a user address
+ * and where to resume if it does, as offsets from the fields themselves.
+ * Collected into __ex_table by the linker.
+ */
+struct exception_table_entry {
+    int32_t insn;
+    int32_t fixup;
+};
+
+#define _ASM_EXTABLE(from, to)                      \
+    "   .pushsection __ex_table, \"a\"\n"           \
+    "   .balign 4\n"                                \
+    "   .long (" #from ") - .\n"                    \
+    "   .long (" #to ") - .\n"                      \
+    "   .popsection\n"
+
+struct pt_regs;
+
+/* Out of line for kernel pointers, which only syscall_handler() callers may pass */
+bool uaccess_kernel_ok(const void *ptr, size_t size);
+
+/* Whether [ptr, ptr + size) may be handed to the copy routines */
+static inline bool access_ok(const void *ptr, size_t size) {
+    uint64_t addr = (uint64_t)ptr;
+    if (__builtin_expect(addr <= USER_ADDR_MAX && size <= USER_ADDR_MAX - addr, 1)) {
+        return true;
+    }
+    return uaccess_kernel_ok(ptr, size);
+}
+
+/*
+ * User memory access (kernel/mm/uaccess.c). With SMAP on, the kernel can
+ * touch user pages only between STAC and CLAC; these routines open that
+ * window around a single copy and recover from faults through the
+ * exception table. The copies return the number of bytes NOT copied;
+ * copy_from_user() zeroes whatever it could not fill. The __ variants
+ * skip access_ok() for callers that already checked.
+ */
+void uaccess_init(void);
+size_t __copy_from_user(void *to, const void *from, size_t n);
+size_t __copy_to_user(void *to, const void *from, size_t n);
+size_t copy_from_user(void *to, const void *from, size_t n);
+size_t copy_to_user(void *to, const void *from, size_t n);
+long strncpy_from_user(char *dst, const char *src, size_t count);
+
+/* Page fault and #GP path: resume at the fixup of a faulting user access */
+bool fixup_exception(struct pt_regs *regs);
+
+void uaccess_benchmark(uint32_t total_kb);
+
+#endif /* _UACCESS_H */
\ No newline at end of file
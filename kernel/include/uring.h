@@ -0,0 +1,99 @@
+#ifndef _URING_H
+#define _URING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Asynchronous I/O rings (kernel/fs/uring.c). A process queues requests
+ * (SQEs) in a submission ring it shares with the kernel and reaps results
+ * (CQEs) from a completion ring, so one uring_enter() call can carry a
+ * whole batch, and with URING_SETUP_SQPOLL a kernel thread picks them up
+ * without any system call. Both rings and the SQE array live in one
+ * region, mapped with mmap() on the ring fd; the offsets of each field
+ * are returned in struct uring_params. The layout is shared with
+ * userland/libc/include/sys/uring.h.
+ */
+#define URING_MAX_ENTRIES       4096
+
+/* Setup flags */
+#define URING_SETUP_SQPOLL      0x01    /* Kernel thread polls the SQ */
+#define URING_SETUP_SQ_AFF      0x02    /* ... bound to sq_thread_cpu */
+
+/* uring_enter() flags */
+#define URING_ENTER_GETEVENTS   0x01    /* Wait for min_complete CQEs */
+#define URING_ENTER_SQ_WAKEUP   0x02    /* Wake a sleeping SQ thread */
+
+/* SQ ring flags */
+#define URING_SQ_NEED_WAKEUP    0x01    /* SQ thread is asleep */
+
+/* Opcodes */
+#define URING_OP_NOP            0
+#define URING_OP_READ           1
+#define URING_OP_WRITE          2
+#define URING_OP_OPEN           3
+#define URING_OP_CLOSE          4
+#define URING_OP_FSYNC          5
+#define URING_OP_POLL           6
+
+/* Submission queue entry */
+struct uring_sqe {
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t resv;
+    int32_t fd;
+    int64_t off;                /* File offset; -1 for the current one */
+    uint64_t addr;              /* Buffer, or path for OPEN */
+    uint32_t len;
+    uint32_t op_flags;          /* OPEN flags, POLL events */
+    uint64_t user_data;         /* Copied to the CQE */
+    uint32_t mode;              /* OPEN mode */
+    uint32_t resv2[5];
+};
+
+/* Completion queue entry */
+struct uring_cqe {
+    uint64_t user_data;
+    int32_t res;                /* Result, or negative errno */
+    uint32_t flags;
+};
+
+struct uring_sq_offsets {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    uint32_t flags;
+    uint32_t dropped;
+    uint32_t array;             /* SQE indices, in submission order */
+    uint32_t sqes;
+};
+
+struct uring_cq_offsets {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    uint32_t cqes;
+    uint32_t resv;
+};
+
+struct uring_params {
+    uint32_t sq_entries;        /* Out: entries rounded up to a power of two */
+    uint32_t cq_entries;        /* Out: twice sq_entries */
+    uint32_t flags;
+    uint32_t sq_thread_cpu;
+    uint32_t sq_thread_idle;    /* Milliseconds the SQ thread spins before sleeping */
+    uint32_t ring_size;         /* Out: bytes to mmap() */
+    struct uring_sq_offsets sq_off;
+    struct uring_cq_offsets cq_off;
+};
+
+struct process_files;
+
+long uring_setup(struct process_files *files, uint32_t entries, struct uring_params *uparams);
+long uring_enter(struct process_files *files, uint32_t fd, uint32_t to_submit,
+                 uint32_t min_complete, uint32_t flags);
+void uring_benchmark(uint32_t nr_ops);
+
+#endif /* _URING_H */
\ No newline at end of file
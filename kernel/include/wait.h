@@ -0,0 +1,103 @@
+#ifndef _WAIT_H
+#define _WAIT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sched.h"
+#include "cpu.h"
+#include "spinlock.h"
+
+/* Exclusive waiters are woken one at a time; the rest are all woken */
+#define WQ_FLAG_EXCLUSIVE       0x01
+
+struct wait_queue_entry;
+
+/*
+ * Wake callback, run with the queue lock held instead of waking a task.
+ * Callback entries stay queued until remove_wait_queue(); the callback
+ * must not sleep or touch the queue it is on.
+ */
+typedef void (*wait_queue_func_t)(struct wait_queue_entry *entry);
+
+struct wait_queue_entry {
+    struct task *task;
+    wait_queue_func_t func;     /* NULL: wake 'task' */
+    void *private;
+    uint32_t flags;
+    bool queued;
+    struct wait_queue_head *wq; /* Queue the entry is on, NULL when not queued */
+    struct wait_queue_entry *next;
+    struct wait_queue_entry *prev;
+};
+
+struct wait_queue_head {
+    spinlock_t lock;
+    struct wait_queue_entry *head;
+    struct wait_queue_entry *tail;
+};
+
+/* Wait queues (kernel/sched/wait.c) */
+void init_waitqueue_head(struct wait_queue_head *wq);
+void init_wait_entry(struct wait_queue_entry *entry, uint32_t flags);
+void prepare_to_wait(struct wait_queue_head *wq, struct wait_queue_entry *entry);
+void finish_wait(struct wait_queue_head *wq, struct wait_queue_entry *entry);
+void init_waitqueue_func_entry(struct wait_queue_entry *entry, wait_queue_func_t func,
+                               void *private);
+void add_wait_queue(struct wait_queue_head *wq, struct wait_queue_entry *entry);
+void remove_wait_queue(struct wait_queue_head *wq, struct wait_queue_entry *entry);
+void wait_entry_cancel(struct wait_queue_entry *entry);
+uint32_t __wake_up(struct wait_queue_head *wq, uint32_t nr_exclusive);
+bool waitqueue_active(struct wait_queue_head *wq);
+
+#define wake_up(wq)             __wake_up(wq, 1)
+#define wake_up_nr(wq, nr)      __wake_up(wq, nr)
+#define wake_up_all(wq)         __wake_up(wq, 0)
+
+/*
+ * Sleep until 'cond' is true. The condition is re-checked after queueing
+ * so a wakeup between the check and the sleep is not lost. Contexts that
+ * cannot sleep poll instead.
+ */
+#define wait_event(wq, cond) do {                                               \
+    struct wait_queue_entry __wait;                                             \
+    init_wait_entry(&__wait, 0);                                                \
+    while (!(cond)) {                                                           \
+        if (!sched_can_block()) {                                               \
+            cpu_relax();                                                        \
+            continue;                                                           \
+        }                                                                       \
+        prepare_to_wait(wq, &__wait);                                           \
+        if (cond) {                                                             \
+            break;                                                              \
+        }                                                                       \
+        schedule();                                                             \
+    }                                                                           \
+    finish_wait(wq, &__wait);                                                   \
+} while (0)
+
+/* Completions: one-shot or counted "work is done" signals */
+struct completion {
+    volatile uint32_t done;
+    struct wait_queue_head wait;
+};
+
+void init_completion(struct completion *x);
+void reinit_completion(struct completion *x);
+void complete(struct completion *x);
+void complete_all(struct completion *x);
+void wait_for_completion(struct completion *x);
+uint64_t wait_for_completion_timeout(struct completion *x, uint64_t timeout);
+bool try_wait_for_completion(struct completion *x);
+
+/* Sleeping mutex for long critical sections */
+struct mutex {
+    volatile int state;         /* 0 unlocked, 1 locked, 2 locked with waiters */
+    struct wait_queue_head wait;
+};
+
+void mutex_init(struct mutex *lock);
+void mutex_lock(struct mutex *lock);
+bool mutex_trylock(struct mutex *lock);
+void mutex_unlock(struct mutex *lock);
+
+#endif /* _WAIT_H */
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef _WORKQUEUE_H
+#define _WORKQUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Workqueue flags */
+#define WQ_UNBOUND              0x01    /* One shared pool, workers on any CPU */
+
+/* Default worker limits per pool */
+#define WQ_DFL_MAX_WORKERS      4
+#define WQ_UNBOUND_MAX_WORKERS  16
+
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+
+/* Deferred function call, embedded in the object it works on */
+struct work_struct {
+    struct work_struct *next;
+    work_func_t func;
+    volatile uint32_t pending;  /* Queued and not yet started */
+    uint64_t queued_at;         /* TSC at queue time, for latency stats */
+};
+
+#define INIT_WORK(work, fn) do {                                                \
+    (work)->next = NULL;                                                        \
+    (work)->func = (fn);                                                        \
+    (work)->pending = 0;                                                        \
+    (work)->queued_at = 0;                                                      \
+} while (0)
+
+#define work_entry(work, type, member) \
+    ((type *)((char *)(work) - offsetof(type, member)))
+
+/* Workqueues (kernel/sched/workqueue.c) */
+struct workqueue_struct;
+
+extern struct workqueue_struct *system_wq;
+extern struct workqueue_struct *system_unbound_wq;
+
+void workqueue_init(void);
+struct workqueue_struct *alloc_workqueue(const char *name, uint32_t flags, uint32_t max_workers);
+void destroy_workqueue(struct workqueue_struct *wq);
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work);
+bool queue_work_on(uint32_t cpu, struct workqueue_struct *wq, struct work_struct *work);
+bool schedule_work(struct work_struct *work);
+void flush_workqueue(struct workqueue_struct *wq);
+void workqueue_get_stats(struct workqueue_struct *wq, uint64_t *queued, uint64_t *executed,
+                         uint32_t *depth, uint32_t *max_depth, uint64_t *avg_latency,
+                         uint64_t *max_latency);
+void workqueue_report(void);
+
+#endif /* _WORKQUEUE_H */
\ No newline at end of file
@@ -0,0 +1,193 @@
+/*
+ * SentinalOS Locking Library
+ * Contention Benchmarks for Spinning Locks
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "smp.h"
+#include "sched.h"
+#include "kthread.h"
+#include "spinlock.h"
+
+/* One in this many reader-writer and seqlock operations is a write */
+#define LOCKBENCH_WRITE_RATIO   16
+
+enum lock_kind {
+    LOCK_TAS,
+    LOCK_TICKET,
+    LOCK_MCS,
+    LOCK_RWLOCK,
+    LOCK_SEQLOCK,
+    LOCK_KINDS
+};
+
+static const char *const lock_names[LOCK_KINDS] = {
+    "tas", "ticket", "mcs", "rwlock", "seqlock"
+};
+
+static struct {
+    enum lock_kind kind;
+    uint32_t iterations;
+    uint32_t hold_cycles;
+    volatile uint32_t ready;            /* Threads waiting at the start line */
+    volatile bool go;
+    
+    volatile int tas;
+    spinlock_t ticket;
+    mcs_lock_t mcs;
+    rwlock_t rwlock;
+    seqlock_t seqlock;
+    
+    volatile uint64_t counter;          /* Protected data: two words kept equal */
+    volatile uint64_t shadow;
+    volatile uint64_t torn;             /* Readers that saw counter != shadow */
+    uint64_t finish[MAX_CPUS];          /* TSC when each thread finished */
+} bench;
+
+static void bench_hold(void) {
+    uint64_t until = get_ticks() + bench.hold_cycles;
+    while (get_ticks() < until) {
+        cpu_relax();
+    }
+}
+
+static void bench_write(void) {
+    bench.counter++;
+    bench_hold();
+    bench.shadow++;
+}
+
+static void bench_read(void) {
+    uint64_t counter = bench.counter;
+    bench_hold();
+    if (counter != bench.shadow) {
+        __sync_fetch_and_add(&bench.torn, 1);
+    }
+}
+
+static int bench_thread(void *data) {
+    uint32_t cpu = (uint32_t)(uintptr_t)data;
+    
+    /* Start all CPUs together so every run is contended; yield to the starter meanwhile */
+    __sync_fetch_and_add(&bench.ready, 1);
+    while (!bench.go) {
+        schedule();
+    }
+    
+    for (uint32_t i = 0; i < bench.iterations; i++) {
+        bool write = (i % LOCKBENCH_WRITE_RATIO) == 0;
+        struct mcs_node node;
+        uint64_t flags;
+        
+        switch (bench.kind) {
+            case LOCK_TAS:
+                flags = local_irq_save();
+                while (__sync_lock_test_and_set(&bench.tas, 1)) {
+                    cpu_relax();
+                }
+                bench_write();
+                __sync_lock_release(&bench.tas);
+                local_irq_restore(flags);
+                break;
+            case LOCK_TICKET:
+                flags = spin_lock_irqsave(&bench.ticket);
+                bench_write();
+                spin_unlock_irqrestore(&bench.ticket, flags);
+                break;
+            case LOCK_MCS:
+                flags = mcs_lock_irqsave(&bench.mcs, &node);
+                bench_write();
+                mcs_unlock_irqrestore(&bench.mcs, &node, flags);
+                break;
+            case LOCK_RWLOCK:
+                if (write) {
+                    flags = write_lock_irqsave(&bench.rwlock);
+                    bench_write();
+                    write_unlock_irqrestore(&bench.rwlock, flags);
+                } else {
+                    flags = read_lock_irqsave(&bench.rwlock);
+                    bench_read();
+                    read_unlock_irqrestore(&bench.rwlock, flags);
+                }
+                break;
+            default:
+                if (write) {
+                    flags = write_seqlock_irqsave(&bench.seqlock);
+                    bench_write();
+                    write_sequnlock_irqrestore(&bench.seqlock, flags);
+                } else {
+                    uint32_t seq;
+                    uint64_t counter, shadow;
+                    do {
+                        seq = read_seqbegin(&bench.seqlock);
+                        counter = bench.counter;
+                        bench_hold();
+                        shadow = bench.shadow;
+                    } while (read_seqretry(&bench.seqlock, seq));
+                    if (counter != shadow) {
+                        __sync_fetch_and_add(&bench.torn, 1);
+                    }
+                }
+                break;
+        }
+    }
+    
+    bench.finish[cpu] = get_ticks();
+    return 0;
+}
+
+/*
+ * Lock contention benchmark: one thread per CPU runs 'iterations' critical
+ * sections of hold_cycles under each lock type. Reports cycles per
+ * operation and the spread between the first and last thread to finish:
+ * a fair lock keeps the spread small, test-and-set lets one CPU run ahead.
+ */
+void spinlock_benchmark(uint32_t iterations, uint32_t hold_cycles) {
+    uint32_t nr_cpus = smp_num_cpus();
+    struct kthread *threads[MAX_CPUS];
+    
+    KLOG_INFO("=== SPINLOCK BENCHMARK (%u CPUs, %u x %u cycles) ===",
+              nr_cpus, iterations, hold_cycles);
+    
+    for (int kind = 0; kind < LOCK_KINDS; kind++) {
+        bench.kind = kind;
+        bench.iterations = iterations;
+        bench.hold_cycles = hold_cycles;
+        bench.ready = 0;
+        bench.go = false;
+        bench.counter = bench.shadow = bench.torn = 0;
+        
+        uint32_t started = 0;
+        for (uint32_t cpu = 0; cpu < nr_cpus; cpu++) {
+            threads[cpu] = kthread_create_on_cpu(bench_thread, (void *)(uintptr_t)cpu, cpu,
+                                                 "lockbench");
+            if (threads[cpu]) {
+                started++;
+            }
+        }
+        while (bench.ready < started) {
+            schedule();
+        }
+        
+        uint64_t start = get_ticks();
+        bench.go = true;
+        uint64_t first = UINT64_MAX, last = 0;
+        for (uint32_t cpu = 0; cpu < nr_cpus; cpu++) {
+            if (!threads[cpu]) {
+                continue;
+            }
+            kthread_stop(threads[cpu]);
+            if (bench.finish[cpu] < first) first = bench.finish[cpu];
+            if (bench.finish[cpu] > last) last = bench.finish[cpu];
+        }
+        
+        uint64_t ops = (uint64_t)started * iterations;
+        uint64_t writes = (kind >= LOCK_RWLOCK) ?
+            (uint64_t)started * ((iterations + LOCKBENCH_WRITE_RATIO - 1) / LOCKBENCH_WRITE_RATIO) : ops;
+        KLOG_INFO("%-8s %lu cycles/op, finish spread %lu cycles, %s",
+                  lock_names[kind], ops ? (last - start) / ops : 0,
+                  started ? last - first : 0,
+                  bench.counter == writes && !bench.torn ? "consistent" : "INCONSISTENT");
+    }
+}
\ No newline at end of file
@@ -6,6 +6,13 @@
 
 #include "kernel.h"
 #include "string.h"
+#include "smp.h"
+#include "sched.h"
+#include "fpu.h"
+#include "ktime.h"
+#include "workqueue.h"
+#include "uaccess.h"
+#include "cpu.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdarg.h>
@@ -97,6 +104,13 @@ void console_puts(const char *s) {
     }
 }
 
+/* Bulk output, used by the console TTY's flush worker */
+void console_write(const char *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        console_putc(buf[i]);
+    }
+}
+
 int console_printf(const char *fmt, ...) {
     /* Simple printf implementation for early boot */
     va_list args;
@@ -184,7 +198,9 @@ void enable_cpu_security_features(void) {
                         : "a" (7), "c" (0));
     
     if (ebx & (1 << 0)) {
-        console_puts("[SECURITY] FSGSBASE supported\n");
+        /* Thread switches load the TLS base with WRFSBASE instead of an MSR write */
+        write_cr4(read_cr4() | CR4_FSGSBASE);
+        console_puts("[SECURITY] FSGSBASE enabled\n");
     }
     
     /* Check for Intel CET */
@@ -226,6 +242,7 @@ void cpu_init(void) {
 /* Declaration - actual implementation in various files */
 void mm_init(void);
 void scheduler_init(void);
+void syscall_init(void);
 void drivers_init(void);
 void security_init_comprehensive(void);
 void security_status_report(void);
@@ -293,9 +310,17 @@ void kernel_main(uint32_t multiboot_magic, struct multiboot_info *multiboot_info
     
     /* Initialize subsystems */
     cpu_init();
+    enable_cpu_security_features();
+    smp_init();
+    idt_init();
+    fpu_init();
+    uaccess_init();
     security_init();
     mm_init();
     scheduler_init();
+    syscall_init();
+    timer_init();
+    workqueue_init();
     drivers_init();
     
     /* Mark kernel as initialized */
@@ -308,11 +333,7 @@ void kernel_main(uint32_t multiboot_magic, struct multiboot_info *multiboot_info
     /* Display security status */
     security_status_report();
     
-    /* Main kernel loop */
-    console_puts("\n[KERNEL] Entering main loop...\n");
-    
-    while (1) {
-        /* Halt until interrupt */
-        __asm__ __volatile__("hlt");
-    }
+    /* The boot context becomes CPU 0's idle task */
+    console_puts("\n[KERNEL] Entering idle loop...\n");
+    cpu_idle_loop();
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
  */
 
 #include "kernel.h"
+#include "cpu.h"
 
 /* Memory layout constants */
 #define KERNEL_HEAP_START   0xFFFFFFFF90000000UL
@@ -288,6 +289,31 @@ void mm_set_page_protection(uint64_t vaddr, uint64_t flags) {
     (void)flags;
 }
 
+/*
+ * Translate a virtual address through the active page tables. Page
+ * tables are identity mapped, so each level is read directly.
+ */
+int mm_virt_to_phys(vaddr_t vaddr, paddr_t *paddr) {
+    uint64_t *table = (uint64_t *)(read_cr3() & 0x000FFFFFFFFFF000UL);
+    
+    for (int level = 3; level >= 0; level--) {
+        uint64_t entry = table[(vaddr >> (PAGE_SHIFT + 9 * level)) & 0x1FF];
+        if (!(entry & PAGE_PRESENT)) {
+            return -14; /* EFAULT */
+        }
+        
+        uint64_t frame = entry & 0x000FFFFFFFFFF000UL;
+        if (level == 0 || (level <= 2 && (entry & PAGE_HUGE))) {
+            uint64_t offset_mask = (1UL << (PAGE_SHIFT + 9 * level)) - 1;
+            *paddr = (frame & ~offset_mask) | (vaddr & offset_mask);
+            return 0;
+        }
+        table = (uint64_t *)frame;
+    }
+    
+    return -14; /* EFAULT */
+}
+
 void mm_enable_smep(void) {
     uint64_t cr4;
     __asm__ __volatile__("mov %%cr4, %0" : "=r" (cr4));
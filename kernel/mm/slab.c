@@ -0,0 +1,157 @@
+/*
+ * SentinalOS Slab Allocator
+ * Object Caches for Fixed-Size Kernel Structures
+ */
+
+#include "kernel.h"
+#include "string.h"
+#include "slab.h"
+#include "spinlock.h"
+
+/* Every slab holds at least this many objects */
+#define SLAB_MIN_OBJECTS        8
+
+/* Free objects are chained through their first word */
+struct slab_free {
+    struct slab_free *next;
+};
+
+struct kmem_cache {
+    const char *name;
+    size_t object_size;         /* Requested size */
+    size_t stride;              /* Object size rounded up to the alignment */
+    size_t slab_size;
+    uint32_t objs_per_slab;
+    spinlock_t lock;
+    struct slab_free *free_list;
+    
+    /* Statistics */
+    uint64_t active;            /* Objects handed out */
+    uint64_t total;             /* Objects in all slabs */
+    uint64_t slabs;
+    
+    struct kmem_cache *next;    /* All caches, for reporting */
+};
+
+static struct kmem_cache *cache_list;
+static spinlock_t cache_list_lock;
+
+/* Interrupt handlers allocate too, so the cache lock is taken with interrupts off */
+static uint64_t cache_lock(struct kmem_cache *cache) {
+    return spin_lock_irqsave(&cache->lock);
+}
+
+static void cache_unlock(struct kmem_cache *cache, uint64_t flags) {
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+/* Create a cache of 'size'-byte objects aligned to 'align' (0 for 8) */
+struct kmem_cache *kmem_cache_create(const char *name, size_t size, size_t align) {
+    if (!size || (align & (align - 1))) {
+        return NULL;
+    }
+    if (align < sizeof(void *)) {
+        align = sizeof(void *);
+    }
+    
+    struct kmem_cache *cache = kmalloc(sizeof(struct kmem_cache));
+    if (!cache) {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(*cache));
+    
+    cache->name = name;
+    cache->object_size = size;
+    cache->stride = (size + align - 1) & ~(align - 1);
+    cache->slab_size = (cache->stride * SLAB_MIN_OBJECTS + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    cache->objs_per_slab = cache->slab_size / cache->stride;
+    
+    spin_lock(&cache_list_lock);
+    cache->next = cache_list;
+    cache_list = cache;
+    spin_unlock(&cache_list_lock);
+    
+    return cache;
+}
+
+/* Carve a new slab into free objects (caller holds the cache lock) */
+static bool cache_grow(struct kmem_cache *cache) {
+    uint8_t *slab = kmalloc_aligned(cache->slab_size, PAGE_SIZE);
+    if (!slab) {
+        return false;
+    }
+    
+    /* Link in address order so consecutive allocations are adjacent */
+    for (int i = cache->objs_per_slab - 1; i >= 0; i--) {
+        struct slab_free *obj = (struct slab_free *)(slab + i * cache->stride);
+        obj->next = cache->free_list;
+        cache->free_list = obj;
+    }
+    
+    cache->total += cache->objs_per_slab;
+    cache->slabs++;
+    return true;
+}
+
+void *kmem_cache_alloc(struct kmem_cache *cache) {
+    if (!cache) {
+        return NULL;
+    }
+    
+    uint64_t flags = cache_lock(cache);
+    if (!cache->free_list && !cache_grow(cache)) {
+        cache_unlock(cache, flags);
+        return NULL;
+    }
+    
+    struct slab_free *obj = cache->free_list;
+    cache->free_list = obj->next;
+    cache->active++;
+    cache_unlock(cache, flags);
+    
+    return obj;
+}
+
+void *kmem_cache_zalloc(struct kmem_cache *cache) {
+    void *obj = kmem_cache_alloc(cache);
+    if (obj) {
+        memset(obj, 0, cache->object_size);
+    }
+    return obj;
+}
+
+void kmem_cache_free(struct kmem_cache *cache, void *obj) {
+    if (!cache || !obj) {
+        return;
+    }
+    
+    uint64_t flags = cache_lock(cache);
+    struct slab_free *free = obj;
+    free->next = cache->free_list;
+    cache->free_list = free;
+    cache->active--;
+    cache_unlock(cache, flags);
+}
+
+/* Get object statistics of one cache */
+void kmem_cache_get_stats(struct kmem_cache *cache, uint64_t *active, uint64_t *total,
+                          uint64_t *slabs) {
+    if (!cache) {
+        return;
+    }
+    
+    if (active) *active = cache->active;
+    if (total) *total = cache->total;
+    if (slabs) *slabs = cache->slabs;
+}
+
+/* Log object usage of every cache */
+void kmem_cache_report(void) {
+    KLOG_INFO("=== SLAB CACHES ===");
+    
+    for (struct kmem_cache *cache = cache_list; cache; cache = cache->next) {
+        KLOG_INFO("%-16s %6lu/%-6lu objects, %lu B stride, %lu slabs of %lu KB",
+                  cache->name, cache->active, cache->total, cache->stride,
+                  cache->slabs, cache->slab_size / 1024);
+    }
+}
\ No newline at end of file
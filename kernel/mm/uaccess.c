@@ -0,0 +1,226 @@
+/*
+ * SentinalOS User Memory Access
+ * SMAP-Aware Copies with Exception Table Fixups
+ */
+
+#include "kernel.h"
+#include "string.h"
+#include "cpu.h"
+#include "idt.h"
+#include "sched.h"
+#include "ktime.h"
+#include "uaccess.h"
+
+/* Linker-provided bounds of __ex_table (linker.ld) */
+extern const struct exception_table_entry __start___ex_table[];
+extern const struct exception_table_entry __stop___ex_table[];
+
+static struct {
+    bool erms;                  /* Fast REP MOVSB (CPUID.7:EBX bit 9) */
+    bool fsrm;                  /* Fast short REP MOVSB (CPUID.7:EDX bit 4) */
+    uint64_t fixups;            /* Faults recovered through the exception table */
+} uaccess_state;
+
+void uaccess_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    cpuid_count(0, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 7) {
+        cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+        uaccess_state.erms = ebx & (1 << 9);
+        uaccess_state.fsrm = edx & (1 << 4);
+    }
+    
+    KLOG_INFO("User copies: %s, %lu exception table entries",
+              uaccess_state.fsrm ? "REP MOVSB (FSRM)" :
+              uaccess_state.erms ? "REP MOVSB (ERMS)" : "REP MOVSQ",
+              (uint64_t)(__stop___ex_table - __start___ex_table));
+}
+
+/* Kernel pointers pass only inside syscall_handler(), the in-kernel syscall entry */
+bool uaccess_kernel_ok(const void *ptr, size_t size) {
+    return sched_uaccess_kernel() && (uint64_t)ptr + size >= (uint64_t)ptr;
+}
+
+static inline uint64_t ex_insn(const struct exception_table_entry *e) {
+    return (uint64_t)&e->insn + e->insn;
+}
+
+static inline uint64_t ex_fixup(const struct exception_table_entry *e) {
+    return (uint64_t)&e->fixup + e->fixup;
+}
+
+/*
+ * A kernel-mode fault: if the faulting instruction is a user access,
+ * resume at its fixup. The table holds a few entries per copy routine,
+ * so a linear scan on this rare path beats sorting it at boot.
+ */
+bool fixup_exception(struct pt_regs *regs) {
+    for (const struct exception_table_entry *e = __start___ex_table; e < __stop___ex_table; e++) {
+        if (ex_insn(e) == regs->rip) {
+            regs->rip = ex_fixup(e);
+            __atomic_fetch_add(&uaccess_state.fixups, 1, __ATOMIC_RELAXED);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* REP MOVSB: microcoded into wide moves on ERMS/FSRM parts. Returns the bytes left */
+static size_t copy_user_erms(void *to, const void *from, size_t n) {
+    __asm__ __volatile__(
+        "   stac\n"
+        "1: rep movsb\n"
+        "2: clac\n"
+        _ASM_EXTABLE(1b, 2b)
+        : "+D" (to), "+S" (from), "+c" (n)
+        :: "memory");
+    return n;
+}
+
+/* Quadwords, then the tail; a fault in the first pass counts the tail as left */
+static size_t copy_user_words(void *to, const void *from, size_t n) {
+    uint64_t tail;
+    __asm__ __volatile__(
+        "   stac\n"
+        "   mov %%rcx, %[tail]\n"
+        "   shr $3, %%rcx\n"
+        "   and $7, %[tail]\n"
+        "1: rep movsq\n"
+        "   mov %[tail], %%rcx\n"
+        "2: rep movsb\n"
+        "   jmp 4f\n"
+        "3: lea (%[tail], %%rcx, 8), %%rcx\n"
+        "4: clac\n"
+        _ASM_EXTABLE(1b, 3b)
+        _ASM_EXTABLE(2b, 4b)
+        : "+D" (to), "+S" (from), "+c" (n), [tail] "=&r" (tail)
+        :: "memory");
+    return n;
+}
+
+static inline size_t copy_user(void *to, const void *from, size_t n) {
+    if (uaccess_state.erms) {
+        return copy_user_erms(to, from, n);
+    }
+    return copy_user_words(to, from, n);
+}
+
+size_t __copy_from_user(void *to, const void *from, size_t n) {
+    size_t left = copy_user(to, from, n);
+    if (unlikely(left)) {
+        memset((uint8_t *)to + n - left, 0, left);
+    }
+    return left;
+}
+
+size_t __copy_to_user(void *to, const void *from, size_t n) {
+    return copy_user(to, from, n);
+}
+
+size_t copy_from_user(void *to, const void *from, size_t n) {
+    if (unlikely(!access_ok(from, n))) {
+        memset(to, 0, n);
+        return n;
+    }
+    return __copy_from_user(to, from, n);
+}
+
+size_t copy_to_user(void *to, const void *from, size_t n) {
+    if (unlikely(!access_ok(to, n))) {
+        return n;
+    }
+    return __copy_to_user(to, from, n);
+}
+
+/*
+ * Copy a NUL-terminated string of at most 'count' bytes. Returns its
+ * length, or 'count' if no NUL was found (dst is then unterminated), or
+ * -EFAULT. The string may end anywhere, so a range past USER_ADDR_MAX is
+ * clipped rather than refused.
+ */
+long strncpy_from_user(char *dst, const char *src, size_t count) {
+    uint64_t addr = (uint64_t)src;
+    if (addr > USER_ADDR_MAX) {
+        if (!uaccess_kernel_ok(src, count)) {
+            return -14; /* EFAULT */
+        }
+    } else if (count > USER_ADDR_MAX - addr) {
+        count = USER_ADDR_MAX - addr;
+    }
+    
+    long len;
+    uint8_t c;
+    __asm__ __volatile__(
+        "   stac\n"
+        "   xor %[len], %[len]\n"
+        "1: cmp %[count], %[len]\n"
+        "   je 4f\n"
+        "2: movb (%[src], %[len]), %[c]\n"
+        "   movb %[c], (%[dst], %[len])\n"
+        "   test %[c], %[c]\n"
+        "   jz 4f\n"
+        "   inc %[len]\n"
+        "   jmp 1b\n"
+        "3: mov $-14, %[len]\n"
+        "4: clac\n"
+        _ASM_EXTABLE(2b, 3b)
+        : [len] "=&r" (len), [c] "=&q" (c)
+        : [src] "r" (src), [dst] "r" (dst), [count] "r" (count)
+        : "memory", "cc");
+    return len;
+}
+
+/*
+ * Copy bandwidth: 'total_kb' KiB moved in 64 B to 64 KiB copies by
+ * memcpy() and by both user copy loops, kernel to kernel, so the cost of
+ * STAC/CLAC and the fixup-ready loops shows against the plain copy.
+ */
+void uaccess_benchmark(uint32_t total_kb) {
+    static const size_t sizes[] = { 64, 512, 4096, 65536 };
+    static const char *const names[] = { "memcpy", "movsb", "movsq" };
+    uint8_t *src = kmalloc(65536);
+    uint8_t *dst = kmalloc(65536);
+    if (!src || !dst) {
+        KLOG_WARN("uaccess benchmark: out of memory");
+        kfree(src);
+        kfree(dst);
+        return;
+    }
+    memset(src, 0x5A, 65536);
+    
+    KLOG_INFO("=== USER COPY BENCHMARK (%u KiB per run, %s) ===", total_kb,
+              uaccess_state.fsrm ? "FSRM" : uaccess_state.erms ? "ERMS" : "no ERMS");
+    
+    for (uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        uint64_t bytes = (uint64_t)total_kb * 1024;
+        uint64_t copies = bytes / sizes[s] ? bytes / sizes[s] : 1;
+        for (int method = 0; method < 3; method++) {
+            uint64_t start = get_ticks();
+            for (uint64_t i = 0; i < copies; i++) {
+                if (method == 0) {
+                    memcpy(dst, src, sizes[s]);
+                } else if (method == 1) {
+                    copy_user_erms(dst, src, sizes[s]);
+                } else {
+                    copy_user_words(dst, src, sizes[s]);
+                }
+            }
+            uint64_t cycles = get_ticks() - start;
+            
+            KLOG_INFO("%-6s %5lu B: %lu MiB/s, %lu cycles/copy", names[method],
+                      (uint64_t)sizes[s],
+                      cycles ? copies * sizes[s] * tsc_khz() / cycles * 1000 / (1024 * 1024) : 0,
+                      cycles / copies);
+        }
+    }
+    
+    /* A fault mid-copy must come back as a short count, not a panic */
+    uint64_t fixups = uaccess_state.fixups;
+    size_t left = copy_to_user((void *)(USER_ADDR_MAX - 64), src, 64);
+    KLOG_INFO("copy to unmapped user page: %lu of 64 bytes left, %lu fixups",
+              (uint64_t)left, uaccess_state.fixups - fixups);
+    
+    kfree(src);
+    kfree(dst);
+}
\ No newline at end of file
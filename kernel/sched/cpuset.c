@@ -0,0 +1,151 @@
+/*
+ * SentinalOS CPU Sets
+ * Partitioning CPUs and Memory Nodes Between Task Groups
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "string.h"
+#include "sched.h"
+#include "cpuset.h"
+#include "spinlock.h"
+
+static struct cpuset cpusets[CPUSET_MAX];
+static spinlock_t cpuset_lock_word;
+
+static uint64_t cpuset_lock(void) {
+    return spin_lock_irqsave(&cpuset_lock_word);
+}
+
+static void cpuset_unlock(uint64_t flags) {
+    spin_unlock_irqrestore(&cpuset_lock_word, flags);
+}
+
+/* Look up a live set (caller holds the lock) */
+static struct cpuset *cpuset_find(int id) {
+    if (id < 0 || id >= CPUSET_MAX || !cpusets[id].in_use) {
+        return NULL;
+    }
+    return &cpusets[id];
+}
+
+/* The root set spans every CPU index and every node; online state is applied at use */
+void cpuset_init(void) {
+    struct cpuset *root = &cpusets[CPUSET_ROOT];
+    
+    memset(cpusets, 0, sizeof(cpusets));
+    root->id = CPUSET_ROOT;
+    strcpy(root->name, "root");
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        cpumask_set_cpu(cpu, &root->cpus);
+    }
+    root->mems = (1ULL << MAX_NUMA_NODES) - 1;
+    root->in_use = true;
+    
+    KLOG_INFO("CPU sets initialized (%u sets max)", CPUSET_MAX);
+}
+
+struct cpuset *cpuset_root(void) {
+    return &cpusets[CPUSET_ROOT];
+}
+
+/* Create a child of 'parent' restricted to cpus and mems; returns the set id */
+int cpuset_create(const char *name, int parent, const cpumask_t *cpus, uint64_t mems) {
+    if (!name || !cpus || cpumask_empty(cpus) || !mems) {
+        return -22; /* EINVAL */
+    }
+    
+    uint64_t flags = cpuset_lock();
+    struct cpuset *up = cpuset_find(parent);
+    if (!up || !cpumask_subset(cpus, &up->cpus) || (mems & ~up->mems)) {
+        cpuset_unlock(flags);
+        return -22; /* EINVAL */
+    }
+    
+    int id = 1;
+    while (id < CPUSET_MAX && cpusets[id].in_use) {
+        id++;
+    }
+    if (id == CPUSET_MAX) {
+        cpuset_unlock(flags);
+        return -28; /* ENOSPC */
+    }
+    
+    struct cpuset *cs = &cpusets[id];
+    memset(cs, 0, sizeof(*cs));
+    cs->id = id;
+    strncpy(cs->name, name, sizeof(cs->name) - 1);
+    cs->cpus = *cpus;
+    cs->mems = mems;
+    cs->parent = up;
+    cs->in_use = true;
+    up->nr_children++;
+    cpuset_unlock(flags);
+    
+    KLOG_INFO("cpuset %d (%s): %u CPUs, nodes 0x%lx", id, cs->name, cpumask_weight(cpus), mems);
+    return id;
+}
+
+/* Remove an empty set */
+int cpuset_destroy(int id) {
+    if (id == CPUSET_ROOT) {
+        return -1; /* EPERM */
+    }
+    
+    uint64_t flags = cpuset_lock();
+    struct cpuset *cs = cpuset_find(id);
+    if (!cs) {
+        cpuset_unlock(flags);
+        return -2; /* ENOENT */
+    }
+    if (cs->nr_tasks || cs->nr_children) {
+        cpuset_unlock(flags);
+        return -16; /* EBUSY */
+    }
+    cs->parent->nr_children--;
+    cs->in_use = false;
+    cpuset_unlock(flags);
+    
+    return 0;
+}
+
+/* Move a task into a set; its affinity becomes the set's CPUs */
+int cpuset_attach(uint64_t pid, int id) {
+    uint64_t flags = cpuset_lock();
+    struct cpuset *cs = cpuset_find(id);
+    if (cs) {
+        cs->nr_tasks++; /* Pin against cpuset_destroy() */
+    }
+    cpuset_unlock(flags);
+    if (!cs) {
+        return -2; /* ENOENT */
+    }
+    
+    int ret = sched_set_cpuset(pid, cs);
+    if (ret < 0) {
+        cpuset_release(cs);
+    }
+    return ret;
+}
+
+/* Task references: one per member task */
+void cpuset_hold(struct cpuset *cs) {
+    __sync_fetch_and_add(&cs->nr_tasks, 1);
+}
+
+void cpuset_release(struct cpuset *cs) {
+    __sync_fetch_and_sub(&cs->nr_tasks, 1);
+}
+
+void cpuset_report(void) {
+    KLOG_INFO("=== CPU SETS ===");
+    for (int id = 0; id < CPUSET_MAX; id++) {
+        struct cpuset *cs = &cpusets[id];
+        if (!cs->in_use) {
+            continue;
+        }
+        KLOG_INFO("%2d %-16s parent %2d, cpus 0x%lx, nodes 0x%lx, %u tasks",
+                  id, cs->name, cs->parent ? cs->parent->id : -1,
+                  cs->cpus.bits[0], cs->mems, cs->nr_tasks);
+    }
+}
\ No newline at end of file
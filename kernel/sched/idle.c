@@ -0,0 +1,112 @@
+/*
+ * SentinalOS Idle Loop
+ * MWAIT/HLT Idle with Tickless Operation
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "smp.h"
+#include "sched.h"
+#include "ktime.h"
+#include "rcu.h"
+
+/* Expected idle time above which the deepest MWAIT C-state is used */
+#define IDLE_DEEP_THRESHOLD_NS  (2 * NSEC_PER_MSEC)
+
+static struct {
+    bool mwait;
+    uint32_t shallow_hint;      /* C1 */
+    uint32_t deep_hint;         /* Deepest enumerated C-state */
+    
+    /* Statistics */
+    uint64_t mwait_entries;
+    uint64_t deep_entries;
+    uint64_t hlt_entries;
+} idle_state;
+
+/* Probe MONITOR/MWAIT and the C-states it can enter */
+void idle_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    cpuid_count(1, 0, &eax, &ebx, &ecx, &edx);
+    idle_state.mwait = ecx & (1 << 3);
+    idle_state.shallow_hint = 0;
+    idle_state.deep_hint = 0;
+    
+    if (idle_state.mwait) {
+        cpuid_count(0, 0, &eax, &ebx, &ecx, &edx);
+        if (eax >= 5) {
+            cpuid_count(5, 0, &eax, &ebx, &ecx, &edx);
+            
+            /* EDX holds the number of sub-states per C-state, 4 bits each from C0 */
+            for (uint32_t cstate = 7; cstate >= 1; cstate--) {
+                uint32_t substates = (edx >> (cstate * 4)) & 0xF;
+                if (substates) {
+                    idle_state.deep_hint = ((cstate - 1) << 4) | (substates - 1);
+                    break;
+                }
+            }
+        }
+    }
+    
+    KLOG_INFO("Idle: %s (deep hint 0x%x)", idle_state.mwait ? "MWAIT" : "HLT",
+              idle_state.deep_hint);
+}
+
+/*
+ * Wait for an interrupt or a write to need_resched. Entered with
+ * interrupts disabled; STI's one-instruction shadow covers the HLT/MWAIT
+ * so a wakeup interrupt cannot slip in before the CPU sleeps.
+ */
+static void cpu_idle_wait(struct percpu *pc, uint64_t expected_ns) {
+    if (!idle_state.mwait) {
+        idle_state.hlt_entries++;
+        __asm__ __volatile__("sti; hlt; cli" ::: "memory");
+        return;
+    }
+    
+    uint32_t hint = idle_state.shallow_hint;
+    if (expected_ns >= IDLE_DEEP_THRESHOLD_NS) {
+        hint = idle_state.deep_hint;
+        idle_state.deep_entries++;
+    }
+    idle_state.mwait_entries++;
+    
+    pc->polling = true;
+    mb(); /* Pairs with resched_cpu(): flag write, then polling check */
+    
+    __asm__ __volatile__("monitor" :: "a" (&pc->need_resched), "c" (0), "d" (0));
+    if (!pc->need_resched) {
+        __asm__ __volatile__("sti; mwait; cli" :: "a" (hint), "c" (0) : "memory");
+    }
+    
+    pc->polling = false;
+}
+
+/* Get idle entry statistics */
+void idle_get_stats(uint64_t *mwait_entries, uint64_t *deep_entries, uint64_t *hlt_entries) {
+    if (mwait_entries) *mwait_entries = idle_state.mwait_entries;
+    if (deep_entries) *deep_entries = idle_state.deep_entries;
+    if (hlt_entries) *hlt_entries = idle_state.hlt_entries;
+}
+
+/* Per-CPU idle loop, run by each CPU's idle task; never returns */
+void cpu_idle_loop(void) {
+    struct percpu *pc = this_cpu();
+    
+    KLOG_INFO("CPU %u entering idle loop", pc->cpu_id);
+    
+    for (;;) {
+        disable_interrupts();
+        while (!pc->need_resched) {
+            rcu_idle_enter();
+            uint64_t expected_ns = tick_nohz_idle_enter();
+            cpu_idle_wait(pc, expected_ns);
+            tick_nohz_idle_exit();
+            rcu_idle_exit();
+        }
+        enable_interrupts();
+        
+        schedule();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+/*
+ * SentinalOS Kernel Threads
+ * Creating and Stopping Kernel Worker Threads
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "sched.h"
+#include "slab.h"
+#include "wait.h"
+#include "kthread.h"
+#include "spinlock.h"
+
+struct kthread {
+    int (*fn)(void *data);
+    void *data;
+    spinlock_t lock;
+    struct task *task;          /* NULL once fn has returned */
+    volatile bool should_stop;
+    volatile bool finished;     /* Last touch of this structure by the thread */
+    int result;
+    struct completion exited;
+};
+
+static struct kmem_cache *kthread_cache;
+static spinlock_t kthread_cache_lock;
+
+static uint64_t kthread_lock(struct kthread *k) {
+    return spin_lock_irqsave(&k->lock);
+}
+
+static void kthread_unlock(struct kthread *k, uint64_t flags) {
+    spin_unlock_irqrestore(&k->lock, flags);
+}
+
+/* First code of every kernel thread */
+static void kthread_main(void *arg) {
+    struct kthread *k = arg;
+    int result = k->fn(k->data);
+    
+    /* The task is about to exit: kthread_stop() must not wake it any more */
+    uint64_t flags = kthread_lock(k);
+    k->result = result;
+    k->task = NULL;
+    kthread_unlock(k, flags);
+    
+    complete_all(&k->exited);
+    k->finished = true;
+}
+
+static struct kthread *kthread_alloc(int (*fn)(void *data), void *data) {
+    if (!kthread_cache) {
+        spin_lock(&kthread_cache_lock);
+        if (!kthread_cache) {
+            kthread_cache = kmem_cache_create("kthread", sizeof(struct kthread), 0);
+        }
+        spin_unlock(&kthread_cache_lock);
+    }
+    
+    struct kthread *k = kmem_cache_zalloc(kthread_cache);
+    if (!k) {
+        return NULL;
+    }
+    k->fn = fn;
+    k->data = data;
+    init_completion(&k->exited);
+    return k;
+}
+
+static struct kthread *__kthread_create(int (*fn)(void *data), void *data, int cpu,
+                                        const char *name) {
+    struct kthread *k = kthread_alloc(fn, data);
+    if (!k) {
+        return NULL;
+    }
+    
+    /* Hold the lock so the thread cannot exit before k->task is set */
+    uint64_t flags = kthread_lock(k);
+    k->task = sched_create_kthread(name, kthread_main, k, k, cpu);
+    bool created = k->task != NULL;
+    kthread_unlock(k, flags);
+    
+    if (!created) {
+        kmem_cache_free(kthread_cache, k);
+        return NULL;
+    }
+    return k;
+}
+
+/* Start a kernel thread on any CPU */
+struct kthread *kthread_create(int (*fn)(void *data), void *data, const char *name) {
+    return __kthread_create(fn, data, -1, name);
+}
+
+/* Start a kernel thread bound to one CPU */
+struct kthread *kthread_create_on_cpu(int (*fn)(void *data), void *data, uint32_t cpu,
+                                      const char *name) {
+    return __kthread_create(fn, data, (int)cpu, name);
+}
+
+/* Should the running kernel thread return from its function? */
+bool kthread_should_stop(void) {
+    struct kthread *k = sched_current_kthread();
+    return k && k->should_stop;
+}
+
+/*
+ * Ask a kernel thread to stop, wake it so it notices, and wait for its
+ * function to return. Returns that function's result.
+ */
+int kthread_stop(struct kthread *k) {
+    if (!k) {
+        return -22; /* EINVAL */
+    }
+    
+    uint64_t flags = kthread_lock(k);
+    k->should_stop = true;
+    if (k->task) {
+        sched_wake_up(k->task);
+    }
+    kthread_unlock(k, flags);
+    
+    wait_for_completion(&k->exited);
+    while (!k->finished) {
+        cpu_relax();
+    }
+    int result = k->result;
+    kmem_cache_free(kthread_cache, k);
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,157 @@
+/*
+ * SentinalOS Preemption Latency Tracer
+ * Worst-Case Non-Preemptible Sections
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "string.h"
+#include "smp.h"
+#include "ktime.h"
+#include "spinlock.h"
+#include "preempt.h"
+
+/* Return addresses kept for the worst section */
+#define LATENCY_STACK_DEPTH     16
+
+/*
+ * Per-CPU open section. Only its own CPU writes it, from the preempt
+ * count transitions, with the count still nonzero.
+ */
+struct latency_cpu {
+    uint64_t start;             /* TSC when preemption went off, 0 if untraced */
+    uintptr_t start_ip;
+    uint64_t sections;
+} __aligned(64);
+
+static struct latency_cpu latency_cpus[MAX_CPUS];
+
+/* Worst section so far, with the stack at its end */
+static struct {
+    spinlock_t lock;            /* Taken raw: preemption is off already */
+    uint64_t max_cycles;
+    uint32_t cpu;
+    uintptr_t start_ip;
+    uintptr_t end_ip;
+    uint32_t depth;
+    uintptr_t stack[LATENCY_STACK_DEPTH];
+} latency_max;
+
+volatile bool latency_tracing = false;
+
+/* Walk the frame pointer chain up from 'fp' (built with -fno-omit-frame-pointer) */
+static uint32_t latency_save_stack(uintptr_t *fp, uintptr_t *stack, uint32_t max) {
+    uint32_t depth = 0;
+    
+    while (fp && depth < max) {
+        uintptr_t ret = fp[1];
+        if (!ret) {
+            break;
+        }
+        stack[depth++] = ret;
+        
+        /* Callers' frames sit above ours on the same stack */
+        uintptr_t *next = (uintptr_t *)fp[0];
+        if (next <= fp || ((uintptr_t)next & 7) ||
+            (uintptr_t)next - (uintptr_t)fp > KERNEL_STACK_SIZE) {
+            break;
+        }
+        fp = next;
+    }
+    return depth;
+}
+
+/* The preempt count just left zero on this CPU */
+void latency_trace_off(void) {
+    struct latency_cpu *lc = &latency_cpus[smp_processor_id()];
+    lc->start_ip = (uintptr_t)__builtin_return_address(0);
+    lc->start = get_ticks();
+}
+
+/* The preempt count is about to return to zero on this CPU */
+void latency_trace_on(void) {
+    uint64_t now = get_ticks();
+    uint32_t cpu = smp_processor_id();
+    struct latency_cpu *lc = &latency_cpus[cpu];
+    
+    /* Section opened before tracing started */
+    if (!lc->start) {
+        return;
+    }
+    uint64_t delta = now - lc->start;
+    lc->start = 0;
+    lc->sections++;
+    
+    if (delta <= latency_max.max_cycles) {
+        return;
+    }
+    
+    uint64_t flags = local_irq_save();
+    raw_spin_lock(&latency_max.lock);
+    if (delta > latency_max.max_cycles) {
+        latency_max.max_cycles = delta;
+        latency_max.cpu = cpu;
+        latency_max.start_ip = lc->start_ip;
+        latency_max.end_ip = (uintptr_t)__builtin_return_address(0);
+        latency_max.depth = latency_save_stack(__builtin_frame_address(0), latency_max.stack,
+                                               LATENCY_STACK_DEPTH);
+    }
+    raw_spin_unlock(&latency_max.lock);
+    local_irq_restore(flags);
+}
+
+/* Forget the previous maximum and trace from now on */
+void latency_tracer_start(void) {
+    latency_tracing = false;
+    
+    uint64_t flags = local_irq_save();
+    raw_spin_lock(&latency_max.lock);
+    latency_max.max_cycles = 0;
+    latency_max.depth = 0;
+    raw_spin_unlock(&latency_max.lock);
+    local_irq_restore(flags);
+    
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        latency_cpus[cpu].start = 0;
+        latency_cpus[cpu].sections = 0;
+    }
+    mb();
+    latency_tracing = true;
+}
+
+void latency_tracer_stop(void) {
+    latency_tracing = false;
+}
+
+/* Log the worst non-preemptible section and where it ended */
+void latency_tracer_report(void) {
+    uint64_t sections = 0;
+    for (uint32_t cpu = 0; cpu < smp_num_cpus(); cpu++) {
+        sections += latency_cpus[cpu].sections;
+    }
+    
+    /* Snapshot: a new maximum may be recorded while we log */
+    uint64_t flags = local_irq_save();
+    raw_spin_lock(&latency_max.lock);
+    uint64_t max_cycles = latency_max.max_cycles;
+    uint32_t max_cpu = latency_max.cpu;
+    uintptr_t start_ip = latency_max.start_ip, end_ip = latency_max.end_ip;
+    uint32_t depth = latency_max.depth;
+    uintptr_t stack[LATENCY_STACK_DEPTH];
+    memcpy(stack, latency_max.stack, sizeof(stack));
+    raw_spin_unlock(&latency_max.lock);
+    local_irq_restore(flags);
+    
+    KLOG_INFO("=== PREEMPTION LATENCY TRACER (%s) ===", latency_tracing ? "running" : "stopped");
+    KLOG_INFO("%lu non-preemptible sections traced", sections);
+    if (!max_cycles) {
+        return;
+    }
+    
+    KLOG_INFO("Worst: %lu ns (%lu cycles) on CPU %u", tsc_cycles_to_ns(max_cycles), max_cycles,
+              max_cpu);
+    KLOG_INFO("  preemption disabled at 0x%lx, enabled at 0x%lx", start_ip, end_ip);
+    for (uint32_t i = 0; i < depth; i++) {
+        KLOG_INFO("  #%u 0x%lx", i, stack[i]);
+    }
+}
\ No newline at end of file
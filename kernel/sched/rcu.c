@@ -0,0 +1,515 @@
+/*
+ * SentinalOS Read-Copy-Update
+ * Quiescent-State Based Grace Periods
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "string.h"
+#include "smp.h"
+#include "sched.h"
+#include "ktime.h"
+#include "cpumask.h"
+#include "spinlock.h"
+#include "wait.h"
+#include "workqueue.h"
+#include "kthread.h"
+#include "rcu.h"
+
+/*
+ * Per-CPU callback segments. 'next' callbacks have no grace period yet,
+ * 'wait' callbacks run once grace period wait_gp has completed, 'done'
+ * callbacks are ready and run from system_wq on this CPU. All three are
+ * only touched by their CPU with interrupts disabled.
+ */
+struct rcu_data {
+    struct rcu_head *next_list;
+    struct rcu_head **next_tail;
+    struct rcu_head *wait_list;
+    struct rcu_head **wait_tail;
+    uint64_t wait_gp;
+    struct rcu_head *done_list;
+    struct rcu_head **done_tail;
+    
+    uint64_t qs_gp;             /* Last grace period this CPU reported for */
+    volatile bool idle;         /* In the idle loop: holds no readers */
+    volatile uint32_t irq_nesting;
+    struct work_struct work;
+    uint64_t invoked;
+} __aligned(64);
+
+/* Grace period state */
+static struct {
+    spinlock_t lock;
+    volatile uint64_t gp_seq;       /* Last grace period started */
+    volatile uint64_t completed;    /* Last grace period finished */
+    uint64_t gp_requested;          /* Highest grace period a callback waits for */
+    cpumask_t pending;              /* CPUs yet to pass a quiescent state in gp_seq */
+    uint64_t nr_gps;
+    bool initialized;
+} rcu_state;
+
+static struct rcu_data rcu_data[MAX_CPUS];
+
+static void rcu_do_batch(struct work_struct *work);
+
+void rcu_init(void) {
+    memset(&rcu_state, 0, sizeof(rcu_state));
+    
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        struct rcu_data *rdp = &rcu_data[cpu];
+        memset(rdp, 0, sizeof(*rdp));
+        rdp->next_tail = &rdp->next_list;
+        rdp->wait_tail = &rdp->wait_list;
+        rdp->done_tail = &rdp->done_list;
+        INIT_WORK(&rdp->work, rcu_do_batch);
+    }
+    rcu_state.initialized = true;
+}
+
+/*
+ * Start the next grace period if a callback wants one and none is running
+ * (rcu_state.lock held). CPUs idle outside an interrupt cannot be inside a
+ * reader and are not waited for.
+ */
+static void rcu_start_gp(void) {
+    while (rcu_state.gp_seq == rcu_state.completed &&
+           rcu_state.gp_requested > rcu_state.completed) {
+        rcu_state.gp_seq++;
+        mb(); /* Pairs with rcu_idle_exit(): a CPU counted idle sees all earlier unlinks */
+        
+        cpumask_clear(&rcu_state.pending);
+        for (uint32_t cpu = 0; cpu < smp_num_cpus(); cpu++) {
+            if (!rcu_data[cpu].idle || rcu_data[cpu].irq_nesting) {
+                cpumask_set_cpu(cpu, &rcu_state.pending);
+            }
+        }
+        
+        if (cpumask_empty(&rcu_state.pending)) {
+            rcu_state.completed = rcu_state.gp_seq;
+            rcu_state.nr_gps++;
+            continue;
+        }
+        
+        /* A busy CPU with its tick stopped would never report: restart the tick */
+        for (uint32_t cpu = 0; cpu < smp_num_cpus(); cpu++) {
+            if (cpumask_test_cpu(cpu, &rcu_state.pending)) {
+                tick_nohz_dep_changed(cpu);
+            }
+        }
+    }
+}
+
+/* This CPU passed a quiescent state: every reader it started earlier has finished */
+static void rcu_report_qs(struct rcu_data *rdp, uint32_t cpu) {
+    if (rdp->qs_gp == rcu_state.gp_seq || rcu_state.gp_seq == rcu_state.completed) {
+        return;
+    }
+    
+    uint64_t flags = spin_lock_irqsave(&rcu_state.lock);
+    rdp->qs_gp = rcu_state.gp_seq;
+    if (cpumask_test_cpu(cpu, &rcu_state.pending)) {
+        cpumask_clear_cpu(cpu, &rcu_state.pending);
+        if (cpumask_empty(&rcu_state.pending)) {
+            rcu_state.completed = rcu_state.gp_seq;
+            rcu_state.nr_gps++;
+            rcu_start_gp();
+        }
+    }
+    spin_unlock_irqrestore(&rcu_state.lock, flags);
+}
+
+/* Move callbacks along their segments (interrupts disabled) */
+static void rcu_advance_cbs(struct rcu_data *rdp, uint32_t cpu) {
+    if (rdp->wait_list && rcu_state.completed >= rdp->wait_gp) {
+        *rdp->done_tail = rdp->wait_list;
+        rdp->done_tail = rdp->wait_tail;
+        rdp->wait_list = NULL;
+        rdp->wait_tail = &rdp->wait_list;
+    }
+    
+    if (!rdp->wait_list && rdp->next_list) {
+        rdp->wait_list = rdp->next_list;
+        rdp->wait_tail = rdp->next_tail;
+        rdp->next_list = NULL;
+        rdp->next_tail = &rdp->next_list;
+        
+        /* Only a grace period starting after this point covers them */
+        spin_lock(&rcu_state.lock);
+        rdp->wait_gp = rcu_state.gp_seq + 1;
+        if (rcu_state.gp_requested < rdp->wait_gp) {
+            rcu_state.gp_requested = rdp->wait_gp;
+        }
+        rcu_start_gp();
+        spin_unlock(&rcu_state.lock);
+    }
+    
+    if (rdp->done_list && system_wq) {
+        queue_work_on(cpu, system_wq, &rdp->work);
+    }
+}
+
+/* Run this CPU's finished callbacks (system_wq, bound to the CPU) */
+static void rcu_do_batch(struct work_struct *work) {
+    struct rcu_data *rdp = work_entry(work, struct rcu_data, work);
+    
+    uint64_t flags = local_irq_save();
+    struct rcu_head *list = rdp->done_list;
+    rdp->done_list = NULL;
+    rdp->done_tail = &rdp->done_list;
+    local_irq_restore(flags);
+    
+    while (list) {
+        struct rcu_head *next = list->next;
+        list->func(list);
+        __sync_fetch_and_add(&rdp->invoked, 1);
+        list = next;
+    }
+}
+
+/* Queue func(head) to run after the next full grace period */
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head)) {
+    head->func = func;
+    head->next = NULL;
+    
+    uint64_t flags = local_irq_save();
+    uint32_t cpu = smp_processor_id();
+    struct rcu_data *rdp = &rcu_data[cpu];
+    *rdp->next_tail = head;
+    rdp->next_tail = &head->next;
+    rcu_advance_cbs(rdp, cpu);
+    local_irq_restore(flags);
+}
+
+struct rcu_synchronize {
+    struct rcu_head head;
+    struct completion done;
+};
+
+static void rcu_wakeme(struct rcu_head *head) {
+    complete(&rcu_entry(head, struct rcu_synchronize, head)->done);
+}
+
+/* Wait until all readers that could still see unlinked data have finished */
+void synchronize_rcu(void) {
+    /*
+     * Blocking here is itself a quiescent state, so with one CPU the grace
+     * period is already over. Before workqueues exist no other CPU runs
+     * readers.
+     */
+    if (!rcu_state.initialized || !system_wq || smp_num_cpus() == 1) {
+        return;
+    }
+    
+    struct rcu_synchronize rs;
+    init_completion(&rs.done);
+    call_rcu(&rs.head, rcu_wakeme);
+    wait_for_completion(&rs.done);
+}
+
+/* Called by schedule() and cond_resched(): a context switch point is quiescent */
+void rcu_note_context_switch(void) {
+    struct percpu *pc = this_cpu();
+    if (unlikely(pc->rcu_nesting)) {
+        KLOG_WARN("CPU %u: scheduling inside an RCU read side critical section",
+                  pc->cpu_id);
+        return;
+    }
+    rcu_report_qs(&rcu_data[pc->cpu_id], pc->cpu_id);
+}
+
+/* Tick: 'quiescent' if the tick interrupted the idle task or preemptible code */
+void rcu_sched_clock_irq(bool quiescent) {
+    uint32_t cpu = smp_processor_id();
+    struct rcu_data *rdp = &rcu_data[cpu];
+    
+    if (quiescent) {
+        rcu_report_qs(rdp, cpu);
+    }
+    rcu_advance_cbs(rdp, cpu);
+}
+
+/* Idle loop entry, interrupts disabled */
+void rcu_idle_enter(void) {
+    uint32_t cpu = smp_processor_id();
+    struct rcu_data *rdp = &rcu_data[cpu];
+    
+    rdp->idle = true;
+    mb(); /* Pairs with rcu_start_gp(): it sees us idle, or we see its grace period */
+    rcu_report_qs(rdp, cpu);
+}
+
+void rcu_idle_exit(void) {
+    rcu_data[smp_processor_id()].idle = false;
+    mb(); /* Readers from here on see everything unlinked before a grace period started */
+}
+
+/* Interrupt entry: handlers may read even when the CPU is idle */
+void rcu_irq_enter(void) {
+    struct rcu_data *rdp = &rcu_data[smp_processor_id()];
+    rdp->irq_nesting++;
+    if (rdp->idle) {
+        mb(); /* As rcu_idle_exit() */
+    }
+}
+
+void rcu_irq_exit(void) {
+    uint32_t cpu = smp_processor_id();
+    struct rcu_data *rdp = &rcu_data[cpu];
+    
+    if (rdp->idle) {
+        mb(); /* The handler's reads complete before we count as idle again */
+        rdp->irq_nesting--;
+        if (!rdp->irq_nesting) {
+            rcu_report_qs(rdp, cpu);
+        }
+        return;
+    }
+    rdp->irq_nesting--;
+}
+
+/* Does this CPU need its tick for RCU (callbacks queued or a report owed)? */
+bool rcu_needs_cpu(void) {
+    uint32_t cpu = smp_processor_id();
+    struct rcu_data *rdp = &rcu_data[cpu];
+    return rdp->next_list || rdp->wait_list ||
+           cpumask_test_cpu(cpu, &rcu_state.pending);
+}
+
+/* Get grace periods completed and callbacks invoked */
+void rcu_get_stats(uint64_t *grace_periods, uint64_t *callbacks) {
+    uint64_t invoked = 0;
+    for (uint32_t cpu = 0; cpu < smp_num_cpus(); cpu++) {
+        invoked += rcu_data[cpu].invoked;
+    }
+    
+    if (grace_periods) *grace_periods = rcu_state.nr_gps;
+    if (callbacks) *callbacks = invoked;
+}
+
+/* Reader scaling benchmark */
+#define RCUBENCH_NODES          32
+#define RCUBENCH_UPDATE_RATIO   256     /* The first reader replaces a node this often */
+#define RCUBENCH_MAGIC          0x52435521
+
+enum rcubench_mode {
+    RCUBENCH_RCU,
+    RCUBENCH_RWLOCK,
+    RCUBENCH_SPINLOCK,
+    RCUBENCH_MODES
+};
+
+static const char *const rcubench_names[RCUBENCH_MODES] = {
+    "rcu", "rwlock", "spinlock"
+};
+
+struct rcubench_node {
+    struct rcubench_node *next;
+    uint32_t key;
+    volatile uint32_t magic;
+    struct rcu_head rcu;
+};
+
+static struct {
+    enum rcubench_mode mode;
+    uint32_t iterations;
+    volatile uint32_t ready;
+    volatile bool go;
+    
+    struct rcubench_node *head;
+    spinlock_t lock;            /* Writers in every mode, readers in spinlock mode */
+    rwlock_t rwlock;
+    
+    volatile uint64_t bad;      /* Lookups that found no node or a freed one */
+    uint64_t cycles[MAX_CPUS];
+} rcubench;
+
+static void rcubench_free(struct rcu_head *head) {
+    struct rcubench_node *node = rcu_entry(head, struct rcubench_node, rcu);
+    node->magic = 0;
+    kfree(node);
+}
+
+static bool rcubench_lookup(uint32_t key) {
+    struct rcubench_node *node;
+    bool found = false;
+    
+    rcu_list_for_each(node, rcubench.head, next) {
+        if (node->key == key) {
+            found = node->magic == RCUBENCH_MAGIC;
+            break;
+        }
+    }
+    return found;
+}
+
+/* Replace the node for 'key' with a copy, as an update of a read-mostly list would */
+static void rcubench_update(uint32_t key) {
+    struct rcubench_node *copy = kmalloc(sizeof(*copy));
+    if (!copy) {
+        return;
+    }
+    copy->key = key;
+    copy->magic = RCUBENCH_MAGIC;
+    
+    uint64_t flags = rcubench.mode == RCUBENCH_RWLOCK ? write_lock_irqsave(&rcubench.rwlock)
+                                                      : spin_lock_irqsave(&rcubench.lock);
+    struct rcubench_node **link = &rcubench.head;
+    while (*link && (*link)->key != key) {
+        link = &(*link)->next;
+    }
+    struct rcubench_node *old = *link;
+    if (old) {
+        copy->next = old->next;
+        rcu_assign_pointer(*link, copy);
+    }
+    if (rcubench.mode == RCUBENCH_RWLOCK) {
+        write_unlock_irqrestore(&rcubench.rwlock, flags);
+    } else {
+        spin_unlock_irqrestore(&rcubench.lock, flags);
+    }
+    
+    if (!old) {
+        kfree(copy);
+    } else if (rcubench.mode == RCUBENCH_RCU) {
+        call_rcu(&old->rcu, rcubench_free);
+    } else {
+        rcubench_free(&old->rcu);
+    }
+}
+
+static int rcubench_thread(void *data) {
+    uint32_t cpu = (uint32_t)(uintptr_t)data;
+    
+    __sync_fetch_and_add(&rcubench.ready, 1);
+    while (!rcubench.go) {
+        schedule();
+    }
+    
+    uint64_t start = get_ticks();
+    for (uint32_t i = 0; i < rcubench.iterations; i++) {
+        uint32_t key = (i * 7 + cpu) % RCUBENCH_NODES;
+        bool found;
+        uint64_t flags;
+        
+        switch (rcubench.mode) {
+            case RCUBENCH_RCU:
+                rcu_read_lock();
+                found = rcubench_lookup(key);
+                rcu_read_unlock();
+                break;
+            case RCUBENCH_RWLOCK:
+                flags = read_lock_irqsave(&rcubench.rwlock);
+                found = rcubench_lookup(key);
+                read_unlock_irqrestore(&rcubench.rwlock, flags);
+                break;
+            default:
+                flags = spin_lock_irqsave(&rcubench.lock);
+                found = rcubench_lookup(key);
+                spin_unlock_irqrestore(&rcubench.lock, flags);
+                break;
+        }
+        if (!found) {
+            __sync_fetch_and_add(&rcubench.bad, 1);
+        }
+        
+        if (cpu == 0 && i % RCUBENCH_UPDATE_RATIO == 0) {
+            rcubench_update(key);
+        }
+        
+        /* Readers are not preempted; give other work a chance between lookups */
+        if ((i & 1023) == 0) {
+            cond_resched();
+        }
+    }
+    rcubench.cycles[cpu] = get_ticks() - start;
+    return 0;
+}
+
+/* Run one mode with readers on CPUs 0 .. nr_readers - 1; returns cycles per lookup */
+static uint64_t rcubench_run(enum rcubench_mode mode, uint32_t nr_readers) {
+    struct kthread *threads[MAX_CPUS];
+    
+    rcubench.mode = mode;
+    rcubench.ready = 0;
+    rcubench.go = false;
+    
+    uint32_t started = 0;
+    for (uint32_t cpu = 0; cpu < nr_readers; cpu++) {
+        rcubench.cycles[cpu] = 0;
+        threads[cpu] = kthread_create_on_cpu(rcubench_thread, (void *)(uintptr_t)cpu, cpu,
+                                             "rcubench");
+        if (threads[cpu]) {
+            started++;
+        }
+    }
+    while (rcubench.ready < started) {
+        schedule();
+    }
+    rcubench.go = true;
+    
+    uint64_t cycles = 0;
+    for (uint32_t cpu = 0; cpu < nr_readers; cpu++) {
+        if (threads[cpu]) {
+            kthread_stop(threads[cpu]);
+            cycles += rcubench.cycles[cpu];
+        }
+    }
+    
+    uint64_t lookups = (uint64_t)started * rcubench.iterations;
+    return lookups ? cycles / lookups : 0;
+}
+
+/*
+ * Reader scaling benchmark: readers on 1, 2, 4 .. all CPUs look up keys in
+ * a shared list protected by RCU, a reader-writer lock or a spinlock,
+ * while one of them keeps replacing nodes. RCU readers take no shared
+ * cache line, so their cost per lookup should stay flat as CPUs are added.
+ */
+void rcu_benchmark(uint32_t iterations) {
+    uint32_t nr_cpus = smp_num_cpus();
+    
+    KLOG_INFO("=== RCU READER SCALING BENCHMARK (%u CPUs, %u lookups each) ===",
+              nr_cpus, iterations);
+    
+    memset(&rcubench, 0, sizeof(rcubench));
+    rcubench.iterations = iterations;
+    for (uint32_t key = 0; key < RCUBENCH_NODES; key++) {
+        struct rcubench_node *node = kmalloc(sizeof(*node));
+        if (!node) {
+            KLOG_WARN("rcubench: out of memory");
+            break;
+        }
+        node->key = key;
+        node->magic = RCUBENCH_MAGIC;
+        rcu_list_add(rcubench.head, node, next);
+    }
+    
+    uint64_t gps_before;
+    rcu_get_stats(&gps_before, NULL);
+    
+    for (uint32_t readers = 1; ; readers = readers * 2 < nr_cpus ? readers * 2 : nr_cpus) {
+        for (int mode = 0; mode < RCUBENCH_MODES; mode++) {
+            KLOG_INFO("%-8s %2u readers: %lu cycles/lookup", rcubench_names[mode], readers,
+                      rcubench_run(mode, readers));
+        }
+        if (readers == nr_cpus) {
+            break;
+        }
+    }
+    
+    synchronize_rcu();
+    uint64_t gps_after;
+    rcu_get_stats(&gps_after, NULL);
+    KLOG_INFO("%lu grace periods, %s", gps_after - gps_before,
+              rcubench.bad ? "INCONSISTENT" : "consistent");
+    
+    struct rcubench_node *node = rcubench.head;
+    rcubench.head = NULL;
+    synchronize_rcu();
+    while (node) {
+        struct rcubench_node *next = node->next;
+        kfree(node);
+        node = next;
+    }
+}
\ No newline at end of file
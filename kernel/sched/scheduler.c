@@ -4,6 +4,22 @@
  */
 
 #include "kernel.h"
+#include "cpu.h"
+#include "string.h"
+#include "smp.h"
+#include "sched.h"
+#include "fpu.h"
+#include "ktime.h"
+#include "pid.h"
+#include "slab.h"
+#include "wait.h"
+#include "futex.h"
+#include "timer.h"
+#include "cpumask.h"
+#include "cpuset.h"
+#include "spinlock.h"
+#include "rcu.h"
+#include "preempt.h"
 
 /* Process states */
 enum proc_state {
@@ -23,22 +39,17 @@ enum security_level {
     SEC_PENTAGON = 4
 };
 
-/* Process control block */
-struct process {
+/* Task control block */
+struct task {
     uint64_t pid;
     uint64_t ppid;
     enum proc_state state;
     enum security_level sec_level;
     
-    /* CPU context */
-    uint64_t rsp;     /* Stack pointer */
-    uint64_t rbp;     /* Base pointer */
-    uint64_t rip;     /* Instruction pointer */
-    uint64_t rflags;  /* Flags register */
-    
-    /* General purpose registers */
-    uint64_t rax, rbx, rcx, rdx;
-    uint64_t rsi, rdi, r8, r9, r10, r11, r12, r13, r14, r15;
+    /* CPU context: callee-saved registers live on the kernel stack */
+    uint64_t kernel_sp;         /* Saved by switch_to */
+    volatile bool on_cpu;       /* Still executing, stack in use */
+    struct fpu fpu;             /* Extended register state */
     
     /* Memory management */
     uint64_t cr3;     /* Page table base */
@@ -55,325 +66,2261 @@ struct process {
     uint64_t time_slice;
     uint64_t cpu_time;
     uint64_t creation_time;
+    uint32_t cpu;       /* CPU the task is queued on, or last ran on */
+    uint64_t last_ran;  /* Runqueue clock when the task last ran */
+    bool bound;         /* Never migrated off 'cpu' (per-CPU kernel threads) */
+    cpumask_t cpus_allowed;     /* Affinity, within the CPUs of the cpuset */
+    struct cpuset *cpuset;
+    
+    /* Scheduling class */
+    uint32_t policy;            /* SCHED_NORMAL, SCHED_FIFO, SCHED_RR or SCHED_DEADLINE */
+    uint32_t rt_priority;       /* 1..99 for FIFO/RR, higher runs first */
+    bool on_rq;                 /* Linked on a run queue list */
+    bool slice_expired;         /* Time slice ran out since it last went on the CPU */
+    uint64_t exec_start;        /* ktime_get_ns() at the last accounting point */
+    
+    /* Deadline parameters and constant bandwidth server state (ns) */
+    struct {
+        uint64_t runtime;       /* Budget per period */
+        uint64_t deadline;      /* Relative deadline */
+        uint64_t period;
+        uint64_t bw;            /* runtime / period, DL_BW_SHIFT fixed point */
+        uint64_t abs_deadline;  /* Deadline of the current instance */
+        int64_t remaining;      /* Budget left for the current instance */
+        bool throttled;         /* Budget exhausted, waiting for replenishment */
+        struct hrtimer timer;   /* Fires at the next period to replenish */
+    } dl;
+    
+    /* Kernel thread control (struct kthread), NULL for other tasks */
+    void *kthread;
+    
+    /* User copies may target kernel memory (syscall_handler() callers) */
+    bool uaccess_kernel;
+    
+    /* Wait queue entry of a prepare_to_wait() sleep, on the task's stack */
+    struct wait_queue_entry *wait_entry;
+    
+    /* PID hash link; lookups hold rcu_read_lock(), so freeing waits a grace period */
+    struct pid_node pid_node;
+    struct rcu_head rcu;
     
     /* Process tree */
-    struct process *parent;
-    struct process *next_sibling;
-    struct process *first_child;
+    struct task *parent;
+    struct task *next_sibling;
+    struct task *first_child;
     
     /* Scheduler queues */
-    struct process *next;
-    struct process *prev;
+    struct task *next;
+    struct task *prev;
     
     char name[32];
-} __packed;
+};
+
+#define RT_BITMAP_WORDS     ((MAX_RT_PRIO + 63) / 64)
+
+/* Per-CPU run queue */
+struct runqueue {
+    spinlock_t lock;
+    struct task *head;          /* Next SCHED_NORMAL task to run */
+    struct task *tail;
+    uint32_t nr_queued;         /* Tasks waiting on this queue, all classes */
+    uint32_t nr_normal;         /* Of which SCHED_NORMAL, on head..tail */
+    
+    /* Real-time classes: a FIFO list per priority and a bitmap of non-empty lists */
+    uint64_t rt_bitmap[RT_BITMAP_WORDS];
+    struct task *rt_head[MAX_RT_PRIO];
+    struct task *rt_tail[MAX_RT_PRIO];
+    uint32_t rt_queued;
+    
+    /* Deadline class, earliest absolute deadline first */
+    struct task *dl_head;
+    struct task *dl_tail;
+    
+    struct task *current;
+    struct task *idle;
+    uint64_t clock;             /* Ticks seen by this CPU */
+    uint64_t next_balance[SD_LEVELS];
+    
+    /* Load balancing statistics, read locklessly under stats_seq */
+    seqcount_t stats_seq;
+    uint64_t migrations;        /* Tasks pulled onto this CPU */
+    uint64_t steals;            /* Tasks stolen while this CPU was idle */
+    uint64_t imbalances;        /* Balance passes that found an imbalance */
+    uint64_t dl_throttles;      /* Deadline tasks that ran out of budget */
+} __aligned(64);
+
+/* Balance policy per domain level */
+static const struct {
+    const char *name;
+    uint64_t interval;          /* Ticks between periodic balance passes */
+    uint32_t imbalance_pct;     /* Busiest load must exceed ours by this much */
+    bool move_cache_hot;        /* Cache-hot tasks may migrate at this level */
+} balance_levels[SD_LEVELS] = {
+    [SD_LLC]    = { "LLC",    4,  117, true  },
+    [SD_NODE]   = { "NODE",   16, 125, false },
+    [SD_SYSTEM] = { "SYSTEM", 64, 150, false },
+};
+
+/* Ticks after running during which a task is considered cache-hot */
+#define SCHED_MIGRATION_COST    2
+
+/* Time slice of SCHED_NORMAL and SCHED_RR tasks, in ticks */
+#define SCHED_TIMESLICE         10
+
+/*
+ * Deadline bandwidth is runtime/period in DL_BW_SHIFT fixed point. Periods
+ * are capped so the shift cannot overflow, and admission keeps the sum of
+ * all deadline bandwidth within DL_BW_LIMIT_PCT of the CPUs.
+ */
+#define DL_BW_SHIFT             20
+#define DL_BW_LIMIT_PCT         95
+#define DL_MIN_RUNTIME          (10 * NSEC_PER_USEC)
+#define DL_MAX_PERIOD           (1ULL << 40)
+
+/* Kernel stack switching (switch.s) */
+extern struct task *switch_to(uint64_t *prev_sp, uint64_t next_sp, struct task *prev);
+extern void task_entry_trampoline(void);
 
 /* Scheduler state */
 static struct {
-    struct process *current;
-    struct process *ready_queue;
-    struct process *blocked_queue;
-    struct process process_table[256];
-    uint64_t next_pid;
+    struct pid_table pids;
+    struct kmem_cache *task_cache;
     uint64_t total_processes;
     uint64_t context_switches;
+    spinlock_t dl_lock;
+    uint64_t dl_total_bw;       /* Admitted deadline bandwidth, all CPUs */
     bool initialized;
 } sched_state;
 
-/* Current running process */
-struct process *current_process = NULL;
+static struct runqueue runqueues[MAX_CPUS];
+
+static inline struct runqueue *this_rq(void) {
+    return &runqueues[smp_processor_id()];
+}
+
+/* Current running task on this CPU */
+static inline struct task *current_task(void) {
+    return sched_state.initialized ? this_rq()->current : NULL;
+}
+
+/* Run queue locking; the tick and hrtimer callbacks take it, so callers disable interrupts */
+static void rq_lock(struct runqueue *rq) {
+    spin_lock(&rq->lock);
+}
+
+static void rq_unlock(struct runqueue *rq) {
+    spin_unlock(&rq->lock);
+}
+
+/* Statistics are only written by rq's own CPU with interrupts off */
+static inline void rq_stat_inc(struct runqueue *rq, uint64_t *counter) {
+    write_seqcount_begin(&rq->stats_seq);
+    (*counter)++;
+    write_seqcount_end(&rq->stats_seq);
+}
+
+/* Lock two run queues in CPU order to avoid ABBA deadlocks */
+static void double_rq_lock(struct runqueue *a, struct runqueue *b) {
+    if (a == b) {
+        rq_lock(a);
+    } else if (a < b) {
+        rq_lock(a);
+        rq_lock(b);
+    } else {
+        rq_lock(b);
+        rq_lock(a);
+    }
+}
+
+static void double_rq_unlock(struct runqueue *a, struct runqueue *b) {
+    rq_unlock(a);
+    if (a != b) {
+        rq_unlock(b);
+    }
+}
+
+/* Runnable load of a CPU: queued tasks plus a non-idle running task */
+static uint32_t rq_load(struct runqueue *rq) {
+    uint32_t load = rq->nr_queued;
+    if (rq->current && rq->current != rq->idle) {
+        load++;
+    }
+    return load;
+}
+
+/*
+ * Load as balancing sees it: only queued SCHED_NORMAL tasks can be pulled,
+ * so real-time and deadline tasks do not make a CPU look busiest.
+ */
+static uint32_t rq_balance_load(struct runqueue *rq) {
+    uint32_t load = rq->nr_normal;
+    if (rq->current && rq->current != rq->idle) {
+        load++;
+    }
+    return load;
+}
+
+/* Ask a CPU to reschedule; an idle CPU polling in MWAIT needs no IPI */
+static void resched_cpu(uint32_t cpu) {
+    struct percpu *pc = smp_percpu(cpu);
+    
+    pc->need_resched = 1;
+    mb();
+    if (cpu != smp_processor_id() && !pc->polling) {
+        lapic_send_reschedule(cpu);
+    }
+}
+
+/* A task was queued on rq: make sure its CPU notices, preempting if asked */
+static void rq_kick(struct runqueue *rq, bool preempt) {
+    uint32_t cpu = (uint32_t)(rq - runqueues);
+    
+    if (preempt || !rq->current || rq->current == rq->idle) {
+        resched_cpu(cpu);
+    } else {
+        /* A lone running task may have had its tick stopped */
+        tick_nohz_dep_changed(cpu);
+    }
+}
+
+/* Topology distance between two CPUs */
+static enum sched_domain_level cpu_distance(uint32_t a, uint32_t b) {
+    if (smp_cpus_share_llc(a, b)) {
+        return SD_LLC;
+    }
+    if (smp_cpus_share_node(a, b)) {
+        return SD_NODE;
+    }
+    return SD_SYSTEM;
+}
 
 /* Process creation */
-static struct process *alloc_process(void) {
-    for (int i = 0; i < 256; i++) {
-        if (sched_state.process_table[i].state == PROC_DEAD) {
-            memset(&sched_state.process_table[i], 0, sizeof(struct process));
-            return &sched_state.process_table[i];
-        }
+static struct task *alloc_process(void) {
+    return kmem_cache_zalloc(sched_state.task_cache);
+}
+
+/* Rank of a task's scheduling class: deadline over real-time over normal */
+static inline int task_class(const struct task *proc) {
+    switch (proc->policy) {
+        case SCHED_DEADLINE:
+            return 2;
+        case SCHED_FIFO:
+        case SCHED_RR:
+            return 1;
+        default:
+            return 0;
     }
-    return NULL;
 }
 
-/* Add process to ready queue */
-static void add_to_ready_queue(struct process *proc) {
-    proc->state = PROC_READY;
-    proc->next = sched_state.ready_queue;
-    proc->prev = NULL;
+static inline bool rt_policy(uint32_t policy) {
+    return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+/* Should a run in preference to b? Equals do not preempt each other */
+static bool task_preempts(const struct task *a, const struct task *b) {
+    int class_a = task_class(a);
+    int class_b = task_class(b);
+    
+    if (class_a != class_b) {
+        return class_a > class_b;
+    }
+    if (class_a == 2) {
+        return (int64_t)(a->dl.abs_deadline - b->dl.abs_deadline) < 0;
+    }
+    if (class_a == 1) {
+        return a->rt_priority > b->rt_priority;
+    }
+    return false;
+}
+
+/* Account deadline bandwidth; fails if admitting new_bw would overcommit the CPUs */
+static int dl_bw_update(uint64_t old_bw, uint64_t new_bw) {
+    uint64_t limit = ((uint64_t)smp_num_cpus() << DL_BW_SHIFT) * DL_BW_LIMIT_PCT / 100;
+    int ret = 0;
+    
+    uint64_t flags = spin_lock_irqsave(&sched_state.dl_lock);
+    uint64_t total = sched_state.dl_total_bw - old_bw + new_bw;
+    if (new_bw > old_bw && total > limit) {
+        ret = -16; /* EBUSY */
+    } else {
+        sched_state.dl_total_bw = total;
+    }
+    spin_unlock_irqrestore(&sched_state.dl_lock, flags);
     
-    if (sched_state.ready_queue) {
-        sched_state.ready_queue->prev = proc;
+    return ret;
+}
+
+static void task_free_rcu(struct rcu_head *head) {
+    kmem_cache_free(sched_state.task_cache, rcu_entry(head, struct task, rcu));
+}
+
+/* A task became PROC_DEAD: retire its PID and recycle the structure after PID lookups */
+static void release_task(struct task *proc) {
+    if (proc->cpuset) {
+        cpuset_release(proc->cpuset);
+    }
+    if (proc->policy == SCHED_DEADLINE) {
+        hrtimer_cancel(&proc->dl.timer);
+        dl_bw_update(proc->dl.bw, 0);
+    }
+    pid_hash_del(&sched_state.pids, &proc->pid_node);
+    pid_free(&sched_state.pids, (uint32_t)proc->pid);
+    call_rcu(&proc->rcu, task_free_rcu);
+}
+
+/* Link a task at the front or back of a queue list */
+static void list_add_task(struct task **head, struct task **tail, struct task *proc, bool front) {
+    if (front) {
+        proc->prev = NULL;
+        proc->next = *head;
+        if (*head) {
+            (*head)->prev = proc;
+        } else {
+            *tail = proc;
+        }
+        *head = proc;
+    } else {
+        proc->next = NULL;
+        proc->prev = *tail;
+        if (*tail) {
+            (*tail)->next = proc;
+        } else {
+            *head = proc;
+        }
+        *tail = proc;
     }
-    sched_state.ready_queue = proc;
 }
 
-/* Remove process from ready queue */
-static void remove_from_ready_queue(struct process *proc) {
+static void list_del_task(struct task **head, struct task **tail, struct task *proc) {
     if (proc->prev) {
         proc->prev->next = proc->next;
     } else {
-        sched_state.ready_queue = proc->next;
+        *head = proc->next;
     }
     
     if (proc->next) {
         proc->next->prev = proc->prev;
+    } else {
+        *tail = proc->prev;
     }
     
     proc->next = NULL;
     proc->prev = NULL;
 }
 
-/* Security check for process operations */
-static bool security_check(struct process *src, struct process *dest, int operation) {
-    /* Pentagon-level security model */
+/* Insert a deadline task behind every task with an earlier or equal deadline */
+static void enqueue_dl(struct runqueue *rq, struct task *proc) {
+    struct task *pos = rq->dl_head;
+    while (pos && (int64_t)(pos->dl.abs_deadline - proc->dl.abs_deadline) <= 0) {
+        pos = pos->next;
+    }
     
-    /* No read up, no write down (Bell-LaPadula) */
-    if (operation == 0) { /* Read */
-        return src->sec_level >= dest->sec_level;
-    } else { /* Write */
-        return src->sec_level <= dest->sec_level;
+    if (!pos) {
+        list_add_task(&rq->dl_head, &rq->dl_tail, proc, false);
+        return;
+    }
+    proc->next = pos;
+    proc->prev = pos->prev;
+    if (pos->prev) {
+        pos->prev->next = proc;
+    } else {
+        rq->dl_head = proc;
     }
+    pos->prev = proc;
 }
 
-/* Context switch implementation */
-static void context_switch(struct process *from, struct process *to) {
-    if (!from || !to) return;
-    
-    sched_state.context_switches++;
+/* Queue a task on the list of its class (caller holds rq->lock) */
+static void __enqueue_task(struct runqueue *rq, struct task *proc, bool front) {
+    proc->state = PROC_READY;
+    proc->cpu = (uint32_t)(rq - runqueues);
     
-    /* Save current context */
-    if (from) {
-        __asm__ __volatile__(
-            "pushfq\n\t"
-            "mov %%rsp, %0\n\t"
-            "mov %%rbp, %1\n\t"
-            "mov %%rax, %2\n\t"
-            "mov %%rbx, %3\n\t"
-            "mov %%rcx, %4\n\t"
-            "mov %%rdx, %5\n\t"
-            "mov %%rsi, %6\n\t"
-            "mov %%rdi, %7\n\t"
-            "mov %%r8, %8\n\t"
-            "mov %%r9, %9\n\t"
-            "mov %%r10, %10\n\t"
-            "mov %%r11, %11\n\t"
-            "mov %%r12, %12\n\t"
-            "mov %%r13, %13\n\t"
-            "mov %%r14, %14\n\t"
-            "mov %%r15, %15\n\t"
-            "popfq\n\t"
-            "mov %%rax, %16"
-            : "=m" (from->rsp), "=m" (from->rbp),
-              "=m" (from->rax), "=m" (from->rbx), "=m" (from->rcx), "=m" (from->rdx),
-              "=m" (from->rsi), "=m" (from->rdi), "=m" (from->r8), "=m" (from->r9),
-              "=m" (from->r10), "=m" (from->r11), "=m" (from->r12), "=m" (from->r13),
-              "=m" (from->r14), "=m" (from->r15), "=m" (from->rflags)
-            :
-            : "memory"
-        );
-        
-        from->state = PROC_READY;
+    if (proc->policy == SCHED_DEADLINE) {
+        enqueue_dl(rq, proc);
+    } else if (rt_policy(proc->policy)) {
+        uint32_t prio = proc->rt_priority;
+        list_add_task(&rq->rt_head[prio], &rq->rt_tail[prio], proc, front);
+        rq->rt_bitmap[prio / 64] |= 1ULL << (prio % 64);
+        rq->rt_queued++;
+    } else {
+        list_add_task(&rq->head, &rq->tail, proc, front);
+        rq->nr_normal++;
+    }
+    proc->on_rq = true;
+    rq->nr_queued++;
+}
+
+/* Append task to the tail of its run queue list (caller holds rq->lock) */
+static void enqueue_task(struct runqueue *rq, struct task *proc) {
+    __enqueue_task(rq, proc, false);
+}
+
+/* Remove task from its run queue (caller holds rq->lock) */
+static void dequeue_task(struct runqueue *rq, struct task *proc) {
+    if (proc->policy == SCHED_DEADLINE) {
+        list_del_task(&rq->dl_head, &rq->dl_tail, proc);
+    } else if (rt_policy(proc->policy)) {
+        uint32_t prio = proc->rt_priority;
+        list_del_task(&rq->rt_head[prio], &rq->rt_tail[prio], proc);
+        if (!rq->rt_head[prio]) {
+            rq->rt_bitmap[prio / 64] &= ~(1ULL << (prio % 64));
+        }
+        rq->rt_queued--;
+    } else {
+        list_del_task(&rq->head, &rq->tail, proc);
+        rq->nr_normal--;
     }
+    proc->on_rq = false;
+    rq->nr_queued--;
+}
+
+/* Best queued task: earliest deadline, then highest real-time priority, then normal */
+static struct task *pick_next_task(struct runqueue *rq) {
+    if (rq->dl_head) {
+        return rq->dl_head;
+    }
+    if (rq->rt_queued) {
+        for (int word = RT_BITMAP_WORDS - 1; word >= 0; word--) {
+            if (rq->rt_bitmap[word]) {
+                uint32_t prio = word * 64 + 63 - __builtin_clzll(rq->rt_bitmap[word]);
+                return rq->rt_head[prio];
+            }
+        }
+    }
+    return rq->head;
+}
+
+/* Would a task queued on rq preempt what it is running? (caller holds rq->lock) */
+static bool wakeup_preempt(struct runqueue *rq, struct task *proc) {
+    struct task *curr = rq->current;
+    return curr && curr != rq->idle && task_preempts(proc, curr);
+}
+
+/*
+ * Start a new deadline instance if the current one is over, or if the
+ * budget left could not be consumed before the deadline without exceeding
+ * the reserved bandwidth (the CBS wakeup rule).
+ */
+static void dl_wakeup(struct task *proc, uint64_t now) {
+    int64_t laxity = (int64_t)(proc->dl.abs_deadline - now);
+    bool overflow = laxity <= 0 ||
+        (unsigned __int128)proc->dl.remaining * proc->dl.period >
+        (unsigned __int128)proc->dl.runtime * (uint64_t)laxity;
     
-    /* Switch to new process */
-    current_process = to;
-    to->state = PROC_RUNNING;
+    if (overflow || proc->dl.remaining <= 0) {
+        proc->dl.abs_deadline = now + proc->dl.deadline;
+        proc->dl.remaining = (int64_t)proc->dl.runtime;
+    }
+}
+
+/* Refill an exhausted budget one period at a time */
+static void dl_replenish(struct task *proc, uint64_t now) {
+    while (proc->dl.remaining <= 0) {
+        proc->dl.abs_deadline += proc->dl.period;
+        proc->dl.remaining += (int64_t)proc->dl.runtime;
+    }
     
-    /* Load new context */
-    __asm__ __volatile__(
-        "mov %0, %%cr3\n\t"      /* Switch page tables */
-        "mov %1, %%rsp\n\t"
-        "mov %2, %%rbp\n\t"
-        "mov %3, %%rax\n\t"
-        "mov %4, %%rbx\n\t"
-        "mov %5, %%rcx\n\t"
-        "mov %6, %%rdx\n\t"
-        "mov %7, %%rsi\n\t"
-        "mov %8, %%rdi\n\t"
-        "mov %9, %%r8\n\t"
-        "mov %10, %%r9\n\t"
-        "mov %11, %%r10\n\t"
-        "mov %12, %%r11\n\t"
-        "mov %13, %%r12\n\t"
-        "mov %14, %%r13\n\t"
-        "mov %15, %%r14\n\t"
-        "mov %16, %%r15\n\t"
-        "push %17\n\t"
-        "popfq"
-        :
-        : "r" (to->cr3), "m" (to->rsp), "m" (to->rbp),
-          "m" (to->rax), "m" (to->rbx), "m" (to->rcx), "m" (to->rdx),
-          "m" (to->rsi), "m" (to->rdi), "m" (to->r8), "m" (to->r9),
-          "m" (to->r10), "m" (to->r11), "m" (to->r12), "m" (to->r13),
-          "m" (to->r14), "m" (to->r15), "m" (to->rflags)
-        : "memory"
-    );
-}
-
-/* Round-robin scheduler */
-void schedule(void) {
-    if (!sched_state.initialized || !sched_state.ready_queue) {
+    /* Fell more than a period behind: restart from now */
+    if ((int64_t)(proc->dl.abs_deadline - now) <= 0) {
+        proc->dl.abs_deadline = now + proc->dl.deadline;
+        proc->dl.remaining = (int64_t)proc->dl.runtime;
+    }
+}
+
+/*
+ * Charge the running task for the time since exec_start. A deadline task
+ * that used up its budget is throttled until the start of its next period.
+ */
+static void update_curr(struct runqueue *rq, struct task *curr, uint64_t now) {
+    if (!curr || curr == rq->idle) {
         return;
     }
     
-    struct process *next = sched_state.ready_queue;
-    
-    /* Security check */
-    if (current_process && !security_check(current_process, next, 0)) {
-        KLOG_WARN("Process %lu blocked by security policy", next->pid);
+    uint64_t delta = now - curr->exec_start;
+    curr->exec_start = now;
+    if (curr->policy != SCHED_DEADLINE || curr->dl.throttled) {
         return;
     }
     
-    /* Remove from ready queue */
-    remove_from_ready_queue(next);
+    curr->dl.remaining -= (int64_t)delta;
+    if (curr->dl.remaining <= 0) {
+        curr->dl.throttled = true;
+        hrtimer_start(&curr->dl.timer,
+                      curr->dl.abs_deadline - curr->dl.deadline + curr->dl.period);
+        rq_stat_inc(rq, &rq->dl_throttles);
+        this_cpu()->need_resched = 1;
+    }
+}
+
+/* Replenishment timer: a throttled task gets its budget back and is requeued */
+static void dl_timer_fn(struct hrtimer *timer) {
+    struct task *proc = timer->data;
+    struct runqueue *rq = &runqueues[proc->cpu];
+    bool queued = false, preempt = false;
     
-    /* Add current process back to ready queue if still running */
-    if (current_process && current_process->state == PROC_RUNNING) {
-        add_to_ready_queue(current_process);
+    rq_lock(rq);
+    if (proc->dl.throttled) {
+        proc->dl.throttled = false;
+        dl_replenish(proc, ktime_get_ns());
+        
+        /* Runnable tasks wait off the queue while throttled */
+        if (proc->state == PROC_READY && !proc->on_rq && !proc->on_cpu) {
+            enqueue_task(rq, proc);
+            queued = true;
+            preempt = wakeup_preempt(rq, proc);
+        }
     }
+    rq_unlock(rq);
     
-    /* Perform context switch */
-    context_switch(current_process, next);
+    if (queued) {
+        rq_kick(rq, preempt);
+    }
 }
 
-/* Create new process */
-struct process *create_process(const char *name, enum security_level sec_level, bool privileged) {
-    struct process *proc = alloc_process();
-    if (!proc) {
-        KLOG_ERR("Failed to allocate process: %s", name);
-        return NULL;
+static inline bool task_allowed(const struct task *proc, uint32_t cpu) {
+    return cpumask_test_cpu(cpu, &proc->cpus_allowed);
+}
+
+/* Is the task likely to still have its working set in cache? */
+static bool task_cache_hot(struct runqueue *rq, struct task *proc) {
+    return rq->clock - proc->last_ran < SCHED_MIGRATION_COST;
+}
+
+/*
+ * Move a queued task from src to dst (caller holds both locks).
+ * Tasks are taken from the tail: the head is about to run on src and
+ * is the one most likely to be cache-hot there.
+ */
+static struct task *pull_one_task(struct runqueue *dst, struct runqueue *src,
+                                  bool allow_cache_hot) {
+    for (struct task *proc = src->tail; proc; proc = proc->prev) {
+        if (proc->on_cpu) {
+            continue; /* Switched out but still on its stack */
+        }
+        if (proc->bound || !task_allowed(proc, (uint32_t)(dst - runqueues))) {
+            continue;
+        }
+        if (!allow_cache_hot && task_cache_hot(src, proc)) {
+            continue;
+        }
+        dequeue_task(src, proc);
+        enqueue_task(dst, proc);
+        rq_stat_inc(dst, &dst->migrations);
+        return proc;
     }
-    
-    /* Initialize process */
-    proc->pid = sched_state.next_pid++;
-    proc->ppid = current_process ? current_process->pid : 0;
-    proc->state = PROC_READY;
-    proc->sec_level = sec_level;
-    proc->privileged = privileged;
-    
-    /* Set up stack */
-    proc->stack_size = 0x4000; /* 16KB stack */
-    proc->stack_base = (uint64_t)kmalloc_aligned(proc->stack_size, PAGE_SIZE);
-    proc->rsp = proc->stack_base + proc->stack_size;
-    
-    /* Initialize security context */
-    proc->stack_canary = get_stack_canary();
-    proc->capabilities = privileged ? 0xFFFFFFFF : 0x00000001;
-    
-    /* Set up initial context */
-    proc->rflags = 0x202; /* Enable interrupts */
-    proc->creation_time = get_ticks();
-    proc->priority = 10;  /* Normal priority */
-    proc->time_slice = 10; /* 10ms time slice */
-    
-    /* Copy name */
-    strncpy(proc->name, name, sizeof(proc->name) - 1);
-    proc->name[sizeof(proc->name) - 1] = '\0';
-    
-    /* Set parent-child relationship */
-    if (current_process) {
-        proc->parent = current_process;
-        proc->next_sibling = current_process->first_child;
-        current_process->first_child = proc;
+    return NULL;
+}
+
+/* Move a queued task onto another CPU's run queue */
+static void migrate_queued_task(struct task *proc, uint32_t cpu) {
+    struct runqueue *src = &runqueues[proc->cpu];
+    struct runqueue *dst = &runqueues[cpu];
+    if (src == dst || !task_allowed(proc, cpu)) {
+        return;
     }
     
-    /* Add to ready queue */
-    add_to_ready_queue(proc);
-    sched_state.total_processes++;
+    uint64_t flags = local_irq_save();
+    double_rq_lock(dst, src);
+    if (proc->on_rq && !proc->on_cpu) {
+        dequeue_task(src, proc);
+        enqueue_task(dst, proc);
+    }
+    double_rq_unlock(dst, src);
+    local_irq_restore(flags);
+}
+
+/* Find the busiest CPU within 'level' of 'cpu' */
+static int find_busiest_cpu(uint32_t cpu, enum sched_domain_level level,
+                            uint32_t *busiest_load) {
+    int busiest = -1;
+    uint32_t max_load = 0;
     
-    KLOG_INFO("Created process: %s (PID: %lu, Security: %d)", name, proc->pid, sec_level);
+    for (uint32_t other = 0; other < smp_num_cpus(); other++) {
+        if (other == cpu || cpu_distance(cpu, other) > level) {
+            continue;
+        }
+        uint32_t load = rq_balance_load(&runqueues[other]);
+        if (runqueues[other].nr_normal > 0 && load > max_load) {
+            max_load = load;
+            busiest = other;
+        }
+    }
     
-    return proc;
+    *busiest_load = max_load;
+    return busiest;
 }
 
-/* Initialize kernel idle process */
-static void create_idle_process(void) {
-    struct process *idle = &sched_state.process_table[0];
-    
-    memset(idle, 0, sizeof(struct process));
-    idle->pid = 0;
-    idle->state = PROC_RUNNING;
-    idle->sec_level = SEC_PENTAGON;
-    idle->privileged = true;
-    strcpy(idle->name, "idle");
+/*
+ * Idle balancing: an idle CPU steals a waiting task, searching the
+ * cheapest domains (shared LLC, then same node) before crossing nodes.
+ */
+static bool idle_balance(uint32_t cpu) {
+    struct runqueue *rq = &runqueues[cpu];
     
-    /* Set as current process */
-    current_process = idle;
-    sched_state.current = idle;
+    for (int level = SD_LLC; level < SD_LEVELS; level++) {
+        uint32_t busiest_load;
+        int busiest = find_busiest_cpu(cpu, level, &busiest_load);
+        if (busiest < 0) {
+            continue;
+        }
+        
+        /* Crossing a node boundary is only worth it for real overload */
+        if (level > SD_LLC && busiest_load < 2) {
+            continue;
+        }
+        
+        struct runqueue *src = &runqueues[busiest];
+        double_rq_lock(rq, src);
+        struct task *stolen = NULL;
+        if (rq->nr_queued == 0) {
+            stolen = pull_one_task(rq, src, true);
+        }
+        if (stolen) {
+            rq_stat_inc(rq, &rq->steals);
+        }
+        double_rq_unlock(rq, src);
+        
+        if (stolen) {
+            return true;
+        }
+    }
     
-    KLOG_INFO("Idle process created (PID: 0)");
+    return false;
 }
 
-void scheduler_init(void) {
-    KLOG_INFO("Initializing Pentagon-level process scheduler...");
+/* Periodic balancing of one domain level */
+static void load_balance(uint32_t cpu, enum sched_domain_level level) {
+    struct runqueue *rq = &runqueues[cpu];
+    uint32_t busiest_load;
+    int busiest = find_busiest_cpu(cpu, level, &busiest_load);
+    if (busiest < 0) {
+        return;
+    }
     
-    /* Initialize scheduler state */
-    memset(&sched_state, 0, sizeof(sched_state));
-    sched_state.next_pid = 1;
+    uint32_t local_load = rq_balance_load(rq);
+    if (busiest_load <= local_load + 1 ||
+        busiest_load * 100 <= local_load * balance_levels[level].imbalance_pct) {
+        return;
+    }
     
-    /* Mark all processes as dead initially */
-    for (int i = 0; i < 256; i++) {
-        sched_state.process_table[i].state = PROC_DEAD;
+    struct runqueue *src = &runqueues[busiest];
+    double_rq_lock(rq, src);
+    
+    /* Recheck under the locks and move half the difference */
+    busiest_load = rq_balance_load(src);
+    local_load = rq_balance_load(rq);
+    if (busiest_load > local_load + 1) {
+        uint32_t imbalance = (busiest_load - local_load) / 2;
+        rq_stat_inc(rq, &rq->imbalances);
+        
+        while (imbalance-- > 0 && src->nr_normal > 0) {
+            if (!pull_one_task(rq, src, balance_levels[level].move_cache_hot)) {
+                break;
+            }
+        }
     }
     
-    /* Create idle process */
-    create_idle_process();
+    double_rq_unlock(rq, src);
+}
+
+/*
+ * Least loaded CPU the task may run on, preferring 'near' and then its
+ * NUMA node; falls back to 'near' if the affinity has no CPU online.
+ */
+static uint32_t select_allowed_cpu(struct task *proc, uint32_t near) {
+    uint32_t best = CPU_INVALID;
+    uint32_t best_load = 0;
+    bool best_local = false;
     
-    /* Create init process */
-    create_process("init", SEC_PENTAGON, true);
+    if (near < smp_num_cpus() && smp_cpu_topology(near)->online && task_allowed(proc, near)) {
+        best = near;
+        best_load = rq_load(&runqueues[near]);
+        best_local = true;
+    }
     
-    sched_state.initialized = true;
+    for (uint32_t cpu = 0; cpu < smp_num_cpus(); cpu++) {
+        if (!task_allowed(proc, cpu) || !smp_cpu_topology(cpu)->online) {
+            continue;
+        }
+        bool local = smp_cpus_share_node(cpu, near);
+        uint32_t load = rq_load(&runqueues[cpu]);
+        if (best == CPU_INVALID || (local && !best_local) ||
+            (local == best_local && load < best_load)) {
+            best = cpu;
+            best_load = load;
+            best_local = local;
+        }
+    }
     
-    KLOG_INFO("Process scheduler initialized");
-    KLOG_INFO("Security model: Bell-LaPadula with Pentagon classification");
+    return best == CPU_INVALID ? near : best;
 }
 
-/* Get process by PID */
-struct process *get_process(uint64_t pid) {
-    for (int i = 0; i < 256; i++) {
-        if (sched_state.process_table[i].pid == pid && 
-            sched_state.process_table[i].state != PROC_DEAD) {
-            return &sched_state.process_table[i];
+/* Pick the CPU for a waking task: the CPU it last ran on, for cache affinity */
+static uint32_t select_wake_cpu(struct task *proc) {
+    if (proc->bound) {
+        return proc->cpu;
+    }
+    if (proc->cpu >= smp_num_cpus() || !smp_cpu_topology(proc->cpu)->online ||
+        !task_allowed(proc, proc->cpu)) {
+        return select_allowed_cpu(proc, smp_processor_id());
+    }
+    
+    /* A real-time task that could not preempt there takes an idle CPU nearby */
+    struct runqueue *rq = &runqueues[proc->cpu];
+    struct task *curr = rq->current;
+    if (task_class(proc) > 0 && curr && curr != rq->idle && !task_preempts(proc, curr)) {
+        for (uint32_t cpu = 0; cpu < smp_num_cpus(); cpu++) {
+            struct runqueue *other = &runqueues[cpu];
+            if (smp_cpus_share_node(cpu, proc->cpu) && task_allowed(proc, cpu) &&
+                other->current == other->idle && other->nr_queued == 0) {
+                return cpu;
+            }
         }
     }
-    return NULL;
+    return proc->cpu;
 }
 
-/* Terminate process */
-void terminate_process(uint64_t pid) {
-    struct process *proc = get_process(pid);
-    if (!proc) return;
+/* Pick the CPU for a new task: least loaded allowed CPU in the parent's node */
+static uint32_t select_fork_cpu(struct task *parent, struct task *proc) {
+    return select_allowed_cpu(proc, parent ? parent->cpu : smp_processor_id());
+}
+
+/* Security check for process operations */
+static bool security_check(struct task *src, struct task *dest, int operation) {
+    /* Pentagon-level security model */
     
-    /* Security check */
-    if (current_process && !security_check(current_process, proc, 1)) {
-        KLOG_WARN("Process termination blocked by security policy");
-        return;
+    /* No read up, no write down (Bell-LaPadula) */
+    if (operation == 0) { /* Read */
+        return src->sec_level >= dest->sec_level;
+    } else { /* Write */
+        return src->sec_level <= dest->sec_level;
     }
+}
+
+/*
+ * Second half of a switch, run by the incoming task on its own stack: the
+ * outgoing task's stack is no longer in use, so it may now migrate or be
+ * reaped. Releases the run queue lock taken by schedule().
+ */
+static void finish_task_switch(struct task *prev) {
+    uint32_t cpu = smp_processor_id();
+    struct runqueue *rq = &runqueues[cpu];
     
-    /* Remove from queues */
-    if (proc->state == PROC_READY) {
-        remove_from_ready_queue(proc);
-    }
+    /* Its affinity changed while it ran here: move it along */
+    bool migrate = prev->on_rq && !task_allowed(prev, cpu);
     
-    /* Clean up resources */
-    if (proc->stack_base) {
-        kfree((void*)proc->stack_base);
+    prev->on_cpu = false;
+    if (prev->state == PROC_ZOMBIE) {
+        /* Task exited while running: free its stack now that we are off it */
+        if (prev->stack_base) {
+            kfree((void*)prev->stack_base);
+            prev->stack_base = 0;
+        }
+        prev->state = PROC_DEAD;
+        release_task(prev);
     }
+    rq_unlock(rq);
     
-    /* Mark as dead */
-    proc->state = PROC_DEAD;
-    sched_state.total_processes--;
+    if (migrate) {
+        migrate_queued_task(prev, select_allowed_cpu(prev, cpu));
+    }
+}
+
+/* Context switch implementation (caller holds rq->lock, interrupts off) */
+static struct task *context_switch(struct task *from, struct task *to) {
+    sched_state.context_switches++;
+    
+    to->state = PROC_RUNNING;
+    to->on_cpu = true;
+    
+    /* Extended state is saved eagerly only if it was touched this slice */
+    fpu_switch_out(&from->fpu);
+    
+    /* Kernel tasks keep the current address space */
+    if (to->cr3 && to->cr3 != from->cr3) {
+        __asm__ __volatile__("mov %0, %%cr3" :: "r" (to->cr3) : "memory");
+    }
+    
+    fpu_switch_in(&to->fpu);
+    
+    /* SYSCALL entry switches to the top of the running task's stack */
+    this_cpu()->kernel_stack = to->stack_base + to->stack_size;
+    
+    return switch_to(&from->kernel_sp, to->kernel_sp, from);
+}
+
+/*
+ * May the picked task replace prev, which could keep running? Higher
+ * classes and priorities win; among equals normal tasks take turns, RR
+ * tasks after their slice, and FIFO and deadline tasks run until they block.
+ */
+static bool switch_from(struct task *prev, struct task *next) {
+    if (task_preempts(next, prev)) {
+        return true;
+    }
+    if (task_preempts(prev, next)) {
+        return false;
+    }
+    switch (prev->policy) {
+        case SCHED_RR:
+            return prev->slice_expired;
+        case SCHED_FIFO:
+        case SCHED_DEADLINE:
+            return false;
+        default:
+            return true;
+    }
+}
+
+/* Pick the best task of the local run queue: deadline, real-time, then round-robin */
+void schedule(void) {
+    if (!sched_state.initialized) {
+        return;
+    }
+    
+    uint64_t flags = local_irq_save();
+    uint32_t cpu = smp_processor_id();
+    struct runqueue *rq = &runqueues[cpu];
+    rcu_note_context_switch();
+    
+    /* Nothing queued locally: try to steal before going idle */
+    if (rq->nr_queued == 0) {
+        idle_balance(cpu);
+    }
+    
+    rq_lock(rq);
+    this_cpu()->need_resched = 0;
+    
+    struct task *prev = rq->current;
+    uint64_t now = ktime_get_ns();
+    update_curr(rq, prev, now);
+    
+    /* A throttled deadline task waits off the queue for its replenishment */
+    if (prev && prev->state == PROC_RUNNING && prev->dl.throttled) {
+        prev->state = PROC_READY;
+    }
+    bool prev_runnable = prev && prev->state == PROC_RUNNING && prev != rq->idle;
+    
+    /* A task no longer allowed here gives up the CPU and is migrated after the switch */
+    bool must_leave = prev_runnable && !task_allowed(prev, cpu);
+    
+    struct task *next = pick_next_task(rq);
+    if (next && prev_runnable && !must_leave && !switch_from(prev, next)) {
+        next = NULL;
+    }
+    
+    if (!next) {
+        /* Fall back to the idle task if the current one stopped running */
+        if (prev && (prev->state != PROC_RUNNING || must_leave) && prev != rq->idle) {
+            next = rq->idle;
+        }
+        if (!next) {
+            if (prev) {
+                prev->slice_expired = false;
+            }
+            rq_unlock(rq);
+            local_irq_restore(flags);
+            return;
+        }
+    } else {
+        /* Security check */
+        if (prev && !security_check(prev, next, 0)) {
+            rq_unlock(rq);
+            local_irq_restore(flags);
+            KLOG_WARN("Process %lu blocked by security policy", next->pid);
+            return;
+        }
+        
+        /* Remove from ready queue */
+        dequeue_task(rq, next);
+    }
+    
+    /*
+     * Add current process back to ready queue if still running. A
+     * preempted real-time task goes back in front of its equals.
+     */
+    if (prev_runnable) {
+        __enqueue_task(rq, prev, rt_policy(prev->policy) && !prev->slice_expired);
+        prev->slice_expired = false;
+    }
+    if (prev) {
+        prev->last_ran = rq->clock;
+    }
+    
+    next->cpu = cpu;
+    next->exec_start = now;
+    rq->current = next;
+    
+    /* Perform context switch; the lock is released on the new stack */
+    if (prev != next) {
+        prev = context_switch(prev, next);
+        finish_task_switch(prev);
+    } else {
+        next->state = PROC_RUNNING;
+        rq_unlock(rq);
+    }
+    
+    local_irq_restore(flags);
+}
+
+/* Voluntary preemption point for long-running kernel code; a no-op under locks */
+void cond_resched(void) {
+    if (preempt_count()) {
+        return;
+    }
+    rcu_note_context_switch();
+    if (this_cpu()->need_resched) {
+        schedule();
+    }
+}
+
+/*
+ * Involuntary preemption, interrupts disabled. A task between
+ * sched_prepare_to_block() and its schedule() is left alone: it would go
+ * to sleep before arming its wakeup (see schedule_timeout()), and it
+ * reaches schedule() shortly anyway.
+ */
+void preempt_schedule_irq(void) {
+    if (!sched_state.initialized) {
+        return;
+    }
+    struct task *curr = current_task();
+    if (curr && curr->state == PROC_BLOCKED) {
+        return;
+    }
+    
+    do {
+        process_resched();
+        schedule();
+    } while (this_cpu()->need_resched);
+}
+
+/* Preemption point of preempt_enable(), once the count is back to zero */
+void preempt_schedule(void) {
+    if (!preemptible()) {
+        return;
+    }
+    
+    uint64_t flags = local_irq_save();
+    preempt_schedule_irq();
+    local_irq_restore(flags);
+}
+
+/*
+ * Timer tick: accounting, time slices and periodic load balancing. 'ticks'
+ * is the number of tick periods elapsed, more than one after a stopped tick.
+ */
+void sched_tick(uint64_t ticks) {
+    if (!sched_state.initialized) {
+        return;
+    }
+    
+    uint32_t cpu = smp_processor_id();
+    struct runqueue *rq = &runqueues[cpu];
+    struct task *curr = rq->current;
+    
+    rq->clock += ticks;
+    /* Interrupted code that was preemptible holds no RCU readers either */
+    rcu_sched_clock_irq(!curr || curr == rq->idle || preempt_count() == HARDIRQ_OFFSET);
+    
+    if (curr && curr != rq->idle) {
+        curr->cpu_time += ticks;
+        update_curr(rq, curr, ktime_get_ns());
+        
+        /* FIFO and deadline tasks have no slice (time_slice 0) */
+        if (curr->time_slice > 0) {
+            if (curr->time_slice <= ticks) {
+                curr->time_slice = SCHED_TIMESLICE;
+                curr->slice_expired = true;
+                this_cpu()->need_resched = 1;
+            } else {
+                curr->time_slice -= ticks;
+            }
+        }
+    }
+    
+    /* Balance each domain on its own interval, nearest domains most often */
+    for (int level = SD_LLC; level < SD_LEVELS; level++) {
+        if (rq->clock >= rq->next_balance[level]) {
+            rq->next_balance[level] = rq->clock + balance_levels[level].interval;
+            load_balance(cpu, level);
+        }
+    }
+    
+    if (rq->nr_queued > 0 && (!curr || curr == rq->idle)) {
+        this_cpu()->need_resched = 1;
+    }
+}
+
+/* May this CPU run without a periodic tick? (nothing waiting to preempt) */
+bool sched_can_stop_tick(void) {
+    if (!sched_state.initialized) {
+        return true;
+    }
+    /* RR slices and deadline budgets are enforced from the tick */
+    struct runqueue *rq = this_rq();
+    struct task *curr = rq->current;
+    if (curr && (curr->policy == SCHED_RR || curr->policy == SCHED_DEADLINE)) {
+        return false;
+    }
+    if (rcu_needs_cpu()) {
+        return false;
+    }
+    return rq->nr_queued == 0;
+}
+
+/*
+ * Wake a blocked task on the CPU it last ran on. A task that has marked
+ * itself blocked but not yet switched out is simply set running again;
+ * schedule() then keeps it on its CPU.
+ */
+void sched_wake_up(struct task *task) {
+    if (!task || task->state != PROC_BLOCKED) {
+        return;
+    }
+    
+    uint64_t flags = local_irq_save();
+    struct runqueue *src = &runqueues[task->cpu];
+    struct runqueue *rq = &runqueues[select_wake_cpu(task)];
+    double_rq_lock(rq, src);
+    
+    bool queued = false, preempt = false;
+    if (task->state == PROC_BLOCKED) {
+        if (task->on_cpu) {
+            task->state = PROC_RUNNING;
+        } else if (task->dl.throttled) {
+            /* Queued by the replenishment timer */
+            task->state = PROC_READY;
+        } else {
+            if (task->policy == SCHED_DEADLINE) {
+                dl_wakeup(task, ktime_get_ns());
+            }
+            enqueue_task(rq, task);
+            queued = true;
+            preempt = wakeup_preempt(rq, task);
+        }
+    }
+    double_rq_unlock(rq, src);
+    local_irq_restore(flags);
+    
+    if (queued) {
+        rq_kick(rq, preempt);
+        /* The woken task outranks us here: switch now, not at the next tick */
+        if (preempt && this_cpu()->need_resched) {
+            preempt_schedule();
+        }
+    }
+}
+
+/* Currently running task on this CPU */
+struct task *sched_current(void) {
+    return current_task();
+}
+
+/* Extended state of the running task, for the #NM handler */
+struct fpu *sched_current_fpu(void) {
+    struct task *curr = current_task();
+    return curr ? &curr->fpu : NULL;
+}
+
+/*
+ * Mark the running task blocked. It goes to sleep at the next schedule()
+ * unless sched_wake_up() runs first, so wakeups in between are not lost.
+ */
+void sched_prepare_to_block(void) {
+    struct task *curr = current_task();
+    if (curr && curr != this_rq()->idle) {
+        curr->state = PROC_BLOCKED;
+    }
+}
+
+/* Undo sched_prepare_to_block() when the wait ended without sleeping */
+void sched_set_running(void) {
+    struct task *curr = current_task();
+    if (!curr) {
+        return;
+    }
+    
+    uint64_t flags = local_irq_save();
+    struct runqueue *rq = this_rq();
+    rq_lock(rq);
+    if (curr->state == PROC_BLOCKED) {
+        curr->state = PROC_RUNNING;
+    }
+    rq_unlock(rq);
+    local_irq_restore(flags);
+}
+
+/* Record the entry the running task waits on (NULL when the wait is over) */
+void sched_set_wait_entry(struct wait_queue_entry *entry) {
+    struct task *curr = current_task();
+    if (curr) {
+        curr->wait_entry = entry;
+    }
+}
+
+/* Block the running task until sched_wake_up() */
+void sched_block_current(void) {
+    if (!sched_can_block()) {
+        return;
+    }
+    
+    sched_prepare_to_block();
+    schedule();
+}
+
+/* Can the running context sleep? (a real task, interrupts enabled) */
+bool sched_can_block(void) {
+    struct task *curr = current_task();
+    return curr && curr != this_rq()->idle && !irqs_disabled();
+}
+
+/* First code run by a new task (from task_entry_trampoline) */
+void sched_task_start(struct task *prev) {
+    finish_task_switch(prev);
+    enable_interrupts();
+}
+
+/*
+ * Build the initial kernel stack of a new task so that the first
+ * switch_to into it "returns" to task_entry_trampoline, which calls
+ * entry(arg). The layout matches the pops in switch_to.
+ */
+static void setup_initial_stack(struct task *proc, void (*entry)(void *), void *arg) {
+    uint64_t *sp = (uint64_t *)(proc->stack_base + proc->stack_size);
+    
+    *--sp = (uint64_t)task_entry_trampoline;   /* Return address */
+    *--sp = 0;                                  /* rbp */
+    *--sp = 0;                                  /* rbx */
+    *--sp = (uint64_t)entry;                    /* r12 */
+    *--sp = (uint64_t)arg;                      /* r13 */
+    *--sp = 0;                                  /* r14 */
+    *--sp = 0;                                  /* r15 */
+    
+    proc->kernel_sp = (uint64_t)sp;
+}
+
+/*
+ * Create a task running entry(arg) in kernel mode, queued on 'cpu' and
+ * bound to it, or on the least loaded CPU near the parent if cpu < 0.
+ */
+static struct task *__create_process(const char *name, enum security_level sec_level,
+                                     bool privileged, void (*entry)(void *), void *arg,
+                                     void *kthread, int cpu) {
+    struct task *proc = alloc_process();
+    if (!proc) {
+        KLOG_ERR("Failed to allocate process: %s", name);
+        return NULL;
+    }
+    
+    int pid = pid_alloc(&sched_state.pids);
+    if (pid < 0) {
+        KLOG_ERR("Out of PIDs for process: %s", name);
+        release_task(proc);
+        return NULL;
+    }
+    
+    struct task *parent = current_task();
+    
+    /* Initialize process */
+    proc->pid = (uint64_t)pid;
+    proc->ppid = parent ? parent->pid : 0;
+    proc->state = PROC_READY;
+    proc->sec_level = sec_level;
+    proc->privileged = privileged;
+    proc->kthread = kthread;
+    
+    /* Set up stack */
+    proc->stack_size = 0x4000; /* 16KB stack */
+    proc->stack_base = (uint64_t)kmalloc_aligned(proc->stack_size, PAGE_SIZE);
+    if (!proc->stack_base) {
+        proc->state = PROC_DEAD;
+        release_task(proc);
+        KLOG_ERR("Failed to allocate stack for process: %s", name);
+        return NULL;
+    }
+    setup_initial_stack(proc, entry, arg);
+    fpu_task_init(&proc->fpu);
+    
+    /* Initialize security context */
+    proc->stack_canary = get_stack_canary();
+    proc->capabilities = privileged ? 0xFFFFFFFF : 0x00000001;
+    
+    /* Scheduling parameters */
+    proc->creation_time = get_ticks();
+    proc->priority = 10;  /* Normal priority */
+    proc->time_slice = SCHED_TIMESLICE; /* 10ms time slice */
+    proc->policy = SCHED_NORMAL;
+    
+    /* Copy name */
+    strncpy(proc->name, name, sizeof(proc->name) - 1);
+    proc->name[sizeof(proc->name) - 1] = '\0';
+    
+    pid_hash_add(&sched_state.pids, &proc->pid_node, pid);
+    
+    /* Set parent-child relationship */
+    if (parent) {
+        proc->parent = parent;
+        proc->next_sibling = parent->first_child;
+        parent->first_child = proc;
+    }
+    
+    /* Inherit the cpuset and affinity of the parent */
+    proc->cpuset = parent && parent->cpuset ? parent->cpuset : cpuset_root();
+    cpuset_hold(proc->cpuset);
+    if (cpu >= 0) {
+        proc->bound = true;
+        cpumask_clear(&proc->cpus_allowed);
+        cpumask_set_cpu((uint32_t)cpu, &proc->cpus_allowed);
+    } else if (parent && parent->cpuset) {
+        proc->cpus_allowed = parent->cpus_allowed;
+    } else {
+        proc->cpus_allowed = proc->cpuset->cpus;
+    }
+    
+    /* Add to the ready queue of the least loaded CPU near the parent */
+    struct runqueue *rq = &runqueues[cpu >= 0 ? (uint32_t)cpu : select_fork_cpu(parent, proc)];
+    uint64_t flags = local_irq_save();
+    rq_lock(rq);
+    enqueue_task(rq, proc);
+    rq_unlock(rq);
+    local_irq_restore(flags);
+    rq_kick(rq, false);
+    sched_state.total_processes++;
+    
+    KLOG_INFO("Created process: %s (PID: %lu, Security: %d, CPU: %u)",
+              name, proc->pid, sec_level, proc->cpu);
+    
+    return proc;
+}
+
+/* Create new process running entry(arg) in kernel mode */
+struct task *create_process(const char *name, enum security_level sec_level, bool privileged,
+                            void (*entry)(void *), void *arg) {
+    return __create_process(name, sec_level, privileged, entry, arg, NULL, -1);
+}
+
+/* Create a privileged kernel thread, bound to 'cpu' unless cpu < 0 */
+struct task *sched_create_kthread(const char *name, void (*entry)(void *), void *arg,
+                                  void *kthread, int cpu) {
+    if (cpu >= (int)smp_num_cpus()) {
+        return NULL;
+    }
+    return __create_process(name, SEC_PENTAGON, true, entry, arg, kthread, cpu);
+}
+
+/* Kernel thread control of the running task */
+void *sched_current_kthread(void) {
+    struct task *curr = current_task();
+    return curr ? curr->kthread : NULL;
+}
+
+/* Let the running task's user copies reach kernel memory; returns the old setting */
+bool sched_set_uaccess_kernel(bool enable) {
+    struct task *curr = current_task();
+    if (!curr) {
+        return false;
+    }
+    bool old = curr->uaccess_kernel;
+    curr->uaccess_kernel = enable;
+    return old;
+}
+
+bool sched_uaccess_kernel(void) {
+    struct task *curr = current_task();
+    return curr && curr->uaccess_kernel;
+}
+
+/*
+ * Run the current task on the page tables at 'cr3', as a kernel thread
+ * working on a process's memory does; returns the previous setting (0:
+ * whatever address space the CPU was in).
+ */
+uint64_t sched_set_cr3(uint64_t cr3) {
+    struct task *curr = current_task();
+    if (!curr) {
+        return 0;
+    }
+    
+    uint64_t flags = local_irq_save();
+    uint64_t old = curr->cr3;
+    curr->cr3 = cr3;
+    if (cr3 && read_cr3() != cr3) {
+        __asm__ __volatile__("mov %0, %%cr3" :: "r" (cr3) : "memory");
+    }
+    local_irq_restore(flags);
+    return old;
+}
+
+/* Initialize the idle task of a CPU */
+static void create_idle_process(uint32_t cpu) {
+    struct task *idle = alloc_process();
+    if (!idle) {
+        PANIC("Failed to allocate idle task for CPU %u", cpu);
+    }
+    
+    idle->pid = 0;
+    idle->state = PROC_RUNNING;
+    idle->sec_level = SEC_PENTAGON;
+    idle->privileged = true;
+    idle->cpu = cpu;
+    idle->on_cpu = true;
+    fpu_task_init(&idle->fpu);
+    strcpy(idle->name, "idle");
+    
+    /* Set as current process */
+    runqueues[cpu].idle = idle;
+    runqueues[cpu].current = idle;
+    
+    KLOG_INFO("Idle process created for CPU %u (PID: 0)", cpu);
+}
+
+/* Prepare the run queue of a CPU that has just come online */
+void sched_cpu_online(uint32_t cpu) {
+    if (cpu >= MAX_CPUS) {
+        return;
+    }
+    
+    struct runqueue *rq = &runqueues[cpu];
+    memset(rq, 0, sizeof(*rq));
+    
+    /* Stagger balance passes so CPUs do not balance in lockstep */
+    for (int level = SD_LLC; level < SD_LEVELS; level++) {
+        rq->next_balance[level] = balance_levels[level].interval + cpu;
+    }
+    
+    create_idle_process(cpu);
+}
+
+/* Kernel-side body of PID 1 until a userland init is loaded */
+static void init_task_main(void *arg) {
+    (void)arg;
+    
+    KLOG_INFO("init running on CPU %u", smp_processor_id());
+    for (;;) {
+        sched_block_current();
+    }
+}
+
+void scheduler_init(void) {
+    KLOG_INFO("Initializing Pentagon-level process scheduler...");
+    
+    /* Initialize scheduler state */
+    memset(&sched_state, 0, sizeof(sched_state));
+    rcu_init();
+    cpuset_init();
+    if (pid_table_init(&sched_state.pids, PID_MAX_DEFAULT) < 0) {
+        PANIC("Failed to allocate the PID table");
+    }
+    sched_state.task_cache = kmem_cache_create("task", sizeof(struct task), 64);
+    if (!sched_state.task_cache) {
+        PANIC("Failed to create the task cache");
+    }
+    
+    /* Per-CPU run queues and idle tasks */
+    for (uint32_t cpu = 0; cpu < smp_num_cpus(); cpu++) {
+        sched_cpu_online(cpu);
+    }
+    sched_state.initialized = true;
+    
+    /* Create init process */
+    create_process("init", SEC_PENTAGON, true, init_task_main, NULL);
+    
+    KLOG_INFO("Process scheduler initialized (%u run queues)", smp_num_cpus());
+    KLOG_INFO("Security model: Bell-LaPadula with Pentagon classification");
+}
+
+/* Get process by PID; the caller holds rcu_read_lock() while it uses the task */
+struct task *get_process(uint64_t pid) {
+    if (!pid || pid >= PID_MAX_DEFAULT) {
+        return NULL;
+    }
+    
+    struct pid_node *node = pid_hash_find(&sched_state.pids, (uint32_t)pid);
+    return node ? pid_entry(node, struct task, pid_node) : NULL;
+}
+
+/* Validate the parameters of a scheduling class change */
+static int sched_check_attr(const struct sched_attr *attr) {
+    switch (attr->sched_policy) {
+        case SCHED_NORMAL:
+            return attr->sched_priority == 0 ? 0 : -22; /* EINVAL */
+        case SCHED_FIFO:
+        case SCHED_RR:
+            if (attr->sched_priority < 1 || attr->sched_priority >= MAX_RT_PRIO) {
+                return -22; /* EINVAL */
+            }
+            return 0;
+        case SCHED_DEADLINE: {
+            uint64_t period = attr->sched_period ? attr->sched_period : attr->sched_deadline;
+            if (attr->sched_runtime < DL_MIN_RUNTIME ||
+                attr->sched_runtime > attr->sched_deadline ||
+                attr->sched_deadline > period || period > DL_MAX_PERIOD) {
+                return -22; /* EINVAL */
+            }
+            return 0;
+        }
+        default:
+            return -22; /* EINVAL */
+    }
+}
+
+/*
+ * Move a task to another scheduling class. Real-time and deadline classes
+ * need a privileged caller, and deadline tasks are admitted only while the
+ * total reserved bandwidth fits in DL_BW_LIMIT_PCT of the CPUs.
+ */
+static int sched_setattr_task(struct task *proc, const struct sched_attr *attr) {
+    struct task *curr = current_task();
+    if (proc->state == PROC_ZOMBIE || proc->state == PROC_DEAD) {
+        return -3; /* ESRCH */
+    }
+    if (curr && attr->sched_policy != SCHED_NORMAL && !curr->privileged) {
+        return -1; /* EPERM */
+    }
+    if (curr && curr != proc && !security_check(curr, proc, 1)) {
+        return -1; /* EPERM */
+    }
+    
+    /* Reserve the new bandwidth before committing to the change */
+    uint32_t policy = attr->sched_policy;
+    uint64_t period = attr->sched_period ? attr->sched_period : attr->sched_deadline;
+    uint64_t new_bw = policy == SCHED_DEADLINE ? (attr->sched_runtime << DL_BW_SHIFT) / period : 0;
+    uint64_t old_bw = proc->policy == SCHED_DEADLINE ? proc->dl.bw : 0;
+    int ret = dl_bw_update(old_bw, new_bw);
+    if (ret < 0) {
+        return ret;
+    }
+    
+    uint64_t flags = local_irq_save();
+    struct runqueue *rq = &runqueues[proc->cpu];
+    rq_lock(rq);
+    
+    bool queued = proc->on_rq;
+    if (queued) {
+        dequeue_task(rq, proc);
+    }
+    if (proc->policy == SCHED_DEADLINE) {
+        hrtimer_cancel(&proc->dl.timer);
+    }
+    
+    proc->policy = policy;
+    proc->rt_priority = rt_policy(policy) ? attr->sched_priority : 0;
+    proc->time_slice = (policy == SCHED_NORMAL || policy == SCHED_RR) ? SCHED_TIMESLICE : 0;
+    proc->dl.throttled = false;
+    if (policy == SCHED_DEADLINE) {
+        proc->dl.runtime = attr->sched_runtime;
+        proc->dl.deadline = attr->sched_deadline;
+        proc->dl.period = period;
+        proc->dl.bw = new_bw;
+        proc->dl.abs_deadline = ktime_get_ns() + proc->dl.deadline;
+        proc->dl.remaining = (int64_t)proc->dl.runtime;
+        hrtimer_setup(&proc->dl.timer, dl_timer_fn, proc);
+    }
+    
+    /* Requeue in the new class; a task that was throttled becomes runnable */
+    bool preempt = false;
+    if (queued || (proc->state == PROC_READY && !proc->on_cpu)) {
+        enqueue_task(rq, proc);
+        preempt = wakeup_preempt(rq, proc);
+    } else if (proc == rq->current) {
+        /* The running task may have lowered itself below a queued one */
+        preempt = rq->nr_queued > 0;
+    }
+    uint32_t cpu = proc->cpu;
+    rq_unlock(rq);
+    local_irq_restore(flags);
+    
+    if (preempt) {
+        resched_cpu(cpu);
+    }
+    return 0;
+}
+
+int sched_setattr(uint64_t pid, const struct sched_attr *attr) {
+    if (!attr) {
+        return -22; /* EINVAL */
+    }
+    int ret = sched_check_attr(attr);
+    if (ret < 0) {
+        return ret;
+    }
+    
+    rcu_read_lock();
+    struct task *proc = pid ? get_process(pid) : current_task();
+    ret = proc ? sched_setattr_task(proc, attr) : -3; /* ESRCH */
+    rcu_read_unlock();
+    return ret;
+}
+
+/* Set a task's policy and real-time priority; SCHED_DEADLINE needs sched_setattr() */
+int sched_setscheduler(uint64_t pid, uint32_t policy, uint32_t priority) {
+    if (policy == SCHED_DEADLINE) {
+        return -22; /* EINVAL */
+    }
+    
+    struct sched_attr attr = {
+        .size = sizeof(attr),
+        .sched_policy = policy,
+        .sched_priority = priority,
+    };
+    return sched_setattr(pid, &attr);
+}
+
+/* Scheduling policy of a task */
+int sched_getscheduler(uint64_t pid) {
+    rcu_read_lock();
+    struct task *proc = pid ? get_process(pid) : current_task();
+    int ret = proc ? (int)proc->policy : -3; /* ESRCH */
+    rcu_read_unlock();
+    return ret;
+}
+
+/*
+ * Install a new affinity. A queued task moves to an allowed CPU now; a
+ * running one is preempted and moved once it is off its CPU (the caller's
+ * own task at its rcu_read_unlock()).
+ */
+static void set_cpus_allowed(struct task *proc, const cpumask_t *mask) {
+    uint64_t flags = local_irq_save();
+    struct runqueue *rq = &runqueues[proc->cpu];
+    rq_lock(rq);
+    
+    proc->cpus_allowed = *mask;
+    uint32_t cpu = proc->cpu;
+    bool queued_away = proc->on_rq && !proc->on_cpu && !task_allowed(proc, cpu);
+    bool running_away = proc == rq->current && !task_allowed(proc, cpu);
+    
+    rq_unlock(rq);
+    local_irq_restore(flags);
+    
+    if (queued_away) {
+        migrate_queued_task(proc, select_allowed_cpu(proc, cpu));
+    }
+    if (running_away) {
+        resched_cpu(cpu);
+    }
+}
+
+/* Restrict a task to the online CPUs of mask within its cpuset */
+static int sched_setaffinity_task(struct task *proc, const cpumask_t *mask) {
+    struct task *curr = current_task();
+    if (proc->state == PROC_ZOMBIE || proc->state == PROC_DEAD) {
+        return -3; /* ESRCH */
+    }
+    if (curr && curr != proc && !security_check(curr, proc, 1)) {
+        return -1; /* EPERM */
+    }
+    if (proc->bound) {
+        return -22; /* EINVAL */
+    }
+    
+    cpumask_t allowed, online;
+    cpumask_online(&online);
+    if (!cpumask_and(&allowed, mask, &proc->cpuset->cpus) ||
+        !cpumask_and(&allowed, &allowed, &online)) {
+        return -22; /* EINVAL */
+    }
+    
+    set_cpus_allowed(proc, &allowed);
+    return 0;
+}
+
+int sched_setaffinity(uint64_t pid, const cpumask_t *mask) {
+    if (!mask) {
+        return -22; /* EINVAL */
+    }
+    
+    rcu_read_lock();
+    struct task *proc = pid ? get_process(pid) : current_task();
+    int ret = proc ? sched_setaffinity_task(proc, mask) : -3; /* ESRCH */
+    rcu_read_unlock();
+    return ret;
+}
+
+int sched_getaffinity(uint64_t pid, cpumask_t *mask) {
+    rcu_read_lock();
+    struct task *proc = pid ? get_process(pid) : current_task();
+    if (proc && mask) {
+        *mask = proc->cpus_allowed;
+    }
+    rcu_read_unlock();
+    return proc ? 0 : -3; /* ESRCH */
+}
+
+/*
+ * Move a task into a cpuset (from cpuset_attach(), which holds a reference
+ * to cs for the task). Only privileged tasks may regroup tasks, since
+ * leaving a set would lift its restriction.
+ */
+static int sched_set_cpuset_task(struct task *proc, struct cpuset *cs) {
+    struct task *curr = current_task();
+    if (proc->state == PROC_ZOMBIE || proc->state == PROC_DEAD) {
+        return -3; /* ESRCH */
+    }
+    if (curr && (!curr->privileged || !security_check(curr, proc, 1))) {
+        return -1; /* EPERM */
+    }
+    if (proc->bound) {
+        return -22; /* EINVAL */
+    }
+    
+    cpumask_t allowed, online;
+    cpumask_online(&online);
+    if (!cpumask_and(&allowed, &cs->cpus, &online)) {
+        return -22; /* EINVAL */
+    }
+    
+    struct cpuset *old = proc->cpuset;
+    proc->cpuset = cs;
+    if (old) {
+        cpuset_release(old);
+    }
+    set_cpus_allowed(proc, &allowed);
+    return 0;
+}
+
+int sched_set_cpuset(uint64_t pid, struct cpuset *cs) {
+    rcu_read_lock();
+    struct task *proc = pid ? get_process(pid) : current_task();
+    int ret = proc ? sched_set_cpuset_task(proc, cs) : -3; /* ESRCH */
+    rcu_read_unlock();
+    return ret;
+}
+
+/* Unlink a task from its parent's child list */
+static void unlink_from_parent(struct task *proc) {
+    if (!proc->parent) {
+        return;
+    }
+    
+    if (proc->parent->first_child == proc) {
+        proc->parent->first_child = proc->next_sibling;
+    } else {
+        struct task *sibling = proc->parent->first_child;
+        while (sibling && sibling->next_sibling != proc) {
+            sibling = sibling->next_sibling;
+        }
+        if (sibling) {
+            sibling->next_sibling = proc->next_sibling;
+        }
+    }
+    proc->parent = NULL;
+    proc->next_sibling = NULL;
+}
+
+/* Terminate a task; returns true if it was the caller, which must schedule away */
+static bool terminate_task(struct task *proc) {
+    struct task *curr = current_task();
+    
+    /* Security check */
+    if (curr && !security_check(curr, proc, 1)) {
+        KLOG_WARN("Process termination blocked by security policy");
+        return false;
+    }
+    
+    /* Remove from queues */
+    uint64_t flags = local_irq_save();
+    struct runqueue *rq = &runqueues[proc->cpu];
+    rq_lock(rq);
+    if (proc->on_rq) {
+        dequeue_task(rq, proc);
+    }
+    
+    /* Mark as dead; a running task keeps its stack until it is switched out */
+    bool was_current = (proc == curr);
+    bool running = proc->on_cpu;
+    bool blocked = proc->state == PROC_BLOCKED;
+    proc->state = running ? PROC_ZOMBIE : PROC_DEAD;
+    rq_unlock(rq);
+    local_irq_restore(flags);
+    if (running && !was_current) {
+        resched_cpu(proc->cpu);
+    }
+    
+    /* A sleeper's wait entry lives on the stack that is freed: unqueue it first */
+    if (blocked && proc->wait_entry) {
+        wait_entry_cancel(proc->wait_entry);
+        proc->wait_entry = NULL;
+    }
+    
+    /* Clean up resources */
+    if (!running && proc->stack_base) {
+        kfree((void*)proc->stack_base);
+        proc->stack_base = 0;
+    }
+    fpu_task_exit(&proc->fpu);
+    unlink_from_parent(proc);
+    sched_state.total_processes--;
     
     KLOG_INFO("Process %s (PID: %lu) terminated", proc->name, proc->pid);
+    if (!running) {
+        release_task(proc);
+    }
+    return was_current;
+}
+
+/* Terminate process */
+void terminate_process(uint64_t pid) {
+    rcu_read_lock();
+    struct task *proc = get_process(pid);
+    bool was_current = proc && terminate_task(proc);
+    rcu_read_unlock();
     
     /* Schedule next process if this was current */
-    if (proc == current_process) {
-        current_process = NULL;
+    if (was_current) {
         schedule();
     }
 }
 
+/* A task's entry function returned */
+void sched_task_exit(void) {
+    struct task *curr = current_task();
+    terminate_process(curr->pid);
+    
+    PANIC("Exited task %lu was scheduled again", curr->pid);
+}
+
 /* Get scheduler statistics */
 void sched_get_stats(uint64_t *processes, uint64_t *context_switches) {
     if (processes) *processes = sched_state.total_processes;
     if (context_switches) *context_switches = sched_state.context_switches;
+}
+
+/* Get load balancing statistics summed over all CPUs */
+void sched_get_balance_stats(uint64_t *migrations, uint64_t *steals, uint64_t *imbalances) {
+    uint64_t total_migrations = 0, total_steals = 0, total_imbalances = 0;
+    
+    for (uint32_t cpu = 0; cpu < smp_num_cpus(); cpu++) {
+        struct runqueue *rq = &runqueues[cpu];
+        uint64_t m, s, i;
+        uint32_t seq;
+        do {
+            seq = read_seqcount_begin(&rq->stats_seq);
+            m = rq->migrations;
+            s = rq->steals;
+            i = rq->imbalances;
+        } while (read_seqcount_retry(&rq->stats_seq, seq));
+        total_migrations += m;
+        total_steals += s;
+        total_imbalances += i;
+    }
+    
+    if (migrations) *migrations = total_migrations;
+    if (steals) *steals = total_steals;
+    if (imbalances) *imbalances = total_imbalances;
+}
+
+/* Get run queue statistics of one CPU */
+void sched_get_cpu_stats(uint32_t cpu, uint32_t *nr_running, uint64_t *migrations,
+                         uint64_t *steals, uint64_t *imbalances) {
+    if (cpu >= smp_num_cpus()) {
+        return;
+    }
+    
+    struct runqueue *rq = &runqueues[cpu];
+    uint64_t m, s, i;
+    uint32_t seq;
+    do {
+        seq = read_seqcount_begin(&rq->stats_seq);
+        m = rq->migrations;
+        s = rq->steals;
+        i = rq->imbalances;
+    } while (read_seqcount_retry(&rq->stats_seq, seq));
+    
+    if (nr_running) *nr_running = rq_load(rq);
+    if (migrations) *migrations = m;
+    if (steals) *steals = s;
+    if (imbalances) *imbalances = i;
+}
+
+/* Benchmark task bodies */
+static void bench_exit_main(void *arg) {
+    (void)arg;
+}
+
+static void bench_sleep_main(void *arg) {
+    (void)arg;
+    for (;;) {
+        sched_block_current();
+    }
+}
+
+/*
+ * Throughput benchmark for fork-heavy and wake-heavy workloads.
+ * Reports TSC cycles per operation and where woken tasks landed.
+ */
+#define SCHED_BENCH_WAKERS 32
+
+void sched_benchmark(uint32_t iterations) {
+    KLOG_INFO("=== SCHEDULER BENCHMARK (%u iterations, %u CPUs) ===",
+              iterations, smp_num_cpus());
+    
+    /* Fork-heavy: create and immediately reap short-lived tasks */
+    uint64_t start = get_ticks();
+    for (uint32_t i = 0; i < iterations; i++) {
+        struct task *proc = create_process("bench-fork", SEC_PENTAGON, false,
+                                           bench_exit_main, NULL);
+        if (!proc) {
+            KLOG_ERR("Fork benchmark stopped at iteration %u", i);
+            break;
+        }
+        terminate_process(proc->pid);
+    }
+    uint64_t fork_cycles = get_ticks() - start;
+    
+    /* Wake-heavy: block and wake a fixed set of tasks repeatedly */
+    struct task *wakers[SCHED_BENCH_WAKERS];
+    uint32_t nr_wakers = 0;
+    for (; nr_wakers < SCHED_BENCH_WAKERS; nr_wakers++) {
+        wakers[nr_wakers] = create_process("bench-wake", SEC_PENTAGON, false,
+                                           bench_sleep_main, NULL);
+        if (!wakers[nr_wakers]) {
+            break;
+        }
+    }
+    
+    uint64_t wakeups = 0;
+    start = get_ticks();
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (uint32_t w = 0; w < nr_wakers; w++) {
+            struct task *proc = wakers[w];
+            struct runqueue *rq = &runqueues[proc->cpu];
+            
+            uint64_t flags = local_irq_save();
+            rq_lock(rq);
+            if (proc->on_rq) {
+                dequeue_task(rq, proc);
+            }
+            proc->state = PROC_BLOCKED;
+            rq_unlock(rq);
+            local_irq_restore(flags);
+            
+            sched_wake_up(proc);
+            wakeups++;
+        }
+    }
+    uint64_t wake_cycles = get_ticks() - start;
+    
+    for (uint32_t w = 0; w < nr_wakers; w++) {
+        terminate_process(wakers[w]->pid);
+    }
+    
+    uint64_t migrations, steals, imbalances;
+    sched_get_balance_stats(&migrations, &steals, &imbalances);
+    
+    KLOG_INFO("fork+exit: %lu cycles/op", iterations ? fork_cycles / iterations : 0);
+    KLOG_INFO("wakeup:    %lu cycles/op", wakeups ? wake_cycles / wakeups : 0);
+    KLOG_INFO("balance:   %lu migrations, %lu steals, %lu imbalances",
+              migrations, steals, imbalances);
+}
+
+/* Ping-pong state: two tasks yielding to each other */
+static struct {
+    uint32_t iterations;
+    volatile uint32_t finished;
+} pingpong;
+
+static void pingpong_main(void *arg) {
+    (void)arg;
+    for (uint32_t i = 0; i < pingpong.iterations; i++) {
+        schedule();
+    }
+    __sync_fetch_and_add(&pingpong.finished, 1);
+}
+
+/*
+ * Context switch latency benchmark: two tasks on this CPU yield to each
+ * other, so every schedule() is a full switch_to between them.
+ */
+void sched_benchmark_switch(uint32_t iterations) {
+    uint32_t cpu = smp_processor_id();
+    
+    KLOG_INFO("=== CONTEXT SWITCH BENCHMARK (%u round trips, CPU %u) ===", iterations, cpu);
+    
+    pingpong.iterations = iterations;
+    pingpong.finished = 0;
+    
+    struct task *ping = create_process("bench-ping", SEC_PENTAGON, true, pingpong_main, NULL);
+    struct task *pong = create_process("bench-pong", SEC_PENTAGON, true, pingpong_main, NULL);
+    if (!ping || !pong) {
+        KLOG_ERR("Context switch benchmark could not create tasks");
+        return;
+    }
+    migrate_queued_task(ping, cpu);
+    migrate_queued_task(pong, cpu);
+    
+    uint64_t saves, restores, traps, lazy_hits;
+    fpu_get_stats(&saves, &restores, &traps, &lazy_hits);
+    uint64_t switches = sched_state.context_switches;
+    uint64_t start = get_ticks();
+    
+    while (pingpong.finished < 2) {
+        schedule();
+    }
+    
+    uint64_t cycles = get_ticks() - start;
+    switches = sched_state.context_switches - switches;
+    
+    uint64_t saves_now, restores_now, traps_now, lazy_hits_now;
+    fpu_get_stats(&saves_now, &restores_now, &traps_now, &lazy_hits_now);
+    
+    KLOG_INFO("switch:    %lu cycles/switch over %lu switches",
+              switches ? cycles / switches : 0, switches);
+    KLOG_INFO("fpu (%s): %lu saves, %lu restores, %lu traps, %lu lazy hits",
+              fpu_save_method(), saves_now - saves, restores_now - restores,
+              traps_now - traps, lazy_hits_now - lazy_hits);
+}
+
+/*
+ * PID lookup benchmark: populate the PID table with nr_tasks blocked
+ * task structures, then time lookups, fork+exit and teardown at that size.
+ */
+#define SCHED_BENCH_PID_FORKS   1000
+
+void sched_benchmark_pid(uint32_t nr_tasks) {
+    KLOG_INFO("=== PID BENCHMARK (%u tasks) ===", nr_tasks);
+    
+    struct task **tasks = kmalloc(sizeof(struct task *) * nr_tasks);
+    if (!tasks) {
+        KLOG_ERR("PID benchmark: out of memory");
+        return;
+    }
+    
+    /* Create: task structure, PID and hash entry; no stack or run queue */
+    uint32_t nr_created = 0;
+    uint64_t start = get_ticks();
+    for (; nr_created < nr_tasks; nr_created++) {
+        struct task *proc = alloc_process();
+        int pid = proc ? pid_alloc(&sched_state.pids) : -11;
+        if (pid < 0) {
+            if (proc) {
+                release_task(proc);
+            }
+            break;
+        }
+        proc->pid = (uint64_t)pid;
+        proc->state = PROC_BLOCKED;
+        pid_hash_add(&sched_state.pids, &proc->pid_node, pid);
+        tasks[nr_created] = proc;
+    }
+    uint64_t create_cycles = get_ticks() - start;
+    if (nr_created < nr_tasks) {
+        KLOG_WARN("PID benchmark: stopped at %u tasks", nr_created);
+    }
+    
+    /* Lookup: random hits across the whole population */
+    uint64_t seed = get_ticks() | 1;
+    uint32_t misses = 0;
+    start = get_ticks();
+    rcu_read_lock();
+    for (uint32_t i = 0; i < nr_created; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        struct task *proc = tasks[(seed >> 33) % nr_created];
+        if (get_process(proc->pid) != proc) {
+            misses++;
+        }
+    }
+    rcu_read_unlock();
+    uint64_t lookup_cycles = get_ticks() - start;
+    
+    /* Full fork+exit with the table populated */
+    start = get_ticks();
+    uint32_t forks = 0;
+    for (; forks < SCHED_BENCH_PID_FORKS; forks++) {
+        struct task *proc = create_process("bench-pid", SEC_PENTAGON, false,
+                                           bench_exit_main, NULL);
+        if (!proc) {
+            break;
+        }
+        terminate_process(proc->pid);
+    }
+    uint64_t fork_cycles = get_ticks() - start;
+    
+    /* Destroy */
+    start = get_ticks();
+    for (uint32_t i = 0; i < nr_created; i++) {
+        tasks[i]->state = PROC_DEAD;
+        release_task(tasks[i]);
+    }
+    uint64_t destroy_cycles = get_ticks() - start;
+    kfree(tasks);
+    
+    if (!nr_created) {
+        return;
+    }
+    KLOG_INFO("create:    %lu cycles/op", create_cycles / nr_created);
+    KLOG_INFO("lookup:    %lu cycles/op, %u misses, %u hash buckets",
+              lookup_cycles / nr_created, misses, sched_state.pids.nr_buckets);
+    KLOG_INFO("fork+exit: %lu cycles/op", forks ? fork_cycles / forks : 0);
+    KLOG_INFO("destroy:   %lu cycles/op", destroy_cycles / nr_created);
+}
+
+/* Contended lock benchmark state */
+enum bench_lock_kind {
+    BENCH_LOCK_SPIN,
+    BENCH_LOCK_MUTEX,
+    BENCH_LOCK_FUTEX,
+    BENCH_LOCK_KINDS
+};
+
+static const char *const bench_lock_names[BENCH_LOCK_KINDS] = {
+    "spin", "mutex", "futex"
+};
+
+static struct {
+    enum bench_lock_kind kind;
+    uint32_t iterations;
+    uint32_t hold_cycles;
+    volatile int spin;
+    struct mutex mutex;
+    volatile uint32_t futex;            /* 0 free, 1 locked, 2 contended */
+    volatile uint64_t counter;
+    volatile uint32_t finished;
+} lockbench;
+
+static void lockbench_futex_lock(void) {
+    uint32_t c = __sync_val_compare_and_swap(&lockbench.futex, 0, 1);
+    if (c == 0) {
+        return;
+    }
+    if (c != 2) {
+        c = __sync_lock_test_and_set(&lockbench.futex, 2);
+    }
+    while (c != 0) {
+        futex_wait((uint32_t *)&lockbench.futex, 2, 0);
+        c = __sync_lock_test_and_set(&lockbench.futex, 2);
+    }
+}
+
+static void lockbench_futex_unlock(void) {
+    if (__sync_fetch_and_sub(&lockbench.futex, 1) != 1) {
+        lockbench.futex = 0;
+        futex_wake((uint32_t *)&lockbench.futex, 1);
+    }
+}
+
+static void lockbench_main(void *arg) {
+    (void)arg;
+    for (uint32_t i = 0; i < lockbench.iterations; i++) {
+        switch (lockbench.kind) {
+            case BENCH_LOCK_SPIN:
+                while (__sync_lock_test_and_set(&lockbench.spin, 1)) {
+                    cpu_relax();
+                }
+                break;
+            case BENCH_LOCK_MUTEX:
+                mutex_lock(&lockbench.mutex);
+                break;
+            default:
+                lockbench_futex_lock();
+                break;
+        }
+        
+        /* Critical section: hold the lock for a fixed time */
+        uint64_t until = get_ticks() + lockbench.hold_cycles;
+        lockbench.counter++;
+        while (get_ticks() < until) {
+            cpu_relax();
+        }
+        
+        switch (lockbench.kind) {
+            case BENCH_LOCK_SPIN:
+                __sync_lock_release(&lockbench.spin);
+                break;
+            case BENCH_LOCK_MUTEX:
+                mutex_unlock(&lockbench.mutex);
+                break;
+            default:
+                lockbench_futex_unlock();
+                break;
+        }
+    }
+    __sync_fetch_and_add(&lockbench.finished, 1);
+}
+
+/*
+ * Contended lock benchmark: nr_tasks tasks spread over all CPUs take one
+ * lock 'iterations' times each and hold it for hold_cycles. Compares a
+ * test-and-set spin lock with the sleeping mutex and a futex lock; the
+ * sleeping locks give the CPU to other work instead of burning it.
+ */
+void sched_benchmark_lock(uint32_t nr_tasks, uint32_t iterations, uint32_t hold_cycles) {
+    uint32_t nr_cpus = smp_num_cpus();
+    
+    KLOG_INFO("=== CONTENDED LOCK BENCHMARK (%u tasks, %u CPUs, %u x %u cycles) ===",
+              nr_tasks, nr_cpus, iterations, hold_cycles);
+    
+    for (int kind = 0; kind < BENCH_LOCK_KINDS; kind++) {
+        lockbench.kind = kind;
+        lockbench.iterations = iterations;
+        lockbench.hold_cycles = hold_cycles;
+        lockbench.spin = 0;
+        lockbench.futex = 0;
+        lockbench.counter = 0;
+        lockbench.finished = 0;
+        mutex_init(&lockbench.mutex);
+        
+        uint64_t waits, wakes;
+        futex_get_stats(&waits, &wakes, NULL, NULL);
+        uint64_t switches = sched_state.context_switches;
+        uint64_t start = get_ticks();
+        
+        uint32_t started = 0;
+        for (; started < nr_tasks; started++) {
+            struct task *proc = create_process("bench-lock", SEC_PENTAGON, true,
+                                               lockbench_main, NULL);
+            if (!proc) {
+                break;
+            }
+            migrate_queued_task(proc, started % nr_cpus);
+        }
+        
+        while (lockbench.finished < started) {
+            schedule();
+        }
+        
+        uint64_t cycles = get_ticks() - start;
+        uint64_t ops = (uint64_t)started * iterations;
+        uint64_t waits_now, wakes_now;
+        futex_get_stats(&waits_now, &wakes_now, NULL, NULL);
+        
+        KLOG_INFO("%-6s %lu cycles/op, %lu switches, %lu futex sleeps, counter %s",
+                  bench_lock_names[kind], ops ? cycles / ops : 0,
+                  sched_state.context_switches - switches, waits_now - waits,
+                  lockbench.counter == ops ? "ok" : "LOST UPDATES");
+    }
+}
+
+/* Wakeup latency benchmark state */
+#define LATBENCH_BUCKETS    100     /* 1us histogram buckets, the last one open-ended */
+#define LATBENCH_BURST      20000   /* Hog cycles between preemption points */
+
+static struct {
+    uint32_t loops;
+    uint32_t interval_us;
+    struct sched_attr attr;         /* Class of the measuring task */
+    int setattr_ret;
+    volatile bool stop;
+    volatile uint32_t finished;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t total_ns;
+    uint32_t hist[LATBENCH_BUCKETS];
+} latbench;
+
+static void latbench_wakeup(struct hrtimer *timer) {
+    sched_wake_up(timer->data);
+}
+
+/* Background load: burn the CPU, yielding only at preemption points */
+static void latbench_hog_main(void *arg) {
+    (void)arg;
+    while (!latbench.stop) {
+        uint64_t until = get_ticks() + LATBENCH_BURST;
+        while (get_ticks() < until) {
+            cpu_relax();
+        }
+        cond_resched();
+    }
+    __sync_fetch_and_add(&latbench.finished, 1);
+}
+
+/* Sleep to absolute targets one interval apart and record how late each wakeup is */
+static void latbench_measure_main(void *arg) {
+    (void)arg;
+    latbench.setattr_ret = sched_setattr(0, &latbench.attr);
+    
+    struct hrtimer timer;
+    hrtimer_setup(&timer, latbench_wakeup, sched_current());
+    uint64_t interval = (uint64_t)latbench.interval_us * NSEC_PER_USEC;
+    uint64_t target = ktime_get_ns() + interval;
+    
+    for (uint32_t i = 0; i < latbench.loops; i++) {
+        while (ktime_get_ns() < target) {
+            sched_prepare_to_block();
+            hrtimer_start(&timer, target);
+            schedule();
+            hrtimer_cancel_sync(&timer);
+        }
+        
+        uint64_t latency = ktime_get_ns() - target;
+        uint64_t bucket = latency / NSEC_PER_USEC;
+        latbench.hist[bucket < LATBENCH_BUCKETS ? bucket : LATBENCH_BUCKETS - 1]++;
+        latbench.total_ns += latency;
+        if (latency < latbench.min_ns) latbench.min_ns = latency;
+        if (latency > latbench.max_ns) latbench.max_ns = latency;
+        target += interval;
+    }
+    
+    latbench.stop = true;
+    __sync_fetch_and_add(&latbench.finished, 1);
+}
+
+/*
+ * Wakeup latency benchmark in the style of cyclictest: a task sleeps to
+ * absolute targets every interval_us while nr_hogs CPU-bound tasks load
+ * all CPUs. Run once per class of the measuring task; the histogram shows
+ * how far a real-time or deadline task stays ahead of the normal class.
+ */
+void sched_benchmark_latency(uint32_t loops, uint32_t interval_us, uint32_t nr_hogs) {
+    uint32_t nr_cpus = smp_num_cpus();
+    uint32_t cpu = smp_processor_id();
+    uint64_t interval = (uint64_t)interval_us * NSEC_PER_USEC;
+    
+    static const char *const phase_names[] = { "normal", "fifo", "deadline" };
+    const struct sched_attr phases[] = {
+        { .size = sizeof(struct sched_attr), .sched_policy = SCHED_NORMAL },
+        { .size = sizeof(struct sched_attr), .sched_policy = SCHED_FIFO, .sched_priority = 80 },
+        { .size = sizeof(struct sched_attr), .sched_policy = SCHED_DEADLINE,
+          .sched_runtime = interval / 4, .sched_deadline = interval, .sched_period = interval },
+    };
+    
+    KLOG_INFO("=== WAKEUP LATENCY BENCHMARK (%u loops, %u us interval, %u hogs, %u CPUs) ===",
+              loops, interval_us, nr_hogs, nr_cpus);
+    
+    for (uint32_t phase = 0; phase < sizeof(phases) / sizeof(phases[0]); phase++) {
+        memset(&latbench, 0, sizeof(latbench));
+        latbench.loops = loops;
+        latbench.interval_us = interval_us;
+        latbench.attr = phases[phase];
+        latbench.min_ns = UINT64_MAX;
+        
+        uint32_t started = 0;
+        for (; started < nr_hogs; started++) {
+            struct task *hog = create_process("bench-hog", SEC_PENTAGON, true,
+                                              latbench_hog_main, NULL);
+            if (!hog) {
+                break;
+            }
+            migrate_queued_task(hog, started % nr_cpus);
+        }
+        struct task *measure = create_process("bench-lat", SEC_PENTAGON, true,
+                                              latbench_measure_main, NULL);
+        if (!measure) {
+            latbench.stop = true;
+        } else {
+            migrate_queued_task(measure, cpu);
+            started++;
+        }
+        
+        while (latbench.finished < started) {
+            schedule();
+        }
+        
+        if (!measure || latbench.setattr_ret < 0) {
+            KLOG_WARN("%-8s skipped (error %d)", phase_names[phase],
+                      measure ? latbench.setattr_ret : -12);
+            continue;
+        }
+        KLOG_INFO("%-8s min %lu us, avg %lu us, max %lu us",
+                  phase_names[phase], latbench.min_ns / NSEC_PER_USEC,
+                  loops ? latbench.total_ns / loops / NSEC_PER_USEC : 0,
+                  latbench.max_ns / NSEC_PER_USEC);
+        for (uint32_t bucket = 0; bucket < LATBENCH_BUCKETS; bucket++) {
+            if (latbench.hist[bucket]) {
+                KLOG_INFO("  %s%3u us: %u", bucket == LATBENCH_BUCKETS - 1 ? ">=" : "  ",
+                          bucket, latbench.hist[bucket]);
+            }
+        }
+    }
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+# SentinalOS Context Switch
+# Pentagon-Level Security Operating System
+# Kernel stack switching between tasks
+
+.section .text
+.code64
+
+# struct task *switch_to(uint64_t *prev_sp, uint64_t next_sp, struct task *prev)
+#
+# Saves the callee-saved registers on the current kernel stack, stores the
+# stack pointer in *prev_sp and resumes the task whose stack is next_sp.
+# Everything else is caller-saved and already spilled by the C caller.
+# Returns 'prev' on the new stack so the resumed task can finish the switch.
+.global switch_to
+.type switch_to, @function
+switch_to:
+    push %rbp
+    push %rbx
+    push %r12
+    push %r13
+    push %r14
+    push %r15
+    
+    mov %rsp, (%rdi)            # Save outgoing stack pointer
+    mov %rsi, %rsp              # Switch to incoming stack
+    
+    pop %r15
+    pop %r14
+    pop %r13
+    pop %r12
+    pop %rbx
+    pop %rbp
+    
+    mov %rdx, %rax              # Return the task we switched away from
+    ret
+.size switch_to, . - switch_to
+
+# First return of a newly created task. The initial frame built by the
+# scheduler leaves the entry point in %r12 and its argument in %r13.
+.global task_entry_trampoline
+.type task_entry_trampoline, @function
+task_entry_trampoline:
+    mov %rax, %rdi              # Previous task, from switch_to
+    call sched_task_start
+    
+    mov %r13, %rdi
+    call *%r12
+    
+    # Entry function returned: the task exits
+    call sched_task_exit
+    ud2
+.size task_entry_trampoline, . - task_entry_trampoline
\ No newline at end of file
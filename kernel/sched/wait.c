@@ -0,0 +1,320 @@
+/*
+ * SentinalOS Wait Queues
+ * Sleeping Waits, Completions and Mutexes
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "sched.h"
+#include "timer.h"
+#include "wait.h"
+
+static uint64_t wq_lock(struct wait_queue_head *wq) {
+    return spin_lock_irqsave(&wq->lock);
+}
+
+static void wq_unlock(struct wait_queue_head *wq, uint64_t flags) {
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+/* Unlink an entry (caller holds the queue lock) */
+static void wq_remove(struct wait_queue_head *wq, struct wait_queue_entry *entry) {
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        wq->head = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        wq->tail = entry->prev;
+    }
+    entry->next = entry->prev = NULL;
+    entry->queued = false;
+    entry->wq = NULL;
+}
+
+void init_waitqueue_head(struct wait_queue_head *wq) {
+    spin_lock_init(&wq->lock);
+    wq->head = NULL;
+    wq->tail = NULL;
+}
+
+void init_wait_entry(struct wait_queue_entry *entry, uint32_t flags) {
+    entry->task = sched_current();
+    entry->func = NULL;
+    entry->private = NULL;
+    entry->flags = flags;
+    entry->queued = false;
+    entry->wq = NULL;
+    entry->next = NULL;
+    entry->prev = NULL;
+}
+
+/* Link an entry in: exclusive waiters at the tail (FIFO), the rest at the head */
+static void wq_add(struct wait_queue_head *wq, struct wait_queue_entry *entry) {
+    if (entry->flags & WQ_FLAG_EXCLUSIVE) {
+        entry->prev = wq->tail;
+        entry->next = NULL;
+        if (wq->tail) {
+            wq->tail->next = entry;
+        } else {
+            wq->head = entry;
+        }
+        wq->tail = entry;
+    } else {
+        entry->prev = NULL;
+        entry->next = wq->head;
+        if (wq->head) {
+            wq->head->prev = entry;
+        } else {
+            wq->tail = entry;
+        }
+        wq->head = entry;
+    }
+    entry->queued = true;
+    entry->wq = wq;
+}
+
+/*
+ * Queue the entry and mark the task blocked. The caller re-checks its
+ * condition before schedule(). The task remembers the entry, so killing
+ * it in its sleep can take the entry off the queue.
+ */
+void prepare_to_wait(struct wait_queue_head *wq, struct wait_queue_entry *entry) {
+    uint64_t flags = wq_lock(wq);
+    
+    if (!entry->queued) {
+        wq_add(wq, entry);
+    }
+    sched_set_wait_entry(entry);
+    sched_prepare_to_block();
+    
+    wq_unlock(wq, flags);
+}
+
+/* Leave the queue after waking, or after the condition became true early */
+void finish_wait(struct wait_queue_head *wq, struct wait_queue_entry *entry) {
+    sched_set_running();
+    sched_set_wait_entry(NULL);
+    
+    if (!entry->queued) {
+        return;
+    }
+    uint64_t flags = wq_lock(wq);
+    if (entry->queued) {
+        wq_remove(wq, entry);
+    }
+    wq_unlock(wq, flags);
+}
+
+/* An entry that runs 'func' on every wakeup of the queue it is added to */
+void init_waitqueue_func_entry(struct wait_queue_entry *entry, wait_queue_func_t func,
+                               void *private) {
+    entry->task = NULL;
+    entry->func = func;
+    entry->private = private;
+    entry->flags = 0;
+    entry->queued = false;
+    entry->wq = NULL;
+    entry->next = NULL;
+    entry->prev = NULL;
+}
+
+/* Queue a callback entry; being non-exclusive, it runs ahead of exclusive waiters */
+void add_wait_queue(struct wait_queue_head *wq, struct wait_queue_entry *entry) {
+    uint64_t flags = wq_lock(wq);
+    if (!entry->queued) {
+        wq_add(wq, entry);
+    }
+    wq_unlock(wq, flags);
+}
+
+/* Dequeue a callback entry; once this returns its callback is not running */
+void remove_wait_queue(struct wait_queue_head *wq, struct wait_queue_entry *entry) {
+    uint64_t flags = wq_lock(wq);
+    if (entry->queued) {
+        wq_remove(wq, entry);
+    }
+    wq_unlock(wq, flags);
+}
+
+/* Take an entry off whatever queue it is on, for a waiter that is going away */
+void wait_entry_cancel(struct wait_queue_entry *entry) {
+    for (;;) {
+        struct wait_queue_head *wq = __atomic_load_n(&entry->wq, __ATOMIC_ACQUIRE);
+        if (!wq) {
+            return;
+        }
+        uint64_t flags = wq_lock(wq);
+        bool removed = entry->wq == wq;
+        if (removed) {
+            wq_remove(wq, entry);
+        }
+        wq_unlock(wq, flags);
+        if (removed) {
+            return;
+        }
+    }
+}
+
+/*
+ * Wake every non-exclusive waiter and up to nr_exclusive exclusive ones
+ * (all of them if 0), and run every callback entry. Woken tasks leave
+ * the queue. Returns the number of tasks woken.
+ */
+uint32_t __wake_up(struct wait_queue_head *wq, uint32_t nr_exclusive) {
+    uint32_t woken = 0;
+    uint64_t flags = wq_lock(wq);
+    
+    struct wait_queue_entry *entry = wq->head;
+    while (entry) {
+        struct wait_queue_entry *next = entry->next;
+        if (entry->func) {
+            entry->func(entry);
+            entry = next;
+            continue;
+        }
+        
+        bool exclusive = entry->flags & WQ_FLAG_EXCLUSIVE;
+        struct task *task = entry->task;
+        
+        /* The entry may vanish with the waiter's stack once dequeued */
+        wq_remove(wq, entry);
+        sched_wake_up(task);
+        woken++;
+        
+        if (exclusive && nr_exclusive && !--nr_exclusive) {
+            break;
+        }
+        entry = next;
+    }
+    
+    wq_unlock(wq, flags);
+    return woken;
+}
+
+bool waitqueue_active(struct wait_queue_head *wq) {
+    return wq->head != NULL;
+}
+
+void init_completion(struct completion *x) {
+    x->done = 0;
+    init_waitqueue_head(&x->wait);
+}
+
+void reinit_completion(struct completion *x) {
+    x->done = 0;
+}
+
+/* Signal one waiter (or let the next wait pass) */
+void complete(struct completion *x) {
+    __sync_fetch_and_add(&x->done, 1);
+    wake_up(&x->wait);
+}
+
+/* Signal all current and future waiters */
+void complete_all(struct completion *x) {
+    x->done = UINT32_MAX / 2;
+    wake_up_all(&x->wait);
+}
+
+/* Consume one completion if available */
+bool try_wait_for_completion(struct completion *x) {
+    uint32_t done = x->done;
+    while (done) {
+        uint32_t seen = __sync_val_compare_and_swap(&x->done, done, done - 1);
+        if (seen == done) {
+            return true;
+        }
+        done = seen;
+    }
+    return false;
+}
+
+void wait_for_completion(struct completion *x) {
+    struct wait_queue_entry wait;
+    init_wait_entry(&wait, WQ_FLAG_EXCLUSIVE);
+    
+    while (!try_wait_for_completion(x)) {
+        if (!sched_can_block()) {
+            cpu_relax();
+            continue;
+        }
+        prepare_to_wait(&x->wait, &wait);
+        if (x->done) {
+            continue;
+        }
+        schedule();
+    }
+    finish_wait(&x->wait, &wait);
+}
+
+/* Wait up to 'timeout' jiffies; returns the jiffies left (at least 1), 0 on timeout */
+uint64_t wait_for_completion_timeout(struct completion *x, uint64_t timeout) {
+    struct wait_queue_entry wait;
+    init_wait_entry(&wait, WQ_FLAG_EXCLUSIVE);
+    uint64_t deadline = jiffies + timeout;
+    bool done;
+    
+    while (!(done = try_wait_for_completion(x))) {
+        if ((int64_t)(deadline - jiffies) <= 0) {
+            break;
+        }
+        if (!sched_can_block()) {
+            cpu_relax();
+            continue;
+        }
+        prepare_to_wait(&x->wait, &wait);
+        if (x->done) {
+            continue;
+        }
+        schedule_timeout(deadline - jiffies);
+    }
+    finish_wait(&x->wait, &wait);
+    
+    if (!done) {
+        return 0;
+    }
+    int64_t left = (int64_t)(deadline - jiffies);
+    return left > 0 ? (uint64_t)left : 1;
+}
+
+void mutex_init(struct mutex *lock) {
+    lock->state = 0;
+    init_waitqueue_head(&lock->wait);
+}
+
+bool mutex_trylock(struct mutex *lock) {
+    return __sync_bool_compare_and_swap(&lock->state, 0, 1);
+}
+
+/* Uncontended: one CAS. Contended: mark waiters present and sleep */
+void mutex_lock(struct mutex *lock) {
+    if (mutex_trylock(lock)) {
+        return;
+    }
+    
+    struct wait_queue_entry wait;
+    init_wait_entry(&wait, WQ_FLAG_EXCLUSIVE);
+    
+    while (__sync_lock_test_and_set(&lock->state, 2) != 0) {
+        if (!sched_can_block()) {
+            cpu_relax();
+            continue;
+        }
+        prepare_to_wait(&lock->wait, &wait);
+        if (lock->state == 0) {
+            continue;
+        }
+        schedule();
+    }
+    finish_wait(&lock->wait, &wait);
+}
+
+void mutex_unlock(struct mutex *lock) {
+    if (__sync_fetch_and_sub(&lock->state, 1) != 1) {
+        lock->state = 0;
+        wake_up(&lock->wait);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,391 @@
+/*
+ * SentinalOS Workqueues
+ * Deferred Work on Per-CPU and Unbound Worker Pools
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "string.h"
+#include "smp.h"
+#include "sched.h"
+#include "wait.h"
+#include "kthread.h"
+#include "workqueue.h"
+#include "spinlock.h"
+
+/*
+ * Workers of one pool share a FIFO of work items. A pool starts with one
+ * worker and adds more (up to max_workers) when items wait while no
+ * worker is idle, e.g. because work functions sleep.
+ */
+struct worker_pool {
+    spinlock_t lock;
+    struct workqueue_struct *wq;
+    int cpu;                    /* CPU the workers are bound to, -1 if unbound */
+    struct work_struct *head;
+    struct work_struct *tail;
+    uint32_t nr_pending;        /* Queued items */
+    uint32_t nr_running;        /* Work functions executing now */
+    uint32_t nr_workers;
+    uint32_t nr_idle;
+    uint32_t max_workers;
+    bool creating;              /* A worker is being started */
+    struct kthread *workers[WQ_UNBOUND_MAX_WORKERS];
+    struct wait_queue_head more_work;   /* Idle workers sleep here */
+    struct wait_queue_head drained;     /* flush_workqueue() sleeps here */
+    
+    /* Statistics */
+    uint64_t queued;
+    uint64_t started;
+    uint64_t executed;
+    uint32_t max_depth;
+    uint64_t latency_total;     /* Cycles from queue to start */
+    uint64_t latency_max;
+    uint64_t exec_total;        /* Cycles in work functions */
+} __aligned(64);
+
+struct workqueue_struct {
+    const char *name;
+    uint32_t flags;
+    uint32_t nr_pools;
+    struct worker_pool *pools;
+    struct workqueue_struct *next;  /* All workqueues, for reporting */
+};
+
+struct workqueue_struct *system_wq;
+struct workqueue_struct *system_unbound_wq;
+
+static struct workqueue_struct *workqueue_list;
+static spinlock_t workqueue_list_lock;
+
+static uint64_t pool_lock(struct worker_pool *pool) {
+    return spin_lock_irqsave(&pool->lock);
+}
+
+static void pool_unlock(struct worker_pool *pool, uint64_t flags) {
+    spin_unlock_irqrestore(&pool->lock, flags);
+}
+
+static int worker_main(void *data);
+
+/* Start one more worker unless the pool is at its limit */
+static bool pool_add_worker(struct worker_pool *pool) {
+    uint64_t flags = pool_lock(pool);
+    if (pool->creating || pool->nr_workers >= pool->max_workers) {
+        pool_unlock(pool, flags);
+        return false;
+    }
+    pool->creating = true;
+    pool_unlock(pool, flags);
+    
+    struct kthread *worker;
+    if (pool->cpu >= 0) {
+        worker = kthread_create_on_cpu(worker_main, pool, (uint32_t)pool->cpu, pool->wq->name);
+    } else {
+        worker = kthread_create(worker_main, pool, pool->wq->name);
+    }
+    
+    flags = pool_lock(pool);
+    if (worker) {
+        pool->workers[pool->nr_workers++] = worker;
+    }
+    pool->creating = false;
+    pool_unlock(pool, flags);
+    
+    return worker != NULL;
+}
+
+/* Take the next item off the pool (caller holds the pool lock) */
+static struct work_struct *pool_dequeue(struct worker_pool *pool) {
+    struct work_struct *work = pool->head;
+    pool->head = work->next;
+    if (!pool->head) {
+        pool->tail = NULL;
+    }
+    work->next = NULL;
+    pool->nr_pending--;
+    return work;
+}
+
+static int worker_main(void *data) {
+    struct worker_pool *pool = data;
+    struct wait_queue_entry wait;
+    init_wait_entry(&wait, WQ_FLAG_EXCLUSIVE);
+    
+    while (!kthread_should_stop()) {
+        uint64_t flags = pool_lock(pool);
+        
+        if (!pool->head) {
+            /* Idle: queue_work() and kthread_stop() wake us */
+            pool->nr_idle++;
+            prepare_to_wait(&pool->more_work, &wait);
+            pool_unlock(pool, flags);
+            if (!kthread_should_stop()) {
+                schedule();
+            }
+            finish_wait(&pool->more_work, &wait);
+            
+            flags = pool_lock(pool);
+            pool->nr_idle--;
+            pool_unlock(pool, flags);
+            continue;
+        }
+        
+        struct work_struct *work = pool_dequeue(pool);
+        uint64_t start = get_ticks();
+        uint64_t latency = start - work->queued_at;
+        pool->started++;
+        pool->latency_total += latency;
+        if (latency > pool->latency_max) {
+            pool->latency_max = latency;
+        }
+        pool->nr_running++;
+        bool starved = pool->head && !pool->nr_idle;
+        pool_unlock(pool, flags);
+        
+        /* More work and nobody free to take it: grow before running ours */
+        if (starved) {
+            pool_add_worker(pool);
+        }
+        
+        /* The function may re-queue or free the item */
+        work_func_t func = work->func;
+        __sync_lock_release(&work->pending);
+        func(work);
+        
+        uint64_t exec = get_ticks() - start;
+        flags = pool_lock(pool);
+        pool->nr_running--;
+        pool->executed++;
+        pool->exec_total += exec;
+        bool drained = !pool->head && !pool->nr_running;
+        pool_unlock(pool, flags);
+        
+        if (drained) {
+            wake_up_all(&pool->drained);
+        }
+    }
+    
+    return 0;
+}
+
+/*
+ * Create a workqueue. Bound queues get a pool per CPU whose workers stay
+ * on that CPU; WQ_UNBOUND queues share one pool whose workers may run
+ * anywhere. Each pool starts with one worker and grows to max_workers.
+ */
+struct workqueue_struct *alloc_workqueue(const char *name, uint32_t flags, uint32_t max_workers) {
+    if (!max_workers) {
+        max_workers = (flags & WQ_UNBOUND) ? WQ_UNBOUND_MAX_WORKERS : WQ_DFL_MAX_WORKERS;
+    }
+    if (max_workers > WQ_UNBOUND_MAX_WORKERS) {
+        max_workers = WQ_UNBOUND_MAX_WORKERS;
+    }
+    
+    struct workqueue_struct *wq = kmalloc(sizeof(struct workqueue_struct));
+    if (!wq) {
+        return NULL;
+    }
+    memset(wq, 0, sizeof(*wq));
+    wq->name = name;
+    wq->flags = flags;
+    wq->nr_pools = (flags & WQ_UNBOUND) ? 1 : smp_num_cpus();
+    wq->pools = kmalloc_aligned(sizeof(struct worker_pool) * wq->nr_pools, 64);
+    if (!wq->pools) {
+        kfree(wq);
+        return NULL;
+    }
+    memset(wq->pools, 0, sizeof(struct worker_pool) * wq->nr_pools);
+    
+    for (uint32_t i = 0; i < wq->nr_pools; i++) {
+        struct worker_pool *pool = &wq->pools[i];
+        pool->wq = wq;
+        pool->cpu = (flags & WQ_UNBOUND) ? -1 : (int)i;
+        pool->max_workers = max_workers;
+        init_waitqueue_head(&pool->more_work);
+        init_waitqueue_head(&pool->drained);
+        if (!pool_add_worker(pool)) {
+            KLOG_WARN("Workqueue %s: no worker for pool %u", name, i);
+        }
+    }
+    
+    spin_lock(&workqueue_list_lock);
+    wq->next = workqueue_list;
+    workqueue_list = wq;
+    spin_unlock(&workqueue_list_lock);
+    
+    return wq;
+}
+
+/* Run all queued work, stop the workers and free the queue */
+void destroy_workqueue(struct workqueue_struct *wq) {
+    if (!wq) {
+        return;
+    }
+    
+    flush_workqueue(wq);
+    
+    spin_lock(&workqueue_list_lock);
+    struct workqueue_struct **link = &workqueue_list;
+    while (*link && *link != wq) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = wq->next;
+    }
+    spin_unlock(&workqueue_list_lock);
+    
+    for (uint32_t i = 0; i < wq->nr_pools; i++) {
+        struct worker_pool *pool = &wq->pools[i];
+        for (uint32_t w = 0; w < pool->nr_workers; w++) {
+            kthread_stop(pool->workers[w]);
+        }
+    }
+    kfree(wq->pools);
+    kfree(wq);
+}
+
+static bool __queue_work(struct worker_pool *pool, struct work_struct *work) {
+    /* Already queued and not started: it will run once for both requests */
+    if (__sync_lock_test_and_set(&work->pending, 1)) {
+        return false;
+    }
+    work->next = NULL;
+    work->queued_at = get_ticks();
+    
+    uint64_t flags = pool_lock(pool);
+    if (pool->tail) {
+        pool->tail->next = work;
+    } else {
+        pool->head = work;
+    }
+    pool->tail = work;
+    pool->nr_pending++;
+    pool->queued++;
+    if (pool->nr_pending > pool->max_depth) {
+        pool->max_depth = pool->nr_pending;
+    }
+    bool starved = !pool->nr_idle && pool->nr_workers < pool->max_workers;
+    pool_unlock(pool, flags);
+    
+    wake_up(&pool->more_work);
+    
+    /* Interrupt handlers cannot start threads; a busy worker will instead */
+    if (starved && sched_can_block()) {
+        pool_add_worker(pool);
+    }
+    return true;
+}
+
+/*
+ * Queue work on the current CPU's pool (any CPU for unbound queues).
+ * Safe from interrupt context. Returns false if it was already pending.
+ */
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work) {
+    if (!wq || !work) {
+        return false;
+    }
+    
+    uint32_t pool = (wq->flags & WQ_UNBOUND) ? 0 : smp_processor_id();
+    return __queue_work(&wq->pools[pool], work);
+}
+
+/* Queue work on a specific CPU's pool */
+bool queue_work_on(uint32_t cpu, struct workqueue_struct *wq, struct work_struct *work) {
+    if (!wq || !work) {
+        return false;
+    }
+    
+    uint32_t pool = (wq->flags & WQ_UNBOUND) ? 0 : cpu;
+    if (pool >= wq->nr_pools) {
+        return false;
+    }
+    return __queue_work(&wq->pools[pool], work);
+}
+
+/* Queue work on the system workqueue */
+bool schedule_work(struct work_struct *work) {
+    return queue_work(system_wq, work);
+}
+
+/*
+ * Wait until every pool of the queue is empty and idle. Must not be
+ * called from a work function of the same queue.
+ */
+void flush_workqueue(struct workqueue_struct *wq) {
+    if (!wq) {
+        return;
+    }
+    
+    for (uint32_t i = 0; i < wq->nr_pools; i++) {
+        struct worker_pool *pool = &wq->pools[i];
+        wait_event(&pool->drained, !pool->head && !pool->nr_running);
+    }
+}
+
+/* Create the system workqueues */
+void workqueue_init(void) {
+    system_wq = alloc_workqueue("events", 0, WQ_DFL_MAX_WORKERS);
+    system_unbound_wq = alloc_workqueue("events_unbound", WQ_UNBOUND, WQ_UNBOUND_MAX_WORKERS);
+    if (!system_wq || !system_unbound_wq) {
+        PANIC("Failed to create the system workqueues");
+    }
+    
+    KLOG_INFO("Workqueues initialized (%u per-CPU pools, 1 unbound pool)", smp_num_cpus());
+}
+
+/* Get queue depth and latency statistics summed over all pools */
+void workqueue_get_stats(struct workqueue_struct *wq, uint64_t *queued, uint64_t *executed,
+                         uint32_t *depth, uint32_t *max_depth, uint64_t *avg_latency,
+                         uint64_t *max_latency) {
+    if (!wq) {
+        return;
+    }
+    
+    uint64_t total_queued = 0, total_executed = 0, started = 0, latency = 0, latency_max = 0;
+    uint32_t total_depth = 0, depth_max = 0;
+    
+    for (uint32_t i = 0; i < wq->nr_pools; i++) {
+        struct worker_pool *pool = &wq->pools[i];
+        total_queued += pool->queued;
+        total_executed += pool->executed;
+        started += pool->started;
+        latency += pool->latency_total;
+        total_depth += pool->nr_pending;
+        if (pool->max_depth > depth_max) {
+            depth_max = pool->max_depth;
+        }
+        if (pool->latency_max > latency_max) {
+            latency_max = pool->latency_max;
+        }
+    }
+    
+    if (queued) *queued = total_queued;
+    if (executed) *executed = total_executed;
+    if (depth) *depth = total_depth;
+    if (max_depth) *max_depth = depth_max;
+    if (avg_latency) *avg_latency = started ? latency / started : 0;
+    if (max_latency) *max_latency = latency_max;
+}
+
+/* Log depth, worker count and latency of every workqueue */
+void workqueue_report(void) {
+    KLOG_INFO("=== WORKQUEUES ===");
+    
+    for (struct workqueue_struct *wq = workqueue_list; wq; wq = wq->next) {
+        uint64_t queued, executed, avg_latency, max_latency, exec = 0;
+        uint32_t depth, max_depth, workers = 0;
+        workqueue_get_stats(wq, &queued, &executed, &depth, &max_depth,
+                            &avg_latency, &max_latency);
+        for (uint32_t i = 0; i < wq->nr_pools; i++) {
+            workers += wq->pools[i].nr_workers;
+            exec += wq->pools[i].exec_total;
+        }
+        
+        KLOG_INFO("%-16s %s, %u workers, depth %u (max %u), %lu/%lu run",
+                  wq->name, (wq->flags & WQ_UNBOUND) ? "unbound" : "per-CPU",
+                  workers, depth, max_depth, executed, queued);
+        KLOG_INFO("%-16s latency %lu avg / %lu max cycles, %lu cycles/item",
+                  "", avg_latency, max_latency, executed ? exec / executed : 0);
+    }
+}
\ No newline at end of file
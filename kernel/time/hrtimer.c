@@ -0,0 +1,229 @@
+/*
+ * SentinalOS High-Resolution Timers
+ * Per-CPU Expiry Heap on the One-Shot Clock Event Device
+ */
+
+#include "kernel.h"
+#include "string.h"
+#include "smp.h"
+#include "timer.h"
+#include "spinlock.h"
+
+#define HRTIMER_HEAP_INITIAL    64
+
+struct hrtimer_base {
+    spinlock_t lock;
+    struct hrtimer **heap;      /* Binary min-heap ordered by expiry */
+    uint32_t count;
+    uint32_t capacity;
+    struct hrtimer *running;    /* Timer whose callback is executing */
+} __aligned(64);
+
+static struct hrtimer_base hrtimer_bases[MAX_CPUS];
+
+static uint64_t hrtimer_lock(struct hrtimer_base *base) {
+    return spin_lock_irqsave(&base->lock);
+}
+
+static void hrtimer_unlock(struct hrtimer_base *base, uint64_t flags) {
+    spin_unlock_irqrestore(&base->lock, flags);
+}
+
+/* Lock the base 'timer' is on; rechecked under the lock, as a restart may move it */
+static struct hrtimer_base *hrtimer_lock_timer(struct hrtimer *timer, uint64_t *flags) {
+    for (;;) {
+        uint32_t cpu = __atomic_load_n(&timer->cpu, __ATOMIC_RELAXED);
+        struct hrtimer_base *base = &hrtimer_bases[cpu];
+        *flags = hrtimer_lock(base);
+        if (timer->cpu == cpu) {
+            return base;
+        }
+        hrtimer_unlock(base, *flags);
+    }
+}
+
+static inline void heap_set(struct hrtimer_base *base, uint32_t index, struct hrtimer *timer) {
+    base->heap[index] = timer;
+    timer->index = (int32_t)index;
+}
+
+static void heap_sift_up(struct hrtimer_base *base, uint32_t index) {
+    struct hrtimer *timer = base->heap[index];
+    while (index > 0) {
+        uint32_t parent = (index - 1) / 2;
+        if (base->heap[parent]->expires <= timer->expires) {
+            break;
+        }
+        heap_set(base, index, base->heap[parent]);
+        index = parent;
+    }
+    heap_set(base, index, timer);
+}
+
+static void heap_sift_down(struct hrtimer_base *base, uint32_t index) {
+    struct hrtimer *timer = base->heap[index];
+    for (;;) {
+        uint32_t child = index * 2 + 1;
+        if (child >= base->count) {
+            break;
+        }
+        if (child + 1 < base->count &&
+            base->heap[child + 1]->expires < base->heap[child]->expires) {
+            child++;
+        }
+        if (timer->expires <= base->heap[child]->expires) {
+            break;
+        }
+        heap_set(base, index, base->heap[child]);
+        index = child;
+    }
+    heap_set(base, index, timer);
+}
+
+/* Double the heap array; the old one goes back to the allocator */
+static int heap_grow(struct hrtimer_base *base) {
+    uint32_t capacity = base->capacity ? base->capacity * 2 : HRTIMER_HEAP_INITIAL;
+    struct hrtimer **heap = kmalloc(sizeof(struct hrtimer *) * capacity);
+    if (!heap) {
+        return -12; /* ENOMEM */
+    }
+    
+    if (base->heap) {
+        memcpy(heap, base->heap, sizeof(struct hrtimer *) * base->count);
+        kfree(base->heap);
+    }
+    base->heap = heap;
+    base->capacity = capacity;
+    return 0;
+}
+
+/* Remove a queued timer from the heap (caller holds the base lock) */
+static void heap_remove(struct hrtimer_base *base, struct hrtimer *timer) {
+    uint32_t index = (uint32_t)timer->index;
+    struct hrtimer *last = base->heap[--base->count];
+    timer->index = -1;
+    
+    if (last == timer) {
+        return;
+    }
+    heap_set(base, index, last);
+    if (index > 0 && base->heap[(index - 1) / 2]->expires > last->expires) {
+        heap_sift_up(base, index);
+    } else {
+        heap_sift_down(base, index);
+    }
+}
+
+void hrtimer_setup(struct hrtimer *timer, void (*function)(struct hrtimer *), void *data) {
+    timer->expires = 0;
+    timer->function = function;
+    timer->data = data;
+    timer->index = -1;
+    timer->cpu = smp_processor_id();
+}
+
+/*
+ * Cancel a timer; returns 1 if it was queued. A callback already running
+ * is not waited for: callers that may hold locks it takes use this one.
+ */
+int hrtimer_cancel(struct hrtimer *timer) {
+    uint64_t flags;
+    struct hrtimer_base *base = hrtimer_lock_timer(timer, &flags);
+    
+    int was_queued = 0;
+    if (timer->index >= 0) {
+        heap_remove(base, timer);
+        was_queued = 1;
+    }
+    
+    hrtimer_unlock(base, flags);
+    return was_queued;
+}
+
+/*
+ * Cancel a timer and wait for a running callback to finish, so the timer
+ * can go away (on-stack timers). Must not be called with a lock the
+ * callback takes, nor from the callback itself.
+ */
+int hrtimer_cancel_sync(struct hrtimer *timer) {
+    int was_queued = 0;
+    for (;;) {
+        uint64_t flags;
+        struct hrtimer_base *base = hrtimer_lock_timer(timer, &flags);
+        if (timer->index >= 0) {
+            heap_remove(base, timer);
+            was_queued = 1;
+        }
+        bool running = base->running == timer;
+        hrtimer_unlock(base, flags);
+        
+        if (!running) {
+            return was_queued;
+        }
+        cpu_relax();
+    }
+}
+
+/* (Re)arm a timer on the local CPU for an absolute ktime expiry */
+int hrtimer_start(struct hrtimer *timer, uint64_t expires_ns) {
+    hrtimer_cancel(timer);
+    
+    uint32_t cpu = smp_processor_id();
+    struct hrtimer_base *base = &hrtimer_bases[cpu];
+    uint64_t flags = hrtimer_lock(base);
+    
+    if (base->count == base->capacity) {
+        int ret = heap_grow(base);
+        if (ret < 0) {
+            hrtimer_unlock(base, flags);
+            return ret;
+        }
+    }
+    
+    timer->expires = expires_ns;
+    timer->cpu = cpu;
+    heap_set(base, base->count++, timer);
+    heap_sift_up(base, base->count - 1);
+    bool earliest = timer->index == 0;
+    
+    hrtimer_unlock(base, flags);
+    
+    /* A new earliest expiry moves the clock event forward */
+    if (earliest) {
+        tick_nohz_timer_added(expires_ns);
+    }
+    return 0;
+}
+
+/* Run all local timers expired by 'now'; called from the clock event */
+void hrtimer_run_local(uint64_t now) {
+    struct hrtimer_base *base = &hrtimer_bases[smp_processor_id()];
+    uint64_t flags = hrtimer_lock(base);
+    
+    while (base->count && base->heap[0]->expires <= now) {
+        struct hrtimer *timer = base->heap[0];
+        void (*function)(struct hrtimer *) = timer->function;
+        heap_remove(base, timer);
+        base->running = timer;
+        
+        hrtimer_unlock(base, flags);
+        function(timer);
+        flags = hrtimer_lock(base);
+        base->running = NULL;
+    }
+    
+    hrtimer_unlock(base, flags);
+}
+
+/* Expiry of the earliest local timer (ktime ns), or TIMER_NO_EXPIRY */
+uint64_t hrtimer_next_expiry(void) {
+    struct hrtimer_base *base = &hrtimer_bases[smp_processor_id()];
+    uint64_t flags = hrtimer_lock(base);
+    uint64_t next = base->count ? base->heap[0]->expires : TIMER_NO_EXPIRY;
+    hrtimer_unlock(base, flags);
+    return next;
+}
+
+uint32_t hrtimer_pending_count(void) {
+    return hrtimer_bases[smp_processor_id()].count;
+}
\ No newline at end of file
@@ -0,0 +1,230 @@
+/*
+ * SentinalOS Local APIC
+ * One-shot and TSC-Deadline Timer, Inter-Processor Interrupts
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "smp.h"
+#include "idt.h"
+#include "ktime.h"
+
+/* APIC base MSR bits */
+#define APIC_BASE_X2APIC        (1UL << 10)
+#define APIC_BASE_ENABLE        (1UL << 11)
+#define APIC_BASE_ADDR_MASK     0xFFFFFF000UL
+
+/* Register offsets (xAPIC MMIO; x2APIC MSR = 0x800 + offset / 16) */
+#define APIC_ID                 0x020
+#define APIC_EOI                0x0B0
+#define APIC_SVR                0x0F0
+#define APIC_ICR_LOW            0x300
+#define APIC_ICR_HIGH           0x310
+#define APIC_LVT_TIMER          0x320
+#define APIC_TIMER_INIT         0x380
+#define APIC_TIMER_CURRENT      0x390
+#define APIC_TIMER_DIVIDE       0x3E0
+
+#define X2APIC_MSR_BASE         0x800
+#define X2APIC_ICR              0x830
+
+/* Register values */
+#define APIC_SVR_ENABLE         (1 << 8)
+#define APIC_LVT_MASKED         (1 << 16)
+#define APIC_TIMER_ONESHOT      (0 << 17)
+#define APIC_TIMER_TSC_DEADLINE (2 << 17)
+#define APIC_TIMER_DIVIDE_16    0x3
+#define APIC_ICR_PENDING        (1 << 12)
+
+/* Programming limits */
+#define LAPIC_MIN_DELTA_NS      1000
+#define LAPIC_CALIBRATE_MS      10
+
+static struct {
+    volatile uint32_t *mmio;        /* xAPIC register window */
+    bool x2apic;
+    bool tsc_deadline;
+    uint64_t timer_hz;              /* One-shot mode count rate (after divide) */
+    bool initialized;
+} lapic_state;
+
+static struct clock_event_device lapic_clockevent;
+
+/* Register access */
+static inline uint32_t lapic_read(uint32_t reg) {
+    if (lapic_state.x2apic) {
+        return (uint32_t)rdmsr(X2APIC_MSR_BASE + (reg >> 4));
+    }
+    return lapic_state.mmio[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    if (lapic_state.x2apic) {
+        wrmsr(X2APIC_MSR_BASE + (reg >> 4), value);
+    } else {
+        lapic_state.mmio[reg / 4] = value;
+    }
+}
+
+void lapic_eoi(void) {
+    lapic_write(APIC_EOI, 0);
+}
+
+/* Send a fixed-delivery IPI to a physical APIC ID */
+static void lapic_send_ipi(uint32_t apic_id, uint8_t vector) {
+    if (lapic_state.x2apic) {
+        wrmsr(X2APIC_ICR, ((uint64_t)apic_id << 32) | vector);
+        return;
+    }
+    
+    while (lapic_read(APIC_ICR_LOW) & APIC_ICR_PENDING) {
+        cpu_relax();
+    }
+    lapic_write(APIC_ICR_HIGH, apic_id << 24);
+    lapic_write(APIC_ICR_LOW, vector);
+}
+
+/* Ask another CPU to reschedule (and re-evaluate its tick) */
+void lapic_send_reschedule(uint32_t cpu) {
+    if (!lapic_state.initialized || cpu >= smp_num_cpus()) {
+        return;
+    }
+    lapic_send_ipi(smp_cpu_topology(cpu)->apic_id, RESCHEDULE_VECTOR);
+}
+
+/* TSC-deadline mode: the timer fires when the TSC reaches the deadline */
+static int lapic_next_deadline(uint64_t expires_ns) {
+    wrmsr(MSR_TSC_DEADLINE, tsc_ktime_to_tsc(expires_ns));
+    return 0;
+}
+
+/* One-shot mode: count down from a relative delta */
+static int lapic_next_oneshot(uint64_t expires_ns) {
+    uint64_t now = ktime_get_ns();
+    uint64_t delta = expires_ns > now ? expires_ns - now : 0;
+    
+    if (delta < LAPIC_MIN_DELTA_NS) {
+        delta = LAPIC_MIN_DELTA_NS;
+    }
+    if (delta > lapic_clockevent.max_delta_ns) {
+        delta = lapic_clockevent.max_delta_ns;
+    }
+    
+    uint64_t count = delta * lapic_state.timer_hz / NSEC_PER_SEC;
+    lapic_write(APIC_TIMER_INIT, count ? (uint32_t)count : 1);
+    return 0;
+}
+
+static void lapic_timer_shutdown(void) {
+    if (lapic_state.tsc_deadline) {
+        wrmsr(MSR_TSC_DEADLINE, 0);
+    } else {
+        lapic_write(APIC_TIMER_INIT, 0);
+    }
+}
+
+static void lapic_timer_interrupt(struct pt_regs *regs) {
+    lapic_eoi();
+    if (lapic_clockevent.event_handler) {
+        lapic_clockevent.event_handler(regs);
+    }
+}
+
+static void lapic_reschedule_interrupt(struct pt_regs *regs) {
+    (void)regs;
+    lapic_eoi();
+    tick_nohz_kick();
+}
+
+static void lapic_spurious_interrupt(struct pt_regs *regs) {
+    (void)regs;
+    /* No EOI for spurious interrupts */
+}
+
+/* Measure the one-shot count rate against the calibrated TSC */
+static uint64_t lapic_calibrate_timer(void) {
+    lapic_write(APIC_TIMER_DIVIDE, APIC_TIMER_DIVIDE_16);
+    lapic_write(APIC_LVT_TIMER, APIC_LVT_MASKED);
+    lapic_write(APIC_TIMER_INIT, 0xFFFFFFFF);
+    
+    uint64_t start = ktime_get_ns();
+    while (ktime_get_ns() - start < LAPIC_CALIBRATE_MS * NSEC_PER_MSEC) {
+        cpu_relax();
+    }
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(APIC_TIMER_CURRENT);
+    lapic_write(APIC_TIMER_INIT, 0);
+    
+    return (uint64_t)elapsed * (1000 / LAPIC_CALIBRATE_MS);
+}
+
+/* Enable the local APIC of the executing CPU and set up its timer */
+static void lapic_cpu_setup(void) {
+    uint64_t base = rdmsr(MSR_APIC_BASE) | APIC_BASE_ENABLE;
+    if (lapic_state.x2apic) {
+        base |= APIC_BASE_X2APIC;
+    }
+    wrmsr(MSR_APIC_BASE, base);
+    
+    lapic_write(APIC_SVR, APIC_SVR_ENABLE | SPURIOUS_APIC_VECTOR);
+    
+    if (lapic_state.tsc_deadline) {
+        lapic_write(APIC_LVT_TIMER, APIC_TIMER_TSC_DEADLINE | LOCAL_TIMER_VECTOR);
+        mb(); /* Mode switch must be visible before the first deadline write */
+    } else {
+        lapic_write(APIC_TIMER_DIVIDE, APIC_TIMER_DIVIDE_16);
+        lapic_write(APIC_LVT_TIMER, APIC_TIMER_ONESHOT | LOCAL_TIMER_VECTOR);
+    }
+}
+
+int lapic_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    KLOG_INFO("Initializing local APIC timer...");
+    
+    cpuid_count(1, 0, &eax, &ebx, &ecx, &edx);
+    if (!(edx & (1 << 9))) {
+        KLOG_ERR("No local APIC present");
+        return -19; /* ENODEV */
+    }
+    lapic_state.x2apic = ecx & (1 << 21);
+    lapic_state.tsc_deadline = ecx & (1 << 24);
+    
+    if (!lapic_state.x2apic) {
+        /* The kernel accesses MMIO through the identity mapping */
+        lapic_state.mmio = (volatile uint32_t *)(rdmsr(MSR_APIC_BASE) & APIC_BASE_ADDR_MASK);
+    }
+    
+    idt_register_handler(LOCAL_TIMER_VECTOR, lapic_timer_interrupt);
+    idt_register_handler(RESCHEDULE_VECTOR, lapic_reschedule_interrupt);
+    idt_register_handler(SPURIOUS_APIC_VECTOR, lapic_spurious_interrupt);
+    
+    lapic_cpu_setup();
+    
+    lapic_clockevent.name = lapic_state.tsc_deadline ? "lapic-deadline" : "lapic-oneshot";
+    lapic_clockevent.features = CLOCK_EVT_FEAT_ONESHOT;
+    lapic_clockevent.min_delta_ns = LAPIC_MIN_DELTA_NS;
+    lapic_clockevent.shutdown = lapic_timer_shutdown;
+    
+    if (lapic_state.tsc_deadline) {
+        lapic_clockevent.features |= CLOCK_EVT_FEAT_DEADLINE;
+        lapic_clockevent.max_delta_ns = TICK_NOHZ_MAX_DEFER;
+        lapic_clockevent.set_next_event = lapic_next_deadline;
+    } else {
+        lapic_state.timer_hz = lapic_calibrate_timer();
+        if (!lapic_state.timer_hz) {
+            KLOG_ERR("LAPIC timer calibration failed");
+            return -5; /* EIO */
+        }
+        /* The 32-bit counter bounds the longest programmable delta */
+        lapic_clockevent.max_delta_ns = 0xFFFFFFFFULL * NSEC_PER_SEC / lapic_state.timer_hz;
+        lapic_clockevent.set_next_event = lapic_next_oneshot;
+        lapic_cpu_setup();
+    }
+    
+    lapic_state.initialized = true;
+    clockevents_register_device(&lapic_clockevent);
+    
+    KLOG_INFO("LAPIC: %s mode, %s", lapic_state.x2apic ? "x2APIC" : "xAPIC",
+              lapic_clockevent.name);
+    return 0;
+}
\ No newline at end of file
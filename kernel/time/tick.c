@@ -0,0 +1,278 @@
+/*
+ * SentinalOS Tick Management
+ * Clock Events, Tickless Idle and Single-Task Tick Suppression
+ */
+
+#include "kernel.h"
+#include "string.h"
+#include "smp.h"
+#include "sched.h"
+#include "ktime.h"
+#include "timer.h"
+#include "rcu.h"
+
+volatile uint64_t jiffies;
+
+/* Per-CPU tick state */
+struct tick_cpu {
+    uint64_t next_tick;         /* Expiry of the next periodic tick (ktime ns) */
+    uint64_t programmed;        /* Expiry the clock event device is set for */
+    bool tick_stopped;          /* Timer programmed for the next real event only */
+    bool idle_active;
+    uint64_t idle_entry;
+    
+    /* Statistics */
+    uint64_t stats_start;
+    uint64_t idle_ns;           /* Time spent in the idle loop */
+    uint64_t wakeups;           /* Idle exits */
+    uint64_t events;            /* Timer interrupts taken */
+    uint64_t tick_stops;        /* Times the periodic tick was suppressed */
+};
+
+static struct tick_cpu tick_cpus[MAX_CPUS];
+static struct clock_event_device *tick_device;
+
+static inline struct tick_cpu *this_tick_cpu(void) {
+    return &tick_cpus[smp_processor_id()];
+}
+
+/* Jiffies follow ktime, so any CPU with a running tick can update them */
+static void tick_update_jiffies(uint64_t now) {
+    uint64_t j = now / TICK_NSEC;
+    if (j > jiffies) {
+        jiffies = j;
+    }
+}
+
+/* Catch up on tick periods elapsed since next_tick and hand them to the scheduler */
+static void tick_account(struct tick_cpu *tc, uint64_t now) {
+    tick_update_jiffies(now);
+    
+    if (now < tc->next_tick) {
+        return;
+    }
+    uint64_t ticks = (now - tc->next_tick) / TICK_NSEC + 1;
+    tc->next_tick += ticks * TICK_NSEC;
+    
+    scheduler_timer_interrupt(ticks);
+    timer_run_local();
+}
+
+/* Earliest pending event other than the periodic tick */
+static uint64_t tick_next_event(uint64_t now) {
+    /* RCU callbacks and grace periods advance from the tick */
+    if (rcu_needs_cpu()) {
+        return now;
+    }
+    
+    uint64_t next = now + TICK_NOHZ_MAX_DEFER;
+    
+    uint64_t wheel = timer_next_expiry();
+    if (wheel != TIMER_NO_EXPIRY && wheel * TICK_NSEC < next) {
+        next = wheel * TICK_NSEC;
+    }
+    return next;
+}
+
+int clockevents_program_event(uint64_t expires_ns) {
+    if (!tick_device) {
+        return -19; /* ENODEV */
+    }
+    return tick_device->set_next_event(expires_ns);
+}
+
+/* Program the device for 'expires' or the earliest hrtimer, whichever is first */
+static void tick_program(struct tick_cpu *tc, uint64_t expires) {
+    uint64_t hrtimer = hrtimer_next_expiry();
+    if (hrtimer < expires) {
+        expires = hrtimer;
+    }
+    tc->programmed = expires;
+    clockevents_program_event(expires);
+}
+
+/* Stop the periodic tick until the next real event */
+static void tick_nohz_stop_tick(struct tick_cpu *tc, uint64_t now) {
+    uint64_t next_event = tick_next_event(now);
+    if (next_event <= tc->next_tick) {
+        tick_program(tc, tc->next_tick);
+        return;
+    }
+    
+    if (!tc->tick_stopped) {
+        tc->tick_stopped = true;
+        tc->tick_stops++;
+    }
+    tick_program(tc, next_event);
+}
+
+/* Resume the periodic tick, aligned to the tick grid */
+static void tick_nohz_restart(struct tick_cpu *tc, uint64_t now) {
+    tick_account(tc, now);
+    tc->tick_stopped = false;
+    tick_program(tc, tc->next_tick);
+}
+
+/* Clock event handler: periodic tick emulated on a one-shot device */
+static void tick_handle_event(struct pt_regs *regs) {
+    (void)regs;
+    struct tick_cpu *tc = this_tick_cpu();
+    uint64_t now = ktime_get_ns();
+    
+    tc->events++;
+    tick_account(tc, now);
+    hrtimer_run_local(now);
+    
+    /* A lone task needs no tick: nothing to preempt it for */
+    if (!tc->idle_active && sched_can_stop_tick()) {
+        tick_nohz_stop_tick(tc, now);
+    } else {
+        tc->tick_stopped = false;
+        tick_program(tc, tc->next_tick);
+    }
+}
+
+void clockevents_register_device(struct clock_event_device *dev) {
+    struct tick_cpu *tc = this_tick_cpu();
+    uint64_t now = ktime_get_ns();
+    
+    dev->event_handler = tick_handle_event;
+    tick_device = dev;
+    
+    tc->next_tick = (now / TICK_NSEC + 1) * TICK_NSEC;
+    tc->stats_start = now;
+    tick_program(tc, tc->next_tick);
+    
+    KLOG_INFO("Clock event device %s: %u Hz tick, nohz up to %lu ms",
+              dev->name, HZ, TICK_NOHZ_MAX_DEFER / NSEC_PER_MSEC);
+}
+
+/*
+ * Called by the idle loop with interrupts disabled. Stops the tick if
+ * nothing is due before the next one. Returns the expected idle time in
+ * nanoseconds so the idle loop can pick a C-state.
+ */
+uint64_t tick_nohz_idle_enter(void) {
+    struct tick_cpu *tc = this_tick_cpu();
+    uint64_t now = ktime_get_ns();
+    
+    tc->idle_active = true;
+    tc->idle_entry = now;
+    
+    if (!tick_device) {
+        return 0;
+    }
+    tick_nohz_stop_tick(tc, now);
+    
+    return tc->programmed > now ? tc->programmed - now : 0;
+}
+
+/* Called by the idle loop after waking, interrupts still disabled */
+void tick_nohz_idle_exit(void) {
+    struct tick_cpu *tc = this_tick_cpu();
+    uint64_t now = ktime_get_ns();
+    
+    tc->idle_ns += now - tc->idle_entry;
+    tc->wakeups++;
+    tc->idle_active = false;
+    
+    if (tc->tick_stopped) {
+        tick_nohz_restart(tc, now);
+    }
+}
+
+/* Reschedule IPI: a task was queued here, so the tick may be needed again */
+void tick_nohz_kick(void) {
+    struct tick_cpu *tc = this_tick_cpu();
+    
+    if (tc->tick_stopped && !tc->idle_active && !sched_can_stop_tick()) {
+        tick_nohz_restart(tc, ktime_get_ns());
+    }
+}
+
+/* The run queue of 'cpu' changed in a way that may need its tick */
+void tick_nohz_dep_changed(uint32_t cpu) {
+    if (cpu >= MAX_CPUS || !tick_cpus[cpu].tick_stopped) {
+        return;
+    }
+    
+    if (cpu == smp_processor_id()) {
+        tick_nohz_kick();
+    } else {
+        lapic_send_reschedule(cpu);
+    }
+}
+
+/*
+ * A local timer was armed for 'expires_ns'. The running tick picks it up
+ * on its own unless the device is set for a later event, which is the
+ * case with the tick stopped or for a sub-tick hrtimer.
+ */
+void tick_nohz_timer_added(uint64_t expires_ns) {
+    struct tick_cpu *tc = this_tick_cpu();
+    uint64_t flags = local_irq_save();
+    
+    if (tick_device && expires_ns < tc->programmed) {
+        tick_program(tc, expires_ns);
+    }
+    
+    local_irq_restore(flags);
+}
+
+/* Get idle statistics of one CPU */
+void tick_get_idle_stats(uint32_t cpu, uint64_t *wakeups, uint64_t *idle_ns,
+                         uint64_t *elapsed_ns) {
+    if (cpu >= smp_num_cpus()) {
+        return;
+    }
+    
+    struct tick_cpu *tc = &tick_cpus[cpu];
+    uint64_t idle = tc->idle_ns;
+    if (tc->idle_active) {
+        idle += ktime_get_ns() - tc->idle_entry;
+    }
+    
+    if (wakeups) *wakeups = tc->wakeups;
+    if (idle_ns) *idle_ns = idle;
+    if (elapsed_ns) *elapsed_ns = ktime_get_ns() - tc->stats_start;
+}
+
+/* Log wakeups per second and idle residency of every CPU */
+void tick_report(void) {
+    KLOG_INFO("=== TICK/IDLE REPORT ===");
+    
+    for (uint32_t cpu = 0; cpu < smp_num_cpus(); cpu++) {
+        uint64_t wakeups, idle_ns, elapsed_ns;
+        tick_get_idle_stats(cpu, &wakeups, &idle_ns, &elapsed_ns);
+        if (!elapsed_ns) {
+            continue;
+        }
+        
+        uint64_t elapsed_ms = elapsed_ns / NSEC_PER_MSEC;
+        KLOG_INFO("CPU %u: %lu wakeups/s, %lu%% idle residency, %lu timer events, %lu tick stops",
+                  cpu, elapsed_ms ? wakeups * 1000 / elapsed_ms : 0,
+                  idle_ns * 100 / elapsed_ns, tick_cpus[cpu].events,
+                  tick_cpus[cpu].tick_stops);
+    }
+    
+    uint64_t mwait_entries, deep_entries, hlt_entries;
+    idle_get_stats(&mwait_entries, &deep_entries, &hlt_entries);
+    KLOG_INFO("Idle entries: %lu MWAIT (%lu deep), %lu HLT",
+              mwait_entries, deep_entries, hlt_entries);
+}
+
+/* Bring up kernel timekeeping and the tick on the boot CPU */
+void timer_init(void) {
+    KLOG_INFO("Initializing timekeeping...");
+    
+    memset(tick_cpus, 0, sizeof(tick_cpus));
+    jiffies = 0;
+    timers_init();
+    
+    tsc_init();
+    idle_init();
+    
+    if (lapic_init() < 0) {
+        KLOG_WARN("No clock event device: running without a tick");
+    }
+}
\ No newline at end of file
@@ -0,0 +1,543 @@
+/*
+ * SentinalOS Timer Wheel
+ * Hierarchical Per-CPU Timers, Sleeping and Timeouts
+ */
+
+#include "kernel.h"
+#include "string.h"
+#include "smp.h"
+#include "sched.h"
+#include "timer.h"
+#include "spinlock.h"
+
+/*
+ * Five-level cascading wheel: the first level has one slot per jiffy for
+ * the next 256 jiffies, each further level covers 64 times the range of
+ * the previous one. Timers cascade down a level as their slot comes due.
+ */
+#define TVR_BITS                8
+#define TVN_BITS                6
+#define TVR_SIZE                (1 << TVR_BITS)
+#define TVN_SIZE                (1 << TVN_BITS)
+#define TVR_MASK                (TVR_SIZE - 1)
+#define TVN_MASK                (TVN_SIZE - 1)
+#define TVN_LEVELS              4
+#define TIMER_MAX_OFFSET        0xFFFFFFFFULL
+
+/* First jiffy covered by upper level 'n' (0-based) */
+#define TVN_SHIFT(n)            (TVR_BITS + (n) * TVN_BITS)
+
+struct timer_base {
+    spinlock_t lock;
+    uint64_t timer_jiffies;             /* Next jiffy to process */
+    uint32_t pending;
+    struct timer_list *tv1[TVR_SIZE];
+    struct timer_list *tvn[TVN_LEVELS][TVN_SIZE];
+    uint64_t tv1_map[TVR_SIZE / 64];    /* Non-empty tv1 slots */
+    uint64_t tvn_map[TVN_LEVELS];       /* Non-empty slots per upper level */
+    struct timer_list *running;         /* Timer whose callback is executing */
+} __aligned(64);
+
+static struct timer_base timer_bases[MAX_CPUS];
+
+/* Base locking; callbacks run from the tick, so interrupts stay off */
+static uint64_t base_lock(struct timer_base *base) {
+    return spin_lock_irqsave(&base->lock);
+}
+
+static void base_unlock(struct timer_base *base, uint64_t flags) {
+    spin_unlock_irqrestore(&base->lock, flags);
+}
+
+/* Lock the base 'timer' is on; rechecked under the lock, as mod_timer() may move it */
+static struct timer_base *lock_timer_base(struct timer_list *timer, uint64_t *flags) {
+    for (;;) {
+        uint32_t cpu = __atomic_load_n(&timer->cpu, __ATOMIC_RELAXED);
+        struct timer_base *base = &timer_bases[cpu];
+        *flags = base_lock(base);
+        if (timer->cpu == cpu) {
+            return base;
+        }
+        base_unlock(base, *flags);
+    }
+}
+
+/* Link a timer into a slot list and mark the slot busy */
+static void slot_add(struct timer_list **slot, uint64_t *map, uint32_t bit,
+                     struct timer_list *timer) {
+    timer->next = *slot;
+    if (*slot) {
+        (*slot)->pprev = &timer->next;
+    }
+    timer->pprev = slot;
+    *slot = timer;
+    map[bit / 64] |= 1ULL << (bit % 64);
+}
+
+/* Queue a timer in the slot matching its distance from timer_jiffies */
+static void internal_add_timer(struct timer_base *base, struct timer_list *timer) {
+    uint64_t expires = timer->expires;
+    uint64_t delta = expires - base->timer_jiffies;
+    
+    if ((int64_t)delta < 0) {
+        /* Already due: run on the next jiffy processed */
+        uint32_t idx = base->timer_jiffies & TVR_MASK;
+        slot_add(&base->tv1[idx], base->tv1_map, idx, timer);
+    } else if (delta < TVR_SIZE) {
+        uint32_t idx = expires & TVR_MASK;
+        slot_add(&base->tv1[idx], base->tv1_map, idx, timer);
+    } else {
+        if (delta > TIMER_MAX_OFFSET) {
+            expires = base->timer_jiffies + TIMER_MAX_OFFSET;
+            delta = TIMER_MAX_OFFSET;
+        }
+        int level = 0;
+        while (level < TVN_LEVELS - 1 && delta >= (1ULL << TVN_SHIFT(level + 1))) {
+            level++;
+        }
+        uint32_t idx = (expires >> TVN_SHIFT(level)) & TVN_MASK;
+        slot_add(&base->tvn[level][idx], &base->tvn_map[level], idx, timer);
+    }
+}
+
+/* Unlink a pending timer (caller holds the base lock) */
+static void detach_timer(struct timer_base *base, struct timer_list *timer) {
+    *timer->pprev = timer->next;
+    if (timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+    base->pending--;
+}
+
+/* Clear busy bits of slots emptied by deletions */
+static void update_slot_maps(struct timer_base *base) {
+    for (uint32_t idx = 0; idx < TVR_SIZE; idx++) {
+        if (!base->tv1[idx]) {
+            base->tv1_map[idx / 64] &= ~(1ULL << (idx % 64));
+        }
+    }
+    for (int level = 0; level < TVN_LEVELS; level++) {
+        for (uint32_t idx = 0; idx < TVN_SIZE; idx++) {
+            if (!base->tvn[level][idx]) {
+                base->tvn_map[level] &= ~(1ULL << idx);
+            }
+        }
+    }
+}
+
+/* Re-queue every timer of an upper-level slot; returns the slot index */
+static uint32_t cascade(struct timer_base *base, int level, uint32_t idx) {
+    struct timer_list *timer = base->tvn[level][idx];
+    base->tvn[level][idx] = NULL;
+    base->tvn_map[level] &= ~(1ULL << idx);
+    
+    while (timer) {
+        struct timer_list *next = timer->next;
+        internal_add_timer(base, timer);
+        timer = next;
+    }
+    return idx;
+}
+
+void timer_setup(struct timer_list *timer, void (*function)(struct timer_list *), void *data) {
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expires = 0;
+    timer->function = function;
+    timer->data = data;
+    timer->cpu = smp_processor_id();
+}
+
+/*
+ * (Re)arm a timer on the local CPU for an absolute jiffies expiry.
+ * Returns 1 if the timer was pending before, 0 otherwise.
+ */
+int mod_timer(struct timer_list *timer, uint64_t expires) {
+    int was_pending = del_timer(timer);
+    
+    uint32_t cpu = smp_processor_id();
+    struct timer_base *base = &timer_bases[cpu];
+    uint64_t flags = base_lock(base);
+    
+    timer->expires = expires;
+    timer->cpu = cpu;
+    internal_add_timer(base, timer);
+    base->pending++;
+    
+    base_unlock(base, flags);
+    
+    /* A CPU running without a tick must wake up for this timer */
+    tick_nohz_timer_added(expires * TICK_NSEC);
+    return was_pending;
+}
+
+void add_timer(struct timer_list *timer) {
+    mod_timer(timer, timer->expires);
+}
+
+/* Cancel a timer; returns 1 if it was pending */
+int del_timer(struct timer_list *timer) {
+    if (!timer_pending(timer)) {
+        return 0;
+    }
+    
+    uint64_t flags;
+    struct timer_base *base = lock_timer_base(timer, &flags);
+    
+    int was_pending = 0;
+    if (timer_pending(timer)) {
+        detach_timer(base, timer);
+        was_pending = 1;
+    }
+    
+    base_unlock(base, flags);
+    return was_pending;
+}
+
+/*
+ * Cancel a timer and wait for a running callback to finish, so the timer
+ * can go away (on-stack timers). Not from the callback, nor with a lock
+ * it takes held.
+ */
+int del_timer_sync(struct timer_list *timer) {
+    int was_pending = 0;
+    for (;;) {
+        uint64_t flags;
+        struct timer_base *base = lock_timer_base(timer, &flags);
+        if (timer_pending(timer)) {
+            detach_timer(base, timer);
+            was_pending = 1;
+        }
+        bool running = base->running == timer;
+        base_unlock(base, flags);
+        
+        if (!running) {
+            return was_pending;
+        }
+        cpu_relax();
+    }
+}
+
+/* Run all local timers that have expired by the current jiffies */
+void timer_run_local(void) {
+    struct timer_base *base = &timer_bases[smp_processor_id()];
+    uint64_t flags = base_lock(base);
+    
+    while ((int64_t)(jiffies - base->timer_jiffies) >= 0) {
+        uint32_t idx = base->timer_jiffies & TVR_MASK;
+        
+        /* Cascade upper levels when the lower one wraps */
+        if (!idx) {
+            for (int level = 0; level < TVN_LEVELS; level++) {
+                uint32_t slot = (base->timer_jiffies >> TVN_SHIFT(level)) & TVN_MASK;
+                if (cascade(base, level, slot)) {
+                    break;
+                }
+            }
+        }
+        base->timer_jiffies++;
+        
+        base->tv1_map[idx / 64] &= ~(1ULL << (idx % 64));
+        while (base->tv1[idx]) {
+            struct timer_list *timer = base->tv1[idx];
+            void (*function)(struct timer_list *) = timer->function;
+            detach_timer(base, timer);
+            base->running = timer;
+            
+            base_unlock(base, flags);
+            function(timer);
+            flags = base_lock(base);
+            base->running = NULL;
+        }
+        
+        if (!base->pending) {
+            /* Nothing left to scan for: jump straight to the present */
+            base->timer_jiffies = jiffies + 1;
+            break;
+        }
+    }
+    
+    base_unlock(base, flags);
+}
+
+/*
+ * Jiffies value of the earliest local timer, or TIMER_NO_EXPIRY. Timers in
+ * upper levels are reported at their cascade time, which is never later
+ * than their expiry; that is all a CPU going tickless needs.
+ */
+uint64_t timer_next_expiry(void) {
+    struct timer_base *base = &timer_bases[smp_processor_id()];
+    uint64_t flags = base_lock(base);
+    uint64_t next = TIMER_NO_EXPIRY;
+    
+    if (!base->pending) {
+        goto out;
+    }
+    update_slot_maps(base);
+    
+    /* Level 1 holds the next 256 jiffies exactly, one slot each */
+    uint32_t start = base->timer_jiffies & TVR_MASK;
+    for (uint32_t i = 0; i < TVR_SIZE; i++) {
+        uint32_t idx = (start + i) & TVR_MASK;
+        if (base->tv1_map[idx / 64] & (1ULL << (idx % 64))) {
+            next = base->timer_jiffies + i;
+            goto out;
+        }
+    }
+    
+    /* Upper levels: the next cascade point of the nearest busy slot */
+    for (int level = 0; level < TVN_LEVELS; level++) {
+        if (!base->tvn_map[level]) {
+            continue;
+        }
+        uint32_t shift = TVN_SHIFT(level);
+        uint64_t period_base = base->timer_jiffies >> shift;
+        for (uint32_t i = 1; i <= TVN_SIZE; i++) {
+            uint32_t idx = (period_base + i) & TVN_MASK;
+            if (base->tvn_map[level] & (1ULL << idx)) {
+                uint64_t cascade_at = (period_base + i) << shift;
+                if (cascade_at < next) {
+                    next = cascade_at;
+                }
+                break;
+            }
+        }
+    }
+
+out:
+    base_unlock(base, flags);
+    return next;
+}
+
+void timers_init(void) {
+    memset(timer_bases, 0, sizeof(timer_bases));
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        timer_bases[cpu].timer_jiffies = jiffies;
+    }
+}
+
+/* Busy-wait for a number of microseconds */
+void udelay(uint32_t us) {
+    uint64_t deadline = ktime_get_ns() + (uint64_t)us * NSEC_PER_USEC;
+    while (ktime_get_ns() < deadline) {
+        cpu_relax();
+    }
+}
+
+static void process_timeout(struct timer_list *timer) {
+    sched_wake_up((struct task *)timer->data);
+}
+
+/*
+ * Sleep for up to 'timeout' jiffies. Returns the jiffies left if woken
+ * early, 0 if the timeout elapsed.
+ */
+uint64_t schedule_timeout(uint64_t timeout) {
+    uint64_t expires = jiffies + timeout;
+    
+    if (!sched_can_block()) {
+        udelay(timeout * (1000000 / HZ));
+        return 0;
+    }
+    
+    struct timer_list timer;
+    timer_setup(&timer, process_timeout, sched_current());
+    
+    sched_prepare_to_block();
+    mod_timer(&timer, expires);
+    schedule();
+    del_timer_sync(&timer);
+    
+    return (int64_t)(expires - jiffies) > 0 ? expires - jiffies : 0;
+}
+
+void msleep(uint32_t ms) {
+    uint64_t timeout = msecs_to_jiffies(ms) + 1;
+    while (timeout) {
+        timeout = schedule_timeout(timeout);
+    }
+}
+
+static void hrtimer_wakeup(struct hrtimer *timer) {
+    sched_wake_up((struct task *)timer->data);
+}
+
+/* Sleep with microsecond resolution on a high-resolution timer */
+void usleep(uint32_t us) {
+    if (!sched_can_block()) {
+        udelay(us);
+        return;
+    }
+    
+    uint64_t expires = ktime_get_ns() + (uint64_t)us * NSEC_PER_USEC;
+    struct hrtimer timer;
+    hrtimer_setup(&timer, hrtimer_wakeup, sched_current());
+    
+    while (ktime_get_ns() < expires) {
+        sched_prepare_to_block();
+        hrtimer_start(&timer, expires);
+        schedule();
+        hrtimer_cancel_sync(&timer);
+    }
+}
+
+/*
+ * Benchmarks: per-operation cost of the wheel and the heap with
+ * nr_timers pending, and firing accuracy of short timers under that load.
+ */
+#define TIMER_BENCH_PROBES      64
+
+static struct {
+    volatile uint32_t fired;
+    uint64_t armed_at[TIMER_BENCH_PROBES];
+    uint64_t expected[TIMER_BENCH_PROBES];
+    uint64_t lateness_total;
+    uint64_t lateness_max;
+} timer_bench;
+
+static void bench_noop_timer(struct timer_list *timer) {
+    (void)timer;
+}
+
+static void bench_noop_hrtimer(struct hrtimer *timer) {
+    (void)timer;
+}
+
+static void bench_record(uint32_t probe) {
+    uint64_t late = ktime_get_ns() - timer_bench.expected[probe];
+    timer_bench.lateness_total += late;
+    if (late > timer_bench.lateness_max) {
+        timer_bench.lateness_max = late;
+    }
+    timer_bench.fired++;
+}
+
+static void bench_probe_timer(struct timer_list *timer) {
+    bench_record((uint32_t)(uintptr_t)timer->data);
+}
+
+static void bench_probe_hrtimer(struct hrtimer *timer) {
+    bench_record((uint32_t)(uintptr_t)timer->data);
+}
+
+/* Wait for all probes with interrupts enabled, bounded by 'limit_ms' */
+static bool bench_wait_probes(uint64_t limit_ms) {
+    uint64_t deadline = ktime_get_ns() + limit_ms * NSEC_PER_MSEC;
+    while (timer_bench.fired < TIMER_BENCH_PROBES && ktime_get_ns() < deadline) {
+        if (sched_can_block()) {
+            msleep(1);
+        } else {
+            __asm__ __volatile__("sti; hlt; cli");
+        }
+    }
+    return timer_bench.fired == TIMER_BENCH_PROBES;
+}
+
+void timer_benchmark(uint32_t nr_timers) {
+    KLOG_INFO("=== TIMER BENCHMARK (%u pending timers) ===", nr_timers);
+    
+    struct timer_list *timers = kmalloc(sizeof(struct timer_list) * nr_timers);
+    struct hrtimer *hrtimers = kmalloc(sizeof(struct hrtimer) * nr_timers);
+    if (!timers || !hrtimers) {
+        KLOG_ERR("Timer benchmark: out of memory");
+        return;
+    }
+    
+    /* Wheel: spread expiries over the next 60 seconds, all levels in use */
+    uint64_t seed = get_ticks() | 1;
+    uint64_t start = get_ticks();
+    for (uint32_t i = 0; i < nr_timers; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        timer_setup(&timers[i], bench_noop_timer, NULL);
+        mod_timer(&timers[i], jiffies + 1000 + (seed >> 33) % (60 * HZ));
+    }
+    uint64_t add_cycles = get_ticks() - start;
+    
+    start = get_ticks();
+    for (uint32_t i = 0; i < nr_timers; i++) {
+        mod_timer(&timers[i], timers[i].expires + HZ);
+    }
+    uint64_t rearm_cycles = get_ticks() - start;
+    
+    start = get_ticks();
+    uint64_t next = timer_next_expiry();
+    uint64_t next_cycles = get_ticks() - start;
+    
+    /* Heap: sub-millisecond spread far in the future so nothing fires */
+    uint64_t base_ns = ktime_get_ns() + 60 * NSEC_PER_SEC;
+    start = get_ticks();
+    for (uint32_t i = 0; i < nr_timers; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        hrtimer_setup(&hrtimers[i], bench_noop_hrtimer, NULL);
+        hrtimer_start(&hrtimers[i], base_ns + (seed >> 33) % NSEC_PER_SEC);
+    }
+    uint64_t hr_add_cycles = get_ticks() - start;
+    
+    KLOG_INFO("wheel:  add %lu, re-arm %lu cycles/op, next-expiry scan %lu cycles (+%lu jiffies)",
+              add_cycles / nr_timers, rearm_cycles / nr_timers, next_cycles,
+              next != TIMER_NO_EXPIRY ? next - jiffies : 0);
+    KLOG_INFO("heap:   add %lu cycles/op (%u queued)",
+              hr_add_cycles / nr_timers, hrtimer_pending_count());
+    
+    /* Accuracy with the full load pending: 1..64 ms wheel timers */
+    struct timer_list probes[TIMER_BENCH_PROBES];
+    struct hrtimer hr_probes[TIMER_BENCH_PROBES];
+    uint64_t irq_flags = local_irq_save();
+    
+    memset(&timer_bench, 0, sizeof(timer_bench));
+    for (uint32_t i = 0; i < TIMER_BENCH_PROBES; i++) {
+        uint64_t expires = jiffies + i + 1;
+        timer_setup(&probes[i], bench_probe_timer, (void *)(uintptr_t)i);
+        timer_bench.expected[i] = expires * TICK_NSEC;
+        mod_timer(&probes[i], expires);
+    }
+    if (bench_wait_probes(1000)) {
+        KLOG_INFO("wheel:  %lu us average, %lu us worst lateness",
+                  timer_bench.lateness_total / TIMER_BENCH_PROBES / NSEC_PER_USEC,
+                  timer_bench.lateness_max / NSEC_PER_USEC);
+    } else {
+        KLOG_WARN("wheel:  only %u/%u probes fired", timer_bench.fired, TIMER_BENCH_PROBES);
+    }
+    
+    /* Accuracy of 10..640 us high-resolution timers */
+    memset(&timer_bench, 0, sizeof(timer_bench));
+    uint64_t now = ktime_get_ns();
+    for (uint32_t i = 0; i < TIMER_BENCH_PROBES; i++) {
+        hrtimer_setup(&hr_probes[i], bench_probe_hrtimer, (void *)(uintptr_t)i);
+        timer_bench.expected[i] = now + (i + 1) * 10 * NSEC_PER_USEC;
+        hrtimer_start(&hr_probes[i], timer_bench.expected[i]);
+    }
+    if (bench_wait_probes(1000)) {
+        KLOG_INFO("heap:   %lu ns average, %lu ns worst lateness",
+                  timer_bench.lateness_total / TIMER_BENCH_PROBES, timer_bench.lateness_max);
+    } else {
+        KLOG_WARN("heap:   only %u/%u probes fired", timer_bench.fired, TIMER_BENCH_PROBES);
+    }
+    
+    for (uint32_t i = 0; i < TIMER_BENCH_PROBES; i++) {
+        del_timer_sync(&probes[i]);
+        hrtimer_cancel_sync(&hr_probes[i]);
+    }
+    local_irq_restore(irq_flags);
+    
+    /* Cancellation cost */
+    start = get_ticks();
+    for (uint32_t i = 0; i < nr_timers; i++) {
+        del_timer(&timers[i]);
+    }
+    uint64_t del_cycles = get_ticks() - start;
+    
+    start = get_ticks();
+    for (uint32_t i = 0; i < nr_timers; i++) {
+        hrtimer_cancel(&hrtimers[i]);
+    }
+    uint64_t hr_del_cycles = get_ticks() - start;
+    
+    KLOG_INFO("cancel: wheel %lu, heap %lu cycles/op",
+              del_cycles / nr_timers, hr_del_cycles / nr_timers);
+    
+    kfree(timers);
+    kfree(hrtimers);
+}
\ No newline at end of file
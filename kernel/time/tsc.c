@@ -0,0 +1,135 @@
+/*
+ * SentinalOS TSC Clocksource
+ * Calibrated Monotonic Kernel Time
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "ktime.h"
+
+/* PIT channel 2, used only for calibration */
+#define PIT_FREQUENCY           1193182
+#define PIT_CH2_DATA            0x42
+#define PIT_COMMAND             0x43
+#define PIT_CH2_GATE            0x61
+#define PIT_CALIBRATE_MS        10
+
+/* Fixed-point conversion shifts */
+#define CYC2NS_SHIFT            32
+#define NS2CYC_SHIFT            24
+
+static struct {
+    uint64_t tsc_hz;
+    uint64_t base;          /* TSC value at ktime 0 */
+    uint64_t cyc2ns_mult;   /* ns = cycles * mult >> CYC2NS_SHIFT */
+    uint64_t ns2cyc_mult;   /* cycles = ns * mult >> NS2CYC_SHIFT */
+    bool invariant;
+    bool initialized;
+} tsc_state;
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ __volatile__("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outb(uint16_t port, uint8_t val) {
+    __asm__ __volatile__("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+/* TSC frequency reported by CPUID leaves 0x15/0x16, or 0 */
+static uint64_t tsc_freq_from_cpuid(void) {
+    uint32_t max_leaf, eax, ebx, ecx, edx;
+    
+    cpuid_count(0, 0, &max_leaf, &ebx, &ecx, &edx);
+    if (max_leaf >= 0x15) {
+        cpuid_count(0x15, 0, &eax, &ebx, &ecx, &edx);
+        if (eax && ebx && ecx) {
+            return (uint64_t)ecx * ebx / eax;
+        }
+    }
+    if (max_leaf >= 0x16) {
+        cpuid_count(0x16, 0, &eax, &ebx, &ecx, &edx);
+        if (eax) {
+            return (uint64_t)(eax & 0xFFFF) * 1000000;
+        }
+    }
+    return 0;
+}
+
+/* Measure the TSC against a PIT channel 2 one-shot countdown */
+static uint64_t tsc_freq_from_pit(void) {
+    uint16_t latch = PIT_FREQUENCY / (1000 / PIT_CALIBRATE_MS);
+    
+    /* Gate on, speaker off */
+    outb(PIT_CH2_GATE, (inb(PIT_CH2_GATE) & ~0x02) | 0x01);
+    
+    /* Channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count) */
+    outb(PIT_COMMAND, 0xB0);
+    outb(PIT_CH2_DATA, latch & 0xFF);
+    outb(PIT_CH2_DATA, latch >> 8);
+    
+    uint64_t start = get_ticks();
+    while (!(inb(PIT_CH2_GATE) & 0x20)) {
+        /* OUT2 goes high at terminal count */
+    }
+    uint64_t end = get_ticks();
+    
+    return (end - start) * (1000 / PIT_CALIBRATE_MS);
+}
+
+void tsc_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    cpuid_count(0x80000000, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 0x80000007) {
+        cpuid_count(0x80000007, 0, &eax, &ebx, &ecx, &edx);
+        tsc_state.invariant = edx & (1 << 8);
+    }
+    
+    const char *source = "CPUID";
+    tsc_state.tsc_hz = tsc_freq_from_cpuid();
+    if (!tsc_state.tsc_hz) {
+        source = "PIT";
+        tsc_state.tsc_hz = tsc_freq_from_pit();
+    }
+    if (!tsc_state.tsc_hz) {
+        PANIC("TSC calibration failed");
+    }
+    
+    tsc_state.cyc2ns_mult = (NSEC_PER_SEC << CYC2NS_SHIFT) / tsc_state.tsc_hz;
+    tsc_state.ns2cyc_mult = (tsc_state.tsc_hz << NS2CYC_SHIFT) / NSEC_PER_SEC;
+    tsc_state.base = get_ticks();
+    tsc_state.initialized = true;
+    
+    KLOG_INFO("TSC: %lu kHz (%s)%s", tsc_state.tsc_hz / 1000, source,
+              tsc_state.invariant ? ", invariant" : "");
+    if (!tsc_state.invariant) {
+        KLOG_WARN("TSC is not invariant; deep C-states may stop it");
+    }
+}
+
+uint64_t tsc_cycles_to_ns(uint64_t cycles) {
+    return (uint64_t)(((unsigned __int128)cycles * tsc_state.cyc2ns_mult) >> CYC2NS_SHIFT);
+}
+
+uint64_t tsc_ns_to_cycles(uint64_t ns) {
+    return (uint64_t)(((unsigned __int128)ns * tsc_state.ns2cyc_mult) >> NS2CYC_SHIFT);
+}
+
+/* Absolute TSC value at which ktime reaches ktime_ns */
+uint64_t tsc_ktime_to_tsc(uint64_t ktime_ns) {
+    return tsc_state.base + tsc_ns_to_cycles(ktime_ns);
+}
+
+/* Monotonic nanoseconds since tsc_init() */
+uint64_t ktime_get_ns(void) {
+    if (unlikely(!tsc_state.initialized)) {
+        return 0;
+    }
+    return tsc_cycles_to_ns(get_ticks() - tsc_state.base);
+}
+
+uint32_t tsc_khz(void) {
+    return (uint32_t)(tsc_state.tsc_hz / 1000);
+}
\ No newline at end of file
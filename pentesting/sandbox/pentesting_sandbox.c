@@ -3,6 +3,7 @@
  * Pentagon-Level Security Isolation for Offensive Tools
  */
 
+#define _GNU_SOURCE             /* CPU_SET and sched_setaffinity */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,6 +26,13 @@
 #define MAX_ARGS 64
 #define MAX_PATH 512
 
+/*
+ * Tools run in their own cpuset on the CPUs above SANDBOX_RESERVED_CPUS,
+ * keeping the compositor and input handling cores free of cracking load.
+ */
+#define SANDBOX_CPUSET_ROOT "/sys/fs/cgroup/pentesting"
+#define SANDBOX_RESERVED_CPUS 2
+
 /* Pentesting tool definitions */
 struct pentesting_tool {
     const char *name;
@@ -47,6 +55,8 @@ struct sandbox_context {
     uint32_t time_limit;
     bool network_isolated;
     char log_file[MAX_PATH];
+    cpu_set_t cpus;             /* CPUs the tool and its children may use */
+    int cpuset_fd;              /* cgroup.procs of the tool's cpuset, or -1 */
 };
 
 /* Available pentesting tools */
@@ -193,6 +203,68 @@ static int setup_sandbox(struct sandbox_context *ctx) {
     return 0;
 }
 
+/* Write a string to a cgroup control file */
+static int write_cgroup_file(const char *dir, const char *file, const char *value) {
+    char path[MAX_PATH];
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t len = (ssize_t)strlen(value);
+    ssize_t written = write(fd, value, len);
+    close(fd);
+    return written == len ? 0 : -1;
+}
+
+/*
+ * Pick the sandbox CPUs and create the tool's cpuset while still root.
+ * cgroup.procs is opened now: the tool joins the set after chroot and the
+ * privilege drop, when the cgroup hierarchy is no longer reachable.
+ */
+static void setup_cpu_isolation(struct sandbox_context *ctx, const char *tool_name) {
+    long nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    
+    CPU_ZERO(&ctx->cpus);
+    for (long cpu = SANDBOX_RESERVED_CPUS; cpu < nr_cpus && cpu < CPU_SETSIZE; cpu++) {
+        CPU_SET(cpu, &ctx->cpus);
+    }
+    if (CPU_COUNT(&ctx->cpus) == 0) {
+        /* Too few CPUs to reserve any: share them all */
+        for (long cpu = 0; cpu < nr_cpus && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &ctx->cpus);
+        }
+    }
+    
+    ctx->cpuset_fd = -1;
+    char dir[MAX_PATH];
+    snprintf(dir, sizeof(dir), "%s/%s", SANDBOX_CPUSET_ROOT, tool_name);
+    mkdir(SANDBOX_CPUSET_ROOT, 0755);
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        log_sandbox_event("SETUP_WARNING", "cpusets unavailable, using affinity only");
+        return;
+    }
+    
+    char cpus[256];
+    size_t pos = 0;
+    cpus[0] = '\0';
+    for (int cpu = 0; cpu < CPU_SETSIZE && pos < sizeof(cpus) - 8; cpu++) {
+        if (CPU_ISSET(cpu, &ctx->cpus)) {
+            pos += snprintf(cpus + pos, sizeof(cpus) - pos, "%s%d", pos ? "," : "", cpu);
+        }
+    }
+    if (write_cgroup_file(dir, "cpuset.cpus", cpus) != 0 ||
+        write_cgroup_file(dir, "cpuset.mems", "0") != 0) {
+        log_sandbox_event("SETUP_WARNING", "Failed to configure sandbox cpuset");
+        return;
+    }
+    
+    char procs[MAX_PATH];
+    snprintf(procs, sizeof(procs), "%s/cgroup.procs", dir);
+    ctx->cpuset_fd = open(procs, O_WRONLY | O_CLOEXEC);
+}
+
 /* Drop privileges and enter sandbox */
 static int enter_sandbox(const struct sandbox_context *ctx) {
     log_sandbox_event("ENTER_START", "Entering sandbox environment");
@@ -231,7 +303,8 @@ static int enter_sandbox(const struct sandbox_context *ctx) {
 }
 
 /* Execute tool in sandbox */
-static int execute_tool(const struct pentesting_tool *tool, char *argv[]) {
+static int execute_tool(const struct sandbox_context *ctx, const struct pentesting_tool *tool,
+                        char *argv[]) {
     char details[512];
     snprintf(details, sizeof(details), "Executing %s", tool->name);
     log_sandbox_event("EXEC_START", details);
@@ -251,6 +324,18 @@ static int execute_tool(const struct pentesting_tool *tool, char *argv[]) {
     limit.rlim_cur = limit.rlim_max = 100 * 1024 * 1024;
     setrlimit(RLIMIT_FSIZE, &limit);
     
+    /* CPU placement: join the tool's cpuset, then pin to the sandbox CPUs */
+    if (ctx->cpuset_fd >= 0) {
+        char pid[32];
+        int len = snprintf(pid, sizeof(pid), "%d", (int)getpid());
+        if (write(ctx->cpuset_fd, pid, len) != len) {
+            log_sandbox_event("EXEC_WARNING", "Failed to join sandbox cpuset");
+        }
+    }
+    if (sched_setaffinity(0, sizeof(ctx->cpus), &ctx->cpus) != 0) {
+        log_sandbox_event("EXEC_WARNING", "Failed to set CPU affinity");
+    }
+    
     /* Execute the tool */
     execv(tool->binary_path, argv);
     
@@ -356,6 +441,7 @@ int main(int argc, char *argv[]) {
     
     snprintf(ctx.chroot_path, sizeof(ctx.chroot_path), "%s/%s", SANDBOX_ROOT, tool->name);
     snprintf(ctx.log_file, sizeof(ctx.log_file), "/var/log/pentesting_%s.log", tool->name);
+    setup_cpu_isolation(&ctx, tool->name);
     
     /* Setup sandbox environment */
     if (setup_sandbox(&ctx) != 0) {
@@ -372,7 +458,7 @@ int main(int argc, char *argv[]) {
         }
         
         /* Execute the tool */
-        execute_tool(tool, &argv[1]);
+        execute_tool(&ctx, tool, &argv[1]);
         exit(1); /* Should not reach here */
     } else if (pid > 0) {
         /* Parent process - monitor execution */
@@ -0,0 +1,25 @@
+#ifndef _FCNTL_H
+#define _FCNTL_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Open flags */
+#define O_RDONLY    0x0000
+#define O_WRONLY    0x0001
+#define O_RDWR      0x0002
+#define O_CREAT     0x0040
+#define O_TRUNC     0x0200
+#define O_APPEND    0x0400
+#define O_NONBLOCK  0x0800
+
+/* splice() flags: accepted but ignored; O_NONBLOCK on a pipe end applies instead */
+#define SPLICE_F_MOVE       0x01
+#define SPLICE_F_NONBLOCK   0x02
+#define SPLICE_F_MORE       0x04
+
+/* Move data between two descriptors, one of them a pipe, without a user copy */
+ssize_t splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len,
+               unsigned int flags);
+
+#endif /* _FCNTL_H */
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef _SCHED_H
+#define _SCHED_H
+
+#include <sys/types.h>
+
+/* clone() flags; the low byte is the exit signal, which is ignored */
+#define CLONE_VM                0x00000100  /* Share the address space */
+#define CLONE_FILES             0x00000400  /* Share the descriptor table */
+#define CLONE_THREAD            0x00010000  /* Same thread group: same getpid() */
+#define CLONE_SETTLS            0x00080000  /* FS base set to 'tls' */
+#define CLONE_PARENT_SETTID     0x00100000  /* Child TID stored at *ptid */
+#define CLONE_CHILD_SETTID      0x01000000  /* Child TID stored at *ctid */
+#define CLONE_CHILD_CLEARTID    0x00200000  /* *ctid zeroed and futex-woken at exit */
+
+/*
+ * Run fn(arg) in a new thread or process on 'stack' (its top), which
+ * exits with fn's result. A thread passes CLONE_VM | CLONE_FILES |
+ * CLONE_THREAD; with CLONE_CHILD_CLEARTID a joiner FUTEX_WAITs on *ctid
+ * until it reads 0. Returns the child's TID.
+ */
+int clone(int (*fn)(void *), void *stack, int flags, void *arg, pid_t *ptid, void *tls,
+          pid_t *ctid);
+
+#endif /* _SCHED_H */
\ No newline at end of file
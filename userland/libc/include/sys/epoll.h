@@ -0,0 +1,43 @@
+#ifndef _SYS_EPOLL_H
+#define _SYS_EPOLL_H
+
+#include <stdint.h>
+
+/* Events */
+#define EPOLLIN         0x001
+#define EPOLLPRI        0x002
+#define EPOLLOUT        0x004
+#define EPOLLERR        0x008   /* Always reported */
+#define EPOLLHUP        0x010   /* Always reported */
+#define EPOLLRDNORM     0x040
+#define EPOLLWRNORM     0x100
+#define EPOLLONESHOT    (1U << 30)
+#define EPOLLET         (1U << 31)
+
+#define EPOLL_CLOEXEC   0x80000
+
+/* epoll_ctl() operations */
+#define EPOLL_CTL_ADD   1
+#define EPOLL_CTL_DEL   2
+#define EPOLL_CTL_MOD   3
+
+typedef union epoll_data {
+    void *ptr;
+    int fd;
+    uint32_t u32;
+    uint64_t u64;
+} epoll_data_t;
+
+struct epoll_event {
+    uint32_t events;
+    epoll_data_t data;
+} __attribute__((packed));
+
+int epoll_create(int size);
+int epoll_create1(int flags);
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event);
+
+/* timeout in ms; -1 waits forever, 0 only checks */
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout);
+
+#endif /* _SYS_EPOLL_H */
\ No newline at end of file
@@ -0,0 +1,11 @@
+#ifndef _SYS_PRCTL_H
+#define _SYS_PRCTL_H
+
+/* arch_prctl() codes */
+#define ARCH_SET_FS 0x1002
+#define ARCH_GET_FS 0x1003
+
+/* Set the FS base, the TLS thread pointer, or read it into *(unsigned long *)addr */
+int arch_prctl(int code, unsigned long addr);
+
+#endif /* _SYS_PRCTL_H */
\ No newline at end of file
@@ -0,0 +1,10 @@
+#ifndef _SYS_SENDFILE_H
+#define _SYS_SENDFILE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Copy between descriptors inside the kernel; *offset advances if given */
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+
+#endif /* _SYS_SENDFILE_H */
\ No newline at end of file
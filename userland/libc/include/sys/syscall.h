@@ -0,0 +1,108 @@
+#ifndef _SYS_SYSCALL_H
+#define _SYS_SYSCALL_H
+
+/*
+ * System call numbers: the position of each call in syscall_t
+ * (kernel/include/system.h). Entries are only ever appended there, so
+ * keep this list in the same order when adding one.
+ */
+#define SYS_EXIT                    0
+#define SYS_FORK                    1
+#define SYS_READ                    2
+#define SYS_WRITE                   3
+#define SYS_OPEN                    4
+#define SYS_CLOSE                   5
+#define SYS_WAITPID                 6
+#define SYS_CREAT                   7
+#define SYS_LINK                    8
+#define SYS_UNLINK                  9
+#define SYS_EXECVE                  10
+#define SYS_CHDIR                   11
+#define SYS_TIME                    12
+#define SYS_MKNOD                   13
+#define SYS_CHMOD                   14
+#define SYS_GETPID                  15
+#define SYS_MOUNT                   16
+#define SYS_UMOUNT                  17
+#define SYS_GETUID                  18
+#define SYS_GETGID                  19
+#define SYS_STIME                   20
+#define SYS_ALARM                   21
+#define SYS_FSTAT                   22
+#define SYS_PAUSE                   23
+#define SYS_UTIME                   24
+#define SYS_ACCESS                  25
+#define SYS_SYNC                    26
+#define SYS_KILL                    27
+#define SYS_RENAME                  28
+#define SYS_MKDIR                   29
+#define SYS_RMDIR                   30
+#define SYS_DUP                     31
+#define SYS_PIPE                    32
+#define SYS_TIMES                   33
+#define SYS_BRK                     34
+#define SYS_SETGID                  35
+#define SYS_GETEGID                 36
+#define SYS_SETSID                  37
+#define SYS_SIGACTION               38
+#define SYS_SGETMASK                39
+#define SYS_SSETMASK                40
+#define SYS_SETREUID                41
+#define SYS_SETREGID                42
+#define SYS_SIGSUSPEND              43
+#define SYS_SIGPENDING              44
+#define SYS_SETHOSTNAME             45
+#define SYS_SETRLIMIT               46
+#define SYS_GETRLIMIT               47
+#define SYS_GETRUSAGE               48
+#define SYS_GETTIMEOFDAY            49
+#define SYS_SETTIMEOFDAY            50
+#define SYS_GETGROUPS               51
+#define SYS_SETGROUPS               52
+#define SYS_SYMLINK                 53
+#define SYS_READLINK                54
+#define SYS_USELIB                  55
+#define SYS_SWAPON                  56
+#define SYS_REBOOT                  57
+#define SYS_READDIR                 58
+#define SYS_MMAP                    59
+#define SYS_MUNMAP                  60
+#define SYS_TRUNCATE                61
+#define SYS_FTRUNCATE               62
+#define SYS_FCHMOD                  63
+#define SYS_FCHOWN                  64
+#define SYS_GETPRIORITY             65
+#define SYS_SETPRIORITY             66
+#define SYS_STATFS                  67
+#define SYS_FSTATFS                 68
+#define SYS_SOCKETCALL              69
+#define SYS_FUTEX                   70
+#define SYS_SCHED_SETSCHEDULER      71
+#define SYS_SCHED_GETSCHEDULER      72
+#define SYS_SCHED_SETATTR           73
+#define SYS_SCHED_SETAFFINITY       74
+#define SYS_SCHED_GETAFFINITY       75
+#define SYS_CPUSET_CREATE           76
+#define SYS_CPUSET_DESTROY          77
+#define SYS_CPUSET_ATTACH           78
+#define SYS_DUP2                    79
+#define SYS_URING_SETUP             80
+#define SYS_URING_ENTER             81
+#define SYS_READV                   82
+#define SYS_WRITEV                  83
+#define SYS_PREADV                  84
+#define SYS_PWRITEV                 85
+#define SYS_SPLICE                  86
+#define SYS_SENDFILE                87
+#define SYS_EPOLL_CREATE            88
+#define SYS_EPOLL_CTL               89
+#define SYS_EPOLL_WAIT              90
+#define SYS_CLONE                   91
+#define SYS_GETTID                  92
+#define SYS_SET_TID_ADDRESS         93
+#define SYS_ARCH_PRCTL              94
+#define SYS_EXIT_GROUP              95
+
+long syscall(long number, ...);
+
+#endif /* _SYS_SYSCALL_H */
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef _SYS_UIO_H
+#define _SYS_UIO_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Most segments one call accepts */
+#define IOV_MAX 1024
+
+/* Scatter/gather segment */
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+
+/* Vectored I/O; the p variants use 'offset' and leave the file offset alone */
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt);
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt);
+ssize_t preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+
+#endif /* _SYS_UIO_H */
\ No newline at end of file
@@ -0,0 +1,185 @@
+#ifndef _SYS_URING_H
+#define _SYS_URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Asynchronous I/O rings. Requests are queued as SQEs in a ring shared
+ * with the kernel and their results reaped as CQEs, so a batch costs one
+ * system call, or none with URING_SETUP_SQPOLL. The structures below
+ * match kernel/include/uring.h.
+ */
+
+/* Setup flags */
+#define URING_SETUP_SQPOLL      0x01    /* Kernel thread polls the SQ */
+#define URING_SETUP_SQ_AFF      0x02    /* ... bound to sq_thread_cpu */
+
+/* uring_enter() flags */
+#define URING_ENTER_GETEVENTS   0x01
+#define URING_ENTER_SQ_WAKEUP   0x02
+
+/* SQ ring flags */
+#define URING_SQ_NEED_WAKEUP    0x01
+
+/* Opcodes */
+#define URING_OP_NOP            0
+#define URING_OP_READ           1
+#define URING_OP_WRITE          2
+#define URING_OP_OPEN           3
+#define URING_OP_CLOSE          4
+#define URING_OP_FSYNC          5
+#define URING_OP_POLL           6
+
+struct uring_sqe {
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t resv;
+    int32_t fd;
+    int64_t off;                /* File offset; -1 for the current one */
+    uint64_t addr;              /* Buffer, or path for OPEN */
+    uint32_t len;
+    uint32_t op_flags;          /* OPEN flags, POLL events */
+    uint64_t user_data;
+    uint32_t mode;              /* OPEN mode */
+    uint32_t resv2[5];
+};
+
+struct uring_cqe {
+    uint64_t user_data;
+    int32_t res;                /* Result, or negative errno */
+    uint32_t flags;
+};
+
+struct uring_sq_offsets {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    uint32_t flags;
+    uint32_t dropped;
+    uint32_t array;
+    uint32_t sqes;
+};
+
+struct uring_cq_offsets {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    uint32_t cqes;
+    uint32_t resv;
+};
+
+struct uring_params {
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    uint32_t flags;
+    uint32_t sq_thread_cpu;
+    uint32_t sq_thread_idle;    /* Milliseconds */
+    uint32_t ring_size;
+    struct uring_sq_offsets sq_off;
+    struct uring_cq_offsets cq_off;
+};
+
+/* A mapped ring, as set up by uring_queue_init() */
+struct uring {
+    int ring_fd;
+    uint32_t flags;
+    void *ring_ptr;
+    size_t ring_size;
+    struct {
+        volatile uint32_t *khead;
+        volatile uint32_t *ktail;
+        volatile uint32_t *kflags;
+        uint32_t *array;
+        struct uring_sqe *sqes;
+        uint32_t ring_mask;
+        uint32_t ring_entries;
+        uint32_t sqe_head;      /* Handed out but not yet submitted: sqe_head..sqe_tail */
+        uint32_t sqe_tail;
+    } sq;
+    struct {
+        volatile uint32_t *khead;
+        volatile uint32_t *ktail;
+        struct uring_cqe *cqes;
+        uint32_t ring_mask;
+    } cq;
+};
+
+/* System calls */
+int uring_setup(unsigned entries, struct uring_params *p);
+int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags);
+
+/* Ring helpers; these return 0 or a negative errno */
+int uring_queue_init(unsigned entries, struct uring *ring, unsigned flags);
+int uring_queue_init_params(unsigned entries, struct uring *ring, struct uring_params *p);
+void uring_queue_exit(struct uring *ring);
+struct uring_sqe *uring_get_sqe(struct uring *ring);
+int uring_submit(struct uring *ring);
+int uring_submit_and_wait(struct uring *ring, unsigned wait_nr);
+int uring_peek_cqe(struct uring *ring, struct uring_cqe **cqe_ptr);
+int uring_wait_cqe(struct uring *ring, struct uring_cqe **cqe_ptr);
+
+/* Hand a CQE returned by uring_peek_cqe() or uring_wait_cqe() back to the ring */
+static inline void uring_cqe_seen(struct uring *ring, struct uring_cqe *cqe) {
+    (void)cqe;
+    __atomic_store_n(ring->cq.khead, *ring->cq.khead + 1, __ATOMIC_RELEASE);
+}
+
+static inline void uring_prep_rw(struct uring_sqe *sqe, uint8_t op, int fd, uint64_t addr,
+                                 uint32_t len, int64_t off) {
+    sqe->opcode = op;
+    sqe->flags = 0;
+    sqe->fd = fd;
+    sqe->off = off;
+    sqe->addr = addr;
+    sqe->len = len;
+    sqe->op_flags = 0;
+    sqe->user_data = 0;
+    sqe->mode = 0;
+}
+
+static inline void uring_prep_nop(struct uring_sqe *sqe) {
+    uring_prep_rw(sqe, URING_OP_NOP, -1, 0, 0, 0);
+}
+
+static inline void uring_prep_read(struct uring_sqe *sqe, int fd, void *buf, unsigned nbytes,
+                                   int64_t offset) {
+    uring_prep_rw(sqe, URING_OP_READ, fd, (uint64_t)(uintptr_t)buf, nbytes, offset);
+}
+
+static inline void uring_prep_write(struct uring_sqe *sqe, int fd, const void *buf,
+                                    unsigned nbytes, int64_t offset) {
+    uring_prep_rw(sqe, URING_OP_WRITE, fd, (uint64_t)(uintptr_t)buf, nbytes, offset);
+}
+
+static inline void uring_prep_open(struct uring_sqe *sqe, const char *path, int flags,
+                                   unsigned mode) {
+    uring_prep_rw(sqe, URING_OP_OPEN, -1, (uint64_t)(uintptr_t)path, 0, 0);
+    sqe->op_flags = flags;
+    sqe->mode = mode;
+}
+
+static inline void uring_prep_close(struct uring_sqe *sqe, int fd) {
+    uring_prep_rw(sqe, URING_OP_CLOSE, fd, 0, 0, 0);
+}
+
+static inline void uring_prep_fsync(struct uring_sqe *sqe, int fd) {
+    uring_prep_rw(sqe, URING_OP_FSYNC, fd, 0, 0, 0);
+}
+
+static inline void uring_prep_poll_add(struct uring_sqe *sqe, int fd, unsigned poll_mask) {
+    uring_prep_rw(sqe, URING_OP_POLL, fd, 0, 0, 0);
+    sqe->op_flags = poll_mask;
+}
+
+static inline void uring_sqe_set_data(struct uring_sqe *sqe, void *data) {
+    sqe->user_data = (uint64_t)(uintptr_t)data;
+}
+
+static inline void *uring_cqe_get_data(const struct uring_cqe *cqe) {
+    return (void *)(uintptr_t)cqe->user_data;
+}
+
+#endif /* _SYS_URING_H */
\ No newline at end of file
@@ -24,10 +24,14 @@
 ssize_t read(int fd, void *buf, size_t count);
 ssize_t write(int fd, const void *buf, size_t count);
 int close(int fd);
+int pipe(int pipefd[2]);
+int pipe2(int pipefd[2], int flags);
 off_t lseek(int fd, off_t offset, int whence);
 
 /* Process functions */
 pid_t getpid(void);
+pid_t gettid(void);
+pid_t set_tid_address(int *tidptr);
 pid_t getppid(void);
 uid_t getuid(void);
 gid_t getgid(void);
@@ -9,6 +9,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 
 /* Memory block header */
 struct mem_block {
@@ -35,7 +36,10 @@ static int heap_initialized = 0;
 static uint32_t heap_canary = 0x12345678;
 static int security_checks_enabled = 1;
 
-/* Thread safety (simplified) */
+/* Thread safety: futex lock, 0 free, 1 locked, 2 locked with sleepers */
+#define FUTEX_WAIT  0
+#define FUTEX_WAKE  1
+
 static volatile int heap_lock = 0;
 
 /* Forward declarations */
@@ -45,6 +49,8 @@ static struct mem_block *create_block(size_t size);
 static void split_block(struct mem_block *block, size_t size);
 static void merge_free_blocks(void);
 static uint32_t calculate_checksum(struct mem_block *block);
+static void heap_lock_acquire(void);
+static void heap_lock_release(void);
 static int validate_block(struct mem_block *block);
 static void *allocate_pages(size_t size);
 static void security_wipe(void *ptr, size_t size);
@@ -96,6 +102,30 @@ static uint32_t calculate_checksum(struct mem_block *block) {
     return checksum;
 }
 
+/* Take the heap lock; contended waiters sleep in the kernel */
+static void heap_lock_acquire(void) {
+    int c = __sync_val_compare_and_swap(&heap_lock, 0, 1);
+    if (c == 0) {
+        return;
+    }
+    
+    if (c != 2) {
+        c = __sync_lock_test_and_set(&heap_lock, 2);
+    }
+    while (c != 0) {
+        syscall(SYS_FUTEX, &heap_lock, FUTEX_WAIT, 2, NULL, NULL);
+        c = __sync_lock_test_and_set(&heap_lock, 2);
+    }
+}
+
+/* Drop the heap lock; only enter the kernel if someone is sleeping */
+static void heap_lock_release(void) {
+    if (__sync_fetch_and_sub(&heap_lock, 1) != 1) {
+        heap_lock = 0;
+        syscall(SYS_FUTEX, &heap_lock, FUTEX_WAKE, 1, NULL, NULL);
+    }
+}
+
 /* Validate block integrity */
 static int validate_block(struct mem_block *block) {
     if (!block || !security_checks_enabled) {
@@ -269,14 +299,12 @@ void *malloc(size_t size) {
     }
     
     /* Acquire lock */
-    while (__sync_lock_test_and_set(&heap_lock, 1)) {
-        /* Spin wait */
-    }
+    heap_lock_acquire();
     
     if (!heap_initialized) {
         heap_init();
         if (!heap_initialized) {
-            __sync_lock_release(&heap_lock);
+            heap_lock_release();
             return NULL;
         }
     }
@@ -292,7 +320,7 @@ void *malloc(size_t size) {
     if (!block) {
         block = create_block(size);
         if (!block) {
-            __sync_lock_release(&heap_lock);
+            heap_lock_release();
             return NULL;
         }
     }
@@ -307,7 +335,7 @@ void *malloc(size_t size) {
     /* Update checksum */
     block->checksum = calculate_checksum(block);
     
-    __sync_lock_release(&heap_lock);
+    heap_lock_release();
     
     /* Return pointer to data area */
     void *ptr = (char *)block + sizeof(struct mem_block);
@@ -326,9 +354,7 @@ void free(void *ptr) {
     }
     
     /* Acquire lock */
-    while (__sync_lock_test_and_set(&heap_lock, 1)) {
-        /* Spin wait */
-    }
+    heap_lock_acquire();
     
     /* Get block header */
     ptr = (char *)ptr - 8; /* Account for canary */
@@ -336,7 +362,7 @@ void free(void *ptr) {
     
     /* Validate block */
     if (!validate_block(block)) {
-        __sync_lock_release(&heap_lock);
+        heap_lock_release();
         abort(); /* Heap corruption or double free */
     }
     
@@ -346,7 +372,7 @@ void free(void *ptr) {
         uint32_t end_canary = *(uint32_t *)((char *)ptr + block->size - 4);
         
         if (start_canary != heap_canary || end_canary != heap_canary) {
-            __sync_lock_release(&heap_lock);
+            heap_lock_release();
             abort(); /* Buffer overflow detected */
         }
     }
@@ -362,7 +388,7 @@ void free(void *ptr) {
     /* Merge adjacent free blocks */
     merge_free_blocks();
     
-    __sync_lock_release(&heap_lock);
+    heap_lock_release();
 }
 
 /* Public calloc implementation */
@@ -7,6 +7,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <errno.h>
+#include <sys/syscall.h>
 
 /* Memory allocation state */
 static struct {
@@ -34,15 +35,6 @@ struct heap_block {
 #define HEAP_FLAG_GUARD     0x02
 #define MIN_BLOCK_SIZE      32
 
-/* System call interface */
-extern long syscall(long number, ...);
-
-#define SYS_BRK         12
-#define SYS_EXIT        60
-#define SYS_GETPID      39
-#define SYS_WRITE       1
-#define SYS_READ        0
-
 /* Initialize heap */
 static void init_heap(void) {
     if (heap_state.initialized) return;
@@ -9,31 +9,8 @@
 /* Global errno variable */
 int errno = 0;
 
-/* System call numbers */
-#define SYS_READ        0
-#define SYS_WRITE       1
-#define SYS_OPEN        2
-#define SYS_CLOSE       3
-#define SYS_STAT        4
-#define SYS_FSTAT       5
-#define SYS_LSTAT       6
-#define SYS_POLL        7
-#define SYS_LSEEK       8
-#define SYS_MMAP        9
-#define SYS_MPROTECT    10
-#define SYS_MUNMAP      11
-#define SYS_BRK         12
-#define SYS_GETPID      39
-#define SYS_GETPPID     110
-#define SYS_GETUID      102
-#define SYS_GETGID      104
-#define SYS_GETEUID     107
-#define SYS_GETEGID     108
-#define SYS_EXIT        60
-#define SYS_KILL        62
-#define SYS_FORK        57
-#define SYS_EXECVE      59
-#define SYS_WAIT4       61
+/* System call numbers; the SentinalOS extensions below have no kernel entry yet */
+#include <sys/syscall.h>
 
 /* Security-enhanced system calls */
 #define SYS_SENTINAL_SECURE_READ   1000
@@ -137,10 +114,9 @@ long syscall(long number, ...) {
     switch (number) {
         /* 0-argument syscalls */
         case SYS_GETPID:
-        case SYS_GETPPID:
+        case SYS_GETTID:
         case SYS_GETUID:
         case SYS_GETGID:
-        case SYS_GETEUID:
         case SYS_GETEGID:
         case SYS_FORK:
             ret = _syscall0(number);
@@ -150,11 +126,16 @@ long syscall(long number, ...) {
         case SYS_CLOSE:
         case SYS_BRK:
         case SYS_EXIT:
+        case SYS_EXIT_GROUP:
+        case SYS_SET_TID_ADDRESS:
+        case SYS_EPOLL_CREATE:
             ret = _syscall1(number, va_arg(args, long));
             break;
             
         /* 2-argument syscalls */
         case SYS_KILL:
+        case SYS_PIPE:
+        case SYS_ARCH_PRCTL:
             ret = _syscall2(number, va_arg(args, long), va_arg(args, long));
             break;
             
@@ -162,13 +143,19 @@ long syscall(long number, ...) {
         case SYS_READ:
         case SYS_WRITE:
         case SYS_OPEN:
-        case SYS_LSEEK:
         case SYS_EXECVE:
+        case SYS_WAITPID:
+        case SYS_READV:
+        case SYS_WRITEV:
             ret = _syscall3(number, va_arg(args, long), va_arg(args, long), va_arg(args, long));
             break;
             
         /* 4-argument syscalls */
-        case SYS_WAIT4:
+        case SYS_PREADV:
+        case SYS_PWRITEV:
+        case SYS_SENDFILE:
+        case SYS_EPOLL_CTL:
+        case SYS_EPOLL_WAIT:
             ret = _syscall4(number, va_arg(args, long), va_arg(args, long), 
                            va_arg(args, long), va_arg(args, long));
             break;
@@ -202,6 +189,11 @@ long syscall(long number, ...) {
 /* Standard POSIX system call wrappers */
 
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <sys/prctl.h>
+#include <sched.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 ssize_t read(int fd, void *buf, size_t count) {
@@ -212,6 +204,60 @@ ssize_t write(int fd, const void *buf, size_t count) {
     return syscall(SYS_WRITE, fd, buf, count);
 }
 
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt) {
+    return syscall(SYS_READV, fd, iov, iovcnt);
+}
+
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt) {
+    return syscall(SYS_WRITEV, fd, iov, iovcnt);
+}
+
+ssize_t preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset) {
+    return syscall(SYS_PREADV, fd, iov, iovcnt, offset);
+}
+
+ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset) {
+    return syscall(SYS_PWRITEV, fd, iov, iovcnt, offset);
+}
+
+int pipe(int pipefd[2]) {
+    return syscall(SYS_PIPE, pipefd, 0);
+}
+
+int pipe2(int pipefd[2], int flags) {
+    return syscall(SYS_PIPE, pipefd, flags);
+}
+
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+    return syscall(SYS_SENDFILE, out_fd, in_fd, offset, count);
+}
+
+ssize_t splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len,
+               unsigned int flags) {
+    return syscall(SYS_SPLICE, fd_in, off_in, fd_out, off_out, len, flags);
+}
+
+/* The size hint is only checked, as on Linux */
+int epoll_create(int size) {
+    if (size <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return syscall(SYS_EPOLL_CREATE, 0);
+}
+
+int epoll_create1(int flags) {
+    return syscall(SYS_EPOLL_CREATE, flags);
+}
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) {
+    return syscall(SYS_EPOLL_CTL, epfd, op, fd, event);
+}
+
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout) {
+    return syscall(SYS_EPOLL_WAIT, epfd, events, maxevents, timeout);
+}
+
 int close(int fd) {
     return syscall(SYS_CLOSE, fd);
 }
@@ -220,8 +266,22 @@ pid_t getpid(void) {
     return syscall(SYS_GETPID);
 }
 
+pid_t gettid(void) {
+    return syscall(SYS_GETTID);
+}
+
+pid_t set_tid_address(int *tidptr) {
+    return syscall(SYS_SET_TID_ADDRESS, tidptr);
+}
+
+int arch_prctl(int code, unsigned long addr) {
+    return syscall(SYS_ARCH_PRCTL, code, addr);
+}
+
+/* No kernel entry yet */
 pid_t getppid(void) {
-    return syscall(SYS_GETPPID);
+    errno = ENOSYS;
+    return -1;
 }
 
 uid_t getuid(void) {
@@ -232,16 +292,19 @@ gid_t getgid(void) {
     return syscall(SYS_GETGID);
 }
 
+/* No kernel entry yet */
 uid_t geteuid(void) {
-    return syscall(SYS_GETEUID);
+    errno = ENOSYS;
+    return (uid_t)-1;
 }
 
 gid_t getegid(void) {
     return syscall(SYS_GETEGID);
 }
 
+/* Ends every thread of the process; a clone() child's return ends only itself */
 void _exit(int status) {
-    syscall(SYS_EXIT, status);
+    syscall(SYS_EXIT_GROUP, status);
     while (1); /* Should never reach here */
 }
 
@@ -253,6 +316,51 @@ pid_t fork(void) {
     return syscall(SYS_FORK);
 }
 
+/*
+ * The child starts on 'stack' with no frame to return to, so fn and arg
+ * travel on that stack and the child calls fn and exits without touching
+ * anything of the parent's.
+ */
+int clone(int (*fn)(void *), void *stack, int flags, void *arg, pid_t *ptid, void *tls,
+          pid_t *ctid) {
+    if (!fn || !stack) {
+        errno = EINVAL;
+        return -1;
+    }
+    
+    void **sp = (void **)((uintptr_t)stack & ~(uintptr_t)15);
+    *--sp = arg;
+    *--sp = (void *)fn;
+    
+    long ret;
+    register long r10 __asm__("r10") = (long)ctid;
+    register long r8 __asm__("r8") = (long)tls;
+    __asm__ __volatile__(
+        "syscall\n"
+        "test %%rax, %%rax\n"
+        "jnz 1f\n"
+        "xor %%ebp, %%ebp\n"
+        "pop %%rax\n"
+        "pop %%rdi\n"
+        "call *%%rax\n"
+        "mov %%eax, %%edi\n"
+        "mov %[exit], %%eax\n"
+        "syscall\n"
+        "2: jmp 2b\n"
+        "1:\n"
+        : "=a" (ret)
+        : "a" ((long)SYS_CLONE), "D" ((long)flags), "S" (sp), "d" (ptid), "r" (r10), "r" (r8),
+          [exit] "i" (SYS_EXIT)
+        : "rcx", "r11", "memory"
+    );
+    
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return ret;
+}
+
 int execve(const char *pathname, char *const argv[], char *const envp[]) {
     return syscall(SYS_EXECVE, pathname, argv, envp);
 }
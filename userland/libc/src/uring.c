@@ -0,0 +1,160 @@
+/*
+ * SentinalOS Asynchronous I/O Rings
+ * Pentagon-Level Batched System Call Interface
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uring.h>
+#include <sys/syscall.h>
+
+#define PROT_READ           0x1
+#define PROT_WRITE          0x2
+#define MAP_SHARED          0x01
+
+extern int close(int fd);
+
+int uring_setup(unsigned entries, struct uring_params *p) {
+    return syscall(SYS_URING_SETUP, entries, p);
+}
+
+int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return syscall(SYS_URING_ENTER, fd, to_submit, min_complete, flags);
+}
+
+/* Set up a ring and map its shared region */
+int uring_queue_init_params(unsigned entries, struct uring *ring, struct uring_params *p) {
+    memset(ring, 0, sizeof(*ring));
+
+    int fd = uring_setup(entries, p);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    long addr = syscall(SYS_MMAP, NULL, p->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == -1) {
+        int err = errno;
+        close(fd);
+        return -err;
+    }
+
+    char *base = (char *)addr;
+    ring->ring_fd = fd;
+    ring->flags = p->flags;
+    ring->ring_ptr = base;
+    ring->ring_size = p->ring_size;
+
+    ring->sq.khead = (volatile uint32_t *)(base + p->sq_off.head);
+    ring->sq.ktail = (volatile uint32_t *)(base + p->sq_off.tail);
+    ring->sq.kflags = (volatile uint32_t *)(base + p->sq_off.flags);
+    ring->sq.array = (uint32_t *)(base + p->sq_off.array);
+    ring->sq.sqes = (struct uring_sqe *)(base + p->sq_off.sqes);
+    ring->sq.ring_mask = *(uint32_t *)(base + p->sq_off.ring_mask);
+    ring->sq.ring_entries = *(uint32_t *)(base + p->sq_off.ring_entries);
+    ring->sq.sqe_head = ring->sq.sqe_tail = *ring->sq.ktail;
+
+    ring->cq.khead = (volatile uint32_t *)(base + p->cq_off.head);
+    ring->cq.ktail = (volatile uint32_t *)(base + p->cq_off.tail);
+    ring->cq.cqes = (struct uring_cqe *)(base + p->cq_off.cqes);
+    ring->cq.ring_mask = *(uint32_t *)(base + p->cq_off.ring_mask);
+
+    return 0;
+}
+
+int uring_queue_init(unsigned entries, struct uring *ring, unsigned flags) {
+    struct uring_params p;
+
+    memset(&p, 0, sizeof(p));
+    p.flags = flags;
+    return uring_queue_init_params(entries, ring, &p);
+}
+
+void uring_queue_exit(struct uring *ring) {
+    syscall(SYS_MUNMAP, ring->ring_ptr, ring->ring_size);
+    close(ring->ring_fd);
+    ring->ring_fd = -1;
+}
+
+/* Next free SQE, or NULL if the SQ is full until the kernel consumes some */
+struct uring_sqe *uring_get_sqe(struct uring *ring) {
+    uint32_t head = __atomic_load_n(ring->sq.khead, __ATOMIC_ACQUIRE);
+
+    if (ring->sq.sqe_tail - head >= ring->sq.ring_entries) {
+        return NULL;
+    }
+
+    return &ring->sq.sqes[ring->sq.sqe_tail++ & ring->sq.ring_mask];
+}
+
+/* Publish the SQEs handed out since the last flush; returns how many are pending */
+static uint32_t uring_flush_sq(struct uring *ring) {
+    uint32_t tail = *ring->sq.ktail;
+
+    while (ring->sq.sqe_head != ring->sq.sqe_tail) {
+        ring->sq.array[tail & ring->sq.ring_mask] = ring->sq.sqe_head & ring->sq.ring_mask;
+        ring->sq.sqe_head++;
+        tail++;
+    }
+
+    /* The kernel must see the SQEs and array slots before the new tail */
+    __atomic_store_n(ring->sq.ktail, tail, __ATOMIC_RELEASE);
+    return tail - __atomic_load_n(ring->sq.khead, __ATOMIC_ACQUIRE);
+}
+
+static int uring_submit_common(struct uring *ring, unsigned wait_nr) {
+    uint32_t submitted = uring_flush_sq(ring);
+    unsigned flags = wait_nr ? URING_ENTER_GETEVENTS : 0;
+
+    if (ring->flags & URING_SETUP_SQPOLL) {
+        /* The SQ thread picks the entries up; only a sleeping one needs a call */
+        if (__atomic_load_n(ring->sq.kflags, __ATOMIC_ACQUIRE) & URING_SQ_NEED_WAKEUP) {
+            flags |= URING_ENTER_SQ_WAKEUP;
+        }
+        if (!flags) {
+            return submitted;
+        }
+
+        int ret = uring_enter(ring->ring_fd, 0, wait_nr, flags);
+        return ret < 0 ? -errno : (int)submitted;
+    }
+
+    if (!submitted && !wait_nr) {
+        return 0;
+    }
+
+    int ret = uring_enter(ring->ring_fd, submitted, wait_nr, flags);
+    return ret < 0 ? -errno : ret;
+}
+
+/* Submit queued SQEs; returns the number submitted or a negative errno */
+int uring_submit(struct uring *ring) {
+    return uring_submit_common(ring, 0);
+}
+
+int uring_submit_and_wait(struct uring *ring, unsigned wait_nr) {
+    return uring_submit_common(ring, wait_nr);
+}
+
+int uring_peek_cqe(struct uring *ring, struct uring_cqe **cqe_ptr) {
+    uint32_t head = *ring->cq.khead;
+
+    if (head == __atomic_load_n(ring->cq.ktail, __ATOMIC_ACQUIRE)) {
+        *cqe_ptr = NULL;
+        return -EAGAIN;
+    }
+
+    *cqe_ptr = &ring->cq.cqes[head & ring->cq.ring_mask];
+    return 0;
+}
+
+int uring_wait_cqe(struct uring *ring, struct uring_cqe **cqe_ptr) {
+    while (uring_peek_cqe(ring, cqe_ptr) == -EAGAIN) {
+        if (uring_enter(ring->ring_fd, 0, 1, URING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            return -errno;
+        }
+    }
+
+    return 0;
+}
\ No newline at end of file